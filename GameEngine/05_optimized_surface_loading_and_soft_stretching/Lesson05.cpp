@@ -1,12 +1,30 @@
-// Using SDL and Standard IO
+// Using SDL, Standard IO, strings and vectors
 #include <SDL.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <vector>
+
+// Scale and blend four pixels at a time where SSE2 is available
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLITTER_SSE2
+#endif
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Most threads a blit is split across
+const int BLITTER_MAX_THREADS = 8;
+
+// Blits smaller than this many pixels stay on one thread
+const int BLITTER_THREAD_PIXELS = 256 * 256;
+
+// Blits timed per case by the benchmark
+const int BENCHMARK_BLITS = 20;
+
 // Starts up SDL and creates window
 bool init();
 
@@ -19,6 +37,98 @@ void close();
 // Loads individual image
 SDL_Surface* loadSurface(std::string path);
 
+// Scaling filters
+enum BlitFilter {
+	BLIT_NEAREST,
+	BLIT_LINEAR
+};
+
+// Scales 32-bit surfaces in software with large targets split across threads. SSE2 blends four pixels at a time and filters one,
+// nearest copies whole 1:1, 2:1 and 4:1 rows with it, other ratios gather a pixel at a time as SSE2 has no gather
+class LSurfaceBlitter {
+public:
+	// Initializes variables
+	LSurfaceBlitter();
+
+	// Deallocates memory
+	~LSurfaceBlitter();
+
+	// Starts the band threads, 0 uses one per CPU
+	bool init(int threads);
+
+	// Stops the band threads
+	void free();
+
+	// Scales src onto dst using the source's colour mod, alpha mod and blend mode, returns 0 on success like SDL_BlitScaled
+	int blitScaled(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, SDL_Rect* dstRect, BlitFilter filter);
+
+	// Gets how many threads share a large blit
+	int getThreadCount();
+
+private:
+	// Thread that blits one band of rows
+	struct Worker {
+		LSurfaceBlitter* blitter;
+		int band;
+		SDL_Thread* thread;
+		SDL_sem* start;
+
+		// Scaled row waiting to be blended
+		std::vector<Uint32> row;
+	};
+
+	// Blits one band of the current job
+	void blitBand(int band, std::vector<Uint32>& row);
+
+	// Scales one destination row
+	void scaleRowNearest(Uint32* out, int y);
+	void scaleRowLinear(Uint32* out, int y);
+
+	// Modulates and blends a scaled row onto the destination
+	void compositeRow(Uint32* out, const Uint32* in, int count);
+
+	// Band thread loop
+	static int bandThread(void* data);
+
+	// Band threads and the main thread's row
+	std::vector<Worker> mWorkers;
+	std::vector<Uint32> mRow;
+	SDL_sem* mDone;
+	SDL_atomic_t mQuit;
+
+	// The current job's pixels
+	Uint8* mSrcPixels;
+	int mSrcPitch;
+	Uint8* mDstPixels;
+	int mDstPitch;
+
+	// The current job's source and destination areas, and the clipped part of the destination
+	SDL_Rect mSrcRect;
+	SDL_Rect mDstRect;
+	SDL_Rect mClipRect;
+	BlitFilter mFilter;
+	int mBands;
+
+	// Destination columns per source column when nearest scales by a whole 1, 2 or 4, else 0
+	int mColumnRatio;
+
+	// Source column of each destination column, and its weight toward the next column for linear
+	std::vector<int> mColumns;
+	std::vector<int> mColumnWeights;
+
+	// Modulation of each byte of a pixel, and where alpha sits
+	Uint32 mModulation;
+	Uint32 mAlphaMask;
+	int mAlphaShift;
+	Uint8 mAlphaMod;
+	bool mModulate;
+	bool mBlend;
+	bool mSourceAlpha;
+};
+
+// Times SDL_BlitScaled against the surface blitter at 1080p and 4K
+void runBlitBenchmark();
+
 
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
@@ -29,6 +139,9 @@ SDL_Surface* gScreenSurface = NULL;
 // Current displayed image
 SDL_Surface* gStretchedSurface = NULL;
 
+// Software scaler for the window surface
+LSurfaceBlitter gBlitter;
+
 
 bool init() {
 	// Initialization flag
@@ -49,6 +162,12 @@ bool init() {
 		else {
 			// Get window surface
 			gScreenSurface = SDL_GetWindowSurface(gWindow);
+
+			// Start the blit threads
+			if (!gBlitter.init(0)) {
+				printf("Surface blitter could not be started!\n");
+				success = false;
+			}
 		}
 	}
 	return success;
@@ -70,6 +189,9 @@ void close() {
 	SDL_FreeSurface(gStretchedSurface);
 	gStretchedSurface = NULL;
 
+	// Stop the blit threads
+	gBlitter.free();
+
 	// Destroy Window
 	SDL_DestroyWindow(gWindow);
 	gWindow = NULL;
@@ -99,9 +221,511 @@ SDL_Surface* loadSurface(std::string path) {
 	return optimizedSurface;
 }
 
+#if defined(BLITTER_SSE2)
+// Multiplies 16-bit lanes and divides by 255, rounded
+static inline __m128i mulDiv255(__m128i a, __m128i b) {
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+#endif
+
+// Divides by 255, rounded
+static inline Uint32 div255(Uint32 x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+LSurfaceBlitter::LSurfaceBlitter() {
+	// Initialize
+	mDone = NULL;
+	SDL_AtomicSet(&mQuit, 0);
+
+	mSrcPixels = NULL;
+	mSrcPitch = 0;
+	mDstPixels = NULL;
+	mDstPitch = 0;
+	mFilter = BLIT_NEAREST;
+	mBands = 1;
+
+	mModulation = 0xFFFFFFFF;
+	mAlphaMask = 0;
+	mAlphaShift = 0;
+	mAlphaMod = 0xFF;
+	mModulate = false;
+	mBlend = false;
+	mSourceAlpha = false;
+}
+
+LSurfaceBlitter::~LSurfaceBlitter() {
+	// Deallocate
+	free();
+}
+
+bool LSurfaceBlitter::init(int threads) {
+	// Get rid of preexisting threads
+	free();
+
+	// One band per CPU by default, the main thread takes the first
+	if (threads <= 0) {
+		threads = SDL_GetCPUCount();
+	}
+	threads = SDL_max(1, SDL_min(threads, BLITTER_MAX_THREADS));
+
+	SDL_AtomicSet(&mQuit, 0);
+	mDone = SDL_CreateSemaphore(0);
+	if (mDone == NULL) {
+		printf("Unable to create semaphore! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	mWorkers.resize(threads - 1);
+	for (int i = 0; i < threads - 1; ++i) {
+		mWorkers[i].blitter = this;
+		mWorkers[i].band = i + 1;
+		mWorkers[i].start = SDL_CreateSemaphore(0);
+		mWorkers[i].thread = mWorkers[i].start != NULL ? SDL_CreateThread(bandThread, "Blit band", &mWorkers[i]) : NULL;
+		if (mWorkers[i].thread == NULL) {
+			printf("Unable to start blit thread! SDL Error: %s\n", SDL_GetError());
+			mWorkers.resize(i + 1);
+			free();
+			return false;
+		}
+	}
+	return true;
+}
+
+void LSurfaceBlitter::free() {
+	// Wake every worker to quit
+	SDL_AtomicSet(&mQuit, 1);
+	for (size_t i = 0; i < mWorkers.size(); ++i) {
+		if (mWorkers[i].thread != NULL) {
+			SDL_SemPost(mWorkers[i].start);
+			SDL_WaitThread(mWorkers[i].thread, NULL);
+		}
+		if (mWorkers[i].start != NULL) {
+			SDL_DestroySemaphore(mWorkers[i].start);
+		}
+	}
+	mWorkers.clear();
+	if (mDone != NULL) {
+		SDL_DestroySemaphore(mDone);
+		mDone = NULL;
+	}
+}
+
+int LSurfaceBlitter::blitScaled(SDL_Surface* src, const SDL_Rect* srcRect, SDL_Surface* dst, SDL_Rect* dstRect, BlitFilter filter) {
+	if (src == NULL || dst == NULL) {
+		return SDL_SetError("Blit surfaces can't be NULL");
+	}
+
+	// Whole surfaces unless told otherwise
+	SDL_Rect srcBounds = { 0, 0, src->w, src->h };
+	SDL_Rect dstBounds = { 0, 0, dst->w, dst->h };
+	mSrcRect = srcRect != NULL ? *srcRect : srcBounds;
+	mDstRect = dstRect != NULL ? *dstRect : dstBounds;
+
+	// Anything but same format 32-bit blits inside the source, unblended or alpha blended without a colour key, goes to SDL
+	SDL_BlendMode blendMode;
+	SDL_GetSurfaceBlendMode(src, &blendMode);
+	SDL_Rect srcInside;
+	Uint32 colorKey;
+	if (src->format->format != dst->format->format || src->format->BytesPerPixel != 4
+		|| (blendMode != SDL_BLENDMODE_NONE && blendMode != SDL_BLENDMODE_BLEND) || SDL_GetColorKey(src, &colorKey) == 0
+		|| !SDL_IntersectRect(&mSrcRect, &srcBounds, &srcInside) || !SDL_RectEquals(&srcInside, &mSrcRect)) {
+		return SDL_BlitScaled(src, srcRect, dst, dstRect);
+	}
+
+	// Clip to the destination, reporting the area drawn like SDL does
+	if (mDstRect.w <= 0 || mDstRect.h <= 0 || !SDL_IntersectRect(&mDstRect, &dst->clip_rect, &mClipRect)) {
+		if (dstRect != NULL) {
+			dstRect->w = 0;
+			dstRect->h = 0;
+		}
+		return 0;
+	}
+	if (dstRect != NULL) {
+		*dstRect = mClipRect;
+	}
+
+	// Linear needs a neighbour on each axis
+	mFilter = filter == BLIT_LINEAR && mSrcRect.w > 1 && mSrcRect.h > 1 ? BLIT_LINEAR : BLIT_NEAREST;
+
+	// Whole ratios repeat each source column the same number of times
+	mColumnRatio = 0;
+	if (mFilter == BLIT_NEAREST) {
+		for (int ratio = 1; ratio <= 4; ratio *= 2) {
+			if (mDstRect.w == mSrcRect.w * ratio) {
+				mColumnRatio = ratio;
+			}
+		}
+	}
+
+	// Map each destination column to the source once for the whole blit
+	mColumns.resize(mClipRect.w);
+	mColumnWeights.resize(mClipRect.w);
+	for (int i = 0; i < mClipRect.w; ++i) {
+		Sint64 column = mClipRect.x - mDstRect.x + i;
+		if (mFilter == BLIT_LINEAR) {
+			// Pixel centres in 1/128ths, clamped to the edges
+			Sint64 position = (2 * column + 1) * mSrcRect.w * 128 / (2 * mDstRect.w) - 64;
+			position = position < 0 ? 0 : (position > (mSrcRect.w - 1) * 128 ? (mSrcRect.w - 1) * 128 : position);
+			int x = (int)(position >> 7);
+			int weight = (int)(position & 127);
+			if (x >= mSrcRect.w - 1) {
+				x = mSrcRect.w - 2;
+				weight = 128;
+			}
+			mColumns[i] = mSrcRect.x + x;
+			mColumnWeights[i] = weight;
+		}
+		else {
+			mColumns[i] = mSrcRect.x + (int)((2 * column + 1) * mSrcRect.w / (2 * mDstRect.w));
+			mColumnWeights[i] = 0;
+		}
+	}
+
+	// Modulation for each byte of the pixel, leaving any unused byte alone
+	SDL_PixelFormat* format = src->format;
+	Uint8 r, g, b;
+	SDL_GetSurfaceColorMod(src, &r, &g, &b);
+	SDL_GetSurfaceAlphaMod(src, &mAlphaMod);
+	mModulation = 0xFFFFFFFF;
+	mModulation = (mModulation & ~format->Rmask) | ((Uint32)r << format->Rshift);
+	mModulation = (mModulation & ~format->Gmask) | ((Uint32)g << format->Gshift);
+	mModulation = (mModulation & ~format->Bmask) | ((Uint32)b << format->Bshift);
+	if (format->Amask != 0) {
+		mModulation = (mModulation & ~format->Amask) | ((Uint32)mAlphaMod << format->Ashift);
+	}
+	mAlphaMask = format->Amask;
+	mAlphaShift = format->Ashift;
+	mSourceAlpha = format->Amask != 0;
+	mModulate = mModulation != 0xFFFFFFFF;
+	mBlend = blendMode == SDL_BLENDMODE_BLEND && (mSourceAlpha || mAlphaMod < 0xFF);
+
+	// Lock pixels for the blit
+	if (SDL_MUSTLOCK(src)) {
+		SDL_LockSurface(src);
+	}
+	if (SDL_MUSTLOCK(dst)) {
+		SDL_LockSurface(dst);
+	}
+	mSrcPixels = (Uint8*)src->pixels;
+	mSrcPitch = src->pitch;
+	mDstPixels = (Uint8*)dst->pixels;
+	mDstPitch = dst->pitch;
+
+	// Split large blits into bands of rows, the main thread takes the first
+	mBands = 1;
+	if (!mWorkers.empty() && mClipRect.w * mClipRect.h >= BLITTER_THREAD_PIXELS) {
+		mBands = SDL_min((int)mWorkers.size() + 1, mClipRect.h);
+	}
+	mRow.resize(mClipRect.w);
+	for (int i = 0; i < mBands - 1; ++i) {
+		mWorkers[i].row.resize(mClipRect.w);
+		SDL_SemPost(mWorkers[i].start);
+	}
+	blitBand(0, mRow);
+	for (int i = 0; i < mBands - 1; ++i) {
+		SDL_SemWait(mDone);
+	}
+
+	// Unlock pixels
+	if (SDL_MUSTLOCK(dst)) {
+		SDL_UnlockSurface(dst);
+	}
+	if (SDL_MUSTLOCK(src)) {
+		SDL_UnlockSurface(src);
+	}
+	return 0;
+}
+
+int LSurfaceBlitter::getThreadCount() {
+	return (int)mWorkers.size() + 1;
+}
+
+void LSurfaceBlitter::blitBand(int band, std::vector<Uint32>& row) {
+	// Unmodulated, unblended rows are scaled straight into the destination
+	bool direct = !mModulate && !mBlend;
+	int firstRow = mClipRect.y + mClipRect.h * band / mBands;
+	int lastRow = mClipRect.y + mClipRect.h * (band + 1) / mBands;
+	for (int y = firstRow; y < lastRow; ++y) {
+		Uint32* out = (Uint32*)(mDstPixels + y * mDstPitch) + mClipRect.x;
+		Uint32* scaled = direct ? out : &row[0];
+		if (mFilter == BLIT_LINEAR) {
+			scaleRowLinear(scaled, y);
+		}
+		else {
+			scaleRowNearest(scaled, y);
+		}
+		if (!direct) {
+			compositeRow(out, scaled, mClipRect.w);
+		}
+	}
+}
+
+void LSurfaceBlitter::scaleRowNearest(Uint32* out, int y) {
+	// Source row nearest this row's centre
+	Sint64 row = y - mDstRect.y;
+	int sourceY = mSrcRect.y + (int)((2 * row + 1) * mSrcRect.h / (2 * mDstRect.h));
+	const Uint32* in = (const Uint32*)(mSrcPixels + sourceY * mSrcPitch);
+
+	// Locals so writes through out aren't taken to change them
+	const int* columns = &mColumns[0];
+	int width = mClipRect.w;
+	int i = 0;
+
+	// Same size rows are a straight copy
+	if (mColumnRatio == 1) {
+		memcpy(out, in + columns[0], width * sizeof(Uint32));
+		return;
+	}
+#if defined(BLITTER_SSE2)
+	// Doubled or quadrupled columns, starting once the output lines up with a source pixel
+	int ratio = mColumnRatio;
+	int firstColumn = mClipRect.x - mDstRect.x;
+	if (ratio == 2) {
+		for (; i < width && (firstColumn + i) % 2 != 0; ++i) {
+			out[i] = in[columns[i]];
+		}
+		for (; i + 4 <= width; i += 4) {
+			__m128i pixels = _mm_loadl_epi64((const __m128i*)(in + columns[i]));
+			_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi32(pixels, pixels));
+		}
+	}
+	else if (ratio == 4) {
+		for (; i < width && (firstColumn + i) % 4 != 0; ++i) {
+			out[i] = in[columns[i]];
+		}
+		for (; i + 4 <= width; i += 4) {
+			_mm_storeu_si128((__m128i*)(out + i), _mm_set1_epi32((int)in[columns[i]]));
+		}
+	}
+#endif
+	for (; i < width; ++i) {
+		out[i] = in[columns[i]];
+	}
+}
+
+void LSurfaceBlitter::scaleRowLinear(Uint32* out, int y) {
+	// The two source rows either side of this row's centre
+	Sint64 row = y - mDstRect.y;
+	Sint64 position = (2 * row + 1) * mSrcRect.h * 128 / (2 * mDstRect.h) - 64;
+	position = position < 0 ? 0 : (position > (mSrcRect.h - 1) * 128 ? (mSrcRect.h - 1) * 128 : position);
+	int sourceY = (int)(position >> 7);
+	int rowWeight = (int)(position & 127);
+	if (sourceY >= mSrcRect.h - 1) {
+		sourceY = mSrcRect.h - 2;
+		rowWeight = 128;
+	}
+	const Uint32* top = (const Uint32*)(mSrcPixels + (mSrcRect.y + sourceY) * mSrcPitch);
+	const Uint32* bottom = (const Uint32*)((const Uint8*)top + mSrcPitch);
+
+	const int* columns = &mColumns[0];
+	const int* weights = &mColumnWeights[0];
+	int width = mClipRect.w;
+#if defined(BLITTER_SSE2)
+	// Both neighbours of a pixel are loaded together and blended as 16-bit lanes
+	__m128i zero = _mm_setzero_si128();
+	__m128i verticalWeight = _mm_set1_epi16((short)rowWeight);
+	__m128i round = _mm_set1_epi16(64);
+	for (int i = 0; i < width; ++i) {
+		__m128i upper = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(top + columns[i])), zero);
+		__m128i lower = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(bottom + columns[i])), zero);
+		__m128i blended = _mm_add_epi16(upper, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(lower, upper), verticalWeight), round), 7));
+		__m128i right = _mm_srli_si128(blended, 8);
+		blended = _mm_add_epi16(blended, _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(right, blended), _mm_set1_epi16((short)weights[i])), round), 7));
+		out[i] = (Uint32)_mm_cvtsi128_si32(_mm_packus_epi16(blended, blended));
+	}
+#else
+	for (int i = 0; i < width; ++i) {
+		Uint32 topLeft = top[columns[i]];
+		Uint32 topRight = top[columns[i] + 1];
+		Uint32 bottomLeft = bottom[columns[i]];
+		Uint32 bottomRight = bottom[columns[i] + 1];
+
+		// Same steps as the wide path, a byte at a time
+		Uint32 pixel = 0;
+		for (int shift = 0; shift < 32; shift += 8) {
+			int left = (int)((topLeft >> shift) & 0xFF);
+			int right = (int)((topRight >> shift) & 0xFF);
+			left += (((int)((bottomLeft >> shift) & 0xFF) - left) * rowWeight + 64) >> 7;
+			right += (((int)((bottomRight >> shift) & 0xFF) - right) * rowWeight + 64) >> 7;
+			pixel |= (Uint32)(left + (((right - left) * weights[i] + 64) >> 7)) << shift;
+		}
+		out[i] = pixel;
+	}
+#endif
+}
+
+void LSurfaceBlitter::compositeRow(Uint32* out, const Uint32* in, int count) {
+	// Locals so writes through out aren't taken to change them
+	bool modulate = mModulate;
+	bool blend = mBlend;
+	bool sourceAlpha = mSourceAlpha;
+	int i = 0;
+#if defined(BLITTER_SSE2)
+	__m128i zero = _mm_setzero_si128();
+	__m128i modulation = _mm_unpacklo_epi8(_mm_set1_epi32((int)mModulation), zero);
+	__m128i alphaShift = _mm_cvtsi32_si128(mAlphaShift);
+	__m128i byteMask = _mm_set1_epi32(0xFF);
+	__m128i alphaLane = _mm_set1_epi32((int)mAlphaMask);
+	__m128i constantAlpha = _mm_set1_epi32(mAlphaMod);
+	__m128i ones = _mm_set1_epi32(-1);
+	for (; i + 4 <= count; i += 4) {
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i low = _mm_unpacklo_epi8(pixels, zero);
+		__m128i high = _mm_unpackhi_epi8(pixels, zero);
+
+		// Colour and alpha mod
+		if (modulate) {
+			low = mulDiv255(low, modulation);
+			high = mulDiv255(high, modulation);
+			pixels = _mm_packus_epi16(low, high);
+		}
+
+		// Source over destination, alpha itself accumulates as a + d(1 - a)
+		if (blend) {
+			__m128i alpha = sourceAlpha ? _mm_and_si128(_mm_srl_epi32(pixels, alphaShift), byteMask) : constantAlpha;
+			alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+			alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+			__m128i sourceWeight = _mm_or_si128(alpha, alphaLane);
+			__m128i destWeight = _mm_xor_si128(alpha, ones);
+			__m128i dest = _mm_loadu_si128((const __m128i*)(out + i));
+			low = _mm_add_epi16(mulDiv255(low, _mm_unpacklo_epi8(sourceWeight, zero)), mulDiv255(_mm_unpacklo_epi8(dest, zero), _mm_unpacklo_epi8(destWeight, zero)));
+			high = _mm_add_epi16(mulDiv255(high, _mm_unpackhi_epi8(sourceWeight, zero)), mulDiv255(_mm_unpackhi_epi8(dest, zero), _mm_unpackhi_epi8(destWeight, zero)));
+			pixels = _mm_packus_epi16(low, high);
+		}
+		_mm_storeu_si128((__m128i*)(out + i), pixels);
+	}
+#endif
+	for (; i < count; ++i) {
+		Uint32 pixel = in[i];
+
+		// Colour and alpha mod
+		if (modulate) {
+			Uint32 modulated = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				modulated |= div255(((pixel >> shift) & 0xFF) * ((mModulation >> shift) & 0xFF)) << shift;
+			}
+			pixel = modulated;
+		}
+
+		// Source over destination
+		if (blend) {
+			Uint32 alpha = sourceAlpha ? (pixel >> mAlphaShift) & 0xFF : mAlphaMod;
+			Uint32 dest = out[i];
+			Uint32 blended = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				Uint32 sourceWeight = ((mAlphaMask >> shift) & 0xFF) != 0 ? 0xFF : alpha;
+				Uint32 value = div255(((pixel >> shift) & 0xFF) * sourceWeight) + div255(((dest >> shift) & 0xFF) * (0xFF - alpha));
+				blended |= (value > 0xFF ? 0xFF : value) << shift;
+			}
+			pixel = blended;
+		}
+		out[i] = pixel;
+	}
+}
+
+int LSurfaceBlitter::bandThread(void* data) {
+	Worker* worker = (Worker*)data;
+	LSurfaceBlitter* blitter = worker->blitter;
+
+	// Blit this band each time a job starts
+	while (true) {
+		SDL_SemWait(worker->start);
+		if (SDL_AtomicGet(&blitter->mQuit)) {
+			break;
+		}
+		blitter->blitBand(worker->band, worker->row);
+		SDL_SemPost(blitter->mDone);
+	}
+	return 0;
+}
+
+double timeBlits(LSurfaceBlitter* blitter, SDL_Surface* src, SDL_Surface* dst, BlitFilter filter) {
+	// SDL's own blitter when none is given
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_BLITS; ++i) {
+		SDL_Rect stretchRect = { 0, 0, dst->w, dst->h };
+		if (blitter != NULL) {
+			blitter->blitScaled(src, NULL, dst, &stretchRect, filter);
+		}
+		else {
+			SDL_BlitScaled(src, NULL, dst, &stretchRect);
+		}
+	}
+	return (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / BENCHMARK_BLITS;
+}
+
+void runBlitBenchmark() {
+	// Initialize SDL for its timers and threads
+	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+		return;
+	}
+
+	// A lesson sized image with some transparency
+	SDL_Surface* source = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (source == NULL) {
+		printf("Unable to create benchmark surface! SDL Error: %s\n", SDL_GetError());
+		SDL_Quit();
+		return;
+	}
+	Uint32* pixels = (Uint32*)source->pixels;
+	for (int i = 0; i < source->h * source->pitch / 4; ++i) {
+		pixels[i] = (Uint32)rand() ^ ((Uint32)rand() << 16);
+	}
+
+	// One blitter on the calling thread only, one spread over every CPU
+	LSurfaceBlitter single;
+	LSurfaceBlitter threaded;
+	if (!single.init(1) || !threaded.init(0)) {
+		single.free();
+		threaded.free();
+		SDL_FreeSurface(source);
+		SDL_Quit();
+		return;
+	}
+
+	// Double size takes the whole ratio path for nearest
+	const int sizes[3][2] = { { SCREEN_WIDTH * 2, SCREEN_HEIGHT * 2 }, { 1920, 1080 }, { 3840, 2160 } };
+	for (int s = 0; s < 3; ++s) {
+		SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, sizes[s][0], sizes[s][1], 32, SDL_PIXELFORMAT_ARGB8888);
+		if (target == NULL) {
+			printf("Unable to create benchmark surface! SDL Error: %s\n", SDL_GetError());
+			continue;
+		}
+
+		// Straight copies
+		SDL_SetSurfaceBlendMode(source, SDL_BLENDMODE_NONE);
+		SDL_SetSurfaceColorMod(source, 0xFF, 0xFF, 0xFF);
+		printf("%dx%d copy: SDL_BlitScaled %.2f ms, nearest %.2f ms, nearest on %d threads %.2f ms, linear on %d threads %.2f ms\n", target->w, target->h,
+			timeBlits(NULL, source, target, BLIT_NEAREST), timeBlits(&single, source, target, BLIT_NEAREST),
+			threaded.getThreadCount(), timeBlits(&threaded, source, target, BLIT_NEAREST), threaded.getThreadCount(), timeBlits(&threaded, source, target, BLIT_LINEAR));
+
+		// Tinted and alpha blended
+		SDL_SetSurfaceBlendMode(source, SDL_BLENDMODE_BLEND);
+		SDL_SetSurfaceColorMod(source, 0xFF, 0x80, 0x40);
+		printf("%dx%d blend: SDL_BlitScaled %.2f ms, nearest %.2f ms, nearest on %d threads %.2f ms, linear on %d threads %.2f ms\n", target->w, target->h,
+			timeBlits(NULL, source, target, BLIT_NEAREST), timeBlits(&single, source, target, BLIT_NEAREST),
+			threaded.getThreadCount(), timeBlits(&threaded, source, target, BLIT_NEAREST), threaded.getThreadCount(), timeBlits(&threaded, source, target, BLIT_LINEAR));
+
+		SDL_FreeSurface(target);
+	}
+
+	// Threads stop before SDL does
+	single.free();
+	threaded.free();
+	SDL_FreeSurface(source);
+	SDL_Quit();
+}
 
 int main(int argc, char* args[])
 {
+	// Time the blitter instead of running the lesson
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		runBlitBenchmark();
+		return 0;
+	}
 
 	if (!init()) {
 		printf("Failed to Initialize! \n");
@@ -136,7 +760,7 @@ int main(int argc, char* args[])
 				stretchRect.y = 0;
 				stretchRect.w = SCREEN_WIDTH;
 				stretchRect.h = SCREEN_HEIGHT;
-				SDL_BlitScaled(gStretchedSurface, NULL, gScreenSurface, &stretchRect);
+				gBlitter.blitScaled(gStretchedSurface, NULL, gScreenSurface, &stretchRect, BLIT_NEAREST);
 
 				// Update the surface
 				SDL_UpdateWindowSurface(gWindow);
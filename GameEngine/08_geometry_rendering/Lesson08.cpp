@@ -1,12 +1,82 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Debug draw colors
+const SDL_Color DEBUG_RED = { 0xFF, 0x00, 0x00, 0xFF };
+const SDL_Color DEBUG_GREEN = { 0x00, 0xFF, 0x00, 0xFF };
+const SDL_Color DEBUG_BLUE = { 0x00, 0x00, 0xFF, 0xFF };
+const SDL_Color DEBUG_YELLOW = { 0xFF, 0xFF, 0x00, 0xFF };
+
+// Primitives and frames drawn by the benchmark
+const int BENCHMARK_PRIMITIVES = 50000;
+const int BENCHMARK_FRAMES = 20;
+
+// Immediate mode debug drawing, primitives are queued per color and drawn a batch at a time
+class LDebugDraw {
+public:
+	// Initializes variables
+	LDebugDraw();
+
+	// Queue primitives in a color
+	void point(int x, int y, SDL_Color color);
+	void line(int x1, int y1, int x2, int y2, SDL_Color color);
+	void rect(SDL_Rect box, SDL_Color color);
+	void fillRect(SDL_Rect box, SDL_Color color);
+
+	// Draws everything queued, fills first then outlines, lines and points, and empties the queue
+	void flush(SDL_Renderer* renderer);
+
+	// Gets the number of SDL draw calls the last flush made
+	int getDrawCalls();
+
+private:
+	// Everything queued in one color
+	struct Batch {
+		SDL_Color color;
+		std::vector<SDL_Point> points;
+		std::vector<SDL_Rect> rects;
+		std::vector<SDL_Rect> fillRects;
+
+		// Lines are kept as strips, a segment starting where the last ended extends the strip
+		std::vector<SDL_Point> lines;
+		std::vector<int> stripStarts;
+	};
+
+	// Finds or adds the batch for a color
+	Batch& getBatch(SDL_Color color);
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	// Queues the triangles of a quad, corners in order around it
+	void addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, SDL_Color color);
+
+	// Queues a one pixel wide line through the centres of the pixels from a to b
+	void addLine(SDL_Point a, SDL_Point b, SDL_Color color);
+
+	// Queues everything as triangles and draws them in one call, false if the renderer refuses
+	bool flushGeometry(SDL_Renderer* renderer);
+
+	// Triangles for the geometry path, kept between frames
+	std::vector<SDL_Vertex> mVertices;
+	std::vector<int> mIndices;
+#endif
+
+	// Batches in the order their colors were first used
+	std::vector<Batch> mBatches;
+	int mLastBatch;
+
+	// Draw calls made by the last flush
+	int mDrawCalls;
+};
+
 // Starts up SDL and creates window
 bool init();
 
@@ -19,6 +89,9 @@ void close();
 // Loads individual image as texture
 SDL_Texture* loadTexture(std::string path);
 
+// Times drawing primitives one call at a time against batching them
+void runDebugDrawBenchmark();
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -28,6 +101,256 @@ SDL_Renderer* gRenderer = NULL;
 // Current displayed texture
 SDL_Texture* gTexture = NULL;
 
+// Queued debug shapes
+LDebugDraw gDebugDraw;
+
+LDebugDraw::LDebugDraw() {
+	// Initialize
+	mLastBatch = 0;
+	mDrawCalls = 0;
+}
+
+void LDebugDraw::point(int x, int y, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	SDL_Point p = { x, y };
+	getBatch(color).points.push_back(p);
+#endif
+}
+
+void LDebugDraw::line(int x1, int y1, int x2, int y2, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	Batch& batch = getBatch(color);
+
+	// Start a new strip unless this segment carries on from the last one
+	if (batch.lines.empty() || batch.lines.back().x != x1 || batch.lines.back().y != y1) {
+		SDL_Point start = { x1, y1 };
+		batch.stripStarts.push_back((int)batch.lines.size());
+		batch.lines.push_back(start);
+	}
+	SDL_Point end = { x2, y2 };
+	batch.lines.push_back(end);
+#endif
+}
+
+void LDebugDraw::rect(SDL_Rect box, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	getBatch(color).rects.push_back(box);
+#endif
+}
+
+void LDebugDraw::fillRect(SDL_Rect box, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	getBatch(color).fillRects.push_back(box);
+#endif
+}
+
+void LDebugDraw::flush(SDL_Renderer* renderer) {
+	mDrawCalls = 0;
+#if !defined(DISABLE_DEBUG_DRAW)
+	// Keep the caller's draw color
+	Uint8 r, g, b, a;
+	SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	// Every primitive as quads in a single call, per-draw calls only if that fails
+	bool drawn = flushGeometry(renderer);
+#else
+	bool drawn = false;
+#endif
+
+	// Layer by kind so the result doesn't depend on the order colors were used
+	for (int pass = 0; !drawn && pass < 4; ++pass) {
+		for (size_t i = 0; i < mBatches.size(); ++i) {
+			Batch& batch = mBatches[i];
+			bool empty = (pass == 0 && batch.fillRects.empty()) || (pass == 1 && batch.rects.empty()) || (pass == 2 && batch.lines.empty()) || (pass == 3 && batch.points.empty());
+			if (empty) {
+				continue;
+			}
+			SDL_SetRenderDrawColor(renderer, batch.color.r, batch.color.g, batch.color.b, batch.color.a);
+			if (pass == 0) {
+				SDL_RenderFillRects(renderer, &batch.fillRects[0], (int)batch.fillRects.size());
+				++mDrawCalls;
+			}
+			else if (pass == 1) {
+				SDL_RenderDrawRects(renderer, &batch.rects[0], (int)batch.rects.size());
+				++mDrawCalls;
+			}
+			else if (pass == 2) {
+				for (size_t s = 0; s < batch.stripStarts.size(); ++s) {
+					int start = batch.stripStarts[s];
+					int end = s + 1 < batch.stripStarts.size() ? batch.stripStarts[s + 1] : (int)batch.lines.size();
+					SDL_RenderDrawLines(renderer, &batch.lines[start], end - start);
+					++mDrawCalls;
+				}
+			}
+			else {
+				SDL_RenderDrawPoints(renderer, &batch.points[0], (int)batch.points.size());
+				++mDrawCalls;
+			}
+		}
+	}
+	SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+	// Empty the queue but keep the memory for the next frame, dropping colors that went unused
+	size_t kept = 0;
+	for (size_t i = 0; i < mBatches.size(); ++i) {
+		Batch& batch = mBatches[i];
+		bool used = !batch.points.empty() || !batch.rects.empty() || !batch.fillRects.empty() || !batch.lines.empty();
+		batch.points.clear();
+		batch.rects.clear();
+		batch.fillRects.clear();
+		batch.lines.clear();
+		batch.stripStarts.clear();
+		if (used) {
+			if (kept != i) {
+				std::swap(mBatches[kept], batch);
+			}
+			++kept;
+		}
+	}
+	mBatches.resize(kept);
+	mLastBatch = 0;
+#endif
+}
+
+int LDebugDraw::getDrawCalls() {
+	return mDrawCalls;
+}
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+void LDebugDraw::addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, SDL_Color color) {
+	int first = (int)mVertices.size();
+	SDL_Vertex corners[4] = {
+		{ { x1, y1 }, color, { 0.0f, 0.0f } },
+		{ { x2, y2 }, color, { 0.0f, 0.0f } },
+		{ { x3, y3 }, color, { 0.0f, 0.0f } },
+		{ { x4, y4 }, color, { 0.0f, 0.0f } }
+	};
+	mVertices.insert(mVertices.end(), corners, corners + 4);
+	int indices[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+	mIndices.insert(mIndices.end(), indices, indices + 6);
+}
+
+void LDebugDraw::addLine(SDL_Point a, SDL_Point b, SDL_Color color) {
+	// A band one pixel across the minor axis, covering one pixel per step along the major axis like a drawn line
+	int dx = b.x - a.x;
+	int dy = b.y - a.y;
+	if (SDL_abs(dx) >= SDL_abs(dy)) {
+		if (dx < 0) {
+			std::swap(a, b);
+			dx = -dx;
+			dy = -dy;
+		}
+		float slope = dx != 0 ? (float)dy / dx : 0.0f;
+		float y1 = a.y - slope * 0.5f;
+		float y2 = b.y + slope * 0.5f;
+		addQuad((float)a.x, y1, (float)b.x + 1, y2, (float)b.x + 1, y2 + 1, (float)a.x, y1 + 1, color);
+	}
+	else {
+		if (dy < 0) {
+			std::swap(a, b);
+			dx = -dx;
+			dy = -dy;
+		}
+		float slope = (float)dx / dy;
+		float x1 = a.x - slope * 0.5f;
+		float x2 = b.x + slope * 0.5f;
+		addQuad(x1, (float)a.y, x1 + 1, (float)a.y, x2 + 1, (float)b.y + 1, x2, (float)b.y + 1, color);
+	}
+}
+
+bool LDebugDraw::flushGeometry(SDL_Renderer* renderer) {
+	// Same layering as the draw calls, triangles are drawn in the order they're queued
+	mVertices.clear();
+	mIndices.clear();
+	for (int pass = 0; pass < 4; ++pass) {
+		for (size_t i = 0; i < mBatches.size(); ++i) {
+			Batch& batch = mBatches[i];
+			SDL_Color color = batch.color;
+			if (pass == 0) {
+				for (size_t r = 0; r < batch.fillRects.size(); ++r) {
+					SDL_Rect& box = batch.fillRects[r];
+					if (box.w > 0 && box.h > 0) {
+						addQuad((float)box.x, (float)box.y, (float)(box.x + box.w), (float)box.y, (float)(box.x + box.w), (float)(box.y + box.h), (float)box.x, (float)(box.y + box.h), color);
+					}
+				}
+			}
+			else if (pass == 1) {
+				// Top and bottom edges, then the sides between them so corners aren't covered twice
+				for (size_t r = 0; r < batch.rects.size(); ++r) {
+					SDL_Rect& box = batch.rects[r];
+					if (box.w <= 0 || box.h <= 0) {
+						continue;
+					}
+					float left = (float)box.x;
+					float top = (float)box.y;
+					float right = (float)(box.x + box.w);
+					float bottom = (float)(box.y + box.h);
+					addQuad(left, top, right, top, right, top + 1, left, top + 1, color);
+					if (box.h > 1) {
+						addQuad(left, bottom - 1, right, bottom - 1, right, bottom, left, bottom, color);
+					}
+					if (box.h > 2) {
+						addQuad(left, top + 1, left + 1, top + 1, left + 1, bottom - 1, left, bottom - 1, color);
+						if (box.w > 1) {
+							addQuad(right - 1, top + 1, right, top + 1, right, bottom - 1, right - 1, bottom - 1, color);
+						}
+					}
+				}
+			}
+			else if (pass == 2) {
+				// Joints between segments of a strip are covered twice, which only shows with translucent colors
+				for (size_t s = 0; s < batch.stripStarts.size(); ++s) {
+					int start = batch.stripStarts[s];
+					int end = s + 1 < batch.stripStarts.size() ? batch.stripStarts[s + 1] : (int)batch.lines.size();
+					for (int p = start; p + 1 < end; ++p) {
+						addLine(batch.lines[p], batch.lines[p + 1], color);
+					}
+				}
+			}
+			else {
+				for (size_t p = 0; p < batch.points.size(); ++p) {
+					float x = (float)batch.points[p].x;
+					float y = (float)batch.points[p].y;
+					addQuad(x, y, x + 1, y, x + 1, y + 1, x, y + 1, color);
+				}
+			}
+		}
+	}
+	if (mIndices.empty()) {
+		return true;
+	}
+	if (SDL_RenderGeometry(renderer, NULL, &mVertices[0], (int)mVertices.size(), &mIndices[0], (int)mIndices.size()) < 0) {
+		return false;
+	}
+	++mDrawCalls;
+	return true;
+}
+#endif
+
+LDebugDraw::Batch& LDebugDraw::getBatch(SDL_Color color) {
+	// Primitives tend to come in runs of one color
+	if (mLastBatch < (int)mBatches.size()) {
+		SDL_Color last = mBatches[mLastBatch].color;
+		if (last.r == color.r && last.g == color.g && last.b == color.b && last.a == color.a) {
+			return mBatches[mLastBatch];
+		}
+	}
+
+	// Otherwise look through the colors in use
+	for (size_t i = 0; i < mBatches.size(); ++i) {
+		SDL_Color other = mBatches[i].color;
+		if (other.r == color.r && other.g == color.g && other.b == color.b && other.a == color.a) {
+			mLastBatch = (int)i;
+			return mBatches[i];
+		}
+	}
+	mBatches.push_back(Batch());
+	mBatches.back().color = color;
+	mLastBatch = (int)mBatches.size() - 1;
+	return mBatches.back();
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -106,8 +429,87 @@ SDL_Texture* loadTexture(std::string path) {
 
 }
 
+void runDebugDrawBenchmark() {
+	// Draw into memory so no window is needed
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	SDL_Renderer* renderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+	if (renderer == NULL) {
+		printf("Unable to create software renderer! SDL Error: %s\n", SDL_GetError());
+		SDL_FreeSurface(surface);
+		return;
+	}
+
+	// An overlay of points, segments and boxes in a few colors
+	SDL_Color colors[] = { DEBUG_RED, DEBUG_GREEN, DEBUG_BLUE, DEBUG_YELLOW };
+	std::vector<SDL_Rect> shapes(BENCHMARK_PRIMITIVES);
+	srand(1);
+	for (int i = 0; i < BENCHMARK_PRIMITIVES; ++i) {
+		shapes[i].x = rand() % SCREEN_WIDTH;
+		shapes[i].y = rand() % SCREEN_HEIGHT;
+		shapes[i].w = rand() % 16 + 1;
+		shapes[i].h = rand() % 16 + 1;
+	}
+	double frequency = (double)SDL_GetPerformanceFrequency();
+
+	// One call per primitive
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+		for (int i = 0; i < BENCHMARK_PRIMITIVES; ++i) {
+			SDL_Color color = colors[i % 4];
+			SDL_Rect& shape = shapes[i];
+			SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+			if (i % 3 == 0) {
+				SDL_RenderDrawPoint(renderer, shape.x, shape.y);
+			}
+			else if (i % 3 == 1) {
+				SDL_RenderDrawLine(renderer, shape.x, shape.y, shape.x + shape.w, shape.y + shape.h);
+			}
+			else {
+				SDL_RenderDrawRect(renderer, &shape);
+			}
+		}
+		SDL_RenderPresent(renderer);
+	}
+	double immediateMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+	// Queued and drawn a color at a time
+	LDebugDraw debugDraw;
+	start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+		for (int i = 0; i < BENCHMARK_PRIMITIVES; ++i) {
+			SDL_Color color = colors[i % 4];
+			SDL_Rect& shape = shapes[i];
+			if (i % 3 == 0) {
+				debugDraw.point(shape.x, shape.y, color);
+			}
+			else if (i % 3 == 1) {
+				debugDraw.line(shape.x, shape.y, shape.x + shape.w, shape.y + shape.h, color);
+			}
+			else {
+				debugDraw.rect(shape, color);
+			}
+		}
+		debugDraw.flush(renderer);
+		SDL_RenderPresent(renderer);
+	}
+	double batchedMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+	printf("%d primitives: %.3f ms a frame drawn one by one, %.3f ms a frame batched into %d draw calls\n", BENCHMARK_PRIMITIVES, immediateMs, batchedMs, debugDraw.getDrawCalls());
+
+	SDL_DestroyRenderer(renderer);
+	SDL_FreeSurface(surface);
+}
+
 int main(int argc, char* args[]) {
 
+	// Time debug drawing without opening a window
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		SDL_Init(0);
+		runDebugDrawBenchmark();
+		SDL_Quit();
+		return 0;
+	}
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -144,24 +546,23 @@ int main(int argc, char* args[]) {
 
 				// Render yellow filled triangle
 				SDL_Rect fillRect = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
-				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0x00, 0x00, 0xFF);
-				SDL_RenderFillRect(gRenderer, &fillRect);
+				gDebugDraw.fillRect(fillRect, DEBUG_RED);
 
 				// Render green outlined quad 
 				SDL_Rect outlineRect = { SCREEN_WIDTH / 6, SCREEN_HEIGHT / 6, SCREEN_WIDTH * 2 / 3, SCREEN_HEIGHT * 2 / 3 };
-				SDL_SetRenderDrawColor(gRenderer, 0x00, 0xFF, 0x00, 0xFF);
-				SDL_RenderDrawRect(gRenderer, &outlineRect);
+				gDebugDraw.rect(outlineRect, DEBUG_GREEN);
 
 				// Draw blue horizontal line
-				SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0xFF, 0xFF);
-				SDL_RenderDrawLine(gRenderer, 0, SCREEN_HEIGHT / 2, SCREEN_WIDTH, SCREEN_HEIGHT / 2);
+				gDebugDraw.line(0, SCREEN_HEIGHT / 2, SCREEN_WIDTH, SCREEN_HEIGHT / 2, DEBUG_BLUE);
 
 				// Draw Vertical line of yellow dots
-				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0x00, 0xFF);
 				for (int i = 0; i < SCREEN_HEIGHT; i+=4){
-					SDL_RenderDrawPoint(gRenderer, SCREEN_WIDTH / 2, i);
+					gDebugDraw.point(SCREEN_WIDTH / 2, i, DEBUG_YELLOW);
 				}
 
+				// Draw the queued shapes
+				gDebugDraw.flush(gRenderer);
+
 				// Update the surface
 				SDL_RenderPresent(gRenderer);
 			}
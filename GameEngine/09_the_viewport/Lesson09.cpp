@@ -1,12 +1,151 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Tile world dimensions
+const int TILE_SIZE = 16;
+const int LEVEL_TILES_X = 512;
+const int LEVEL_TILES_Y = 512;
+const int LEVEL_WIDTH = TILE_SIZE * LEVEL_TILES_X;
+const int LEVEL_HEIGHT = TILE_SIZE * LEVEL_TILES_Y;
+const int TOTAL_TILE_TYPES = 4;
+
+// Static tiles are drawn once into square chunks of this many tiles
+const int CHUNK_TILES = 16;
+const int CHUNK_SIZE = TILE_SIZE * CHUNK_TILES;
+const int MAX_CACHED_CHUNKS = 64;
+
+// Split screen views, one per player
+const int TOTAL_VIEWS = 4;
+
+// Things moving around the world, the first of them are the players
+const int TOTAL_ENTITIES = 20000;
+const int ENTITY_SIZE = 8;
+const int ENTITY_SPEED = 3;
+const int PLAYER_WIDTH = 32;
+const int PLAYER_HEIGHT = 24;
+
+// Frames drawn by the benchmark
+const int BENCHMARK_FRAMES = 30;
+
+// Something moving around the world
+struct WorldEntity {
+	int x, y;
+	int velX, velY;
+};
+
+// Static tile textures kept around in chunks, the least recently used one is redrawn when room is needed
+class LChunkCache {
+public:
+	// Initializes variables
+	LChunkCache();
+
+	// Deallocates chunks
+	~LChunkCache();
+
+	// Gets a chunk's texture, drawing it the first time, NULL if it can't be made
+	SDL_Texture* getChunk(int chunkX, int chunkY, Uint32 frame);
+
+	// Deallocates chunks
+	void free();
+
+	// Gets how many chunks have been drawn
+	int getBuildCount();
+
+private:
+	// A drawn chunk
+	struct Chunk {
+		int x, y;
+		SDL_Texture* texture;
+		Uint32 lastUsed;
+	};
+
+	// Cached chunks
+	std::vector<Chunk> mChunks;
+
+	// Chunks drawn so far
+	int mBuilds;
+};
+
+// Split screen views, each with a camera on its player and the entities it can see
+class LViewSystem {
+public:
+	// Initializes variables
+	LViewSystem();
+
+	// Stops culling threads
+	~LViewSystem();
+
+	// Lays out views across the screen and starts a culling thread for each view past the first
+	bool init(int count, int width, int height);
+
+	// Stops culling threads and deallocates chunks
+	void free();
+
+	// Centers each camera on its player and finds what it can see, all views at once
+	void update();
+
+	// Draws every view
+	void render();
+
+	// Draws the static layer from cached chunks, or tile by tile when off
+	void setChunkCaching(bool enabled);
+
+	// Drops cached chunks whose contents the renderer lost
+	void resetChunks();
+
+	// Gets how many entities the views can see between them
+	int getVisibleCount();
+
+	// Gets how many static chunks have been drawn
+	int getChunkBuilds();
+
+private:
+	// One screen region
+	struct View {
+		SDL_Rect viewport;
+		SDL_Rect camera;
+
+		// Visible entities in viewport coordinates
+		std::vector<SDL_Rect> visible;
+	};
+
+	// Thread that culls one view
+	struct Worker {
+		LViewSystem* system;
+		int view;
+		SDL_Thread* thread;
+		SDL_sem* start;
+	};
+
+	// Culls a view
+	void cullView(int view);
+
+	// Culling thread loop
+	static int cullThread(void* data);
+
+	// Views and their workers
+	std::vector<View> mViews;
+	std::vector<Worker> mWorkers;
+
+	// Workers post here when their view is culled
+	SDL_sem* mDone;
+	SDL_atomic_t mQuit;
+
+	// Shared static layer
+	LChunkCache mChunks;
+	Uint32 mFrame;
+	bool mChunkCaching;
+};
+
 // Starts up SDL and creates window
 bool init();
 
@@ -19,6 +158,18 @@ void close();
 // Loads individual image as texture
 SDL_Texture* loadTexture(std::string path);
 
+// Fills the level with tiles and scatters the entities
+void createWorld();
+
+// Moves the entities, bouncing them off the level edges
+void moveEntities();
+
+// Draws the tiles overlapping a level area, shifted by an offset
+void renderTiles(SDL_Rect area, int offsetX, int offsetY);
+
+// Times redrawing every view in full against the view system, with and without cached chunks
+void runViewBenchmark();
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -28,6 +179,289 @@ SDL_Renderer* gRenderer = NULL;
 // Current displayed texture
 SDL_Texture* gTexture = NULL;
 
+// Tile types and their colors
+std::vector<Uint8> gTiles;
+const SDL_Color gTileColors[TOTAL_TILE_TYPES] = { { 0x3A, 0x9D, 0x3A, 0xFF }, { 0x8B, 0x6B, 0x3D, 0xFF }, { 0x2E, 0x6F, 0xC7, 0xFF }, { 0xE0, 0xD0, 0x8A, 0xFF } };
+
+// Moving entities
+std::vector<WorldEntity> gEntities;
+
+// Split screen
+LViewSystem gViews;
+
+LChunkCache::LChunkCache() {
+	// Initialize
+	mBuilds = 0;
+}
+
+LChunkCache::~LChunkCache() {
+	// Deallocate
+	free();
+}
+
+SDL_Texture* LChunkCache::getChunk(int chunkX, int chunkY, Uint32 frame) {
+	// Use the cached chunk when there is one, remembering the oldest in case one has to go
+	int oldest = -1;
+	for (size_t i = 0; i < mChunks.size(); ++i) {
+		if (mChunks[i].x == chunkX && mChunks[i].y == chunkY) {
+			mChunks[i].lastUsed = frame;
+			return mChunks[i].texture;
+		}
+		if (oldest < 0 || mChunks[i].lastUsed < mChunks[oldest].lastUsed) {
+			oldest = (int)i;
+		}
+	}
+
+	// Reuse the least recently used texture unless it's on screen this frame
+	SDL_Texture* texture = NULL;
+	if (mChunks.size() >= (size_t)MAX_CACHED_CHUNKS && mChunks[oldest].lastUsed != frame) {
+		texture = mChunks[oldest].texture;
+		mChunks[oldest] = mChunks.back();
+		mChunks.pop_back();
+	}
+	else {
+		texture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, CHUNK_SIZE, CHUNK_SIZE);
+		if (texture == NULL) {
+			return NULL;
+		}
+	}
+
+	// Draw the chunk's tiles into it
+	SDL_Texture* previousTarget = SDL_GetRenderTarget(gRenderer);
+	SDL_SetRenderTarget(gRenderer, texture);
+	SDL_Rect area = { chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE };
+	renderTiles(area, -area.x, -area.y);
+	SDL_SetRenderTarget(gRenderer, previousTarget);
+	++mBuilds;
+
+	Chunk chunk = { chunkX, chunkY, texture, frame };
+	mChunks.push_back(chunk);
+	return texture;
+}
+
+void LChunkCache::free() {
+	for (size_t i = 0; i < mChunks.size(); ++i) {
+		SDL_DestroyTexture(mChunks[i].texture);
+	}
+	mChunks.clear();
+}
+
+int LChunkCache::getBuildCount() {
+	return mBuilds;
+}
+
+LViewSystem::LViewSystem() {
+	// Initialize
+	mDone = NULL;
+	SDL_AtomicSet(&mQuit, 0);
+	mFrame = 0;
+	mChunkCaching = true;
+}
+
+LViewSystem::~LViewSystem() {
+	// Deallocate
+	free();
+}
+
+bool LViewSystem::init(int count, int width, int height) {
+	// Get rid of preexisting views
+	free();
+
+	// Lay the views out in a grid, the last row stretching over any gap
+	int columns = 1;
+	while (columns * columns < count) {
+		++columns;
+	}
+	int rows = (count + columns - 1) / columns;
+	mViews.resize(count);
+	for (int i = 0; i < count; ++i) {
+		int row = i / columns;
+		int rowColumns = row == rows - 1 ? count - row * columns : columns;
+		int column = i % columns;
+		View& view = mViews[i];
+		view.viewport.x = column * width / rowColumns;
+		view.viewport.y = row * height / rows;
+		view.viewport.w = (column + 1) * width / rowColumns - view.viewport.x;
+		view.viewport.h = (row + 1) * height / rows - view.viewport.y;
+		view.camera.x = 0;
+		view.camera.y = 0;
+		view.camera.w = view.viewport.w;
+		view.camera.h = view.viewport.h;
+	}
+
+	// The main thread culls the first view, workers the rest
+	SDL_AtomicSet(&mQuit, 0);
+	mDone = SDL_CreateSemaphore(0);
+	if (mDone == NULL) {
+		printf("Unable to create semaphore! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	mWorkers.resize(count - 1);
+	for (int i = 0; i < count - 1; ++i) {
+		mWorkers[i].system = this;
+		mWorkers[i].view = i + 1;
+		mWorkers[i].start = SDL_CreateSemaphore(0);
+		mWorkers[i].thread = mWorkers[i].start != NULL ? SDL_CreateThread(cullThread, "View culler", &mWorkers[i]) : NULL;
+		if (mWorkers[i].thread == NULL) {
+			printf("Unable to start view culler! SDL Error: %s\n", SDL_GetError());
+			mWorkers.resize(i + 1);
+			free();
+			return false;
+		}
+	}
+	return true;
+}
+
+void LViewSystem::free() {
+	// Wake every worker to quit
+	SDL_AtomicSet(&mQuit, 1);
+	for (size_t i = 0; i < mWorkers.size(); ++i) {
+		if (mWorkers[i].thread != NULL) {
+			SDL_SemPost(mWorkers[i].start);
+			SDL_WaitThread(mWorkers[i].thread, NULL);
+		}
+		if (mWorkers[i].start != NULL) {
+			SDL_DestroySemaphore(mWorkers[i].start);
+		}
+	}
+	mWorkers.clear();
+	if (mDone != NULL) {
+		SDL_DestroySemaphore(mDone);
+		mDone = NULL;
+	}
+	mViews.clear();
+	mChunks.free();
+}
+
+void LViewSystem::update() {
+	// Start the workers, cull the first view here, then wait for the rest
+	for (size_t i = 0; i < mWorkers.size(); ++i) {
+		SDL_SemPost(mWorkers[i].start);
+	}
+	if (!mViews.empty()) {
+		cullView(0);
+	}
+	for (size_t i = 0; i < mWorkers.size(); ++i) {
+		SDL_SemWait(mDone);
+	}
+}
+
+void LViewSystem::render() {
+	// Frame stamp keeps this frame's chunks from being reused
+	++mFrame;
+
+	// Draw the chunks each view needs first, so switching render targets doesn't happen between views
+	for (size_t v = 0; mChunkCaching && v < mViews.size(); ++v) {
+		SDL_Rect& camera = mViews[v].camera;
+		for (int chunkY = camera.y / CHUNK_SIZE; chunkY <= (camera.y + camera.h - 1) / CHUNK_SIZE; ++chunkY) {
+			for (int chunkX = camera.x / CHUNK_SIZE; chunkX <= (camera.x + camera.w - 1) / CHUNK_SIZE; ++chunkX) {
+				mChunks.getChunk(chunkX, chunkY, mFrame);
+			}
+		}
+	}
+
+	for (size_t v = 0; v < mViews.size(); ++v) {
+		View& view = mViews[v];
+		SDL_Rect& camera = view.camera;
+		SDL_RenderSetViewport(gRenderer, &view.viewport);
+
+		// Static layer from the cached chunks, tile by tile if a chunk couldn't be made or caching is off
+		if (!mChunkCaching) {
+			renderTiles(camera, -camera.x, -camera.y);
+		}
+		for (int chunkY = camera.y / CHUNK_SIZE; mChunkCaching && chunkY <= (camera.y + camera.h - 1) / CHUNK_SIZE; ++chunkY) {
+			for (int chunkX = camera.x / CHUNK_SIZE; chunkX <= (camera.x + camera.w - 1) / CHUNK_SIZE; ++chunkX) {
+				SDL_Rect chunkQuad = { chunkX * CHUNK_SIZE - camera.x, chunkY * CHUNK_SIZE - camera.y, CHUNK_SIZE, CHUNK_SIZE };
+				SDL_Texture* chunk = mChunks.getChunk(chunkX, chunkY, mFrame);
+				if (chunk != NULL) {
+					SDL_RenderCopy(gRenderer, chunk, NULL, &chunkQuad);
+				}
+				else {
+					SDL_Rect area = { chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE };
+					renderTiles(area, -camera.x, -camera.y);
+				}
+			}
+		}
+
+		// Visible entities in one call
+		if (!view.visible.empty()) {
+			SDL_SetRenderDrawColor(gRenderer, 0x20, 0x20, 0x20, 0xFF);
+			SDL_RenderFillRects(gRenderer, &view.visible[0], (int)view.visible.size());
+		}
+
+		// Players on top
+		for (int i = 0; i < (int)mViews.size() && i < (int)gEntities.size(); ++i) {
+			SDL_Rect playerQuad = { gEntities[i].x - camera.x, gEntities[i].y - camera.y, PLAYER_WIDTH, PLAYER_HEIGHT };
+			if (playerQuad.x + PLAYER_WIDTH > 0 && playerQuad.y + PLAYER_HEIGHT > 0 && playerQuad.x < camera.w && playerQuad.y < camera.h) {
+				SDL_RenderCopy(gRenderer, gTexture, NULL, &playerQuad);
+			}
+		}
+	}
+
+	// Back to the whole screen
+	SDL_RenderSetViewport(gRenderer, NULL);
+}
+
+void LViewSystem::setChunkCaching(bool enabled) {
+	mChunkCaching = enabled;
+}
+
+void LViewSystem::resetChunks() {
+	mChunks.free();
+}
+
+int LViewSystem::getVisibleCount() {
+	int visible = 0;
+	for (size_t i = 0; i < mViews.size(); ++i) {
+		visible += (int)mViews[i].visible.size();
+	}
+	return visible;
+}
+
+int LViewSystem::getChunkBuilds() {
+	return mChunks.getBuildCount();
+}
+
+void LViewSystem::cullView(int index) {
+	View& view = mViews[index];
+	SDL_Rect& camera = view.camera;
+
+	// Center the camera on the view's player, keeping it in the level
+	if (index < (int)gEntities.size()) {
+		camera.x = gEntities[index].x + PLAYER_WIDTH / 2 - camera.w / 2;
+		camera.y = gEntities[index].y + PLAYER_HEIGHT / 2 - camera.h / 2;
+	}
+	camera.x = SDL_max(0, SDL_min(LEVEL_WIDTH - camera.w, camera.x));
+	camera.y = SDL_max(0, SDL_min(LEVEL_HEIGHT - camera.h, camera.y));
+
+	// Keep the entities overlapping the camera, already moved into the viewport
+	view.visible.clear();
+	for (size_t i = mViews.size(); i < gEntities.size(); ++i) {
+		int x = gEntities[i].x - camera.x;
+		int y = gEntities[i].y - camera.y;
+		if (x + ENTITY_SIZE > 0 && y + ENTITY_SIZE > 0 && x < camera.w && y < camera.h) {
+			SDL_Rect box = { x, y, ENTITY_SIZE, ENTITY_SIZE };
+			view.visible.push_back(box);
+		}
+	}
+}
+
+int LViewSystem::cullThread(void* data) {
+	Worker* worker = (Worker*)data;
+	LViewSystem* system = worker->system;
+
+	// Cull the view each time the frame starts
+	while (true) {
+		SDL_SemWait(worker->start);
+		if (SDL_AtomicGet(&system->mQuit)) {
+			break;
+		}
+		system->cullView(worker->view);
+		SDL_SemPost(system->mDone);
+	}
+	return 0;
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -82,11 +516,21 @@ bool loadMedia() {
 		success = false;
 	}
 
+	// Build the world and a view for each player
+	createWorld();
+	if (!gViews.init(TOTAL_VIEWS, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+		printf("Failed to create views!\n");
+		success = false;
+	}
+
 	// Nothing to load
 	return success;
 }
 
 void close() {
+	// Stop the views and free their chunks
+	gViews.free();
+
 	// Deallocate surface
 	SDL_DestroyTexture(gTexture);
 	gTexture = NULL;
@@ -114,8 +558,143 @@ SDL_Texture* loadTexture(std::string path) {
 
 }
 
+void createWorld() {
+	// Patches of ground a few tiles across, with the odd stray tile
+	srand(9);
+	gTiles.resize(LEVEL_TILES_X * LEVEL_TILES_Y);
+	for (int y = 0; y < LEVEL_TILES_Y; ++y) {
+		for (int x = 0; x < LEVEL_TILES_X; ++x) {
+			Uint32 patch = (Uint32)(x / 6) * 73856093U ^ (Uint32)(y / 6) * 19349663U;
+			gTiles[y * LEVEL_TILES_X + x] = rand() % 8 == 0 ? rand() % TOTAL_TILE_TYPES : (patch >> 7) % TOTAL_TILE_TYPES;
+		}
+	}
+
+	// Players start near the middle, everything else anywhere
+	gEntities.resize(TOTAL_ENTITIES);
+	for (int i = 0; i < TOTAL_ENTITIES; ++i) {
+		WorldEntity& entity = gEntities[i];
+		entity.x = i < TOTAL_VIEWS ? LEVEL_WIDTH / 2 + i * 4 * PLAYER_WIDTH : rand() % (LEVEL_WIDTH - ENTITY_SIZE);
+		entity.y = i < TOTAL_VIEWS ? LEVEL_HEIGHT / 2 : rand() % (LEVEL_HEIGHT - ENTITY_SIZE);
+		entity.velX = rand() % (ENTITY_SPEED * 2 + 1) - ENTITY_SPEED;
+		entity.velY = rand() % (ENTITY_SPEED * 2 + 1) - ENTITY_SPEED;
+	}
+}
+
+void moveEntities() {
+	for (size_t i = 0; i < gEntities.size(); ++i) {
+		WorldEntity& entity = gEntities[i];
+		int w = i < (size_t)TOTAL_VIEWS ? PLAYER_WIDTH : ENTITY_SIZE;
+		int h = i < (size_t)TOTAL_VIEWS ? PLAYER_HEIGHT : ENTITY_SIZE;
+
+		// Move, turning back at the edges
+		entity.x += entity.velX;
+		if (entity.x < 0 || entity.x + w > LEVEL_WIDTH) {
+			entity.velX = -entity.velX;
+			entity.x += entity.velX;
+		}
+		entity.y += entity.velY;
+		if (entity.y < 0 || entity.y + h > LEVEL_HEIGHT) {
+			entity.velY = -entity.velY;
+			entity.y += entity.velY;
+		}
+	}
+}
+
+void renderTiles(SDL_Rect area, int offsetX, int offsetY) {
+	// Tiles overlapping the area
+	int left = SDL_max(0, area.x / TILE_SIZE);
+	int top = SDL_max(0, area.y / TILE_SIZE);
+	int right = SDL_min(LEVEL_TILES_X - 1, (area.x + area.w - 1) / TILE_SIZE);
+	int bottom = SDL_min(LEVEL_TILES_Y - 1, (area.y + area.h - 1) / TILE_SIZE);
+
+	// One fill per tile
+	for (int y = top; y <= bottom; ++y) {
+		for (int x = left; x <= right; ++x) {
+			SDL_Color color = gTileColors[gTiles[y * LEVEL_TILES_X + x]];
+			SDL_Rect tile = { x * TILE_SIZE + offsetX, y * TILE_SIZE + offsetY, TILE_SIZE, TILE_SIZE };
+			SDL_SetRenderDrawColor(gRenderer, color.r, color.g, color.b, color.a);
+			SDL_RenderFillRect(gRenderer, &tile);
+		}
+	}
+}
+
+void runViewBenchmark() {
+	// Draw into memory so no window is needed
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	gRenderer = surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+	if (gRenderer == NULL) {
+		printf("Unable to create software renderer! SDL Error: %s\n", SDL_GetError());
+		SDL_FreeSurface(surface);
+		return;
+	}
+	gTexture = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC, PLAYER_WIDTH, PLAYER_HEIGHT);
+	createWorld();
+	if (!gViews.init(TOTAL_VIEWS, SCREEN_WIDTH, SCREEN_HEIGHT)) {
+		SDL_DestroyTexture(gTexture);
+		gTexture = NULL;
+		SDL_DestroyRenderer(gRenderer);
+		gRenderer = NULL;
+		SDL_FreeSurface(surface);
+		return;
+	}
+	double frequency = (double)SDL_GetPerformanceFrequency();
+
+	// Every view redraws its tiles one by one and every entity, unculled
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+		moveEntities();
+		for (int v = 0; v < TOTAL_VIEWS; ++v) {
+			SDL_Rect viewport = { (v % 2) * SCREEN_WIDTH / 2, (v / 2) * SCREEN_HEIGHT / 2, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
+			SDL_Rect camera = { gEntities[v].x + PLAYER_WIDTH / 2 - viewport.w / 2, gEntities[v].y + PLAYER_HEIGHT / 2 - viewport.h / 2, viewport.w, viewport.h };
+			camera.x = SDL_max(0, SDL_min(LEVEL_WIDTH - camera.w, camera.x));
+			camera.y = SDL_max(0, SDL_min(LEVEL_HEIGHT - camera.h, camera.y));
+			SDL_RenderSetViewport(gRenderer, &viewport);
+			renderTiles(camera, -camera.x, -camera.y);
+			SDL_SetRenderDrawColor(gRenderer, 0x20, 0x20, 0x20, 0xFF);
+			for (size_t i = TOTAL_VIEWS; i < gEntities.size(); ++i) {
+				SDL_Rect box = { gEntities[i].x - camera.x, gEntities[i].y - camera.y, ENTITY_SIZE, ENTITY_SIZE };
+				SDL_RenderFillRect(gRenderer, &box);
+			}
+		}
+		SDL_RenderSetViewport(gRenderer, NULL);
+		SDL_RenderPresent(gRenderer);
+	}
+	double fullMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+	// Views cull in parallel, drawing the static layer tile by tile and then from chunks
+	double viewMs[2];
+	for (int cached = 0; cached < 2; ++cached) {
+		gViews.setChunkCaching(cached == 1);
+		start = SDL_GetPerformanceCounter();
+		for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+			moveEntities();
+			gViews.update();
+			gViews.render();
+			SDL_RenderPresent(gRenderer);
+		}
+		viewMs[cached] = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+	}
+
+	printf("%d views, %d entities: %.3f ms a frame unculled, %.3f ms culled, %.3f ms culled with cached chunks (%d visible, %d chunks drawn)\n", TOTAL_VIEWS, TOTAL_ENTITIES, fullMs, viewMs[0], viewMs[1], gViews.getVisibleCount(), gViews.getChunkBuilds());
+
+	gViews.free();
+	SDL_DestroyTexture(gTexture);
+	gTexture = NULL;
+	SDL_DestroyRenderer(gRenderer);
+	gRenderer = NULL;
+	SDL_FreeSurface(surface);
+}
+
 int main(int argc, char* args[]) {
 
+	// Time the split screen without opening a window
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		SDL_Init(0);
+		runViewBenchmark();
+		SDL_Quit();
+		return 0;
+	}
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -144,44 +723,22 @@ int main(int argc, char* args[]) {
 					if (e.type == SDL_QUIT) {
 						quit = true;
 					}
+					// Target textures lost their contents
+					else if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+						gViews.resetChunks();
+					}
 				}
 
+				// Move everything and work out what each view sees
+				moveEntities();
+				gViews.update();
+
 				// Clear screen
 				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
 				SDL_RenderClear(gRenderer);
 
-				// Top left corner viewport
-				SDL_Rect topLeftViewport;
-				topLeftViewport.x = 0;
-				topLeftViewport.y = 0;
-				topLeftViewport.w = SCREEN_WIDTH / 2;
-				topLeftViewport.h = SCREEN_HEIGHT / 2;
-				SDL_RenderSetViewport(gRenderer, &topLeftViewport);
-
-				// Render texture to screen
-				SDL_RenderCopy(gRenderer, gTexture, NULL, NULL);
-
-				// Top right corner viewport
-				SDL_Rect topRightViewport;
-				topRightViewport.x = SCREEN_WIDTH /2 ;
-				topRightViewport.y = 0;
-				topRightViewport.w = SCREEN_WIDTH / 2;
-				topRightViewport.h = SCREEN_HEIGHT / 2;
-				SDL_RenderSetViewport(gRenderer, &topRightViewport);
-
-				// Render texture to screen
-				SDL_RenderCopy(gRenderer, gTexture, NULL, NULL);
-
-				// Bottom Viewport
-				SDL_Rect bottomViewport;
-				bottomViewport.x = 0;
-				bottomViewport.y = SCREEN_HEIGHT / 2;
-				bottomViewport.w = SCREEN_WIDTH;
-				bottomViewport.h = SCREEN_HEIGHT / 2;
-				SDL_RenderSetViewport(gRenderer, &bottomViewport);
-
-				// Render texture to screen
-				SDL_RenderCopy(gRenderer, gTexture, NULL, NULL);
+				// Render every player's view
+				gViews.render();
 
 				// Update the surface
 				SDL_RenderPresent(gRenderer);
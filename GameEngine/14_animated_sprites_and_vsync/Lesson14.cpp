@@ -1,12 +1,22 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Marks an animation slot that isn't playing
+const Uint16 ANIMATION_STOPPED = 0xFFFF;
+
+// Sprites and ticks run by the benchmark
+const int BENCHMARK_SPRITES = 50000;
+const int BENCHMARK_TICKS = 1000;
+
 // Starts up SDL and creates window
 bool init();
 
@@ -16,6 +26,9 @@ bool loadMedia();
 // Frees media and shuts down SDL
 void close();
 
+// Times advancing a crowd of animated sprites
+void runAnimationBenchmark();
+
 // Texture wrapper class
 class LTexture {
 public:
@@ -56,6 +69,62 @@ private:
 	int mHeight;
 };
 
+// A run of frames in the shared frame table, each shown for the same time
+struct AnimationClip {
+	int firstFrame;
+	int frameCount;
+	Uint32 frameMs;
+	Uint32 duration;
+	bool loop;
+};
+
+// Time based sprite animation, clips are shared and every playhead is advanced in one pass
+class LAnimationSystem {
+public:
+	// Initializes variables
+	LAnimationSystem();
+
+	// Adds a clip of frames shown for frameMs each, returns the clip's id or -1 if it is empty
+	int addClip(SDL_Rect* frames, int count, Uint32 frameMs, bool loop);
+
+	// Starts playing a clip some way in, returns the animation's id
+	int play(int clip, Uint32 offsetMs);
+
+	// Stops an animation so its id can be reused
+	void stop(int animation);
+
+	// Advances every playing animation
+	void update(Uint32 elapsedMs);
+
+	// Gets the frame an animation is showing
+	SDL_Rect* getFrame(int animation);
+
+	// Gets how far into its clip an animation is in frames
+	int getFrameIndex(int animation);
+
+	// Checks if an animation that doesn't loop has played through
+	bool isFinished(int animation);
+
+	// Gets the number of playing animations
+	int getPlayingCount();
+
+	// Removes every clip and animation
+	void clear();
+
+private:
+	// Frames of every clip, back to back
+	std::vector<SDL_Rect> mFrames;
+	std::vector<AnimationClip> mClips;
+
+	// Playheads, one entry per animation in each array
+	std::vector<Uint16> mClip;
+	std::vector<Uint32> mTime;
+	std::vector<Uint32> mFrame;
+
+	// Ids of stopped animations, free for reuse
+	std::vector<int> mFreeIds;
+};
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -64,9 +133,14 @@ SDL_Renderer* gRenderer = NULL;
 
 // Walking animation
 const int WALKING_ANIMAION_FRAMES = 4;
+const Uint32 WALKING_FRAME_MS = 66;
 SDL_Rect gSpriteClips[WALKING_ANIMAION_FRAMES];
 LTexture gSpriteSheetTexture;
 
+// Animation clips and playheads
+LAnimationSystem gAnimations;
+int gWalkingClip = 0;
+
 
 LTexture::LTexture() {
 	// Initialize
@@ -238,6 +312,12 @@ bool loadMedia() {
         gSpriteClips[3].y = 0;
         gSpriteClips[3].w = 64;
         gSpriteClips[3].h = 205;
+
+        // Walk cycle at the pace it had as four vsynced frames per picture
+        gWalkingClip = gAnimations.addClip(gSpriteClips, WALKING_ANIMAION_FRAMES, WALKING_FRAME_MS, true);
+        if (gWalkingClip < 0) {
+            success = false;
+        }
     }
 
 	return success;
@@ -270,8 +350,164 @@ SDL_Texture* loadTexture(std::string path) {
 
 }
 
+LAnimationSystem::LAnimationSystem() {
+	// Nothing playing yet
+	clear();
+}
+
+int LAnimationSystem::addClip(SDL_Rect* frames, int count, Uint32 frameMs, bool loop) {
+	// A clip needs frames and time to show them, playheads wrap around its duration
+	if (frames == NULL || count <= 0 || frameMs == 0) {
+		printf("Unable to add animation clip of %d frames at %u ms!\n", count, frameMs);
+		return -1;
+	}
+
+	// Copy the frames into the shared table
+	AnimationClip clip;
+	clip.firstFrame = (int)mFrames.size();
+	clip.frameCount = count;
+	clip.frameMs = frameMs;
+	clip.duration = clip.frameMs * count;
+	clip.loop = loop;
+	mFrames.insert(mFrames.end(), frames, frames + count);
+	mClips.push_back(clip);
+	return (int)mClips.size() - 1;
+}
+
+int LAnimationSystem::play(int clip, Uint32 offsetMs) {
+	// Reuse a stopped animation's slot when there is one
+	int animation;
+	if (!mFreeIds.empty()) {
+		animation = mFreeIds.back();
+		mFreeIds.pop_back();
+	}
+	else {
+		animation = (int)mClip.size();
+		mClip.push_back(0);
+		mTime.push_back(0);
+		mFrame.push_back(0);
+	}
+
+	// Start at the offset, which update works out the frame for
+	mClip[animation] = (Uint16)clip;
+	mTime[animation] = 0;
+	mFrame[animation] = mClips[clip].firstFrame;
+	if (offsetMs > 0) {
+		AnimationClip& playing = mClips[clip];
+		Uint32 time = playing.loop ? offsetMs % playing.duration : SDL_min(offsetMs, playing.duration);
+		mTime[animation] = time;
+		mFrame[animation] = playing.firstFrame + SDL_min(time / playing.frameMs, (Uint32)playing.frameCount - 1);
+	}
+	return animation;
+}
+
+void LAnimationSystem::stop(int animation) {
+	if (mClip[animation] != ANIMATION_STOPPED) {
+		mClip[animation] = ANIMATION_STOPPED;
+		mFreeIds.push_back(animation);
+	}
+}
+
+void LAnimationSystem::update(Uint32 elapsedMs) {
+	// One tight pass over the playheads, no per sprite calls
+	Uint16* clips = mClip.empty() ? NULL : &mClip[0];
+	Uint32* times = mTime.empty() ? NULL : &mTime[0];
+	Uint32* frames = mFrame.empty() ? NULL : &mFrame[0];
+	int count = (int)mClip.size();
+	for (int i = 0; i < count; ++i) {
+		if (clips[i] == ANIMATION_STOPPED) {
+			continue;
+		}
+		const AnimationClip& clip = mClips[clips[i]];
+
+		// Wrap looping clips, hold the others on their last frame
+		Uint32 time = times[i] + elapsedMs;
+		if (time >= clip.duration) {
+			time = clip.loop ? time % clip.duration : clip.duration;
+		}
+		times[i] = time;
+
+		Uint32 frame = time / clip.frameMs;
+		frames[i] = clip.firstFrame + (frame < (Uint32)clip.frameCount ? frame : clip.frameCount - 1);
+	}
+}
+
+SDL_Rect* LAnimationSystem::getFrame(int animation) {
+	return &mFrames[mFrame[animation]];
+}
+
+int LAnimationSystem::getFrameIndex(int animation) {
+	// Stopped animations have no clip to count from
+	if (mClip[animation] == ANIMATION_STOPPED) {
+		return 0;
+	}
+	return (int)mFrame[animation] - mClips[mClip[animation]].firstFrame;
+}
+
+bool LAnimationSystem::isFinished(int animation) {
+	if (mClip[animation] == ANIMATION_STOPPED) {
+		return true;
+	}
+	const AnimationClip& clip = mClips[mClip[animation]];
+	return !clip.loop && mTime[animation] >= clip.duration;
+}
+
+int LAnimationSystem::getPlayingCount() {
+	return (int)(mClip.size() - mFreeIds.size());
+}
+
+void LAnimationSystem::clear() {
+	mFrames.clear();
+	mClips.clear();
+	mClip.clear();
+	mTime.clear();
+	mFrame.clear();
+	mFreeIds.clear();
+}
+
+void runAnimationBenchmark() {
+	// A few clips of different lengths and speeds
+	LAnimationSystem animations;
+	SDL_Rect frames[16];
+	for (int i = 0; i < 16; ++i) {
+		frames[i].x = i * 64;
+		frames[i].y = 0;
+		frames[i].w = 64;
+		frames[i].h = 205;
+	}
+	for (int clip = 0; clip < 8; ++clip) {
+		animations.addClip(frames, 4 + clip, 40 + clip * 10, clip % 4 != 3);
+	}
+
+	// A crowd of sprites at different points in them
+	srand(1);
+	for (int i = 0; i < BENCHMARK_SPRITES; ++i) {
+		animations.play(rand() % 8, rand() % 1000);
+	}
+
+	// Ticks of about a frame each
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int tick = 0; tick < BENCHMARK_TICKS; ++tick) {
+		animations.update(16 + tick % 2);
+	}
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+	// Read the frames back so the work can't be skipped
+	int checksum = 0;
+	for (int i = 0; i < BENCHMARK_SPRITES; ++i) {
+		checksum += animations.getFrame(i)->x;
+	}
+	printf("%d sprites: %.3f ms a tick (checksum %d)\n", animations.getPlayingCount(), ms / BENCHMARK_TICKS, checksum);
+}
+
 int main(int argc, char* args[]) {
 
+	// Time animation updates without opening a window
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		runAnimationBenchmark();
+		return 0;
+	}
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -290,8 +526,9 @@ int main(int argc, char* args[]) {
 			// Event handler
 			SDL_Event e;
 
-			// Animation frame counter   
-            int frame = 0;
+			// Start walking
+            int walker = gAnimations.play(gWalkingClip, 0);
+            Uint32 lastTicks = SDL_GetTicks();
 
 			// While application is running
 			while (!quit) {
@@ -306,24 +543,21 @@ int main(int argc, char* args[]) {
 					
 				}
 
+				// Advance the animation by the time that passed
+				Uint32 ticks = SDL_GetTicks();
+				gAnimations.update(ticks - lastTicks);
+				lastTicks = ticks;
+
 				// Clear screen
 				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
 				SDL_RenderClear(gRenderer);
 
                 // Render current frame
-                SDL_Rect* currentClip = &gSpriteClips[frame/4];
+                SDL_Rect* currentClip = gAnimations.getFrame(walker);
                 gSpriteSheetTexture.render((SCREEN_WIDTH - currentClip->w)/2, (SCREEN_HEIGHT - currentClip->h)/2, currentClip);
 
 				// Update screen
 				SDL_RenderPresent(gRenderer);
-
-                // Go to next frame
-                ++frame;
-
-                // Cycle animation
-                if (frame/4 >= WALKING_ANIMAION_FRAMES){
-                    frame  = 0;
-                }
 			}
 		}
 	}
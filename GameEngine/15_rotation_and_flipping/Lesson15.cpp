@@ -1,12 +1,26 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <string>
+#include <list>
+#include <map>
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Angle steps per turn for cached rotations, 5 degrees so the 60 degree turns land exactly
+const int ROTATION_CACHE_STEPS = 72;
+
+// Memory kept for cached rotations
+const size_t ROTATION_CACHE_BUDGET = 16 * 1024 * 1024;
+
+// Frames timed per case by the benchmark, and arrows drawn per frame
+const int BENCHMARK_FRAMES = 360;
+const int BENCHMARK_ARROWS = 200;
+
 // Starts up SDL and creates window
 bool init();
 
@@ -16,6 +30,77 @@ bool loadMedia();
 // Frees media and shuts down SDL
 void close();
 
+// Times rotated drawing with and without the rotation cache
+void runRotationBenchmark();
+
+// Pre-rotated copies of textures at a fixed number of angle steps, least recently used go first once over budget
+class LRotationCache {
+public:
+	// Initializes variables
+	LRotationCache();
+
+	// Deallocates memory
+	~LRotationCache();
+
+	// Sets how many angle steps make a full turn and how many bytes of variants to keep
+	void init(int steps, size_t budget);
+
+	// Frees every variant
+	void free();
+
+	// Drops the variants of a texture whose pixels changed or that is being destroyed
+	void invalidate(SDL_Texture* texture);
+
+	// Draws like SDL_RenderCopyEx, but from a variant rotated to the nearest angle step
+	void render(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, const SDL_Rect* dst, double angle, const SDL_Point* center, SDL_RendererFlip flip);
+
+	// Gets how often draws found their variant, and the memory held
+	int getHits();
+	int getMisses();
+	size_t getBytes();
+	void resetStats();
+
+private:
+	// What a variant was made from
+	struct VariantKey {
+		SDL_Texture* texture;
+
+		// Clip x, y, w, h, drawn width and height, angle step and flip
+		int values[8];
+
+		bool operator<(const VariantKey& other) const;
+	};
+
+	// A rotated copy
+	struct Variant {
+		VariantKey key;
+		SDL_Texture* texture;
+		int width;
+		int height;
+		size_t bytes;
+	};
+
+	// Renders a new variant, returns false if it can't be cached
+	bool createVariant(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, int width, int height, double angle, SDL_RendererFlip flip, Variant& variant);
+
+	// Frees variants from the back of the list until within budget
+	void trim();
+
+	// Variants most recently used first, and an index into them
+	std::list<Variant> mVariants;
+	std::map<VariantKey, std::list<Variant>::iterator> mIndex;
+
+	// The renderer the variants belong to
+	SDL_Renderer* mRenderer;
+
+	// Settings and stats
+	int mSteps;
+	size_t mBudget;
+	size_t mBytes;
+	int mHits;
+	int mMisses;
+};
+
 // Texture wrapper class
 class LTexture {
 public:
@@ -40,6 +125,9 @@ public:
 	// Set alpha modulation
 	void setAlpha(Uint8 alpha);
 
+	// Draws rotations through a cache, NULL to rotate every draw
+	void setRotationCache(LRotationCache* cache);
+
 	// Renders texture at given point 
 	void render(int x, int y, SDL_Rect* clip = NULL, double angle = 0.0 , SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE);
 
@@ -54,6 +142,9 @@ private:
 	// Image dimensions
 	int mWidth;
 	int mHeight;
+
+	// Where rotated variants come from, if anywhere
+	LRotationCache* mRotationCache;
 };
 
 // The window we'll be rendering to
@@ -65,12 +156,17 @@ SDL_Renderer* gRenderer = NULL;
 // Arrow texture
 LTexture gArrowTexture;
 
+// Rotated arrows, used on software renderers or with --rotation-cache
+LRotationCache gRotationCache;
+bool gUseRotationCache = false;
+
 
 LTexture::LTexture() {
 	// Initialize
 	mTexture = NULL;
 	mWidth = 0;
 	mHeight = 0;
+	mRotationCache = NULL;
 }
 
 LTexture::~LTexture() {
@@ -121,6 +217,9 @@ bool LTexture::loadFromFile(std::string path) {
 void LTexture::free() {
 	// Free texture if exists
 	if (mTexture != NULL) {
+		if (mRotationCache != NULL) {
+			mRotationCache->invalidate(mTexture);
+		}
 		SDL_DestroyTexture(mTexture);
 		mTexture = NULL;
 		mWidth = 0;
@@ -143,6 +242,15 @@ void LTexture::setAlpha(Uint8 alpha) {
 	// Modulate texture alpha
 	SDL_SetTextureAlphaMod(mTexture, alpha);
 }
+
+void LTexture::setRotationCache(LRotationCache* cache) {
+	// Variants in the old cache won't be used again
+	if (mRotationCache != NULL && mTexture != NULL) {
+		mRotationCache->invalidate(mTexture);
+	}
+	mRotationCache = cache;
+}
+
 void LTexture::render(int x, int y, SDL_Rect* clip, double angle , SDL_Point* center, SDL_RendererFlip flip) {
 
 	// Set Rendering space and render to screen
@@ -153,8 +261,13 @@ void LTexture::render(int x, int y, SDL_Rect* clip, double angle , SDL_Point* ce
 		renderQuad.w = clip->w;
 		renderQuad.h = clip->h;
 	}
-	// Render to screen
-	SDL_RenderCopyEx(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
+	// Render to screen, rotated copies come from the cache when there is one
+	if (mRotationCache != NULL && (angle != 0.0 || flip != SDL_FLIP_NONE)) {
+		mRotationCache->render(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
+	}
+	else {
+		SDL_RenderCopyEx(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
+	}
 }
 
 int LTexture::getWidth() {
@@ -164,6 +277,218 @@ int LTexture::getWidth() {
 int LTexture::getHeight() {
 	return mHeight;
 }
+
+bool LRotationCache::VariantKey::operator<(const VariantKey& other) const {
+	if (texture != other.texture) {
+		return texture < other.texture;
+	}
+	return memcmp(values, other.values, sizeof(values)) < 0;
+}
+
+LRotationCache::LRotationCache() {
+	// Initialize
+	mRenderer = NULL;
+	mSteps = 0;
+	mBudget = 0;
+	mBytes = 0;
+	mHits = 0;
+	mMisses = 0;
+}
+
+LRotationCache::~LRotationCache() {
+	// Deallocate
+	free();
+}
+
+void LRotationCache::init(int steps, size_t budget) {
+	// Variants made at the old steps are no use
+	free();
+	mSteps = steps;
+	mBudget = budget;
+	resetStats();
+}
+
+void LRotationCache::free() {
+	// Free every variant
+	for (std::list<Variant>::iterator it = mVariants.begin(); it != mVariants.end(); ++it) {
+		SDL_DestroyTexture(it->texture);
+	}
+	mVariants.clear();
+	mIndex.clear();
+	mBytes = 0;
+	mRenderer = NULL;
+}
+
+void LRotationCache::invalidate(SDL_Texture* texture) {
+	std::list<Variant>::iterator it = mVariants.begin();
+	while (it != mVariants.end()) {
+		if (it->key.texture == texture) {
+			SDL_DestroyTexture(it->texture);
+			mBytes -= it->bytes;
+			mIndex.erase(it->key);
+			it = mVariants.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void LRotationCache::render(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, const SDL_Rect* dst, double angle, const SDL_Point* center, SDL_RendererFlip flip) {
+	// Without steps or render targets there is nothing to cache
+	if (mSteps <= 0 || dst == NULL || !SDL_RenderTargetSupported(renderer)) {
+		SDL_RenderCopyEx(renderer, texture, clip, dst, angle, center, flip);
+		return;
+	}
+
+	// Variants only draw on the renderer that made them
+	if (renderer != mRenderer) {
+		free();
+		mRenderer = renderer;
+	}
+
+	// Nearest angle step, an unflipped step 0 is a plain copy
+	int step = (int)floor(angle * mSteps / 360.0 + 0.5) % mSteps;
+	if (step < 0) {
+		step += mSteps;
+	}
+	if (step == 0 && flip == SDL_FLIP_NONE) {
+		SDL_RenderCopy(renderer, texture, clip, dst);
+		return;
+	}
+	double radians = step * 2.0 * M_PI / mSteps;
+
+	// Find the variant, making it if it's new
+	VariantKey key;
+	key.texture = texture;
+	key.values[0] = clip != NULL ? clip->x : 0;
+	key.values[1] = clip != NULL ? clip->y : 0;
+	key.values[2] = clip != NULL ? clip->w : -1;
+	key.values[3] = clip != NULL ? clip->h : -1;
+	key.values[4] = dst->w;
+	key.values[5] = dst->h;
+	key.values[6] = step;
+	key.values[7] = flip;
+	std::map<VariantKey, std::list<Variant>::iterator>::iterator found = mIndex.find(key);
+	if (found != mIndex.end()) {
+		// Most recently used goes to the front
+		mVariants.splice(mVariants.begin(), mVariants, found->second);
+		++mHits;
+	}
+	else {
+		++mMisses;
+		Variant variant;
+		variant.key = key;
+		if (!createVariant(renderer, texture, clip, dst->w, dst->h, step * 360.0 / mSteps, flip, variant)) {
+			SDL_RenderCopyEx(renderer, texture, clip, dst, angle, center, flip);
+			return;
+		}
+		mVariants.push_front(variant);
+		mIndex[key] = mVariants.begin();
+		mBytes += variant.bytes;
+		trim();
+	}
+	Variant& variant = mVariants.front();
+
+	// Carry the texture's current modulation over to the copy
+	Uint8 r, g, b, a;
+	SDL_BlendMode blendMode;
+	SDL_GetTextureColorMod(texture, &r, &g, &b);
+	SDL_GetTextureAlphaMod(texture, &a);
+	SDL_GetTextureBlendMode(texture, &blendMode);
+	SDL_SetTextureColorMod(variant.texture, r, g, b);
+	SDL_SetTextureAlphaMod(variant.texture, a);
+	SDL_SetTextureBlendMode(variant.texture, blendMode == SDL_BLENDMODE_NONE ? SDL_BLENDMODE_BLEND : blendMode);
+
+	// The variant is rotated about its middle, shift it for any other centre
+	double middleX = dst->w / 2.0;
+	double middleY = dst->h / 2.0;
+	double offsetX = center != NULL ? center->x - middleX : 0.0;
+	double offsetY = center != NULL ? center->y - middleY : 0.0;
+	double cosine = cos(radians);
+	double sine = sin(radians);
+	double x = dst->x + middleX + offsetX - (offsetX * cosine - offsetY * sine) - variant.width / 2.0;
+	double y = dst->y + middleY + offsetY - (offsetX * sine + offsetY * cosine) - variant.height / 2.0;
+	SDL_Rect renderQuad = { (int)floor(x + 0.5), (int)floor(y + 0.5), variant.width, variant.height };
+	SDL_RenderCopy(renderer, variant.texture, NULL, &renderQuad);
+}
+
+bool LRotationCache::createVariant(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, int width, int height, double angle, SDL_RendererFlip flip, Variant& variant) {
+	// Bounding box of the rotated rectangle
+	double radians = angle * M_PI / 180.0;
+	double cosine = fabs(cos(radians));
+	double sine = fabs(sin(radians));
+	variant.width = (int)ceil(width * cosine + height * sine - 0.001);
+	variant.height = (int)ceil(width * sine + height * cosine - 0.001);
+	variant.bytes = (size_t)variant.width * variant.height * 4;
+
+	// Too big to ever fit
+	if (variant.bytes > mBudget) {
+		return false;
+	}
+
+	variant.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, variant.width, variant.height);
+	if (variant.texture == NULL) {
+		printf("Unable to create rotation cache texture! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	// Rotate once into a clear target, copying pixels as they are so modulation can be applied later
+	SDL_Texture* oldTarget = SDL_GetRenderTarget(renderer);
+	Uint8 oldR, oldG, oldB, oldA;
+	SDL_GetRenderDrawColor(renderer, &oldR, &oldG, &oldB, &oldA);
+	Uint8 r, g, b, a;
+	SDL_BlendMode blendMode;
+	SDL_GetTextureColorMod(texture, &r, &g, &b);
+	SDL_GetTextureAlphaMod(texture, &a);
+	SDL_GetTextureBlendMode(texture, &blendMode);
+
+	SDL_SetRenderTarget(renderer, variant.texture);
+	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+	SDL_RenderClear(renderer);
+	SDL_SetTextureColorMod(texture, 0xFF, 0xFF, 0xFF);
+	SDL_SetTextureAlphaMod(texture, 0xFF);
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+	SDL_Rect renderQuad = { (variant.width - width) / 2, (variant.height - height) / 2, width, height };
+	SDL_RenderCopyEx(renderer, texture, clip, &renderQuad, angle, NULL, flip);
+
+	// Put everything back
+	SDL_SetTextureColorMod(texture, r, g, b);
+	SDL_SetTextureAlphaMod(texture, a);
+	SDL_SetTextureBlendMode(texture, blendMode);
+	SDL_SetRenderTarget(renderer, oldTarget);
+	SDL_SetRenderDrawColor(renderer, oldR, oldG, oldB, oldA);
+	return true;
+}
+
+void LRotationCache::trim() {
+	// Keep at least the variant just drawn
+	while (mBytes > mBudget && mVariants.size() > 1) {
+		Variant& oldest = mVariants.back();
+		SDL_DestroyTexture(oldest.texture);
+		mBytes -= oldest.bytes;
+		mIndex.erase(oldest.key);
+		mVariants.pop_back();
+	}
+}
+
+int LRotationCache::getHits() {
+	return mHits;
+}
+
+int LRotationCache::getMisses() {
+	return mMisses;
+}
+
+size_t LRotationCache::getBytes() {
+	return mBytes;
+}
+
+void LRotationCache::resetStats() {
+	mHits = 0;
+	mMisses = 0;
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -210,6 +535,13 @@ bool loadMedia() {
 	// Loading succes flag
 	bool success = true;
 
+	// Rotations of the arrow are cached when rotating costs, in software, or when asked for
+	SDL_RendererInfo info;
+	if (gUseRotationCache || (SDL_GetRendererInfo(gRenderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE))) {
+		gRotationCache.init(ROTATION_CACHE_STEPS, ROTATION_CACHE_BUDGET);
+		gArrowTexture.setRotationCache(&gRotationCache);
+	}
+
 	// Load sprite sheet texture
     if (!gArrowTexture.loadFromFile("15_rotation_and_flipping/arrow.png")){
         printf("Failed to load walking texture animation!\n");
@@ -222,6 +554,7 @@ bool loadMedia() {
 void close() {
 	// Free loaded images
 	gArrowTexture.free();
+	gRotationCache.free();
 
 	// Destroy window
 	SDL_DestroyRenderer(gRenderer);
@@ -246,8 +579,113 @@ SDL_Texture* loadTexture(std::string path) {
 
 }
 
+// Draws a ring of arrows at their own speeds, or a full screen texture turning, and returns ms per frame
+double timeFrames(LTexture* arrow, SDL_Texture* screen, LRotationCache* cache) {
+	if (arrow != NULL) {
+		arrow->setRotationCache(cache);
+	}
+	if (cache != NULL) {
+		cache->resetStats();
+	}
+
+	SDL_Rect screenQuad = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+		SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+		SDL_RenderClear(gRenderer);
+
+		if (arrow != NULL) {
+			for (int i = 0; i < BENCHMARK_ARROWS; ++i) {
+				int x = (i * 37) % SCREEN_WIDTH - arrow->getWidth() / 2;
+				int y = (i * 53) % SCREEN_HEIGHT - arrow->getHeight() / 2;
+				double degrees = frame * (1 + i % 5) * ((i & 1) ? -1 : 1);
+				arrow->render(x, y, NULL, degrees, NULL, (SDL_RendererFlip)(i % 3));
+			}
+		}
+		else if (cache != NULL) {
+			cache->render(gRenderer, screen, NULL, &screenQuad, frame * 2.0, NULL, SDL_FLIP_NONE);
+		}
+		else {
+			SDL_RenderCopyEx(gRenderer, screen, NULL, &screenQuad, frame * 2.0, NULL, SDL_FLIP_NONE);
+		}
+
+		SDL_RenderPresent(gRenderer);
+	}
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency() / BENCHMARK_FRAMES;
+
+	if (cache == NULL) {
+		printf("  uncached: %.2f ms per frame\n", ms);
+	}
+	else {
+		int draws = cache->getHits() + cache->getMisses();
+		printf("  cached:   %.2f ms per frame, %.1f%% hits, %.1f MB of variants\n", ms,
+			draws > 0 ? cache->getHits() * 100.0 / draws : 0.0, cache->getBytes() / (1024.0 * 1024.0));
+	}
+	return ms;
+}
+
+void runRotationBenchmark() {
+	// Draw in software so the numbers don't depend on a GPU
+	if (SDL_Init(SDL_INIT_VIDEO) < 0 || !(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+		return;
+	}
+	SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (surface == NULL || (gRenderer = SDL_CreateSoftwareRenderer(surface)) == NULL) {
+		printf("Unable to create benchmark renderer! SDL Error: %s\n", SDL_GetError());
+		SDL_FreeSurface(surface);
+		SDL_Quit();
+		return;
+	}
+
+	// A screen sized texture with something drawn on it
+	SDL_Texture* screen = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
+	if (screen != NULL) {
+		SDL_SetRenderTarget(gRenderer, screen);
+		SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0xFF, 0xFF);
+		SDL_RenderClear(gRenderer);
+		SDL_Rect fillRect = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
+		SDL_SetRenderDrawColor(gRenderer, 0xFF, 0x00, 0x00, 0xFF);
+		SDL_RenderFillRect(gRenderer, &fillRect);
+		SDL_SetRenderTarget(gRenderer, NULL);
+	}
+
+	LRotationCache cache;
+	if (gArrowTexture.loadFromFile("15_rotation_and_flipping/arrow.png")) {
+		printf("%d spinning arrows:\n", BENCHMARK_ARROWS);
+		cache.init(ROTATION_CACHE_STEPS, ROTATION_CACHE_BUDGET);
+		timeFrames(&gArrowTexture, NULL, NULL);
+		timeFrames(&gArrowTexture, NULL, &cache);
+		gArrowTexture.free();
+	}
+	if (screen != NULL) {
+		// Every step of a turn has to fit or the oldest is always the one evicted
+		printf("%dx%d texture turning 2 degrees a frame:\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+		cache.init(ROTATION_CACHE_STEPS, (size_t)ROTATION_CACHE_STEPS * 800 * 800 * 4);
+		timeFrames(NULL, screen, NULL);
+		timeFrames(NULL, screen, &cache);
+		SDL_DestroyTexture(screen);
+	}
+
+	cache.free();
+	SDL_DestroyRenderer(gRenderer);
+	gRenderer = NULL;
+	SDL_FreeSurface(surface);
+	IMG_Quit();
+	SDL_Quit();
+}
+
 int main(int argc, char* args[]) {
 
+	// Time the rotation cache instead of running the lesson
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		runRotationBenchmark();
+		return 0;
+	}
+
+	// Cache rotations even on an accelerated renderer
+	gUseRotationCache = argc > 1 && strcmp(args[1], "--rotation-cache") == 0;
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -282,6 +720,10 @@ int main(int argc, char* args[]) {
 					if (e.type == SDL_QUIT) {
 						quit = true;
 					}
+					// Target textures lost their contents
+					else if (e.type == SDL_RENDER_TARGETS_RESET) {
+						gRotationCache.free();
+					}
                     else if (e.type == SDL_KEYDOWN){
                         switch(e.key.keysym.sym){
                             case SDLK_a:
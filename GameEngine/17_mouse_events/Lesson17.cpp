@@ -1,8 +1,10 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <cmath>
+#include <vector>
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -13,6 +15,17 @@ const int BUTTON_WIDTH = 300;
 const int BUTTON_HEIGHT = 200;
 const int TOTAL_BUTTONS = 4;
 
+// Size of the hit test grid cells in pixels
+const int UI_CELL_SIZE = 64;
+
+// Inventory screen used by the benchmark
+const int BENCHMARK_SLOT_COLUMNS = 64;
+const int BENCHMARK_SLOT_ROWS = 64;
+const int BENCHMARK_SLOT_SIZE = 40;
+const int BENCHMARK_SLOT_GAP = 4;
+const int BENCHMARK_EVENTS = 20000;
+const int BENCHMARK_EVENTS_PER_FRAME = 16;
+
 enum LButtonSprite {
 	BUTTON_SPRITE_MOUSE_OUT = 0,
 	BUTTON_SPRITE_MOUSE_OVER_MOTION = 1,
@@ -82,8 +95,20 @@ public:
 	// Sets top left position
 	void setPosition(int x, int y);
 
-	// Handles mouse event
-	void handleEvent(SDL_Event* e);
+	// Sets the clickable size
+	void setSize(int w, int h);
+
+	// Checks if a point is over the button, edges included
+	bool contains(int x, int y);
+
+	// Gets the clickable area
+	SDL_Rect getBox();
+
+	// Sets the sprite for a change in mouse state over the button
+	void setSprite(LButtonSprite sprite);
+
+	// Gets the current sprite
+	LButtonSprite getSprite();
 
 	// Shows button sprite
 	void render();
@@ -92,10 +117,69 @@ private:
 	// Top left position
 	SDL_Point mPosition;
 
+	// Clickable size
+	int mWidth, mHeight;
+
 	// Currently used global sprite
 	LButtonSprite mCurrentSprite;
 };
 
+// Routes mouse events to buttons, finding them through a grid of the buttons overlapping each cell
+class LUILayer {
+public:
+	// Initializes internal variables
+	LUILayer();
+
+	// Sets the area the grid covers
+	void init(int width, int height);
+
+	// Adds a button, later buttons are on top of earlier ones
+	void addButton(LButton* button);
+
+	// Removes every button
+	void clear();
+
+	// Takes a mouse event, motion only moves the cached mouse until the next update
+	void handleEvent(SDL_Event* e);
+
+	// Applies the frame's latest mouse position
+	void update();
+
+	// Finds the topmost button under a point, NULL if there is none
+	LButton* hitTest(int x, int y);
+
+	// Gets how many sprite changes were sent to buttons
+	int getDispatchCount();
+
+private:
+	// Moves the hover to the button under a point and gives it a sprite
+	void moveMouse(int x, int y, LButtonSprite sprite);
+
+	// Sends a sprite to a button if it actually changes
+	void dispatch(LButton* button, LButtonSprite sprite);
+
+	// Buttons in the order added
+	std::vector<LButton*> mButtons;
+
+	// Indices of the buttons overlapping each cell, in the order added
+	std::vector<std::vector<int> > mCells;
+	int mWidth, mHeight;
+	int mColumns, mRows;
+
+	// Button the mouse is over
+	LButton* mHovered;
+
+	// Mouse position from the latest event
+	int mMouseX, mMouseY;
+	bool mMotionPending;
+
+	// Sprite changes sent
+	int mDispatches;
+};
+
+// Times routing mouse events through the UI layer against checking every button
+void runHitTestBenchmark();
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -114,6 +198,9 @@ SDL_Rect gSpriteClips[BUTTON_SPRITE_TOTAL];
 // Buttons object
 LButton gButtons[TOTAL_BUTTONS];
 
+// Mouse routing for the buttons
+LUILayer gUILayer;
+
 LTexture::LTexture() {
 	// Initialize
 	mTexture = NULL;
@@ -198,6 +285,8 @@ bool LTexture::loadFromRenderedText(std::string textureText, SDL_Color textColor
 LButton::LButton() {
 	mPosition.x = 0;
 	mPosition.y = 0;
+	mWidth = BUTTON_WIDTH;
+	mHeight = BUTTON_HEIGHT;
 
 	mCurrentSprite = BUTTON_SPRITE_MOUSE_OUT;
 }
@@ -207,51 +296,27 @@ void LButton::setPosition(int x, int y) {
 	mPosition.y = y;
 }
 
-void LButton::handleEvent(SDL_Event* e) {
-	// If mouse event happened
-	if (e->type == SDL_MOUSEMOTION || e->type == SDL_MOUSEBUTTONDOWN || e->type == SDL_MOUSEBUTTONUP) {
-		// Get mouse position
-		int x, y;
-		SDL_GetMouseState(&x, &y);
+void LButton::setSize(int w, int h) {
+	mWidth = w;
+	mHeight = h;
+}
 
-		// Check if mouse is in button
-		bool inside = true;
+bool LButton::contains(int x, int y) {
+	// Mouse is inside the button
+	return x >= mPosition.x && x <= mPosition.x + mWidth && y >= mPosition.y && y <= mPosition.y + mHeight;
+}
 
-		// Mouse is left of the button
-		if (x < mPosition.x) {
-			inside = false;
-		}
-		else if (x > mPosition.x + BUTTON_WIDTH) {
-			inside = false;
-		}
-		else if (y < mPosition.y) {
-			inside = false;
-		}
-		else if (y > mPosition.y + BUTTON_HEIGHT) {
-			inside = false;
-		}
-		if (!inside) {
-			mCurrentSprite = BUTTON_SPRITE_MOUSE_OUT;
-		}
-		
-		// Mouse is inside button
-		else {
-			// Set mouse over sprite
-			switch (e->type) {
-			case SDL_MOUSEMOTION:
-				mCurrentSprite = BUTTON_SPRITE_MOUSE_OVER_MOTION;
-				break;
-
-			case SDL_MOUSEBUTTONDOWN:
-				mCurrentSprite = BUTTON_SPRITE_MOUSE_DOWN;
-				break;
-
-			case SDL_MOUSEBUTTONUP:
-				mCurrentSprite = BUTTON_SPRITE_MOUSE_UP;
-				break;
-			}
-		}
-	}
+SDL_Rect LButton::getBox() {
+	SDL_Rect box = { mPosition.x, mPosition.y, mWidth, mHeight };
+	return box;
+}
+
+void LButton::setSprite(LButtonSprite sprite) {
+	mCurrentSprite = sprite;
+}
+
+LButtonSprite LButton::getSprite() {
+	return mCurrentSprite;
 }
 
 void LButton::render() {
@@ -305,6 +370,200 @@ int LTexture::getWidth() {
 int LTexture::getHeight() {
 	return mHeight;
 }
+
+LUILayer::LUILayer() {
+	mWidth = 0;
+	mHeight = 0;
+	mColumns = 0;
+	mRows = 0;
+	mHovered = NULL;
+	mMouseX = 0;
+	mMouseY = 0;
+	mMotionPending = false;
+	mDispatches = 0;
+}
+
+void LUILayer::init(int width, int height) {
+	// Size the grid to cover the area
+	clear();
+	mWidth = width;
+	mHeight = height;
+	mColumns = width / UI_CELL_SIZE + 1;
+	mRows = height / UI_CELL_SIZE + 1;
+	mCells.resize(mColumns * mRows);
+}
+
+void LUILayer::addButton(LButton* button) {
+	// Put the button in every cell it overlaps, edges included like the button's own check
+	SDL_Rect box = button->getBox();
+	int left = SDL_max(box.x, 0) / UI_CELL_SIZE;
+	int top = SDL_max(box.y, 0) / UI_CELL_SIZE;
+	int right = SDL_min(box.x + box.w, mWidth) / UI_CELL_SIZE;
+	int bottom = SDL_min(box.y + box.h, mHeight) / UI_CELL_SIZE;
+	for (int row = top; row <= bottom && row < mRows; ++row) {
+		for (int col = left; col <= right && col < mColumns; ++col) {
+			mCells[row * mColumns + col].push_back((int)mButtons.size());
+		}
+	}
+	mButtons.push_back(button);
+}
+
+void LUILayer::clear() {
+	mButtons.clear();
+	for (size_t i = 0; i < mCells.size(); ++i) {
+		mCells[i].clear();
+	}
+	mHovered = NULL;
+	mMotionPending = false;
+}
+
+void LUILayer::handleEvent(SDL_Event* e) {
+	switch (e->type) {
+	case SDL_MOUSEMOTION:
+		// Only the last position of the frame matters for hovering
+		mMouseX = e->motion.x;
+		mMouseY = e->motion.y;
+		mMotionPending = true;
+		break;
+
+	case SDL_MOUSEBUTTONDOWN:
+		// Clicks go out in order, at the position they happened
+		mMouseX = e->button.x;
+		mMouseY = e->button.y;
+		mMotionPending = false;
+		moveMouse(mMouseX, mMouseY, BUTTON_SPRITE_MOUSE_DOWN);
+		break;
+
+	case SDL_MOUSEBUTTONUP:
+		mMouseX = e->button.x;
+		mMouseY = e->button.y;
+		mMotionPending = false;
+		moveMouse(mMouseX, mMouseY, BUTTON_SPRITE_MOUSE_UP);
+		break;
+	}
+}
+
+void LUILayer::update() {
+	// Apply the motion held back during the frame
+	if (mMotionPending) {
+		mMotionPending = false;
+		moveMouse(mMouseX, mMouseY, BUTTON_SPRITE_MOUSE_OVER_MOTION);
+	}
+}
+
+LButton* LUILayer::hitTest(int x, int y) {
+	// Outside the grid nothing is hit
+	if (x < 0 || y < 0 || x > mWidth || y > mHeight) {
+		return NULL;
+	}
+
+	// Check the cell's buttons from the top down
+	std::vector<int>& cell = mCells[(y / UI_CELL_SIZE) * mColumns + x / UI_CELL_SIZE];
+	for (int i = (int)cell.size() - 1; i >= 0; --i) {
+		if (mButtons[cell[i]]->contains(x, y)) {
+			return mButtons[cell[i]];
+		}
+	}
+	return NULL;
+}
+
+int LUILayer::getDispatchCount() {
+	return mDispatches;
+}
+
+void LUILayer::moveMouse(int x, int y, LButtonSprite sprite) {
+	// Only the button left behind and the one entered hear about it
+	LButton* hit = hitTest(x, y);
+	if (hit != mHovered) {
+		if (mHovered != NULL) {
+			dispatch(mHovered, BUTTON_SPRITE_MOUSE_OUT);
+		}
+		mHovered = hit;
+	}
+	if (hit != NULL) {
+		dispatch(hit, sprite);
+	}
+}
+
+void LUILayer::dispatch(LButton* button, LButtonSprite sprite) {
+	if (button->getSprite() != sprite) {
+		button->setSprite(sprite);
+		++mDispatches;
+	}
+}
+
+void runHitTestBenchmark() {
+	// Lay out an inventory screen of slots
+	int width = BENCHMARK_SLOT_COLUMNS * (BENCHMARK_SLOT_SIZE + BENCHMARK_SLOT_GAP);
+	int height = BENCHMARK_SLOT_ROWS * (BENCHMARK_SLOT_SIZE + BENCHMARK_SLOT_GAP);
+	int total = BENCHMARK_SLOT_COLUMNS * BENCHMARK_SLOT_ROWS;
+	std::vector<LButton> checked(total);
+	std::vector<LButton> routed(total);
+	LUILayer layer;
+	layer.init(width, height);
+	for (int i = 0; i < total; ++i) {
+		int x = (i % BENCHMARK_SLOT_COLUMNS) * (BENCHMARK_SLOT_SIZE + BENCHMARK_SLOT_GAP);
+		int y = (i / BENCHMARK_SLOT_COLUMNS) * (BENCHMARK_SLOT_SIZE + BENCHMARK_SLOT_GAP);
+		checked[i].setPosition(x, y);
+		checked[i].setSize(BENCHMARK_SLOT_SIZE, BENCHMARK_SLOT_SIZE);
+		routed[i].setPosition(x, y);
+		routed[i].setSize(BENCHMARK_SLOT_SIZE, BENCHMARK_SLOT_SIZE);
+		layer.addButton(&routed[i]);
+	}
+
+	// A wandering mouse with the odd click
+	std::vector<SDL_Event> events(BENCHMARK_EVENTS);
+	int x = width / 2, y = height / 2;
+	srand(1);
+	for (int i = 0; i < BENCHMARK_EVENTS; ++i) {
+		memset(&events[i], 0, sizeof(SDL_Event));
+		x = SDL_max(0, SDL_min(width - 1, x + rand() % 31 - 15));
+		y = SDL_max(0, SDL_min(height - 1, y + rand() % 31 - 15));
+		if (rand() % 20 == 0) {
+			events[i].type = i % 2 == 0 ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+			events[i].button.x = x;
+			events[i].button.y = y;
+		}
+		else {
+			events[i].type = SDL_MOUSEMOTION;
+			events[i].motion.x = x;
+			events[i].motion.y = y;
+		}
+	}
+	double frequency = (double)SDL_GetPerformanceFrequency();
+
+	// Every button checks every event itself
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_EVENTS; ++i) {
+		int mouseX = events[i].type == SDL_MOUSEMOTION ? events[i].motion.x : events[i].button.x;
+		int mouseY = events[i].type == SDL_MOUSEMOTION ? events[i].motion.y : events[i].button.y;
+		LButtonSprite sprite = events[i].type == SDL_MOUSEMOTION ? BUTTON_SPRITE_MOUSE_OVER_MOTION : events[i].type == SDL_MOUSEBUTTONDOWN ? BUTTON_SPRITE_MOUSE_DOWN : BUTTON_SPRITE_MOUSE_UP;
+		for (int b = 0; b < total; ++b) {
+			checked[b].setSprite(checked[b].contains(mouseX, mouseY) ? sprite : BUTTON_SPRITE_MOUSE_OUT);
+		}
+	}
+	double checkedMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+	// The layer routes them, updating once a frame
+	start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_EVENTS; ++i) {
+		layer.handleEvent(&events[i]);
+		if (i % BENCHMARK_EVENTS_PER_FRAME == BENCHMARK_EVENTS_PER_FRAME - 1) {
+			layer.update();
+		}
+	}
+	layer.update();
+	double routedMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+	// Both should leave the slots looking the same
+	int mismatches = 0;
+	for (int i = 0; i < total; ++i) {
+		if (checked[i].getSprite() != routed[i].getSprite()) {
+			++mismatches;
+		}
+	}
+	printf("%d slots, %d events: %.3f ms checking every slot, %.3f ms routed with %d sprite changes, %d slots differ\n", total, BENCHMARK_EVENTS, checkedMs, routedMs, layer.getDispatchCount(), mismatches);
+}
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -377,6 +636,12 @@ bool loadMedia() {
 		gButtons[1].setPosition(SCREEN_WIDTH - BUTTON_WIDTH, 0);
 		gButtons[2].setPosition(0, SCREEN_HEIGHT - BUTTON_HEIGHT);
 		gButtons[3].setPosition(SCREEN_WIDTH - BUTTON_WIDTH, SCREEN_HEIGHT - BUTTON_HEIGHT);
+
+		// Route mouse events to them
+		gUILayer.init(SCREEN_WIDTH, SCREEN_HEIGHT);
+		for (int i = 0; i < TOTAL_BUTTONS; ++i) {
+			gUILayer.addButton(&gButtons[i]);
+		}
 	}
 
 	return success;
@@ -420,6 +685,12 @@ SDL_Texture* loadTexture(std::string path) {
 
 int main(int argc, char* args[]) {
 
+	// Time hit testing without opening a window
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		runHitTestBenchmark();
+		return 0;
+	}
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -456,11 +727,12 @@ int main(int argc, char* args[]) {
 					}
 
 					// Handle button events
-					for (int i = 0; i < TOTAL_BUTTONS; i++) {
-						gButtons[i].handleEvent(&e);
-					}
+					gUILayer.handleEvent(&e);
 				}
 
+				// Apply the frame's mouse movement to the buttons
+				gUILayer.update();
+
 				// Clear screen
 				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
 				SDL_RenderClear(gRenderer);
@@ -1,6 +1,7 @@
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <cmath>
 
@@ -61,6 +62,85 @@ private:
 	int mHeight;
 };
 
+// Game actions, each one a bit in the input snapshot
+enum InputAction {
+	ACTION_UP,
+	ACTION_DOWN,
+	ACTION_LEFT,
+	ACTION_RIGHT,
+	ACTION_FIRE,
+	TOTAL_ACTIONS
+};
+
+// Analog axes, -1 to 1
+enum InputAxis {
+	AXIS_MOVE_X,
+	AXIS_MOVE_Y,
+	TOTAL_AXES
+};
+
+// Folds keyboard, mouse and joystick into a per tick snapshot of actions and axes
+class LInput {
+public:
+	// Mouse and joystick buttons that can be bound
+	static const int MAX_MOUSE_BUTTONS = 8;
+	static const int MAX_JOYSTICK_BUTTONS = 32;
+
+	// Initializes variables
+	LInput();
+
+	// Binds a key or button to an action, a key can drive several actions
+	void bindKey(SDL_Scancode key, int action);
+	void bindMouseButton(int button, int action);
+	void bindJoystickButton(int button, int action);
+
+	// Sets how far from centre the stick must be pushed before it registers, from 0 to 32766
+	void setDeadZone(int deadZone);
+
+	// Folds an event into the raw input state
+	void handleEvent(SDL_Event& e);
+
+	// Takes this tick's snapshot, call once per tick after handling events
+	void update();
+
+	// Action state in the last snapshot
+	bool isDown(int action);
+	bool wasPressed(int action);
+	bool wasReleased(int action);
+
+	// Gets an axis from the last snapshot
+	float getAxis(int axis);
+
+private:
+	// Marks an action's source as going down or up
+	void press(Uint32 actions);
+	void release(Uint32 actions);
+
+	// Bound actions of each source, as action bits
+	Uint32 mKeyBindings[SDL_NUM_SCANCODES];
+	Uint32 mMouseBindings[MAX_MOUSE_BUTTONS];
+	Uint32 mJoystickBindings[MAX_JOYSTICK_BUTTONS];
+
+	// How many held sources drive each action
+	Uint8 mHoldCounts[TOTAL_ACTIONS];
+
+	// Actions held now, and actions pressed since the last snapshot so taps aren't lost
+	Uint32 mHeld;
+	Uint32 mLatched;
+
+	// Joystick buttons held, so they can be let go if the joystick is unplugged
+	Uint32 mJoystickHeld;
+
+	// Raw stick position
+	int mStickX, mStickY;
+	int mDeadZone;
+
+	// This tick's and last tick's snapshots
+	Uint32 mCurrent;
+	Uint32 mPrevious;
+	float mAxes[TOTAL_AXES];
+};
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -72,6 +152,9 @@ SDL_Renderer* gRenderer = NULL;
 TTF_Font* gFont = NULL;
 #endif
 
+// Input snapshot for the current tick
+LInput gInput;
+
 // Scene textures
 LTexture gPressTexture;
 LTexture gUpTexture;
@@ -207,6 +290,199 @@ int LTexture::getWidth() {
 int LTexture::getHeight() {
 	return mHeight;
 }
+LInput::LInput() {
+	// Nothing bound and nothing held
+	memset(mKeyBindings, 0, sizeof(mKeyBindings));
+	memset(mMouseBindings, 0, sizeof(mMouseBindings));
+	memset(mJoystickBindings, 0, sizeof(mJoystickBindings));
+	memset(mHoldCounts, 0, sizeof(mHoldCounts));
+	mHeld = 0;
+	mLatched = 0;
+	mJoystickHeld = 0;
+
+	mStickX = 0;
+	mStickY = 0;
+	mDeadZone = 8000;
+
+	mCurrent = 0;
+	mPrevious = 0;
+	for (int i = 0; i < TOTAL_AXES; ++i) {
+		mAxes[i] = 0.f;
+	}
+}
+
+void LInput::bindKey(SDL_Scancode key, int action) {
+	if (key >= 0 && key < SDL_NUM_SCANCODES && action >= 0 && action < TOTAL_ACTIONS) {
+		mKeyBindings[key] |= 1u << action;
+	}
+}
+
+void LInput::bindMouseButton(int button, int action) {
+	if (button >= 0 && button < MAX_MOUSE_BUTTONS && action >= 0 && action < TOTAL_ACTIONS) {
+		mMouseBindings[button] |= 1u << action;
+	}
+}
+
+void LInput::bindJoystickButton(int button, int action) {
+	if (button >= 0 && button < MAX_JOYSTICK_BUTTONS && action >= 0 && action < TOTAL_ACTIONS) {
+		mJoystickBindings[button] |= 1u << action;
+	}
+}
+
+void LInput::setDeadZone(int deadZone) {
+	// A full size dead zone would leave nothing to rescale the stick into
+	mDeadZone = deadZone < 0 ? 0 : (deadZone > 32766 ? 32766 : deadZone);
+}
+
+void LInput::press(Uint32 actions) {
+	// Count every source so letting go of one of two bound keys keeps the action held
+	for (int i = 0; actions != 0; ++i, actions >>= 1) {
+		if ((actions & 1) && mHoldCounts[i]++ == 0) {
+			mHeld |= 1u << i;
+			mLatched |= 1u << i;
+		}
+	}
+}
+
+void LInput::release(Uint32 actions) {
+	for (int i = 0; actions != 0; ++i, actions >>= 1) {
+		if ((actions & 1) && mHoldCounts[i] > 0 && --mHoldCounts[i] == 0) {
+			mHeld &= ~(1u << i);
+		}
+	}
+}
+
+void LInput::handleEvent(SDL_Event& e) {
+	switch (e.type) {
+	case SDL_KEYDOWN:
+		if (e.key.repeat == 0) {
+			press(mKeyBindings[e.key.keysym.scancode]);
+		}
+		break;
+
+	case SDL_KEYUP:
+		if (e.key.repeat == 0) {
+			release(mKeyBindings[e.key.keysym.scancode]);
+		}
+		break;
+
+	case SDL_MOUSEBUTTONDOWN:
+		if (e.button.button < MAX_MOUSE_BUTTONS) {
+			press(mMouseBindings[e.button.button]);
+		}
+		break;
+
+	case SDL_MOUSEBUTTONUP:
+		if (e.button.button < MAX_MOUSE_BUTTONS) {
+			release(mMouseBindings[e.button.button]);
+		}
+		break;
+
+	case SDL_JOYBUTTONDOWN:
+		if (e.jbutton.which == 0 && e.jbutton.button < MAX_JOYSTICK_BUTTONS && !(mJoystickHeld & (1u << e.jbutton.button))) {
+			mJoystickHeld |= 1u << e.jbutton.button;
+			press(mJoystickBindings[e.jbutton.button]);
+		}
+		break;
+
+	case SDL_JOYBUTTONUP:
+		if (e.jbutton.which == 0 && e.jbutton.button < MAX_JOYSTICK_BUTTONS && (mJoystickHeld & (1u << e.jbutton.button))) {
+			mJoystickHeld &= ~(1u << e.jbutton.button);
+			release(mJoystickBindings[e.jbutton.button]);
+		}
+		break;
+
+	case SDL_JOYAXISMOTION:
+		// Left stick of the first controller
+		if (e.jaxis.which == 0) {
+			if (e.jaxis.axis == 0) {
+				mStickX = e.jaxis.value;
+			}
+			else if (e.jaxis.axis == 1) {
+				mStickY = e.jaxis.value;
+			}
+		}
+		break;
+
+	case SDL_JOYDEVICEREMOVED:
+		// Unplugged mid press, let go of everything it was holding
+		if (e.jdevice.which == 0) {
+			for (int i = 0; i < MAX_JOYSTICK_BUTTONS; ++i) {
+				if (mJoystickHeld & (1u << i)) {
+					release(mJoystickBindings[i]);
+				}
+			}
+			mJoystickHeld = 0;
+			mStickX = 0;
+			mStickY = 0;
+		}
+		break;
+	}
+}
+
+void LInput::update() {
+	// Keys and buttons held or tapped since the last tick
+	Uint32 buttons = mHeld | mLatched;
+	mLatched = 0;
+
+	// Digital directions give a full axis
+	float x = (float)((int)((buttons >> ACTION_RIGHT) & 1) - (int)((buttons >> ACTION_LEFT) & 1));
+	float y = (float)((int)((buttons >> ACTION_DOWN) & 1) - (int)((buttons >> ACTION_UP) & 1));
+
+	// Radial dead zone so diagonals aren't cut off, rescaled to start from 0 at its edge
+	float stickX = mStickX / 32767.f;
+	float stickY = mStickY / 32767.f;
+	float length = sqrtf(stickX * stickX + stickY * stickY);
+	float deadZone = mDeadZone / 32767.f;
+	Uint32 stickActions = 0;
+	if (length > deadZone && deadZone < 1.f) {
+		float magnitude = length > 1.f ? 1.f : length;
+		float scale = (magnitude - deadZone) / (1.f - deadZone) / length;
+		stickX *= scale;
+		stickY *= scale;
+		x += stickX;
+		y += stickY;
+
+		// The stick drives the direction actions past halfway
+		if (stickX < -0.5f) {
+			stickActions |= 1u << ACTION_LEFT;
+		}
+		else if (stickX > 0.5f) {
+			stickActions |= 1u << ACTION_RIGHT;
+		}
+		if (stickY < -0.5f) {
+			stickActions |= 1u << ACTION_UP;
+		}
+		else if (stickY > 0.5f) {
+			stickActions |= 1u << ACTION_DOWN;
+		}
+	}
+
+	// Keep the combined axes in range
+	mAxes[AXIS_MOVE_X] = x < -1.f ? -1.f : (x > 1.f ? 1.f : x);
+	mAxes[AXIS_MOVE_Y] = y < -1.f ? -1.f : (y > 1.f ? 1.f : y);
+
+	// Shift the snapshots along
+	mPrevious = mCurrent;
+	mCurrent = buttons | stickActions;
+}
+
+bool LInput::isDown(int action) {
+	return (mCurrent >> action) & 1;
+}
+
+bool LInput::wasPressed(int action) {
+	return ((mCurrent & ~mPrevious) >> action) & 1;
+}
+
+bool LInput::wasReleased(int action) {
+	return ((mPrevious & ~mCurrent) >> action) & 1;
+}
+
+float LInput::getAxis(int axis) {
+	return mAxes[axis];
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -366,6 +642,16 @@ int main(int argc, char* args[]) {
 			// Flip type
 			SDL_RendererFlip flipType = SDL_FLIP_NONE;
 
+			// Arrow keys and WASD both steer
+			gInput.bindKey(SDL_SCANCODE_UP, ACTION_UP);
+			gInput.bindKey(SDL_SCANCODE_DOWN, ACTION_DOWN);
+			gInput.bindKey(SDL_SCANCODE_LEFT, ACTION_LEFT);
+			gInput.bindKey(SDL_SCANCODE_RIGHT, ACTION_RIGHT);
+			gInput.bindKey(SDL_SCANCODE_W, ACTION_UP);
+			gInput.bindKey(SDL_SCANCODE_S, ACTION_DOWN);
+			gInput.bindKey(SDL_SCANCODE_A, ACTION_LEFT);
+			gInput.bindKey(SDL_SCANCODE_D, ACTION_RIGHT);
+
 			// While application is running
 			while (!quit) {
 
@@ -376,19 +662,22 @@ int main(int argc, char* args[]) {
 					if (e.type == SDL_QUIT) {
 						quit = true;
 					}
+					gInput.handleEvent(e);
 				}
-				// Set texture based on current keystate
-				const Uint8* currentKeyStates = SDL_GetKeyboardState(NULL);
-				if (currentKeyStates[SDL_SCANCODE_UP]) {
+				// Snapshot this tick's input
+				gInput.update();
+
+				// Set texture based on current actions
+				if (gInput.isDown(ACTION_UP)) {
 					currentTexture = &gUpTexture;
 				}
-				else if (currentKeyStates[SDL_SCANCODE_DOWN]) {
+				else if (gInput.isDown(ACTION_DOWN)) {
 					currentTexture = &gDownTexture;
 				}
-				else if (currentKeyStates[SDL_SCANCODE_LEFT]) {
+				else if (gInput.isDown(ACTION_LEFT)) {
 					currentTexture = &gLeftTexture;
 				}
-				else if (currentKeyStates[SDL_SCANCODE_RIGHT]) {
+				else if (gInput.isDown(ACTION_RIGHT)) {
 					currentTexture = &gRightTexture;
 				}
 				else {
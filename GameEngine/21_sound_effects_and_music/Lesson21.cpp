@@ -1,14 +1,75 @@
 #include <SDL.h>
 #include <SDL_image.h>
-#include <SDL_mixer.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
 #include <cmath>
 
+// Mix four samples at a time where SSE is available
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIXER_SSE
+#endif
+
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Mixer output format, always stereo float
+const int MIXER_FREQUENCY = 44100;
+const int MIXER_SAMPLES = 512;
+
+// Number of voices that can play at once
+const int MAX_VOICES = 256;
+
+// Commands the game can queue between two audio callbacks, must be a power of two
+const int MIXER_COMMAND_QUEUE_SIZE = 1024;
+
+// Voice priorities, a voice only steals from voices of equal or lower priority
+const int PRIORITY_AMBIENT = 64;
+const int PRIORITY_EFFECT = 128;
+const int PRIORITY_MUSIC = 255;
+
+// Streams buffer this many decoded frames, must be a power of two
+const int STREAM_BUFFER_FRAMES = 32768;
+
+// Source frames read from disk per decode step
+const int STREAM_CHUNK_FRAMES = 4096;
+
+// How often the decoder thread tops up the streams
+const Uint32 STREAM_POLL_MS = 10;
+
+// Mixer benchmark defaults
+const int BENCHMARK_VOICES = 256;
+const int BENCHMARK_STREAMS = 32;
+const int BENCHMARK_SECONDS = 5;
+
+// Positional emitters that can exist at once
+const int MAX_EMITTERS = 1024;
+
+// Positional voices handed to the mixer at most, the quietest audible emitters are culled past this
+const int SPATIAL_MAX_VOICES = 192;
+
+// Emitters quieter than this never reach the mixer
+const float SPATIAL_AUDIBLE_GAIN = 0.01f;
+
+// Gain changes smaller than this are not sent to the audio thread
+const float SPATIAL_GAIN_EPSILON = 0.005f;
+
+// Horizontal distance in pixels at which a sound is fully panned to one side
+const float SPATIAL_PAN_DISTANCE = 320.f;
+
+// Default distance in pixels inside which an emitter plays at full volume, and past which it is silent
+const float SPATIAL_MIN_DISTANCE = 32.f;
+const float SPATIAL_MAX_DISTANCE = 400.f;
+
+// Spatial benchmark defaults
+const int BENCHMARK_EMITTERS = 512;
+
 // Analog joystick dead zone
 const int JOYSTICK_DEAD_ZONE = 8000;
 
@@ -21,6 +82,15 @@ bool loadMedia();
 // Frees media and shuts down SDL
 void close();
 
+// Plays hundreds of voices and prints the mixer load
+void runMixerBenchmark(int voices);
+
+// Streams the music many times over and prints the mixer load and underruns
+void runStreamBenchmark(int count);
+
+// Moves hundreds of positional emitters around and prints how many were culled
+void runSpatialBenchmark(int count);
+
 // Texture wrapper class
 class LTexture {
 public:
@@ -65,20 +135,406 @@ private:
 	int mHeight;
 };
 
+// Sound wrapper class, samples are kept as float in the mixer's frequency
+class LSound {
+public:
+	// Initializes variables
+	LSound();
+
+	// Deallocates memory
+	~LSound();
+
+	// Loads a WAV file and converts it for a mixer running at the given frequency
+	bool loadFromFile(std::string path, int frequency);
+
+	// Deallocates samples
+	void free();
+
+	// Gets the converted samples, interleaved when stereo
+	const float* getSamples();
+
+	// Gets the length in frames and the channel count (1 or 2)
+	Uint32 getFrames();
+	int getChannels();
+
+private:
+	// The converted samples
+	float* mSamples;
+
+	// Sound dimensions
+	Uint32 mFrames;
+	int mChannels;
+};
+
+// WAV file decoded a chunk at a time by the stream thread into a fixed ring buffer
+// A stream can feed one voice at a time and must outlive it
+class LAudioStream {
+public:
+	// Initializes variables
+	LAudioStream();
+
+	// Deallocates memory
+	~LAudioStream();
+
+	// Opens a WAV file for streaming to a mixer running at the given frequency
+	bool open(std::string path, int frequency, bool loop);
+
+	// Closes the file and frees the buffers, remove the stream from its thread first
+	void close();
+
+	// Asks the decoder to continue from the given time
+	void seek(double seconds);
+
+	// Gets the output channel count (1 or 2)
+	int getChannels();
+
+	// Gets the memory held by the stream's buffers
+	int getBufferBytes();
+
+	// Gets how often the mixer ran dry since the last call
+	int getUnderruns();
+
+	// Decodes into the free part of the ring, called by the stream thread
+	bool decode();
+
+	// Gets up to the given number of contiguous decoded frames, called by the mixer
+	int peek(const float** samples, int frames);
+
+	// Releases frames returned by peek
+	void consume(int frames);
+
+	// Checks if a non looping stream has played everything
+	bool isFinished();
+
+private:
+	// Reads the next chunk of the file into the converter
+	void readChunk();
+
+	// File and its sample data
+	SDL_RWops* mFile;
+	Uint32 mDataStart;
+	Uint32 mDataLength;
+	Uint32 mDataPosition;
+	int mBlockAlign;
+	int mSourceRate;
+	bool mLoop;
+	bool mSourceDone;
+
+	// Converts file chunks to float at the mixer frequency
+	SDL_AudioStream* mConverter;
+	Uint8* mChunk;
+
+	// Decoded frames, positions only ever grow and wrap around the ring
+	// Only the mixer moves the read position and only the decoder moves the write position
+	float* mBuffer;
+	int mChannels;
+	SDL_atomic_t mReadPosition;
+	SDL_atomic_t mWritePosition;
+	Uint32 mPeekPosition;
+
+	// Seeks are counted, the mixer drops the stale frames before the decoder refills
+	// from the new position and publishes where those frames start
+	SDL_atomic_t mSeekFrame;
+	SDL_atomic_t mSeekRequested;
+	SDL_atomic_t mSeekDropped;
+	SDL_atomic_t mSeekApplied;
+	SDL_atomic_t mSeekStart;
+	int mSeekPlayed;
+
+	// Status shared between the threads
+	SDL_atomic_t mEnded;
+	SDL_atomic_t mUnderruns;
+};
+
+// Background thread keeping all open streams decoded ahead of the mixer
+class LStreamThread {
+public:
+	// Initializes variables
+	LStreamThread();
+
+	// Stops the thread
+	~LStreamThread();
+
+	// Starts decoding
+	bool start();
+
+	// Stops decoding and waits for the thread
+	void stop();
+
+	// Adds or removes a stream to keep filled
+	void add(LAudioStream* stream);
+	void remove(LAudioStream* stream);
+
+private:
+	// Tops up every stream then sleeps for a poll period
+	static int run(void* data);
+
+	// Thread and what it works on, the lock only guards the list and the stream being decoded
+	SDL_Thread* mThread;
+	SDL_mutex* mLock;
+	SDL_cond* mDecoded;
+	SDL_sem* mWake;
+	std::vector<LAudioStream*> mStreams;
+	LAudioStream* mDecoding;
+	SDL_atomic_t mQuit;
+};
+
+// Handle to a playing voice, 0 is never a valid handle
+typedef Uint32 VoiceHandle;
+
+// Mixer load since the last time the stats were read
+struct MixerStats {
+	int callbacks;
+	double averageMs;
+	double peakMs;
+	double budgetMs;
+	int activeVoices;
+	int stolenVoices;
+	int rejectedVoices;
+	int droppedCommands;
+};
+
+// Mixes a fixed pool of voices in the audio callback
+class LAudioMixer {
+public:
+	// Initializes variables
+	LAudioMixer();
+
+	// Closes the device
+	~LAudioMixer();
+
+	// Opens the default audio device and starts mixing
+	bool open();
+
+	// Stops mixing and closes the device
+	void close();
+
+	// Gets the frequency sounds have to be converted to
+	int getFrequency();
+
+	// Starts a voice, stealing the oldest lowest priority voice when the pool is full
+	VoiceHandle play(LSound* sound, float volume = 1.f, float pan = 0.f, int priority = PRIORITY_EFFECT, bool loop = false);
+
+	// Starts a voice fed by a stream, looping is up to the stream
+	VoiceHandle play(LAudioStream* stream, float volume = 1.f, float pan = 0.f, int priority = PRIORITY_MUSIC);
+
+	// Stops a voice
+	void stop(VoiceHandle voice);
+
+	// Changes the volume and the pan (-1 left to 1 right) of a voice
+	void setVolume(VoiceHandle voice, float volume, float pan);
+
+	// Pauses or resumes a voice
+	void setPaused(VoiceHandle voice, bool paused);
+
+	// Checks if a voice is still playing or paused
+	bool isPlaying(VoiceHandle voice);
+
+	// Gets the stats since the last call
+	MixerStats getStats();
+
+private:
+	// A voice as seen by the audio thread
+	struct Voice {
+		VoiceHandle handle;
+		LSound* sound;
+		LAudioStream* stream;
+		Uint32 position;
+		float gainLeft, gainRight;
+		float targetLeft, targetRight;
+		bool loop;
+		bool paused;
+	};
+
+	// Requests sent from the game to the audio thread
+	enum MixerCommandType {
+		MIXER_PLAY,
+		MIXER_STOP,
+		MIXER_SET_GAIN,
+		MIXER_PAUSE
+	};
+
+	struct MixerCommand {
+		MixerCommandType type;
+		VoiceHandle handle;
+		LSound* sound;
+		LAudioStream* stream;
+		float gainLeft, gainRight;
+		bool loop;
+		bool paused;
+	};
+
+	// Picks a slot and queues the play command for either source
+	VoiceHandle startVoice(LSound* sound, LAudioStream* stream, float volume, float pan, int priority, bool loop);
+
+	// Mixes into the device buffer
+	static void SDLCALL audioCallback(void* userdata, Uint8* stream, int len);
+	void mix(float* output, int frames);
+
+	// Applies the commands queued since the last callback
+	void applyCommands();
+
+	// Adds one voice to the output
+	void mixVoice(Voice& voice, float* output, int frames);
+
+	// Adds samples to the stereo output with gains ramping by a step per frame
+	static void mixMono(float* output, const float* input, int frames, float gainLeft, float gainRight, float stepLeft, float stepRight);
+	static void mixStereo(float* output, const float* input, int frames, float gainLeft, float gainRight, float stepLeft, float stepRight);
+
+	// Marks a voice as finished so the game can reuse its slot
+	void finishVoice(Voice& voice);
+
+	// Queues a command, fails when the audio thread is too far behind
+	bool pushCommand(MixerCommand& command);
+
+	// Converts a volume and pan to equal power channel gains
+	static void getGains(float volume, float pan, float& left, float& right);
+
+	// Device
+	SDL_AudioDeviceID mDevice;
+	SDL_AudioSpec mSpec;
+	Uint64 mCounterFrequency;
+
+	// Voices, only touched by the audio thread
+	Voice mVoices[MAX_VOICES];
+
+	// The game's view of the slots, used to pick voices to steal
+	VoiceHandle mSlotHandles[MAX_VOICES];
+	int mSlotPriorities[MAX_VOICES];
+	Uint32 mSlotStarts[MAX_VOICES];
+	Uint32 mStartCount;
+
+	// Last handle each slot finished, written by the audio thread
+	SDL_atomic_t mSlotEnded[MAX_VOICES];
+
+	// Single producer single consumer command queue
+	MixerCommand mCommands[MIXER_COMMAND_QUEUE_SIZE];
+	SDL_atomic_t mCommandHead;
+	SDL_atomic_t mCommandTail;
+
+	// Stats written by the audio thread
+	SDL_atomic_t mStatCallbacks;
+	SDL_atomic_t mStatMixMicroseconds;
+	SDL_atomic_t mStatPeakMicroseconds;
+	SDL_atomic_t mStatActiveVoices;
+
+	// Stats written by the game
+	int mStolenVoices;
+	int mRejectedVoices;
+	int mDroppedCommands;
+};
+
+// Handle to a positional emitter, 0 is never a valid handle
+typedef Uint32 EmitterHandle;
+
+// Positional audio counts from the last update
+struct SpatialStats {
+	int emitters;
+	int audibleVoices;
+	int culledSilent;
+	int culledBudget;
+	int gainUpdates;
+};
+
+// Turns emitter and listener positions into mixer voices once per game tick
+class LSpatialAudio {
+public:
+	// Initializes variables
+	LSpatialAudio();
+
+	// Adds an emitter at a position, looping emitters keep a voice while audible, one shot emitters go away once played
+	EmitterHandle addEmitter(LSound* sound, float x, float y, float volume = 1.f, bool loop = true, int priority = PRIORITY_AMBIENT, float minDistance = SPATIAL_MIN_DISTANCE, float maxDistance = SPATIAL_MAX_DISTANCE);
+
+	// Stops and removes an emitter
+	void removeEmitter(EmitterHandle emitter);
+
+	// Removes every emitter
+	void clear();
+
+	// Moves an emitter, takes effect on the next update
+	void setPosition(EmitterHandle emitter, float x, float y);
+
+	// Moves the listener, takes effect on the next update
+	void setListener(float x, float y);
+
+	// Computes gains, culls inaudible emitters and sends the changes to the mixer
+	void update();
+
+	// Gets the counts from the last update
+	SpatialStats getStats();
+
+private:
+	struct Emitter {
+		EmitterHandle handle;
+		LSound* sound;
+		float x, y;
+		float volume;
+		float minDistance, maxDistance;
+		int priority;
+		bool loop;
+		bool started;
+
+		// What the mixer was last told
+		VoiceHandle voice;
+		float sentGain, sentPan;
+
+		// Computed by update
+		float gain, pan;
+	};
+
+	// Gets the emitter a handle refers to, NULL when stale
+	Emitter* getEmitter(EmitterHandle emitter);
+
+	// Takes an emitter's voice away
+	void cull(Emitter& emitter);
+
+	// Listener
+	float mListenerX, mListenerY;
+
+	// Emitter slots and the unused ones
+	Emitter mEmitters[MAX_EMITTERS];
+	std::vector<int> mFreeSlots;
+	int mEmitterCount;
+
+	// Audible emitters this update, kept to avoid allocating every tick
+	std::vector<int> mAudible;
+
+	SpatialStats mStats;
+};
+
+// A looping sound bouncing around the screen, stands in for a moving entity
+struct SpatialDot {
+	float x, y;
+	float velX, velY;
+	EmitterHandle emitter;
+};
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
 // The surface contained by the window
 SDL_Renderer* gRenderer = NULL;
 
+// The engine mixer
+LAudioMixer gMixer;
+
+// Decodes the streamed music
+LStreamThread gStreamThread;
+
+// Positional sound effects and the dots carrying them
+LSpatialAudio gSpatial;
+std::vector<SpatialDot> gDots;
+
 // The music that will be played
-Mix_Music* gMusic = NULL;
+LAudioStream gMusic;
+VoiceHandle gMusicVoice = 0;
+bool gMusicPaused = false;
 
 // The sound effects that will be used
-Mix_Chunk* gScratch = NULL;
-Mix_Chunk* gHigh = NULL;
-Mix_Chunk* gMedium = NULL;
-Mix_Chunk* gLow = NULL;
+LSound gScratch;
+LSound gHigh;
+LSound gMedium;
+LSound gLow;
 
 // Scene texture
 LTexture gPromptTexture;
@@ -223,6 +679,1158 @@ int LTexture::getHeight() {
 	return mHeight;
 }
 
+LSound::LSound() {
+	// Initialize
+	mSamples = NULL;
+	mFrames = 0;
+	mChannels = 0;
+}
+
+LSound::~LSound() {
+	// Deallocate
+	free();
+}
+
+bool LSound::loadFromFile(std::string path, int frequency) {
+	// Get rid of preexisting samples
+	free();
+
+	// Load the WAV as it is on disk
+	SDL_AudioSpec wavSpec;
+	Uint8* wavBuffer = NULL;
+	Uint32 wavLength = 0;
+	if (SDL_LoadWAV(path.c_str(), &wavSpec, &wavBuffer, &wavLength) == NULL) {
+		printf("Unable to load sound %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+
+	// Convert to float at the mixer frequency, keeping mono sounds mono
+	int channels = wavSpec.channels > 1 ? 2 : 1;
+	SDL_AudioStream* stream = SDL_NewAudioStream(wavSpec.format, wavSpec.channels, wavSpec.freq, AUDIO_F32SYS, channels, frequency);
+	if (stream == NULL) {
+		printf("Unable to convert sound %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+	}
+	else {
+		if (SDL_AudioStreamPut(stream, wavBuffer, wavLength) < 0 || SDL_AudioStreamFlush(stream) < 0) {
+			printf("Unable to convert sound %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		}
+		else {
+			// Get the converted samples
+			int bytes = SDL_AudioStreamAvailable(stream);
+			mFrames = bytes / (channels * sizeof(float));
+			mChannels = channels;
+			mSamples = new float[mFrames * channels];
+			SDL_AudioStreamGet(stream, mSamples, mFrames * channels * sizeof(float));
+		}
+		SDL_FreeAudioStream(stream);
+	}
+
+	// Get rid of the file data
+	SDL_FreeWAV(wavBuffer);
+
+	return mSamples != NULL;
+}
+
+void LSound::free() {
+	// Free samples if they exist
+	if (mSamples != NULL) {
+		delete[] mSamples;
+		mSamples = NULL;
+		mFrames = 0;
+		mChannels = 0;
+	}
+}
+
+const float* LSound::getSamples() {
+	return mSamples;
+}
+
+Uint32 LSound::getFrames() {
+	return mFrames;
+}
+
+int LSound::getChannels() {
+	return mChannels;
+}
+
+LAudioStream::LAudioStream() {
+	// Initialize
+	mFile = NULL;
+	mDataStart = 0;
+	mDataLength = 0;
+	mDataPosition = 0;
+	mBlockAlign = 0;
+	mSourceRate = 0;
+	mLoop = false;
+	mSourceDone = false;
+	mConverter = NULL;
+	mChunk = NULL;
+	mBuffer = NULL;
+	mChannels = 0;
+	SDL_AtomicSet(&mReadPosition, 0);
+	SDL_AtomicSet(&mWritePosition, 0);
+	mPeekPosition = 0;
+	SDL_AtomicSet(&mSeekFrame, 0);
+	SDL_AtomicSet(&mSeekRequested, 0);
+	SDL_AtomicSet(&mSeekDropped, 0);
+	SDL_AtomicSet(&mSeekApplied, 0);
+	SDL_AtomicSet(&mSeekStart, 0);
+	mSeekPlayed = 0;
+	SDL_AtomicSet(&mEnded, 0);
+	SDL_AtomicSet(&mUnderruns, 0);
+}
+
+LAudioStream::~LAudioStream() {
+	// Deallocate
+	close();
+}
+
+bool LAudioStream::open(std::string path, int frequency, bool loop) {
+	// Get rid of preexisting stream
+	close();
+
+	mFile = SDL_RWFromFile(path.c_str(), "rb");
+	if (mFile == NULL) {
+		printf("Unable to open stream %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+
+	// Check the RIFF header
+	char id[4];
+	if (SDL_RWread(mFile, id, 4, 1) != 1 || memcmp(id, "RIFF", 4) != 0 || SDL_RWseek(mFile, 4, RW_SEEK_CUR) < 0 || SDL_RWread(mFile, id, 4, 1) != 1 || memcmp(id, "WAVE", 4) != 0) {
+		printf("Unable to stream %s! Not a WAV file\n", path.c_str());
+		close();
+		return false;
+	}
+
+	// Walk the chunks up to the sample data
+	Uint16 formatTag = 0;
+	Uint16 channels = 0;
+	Uint32 rate = 0;
+	Uint16 bits = 0;
+	while (mDataStart == 0 && SDL_RWread(mFile, id, 4, 1) == 1) {
+		Uint32 size = SDL_ReadLE32(mFile);
+		Sint64 next = SDL_RWtell(mFile) + size + (size & 1);
+		if (memcmp(id, "fmt ", 4) == 0) {
+			formatTag = SDL_ReadLE16(mFile);
+			channels = SDL_ReadLE16(mFile);
+			rate = SDL_ReadLE32(mFile);
+			SDL_ReadLE32(mFile);
+			mBlockAlign = SDL_ReadLE16(mFile);
+			bits = SDL_ReadLE16(mFile);
+
+			// Extensible files keep the real format tag in their sub format
+			if (formatTag == 0xFFFE && size >= 26) {
+				SDL_RWseek(mFile, 8, RW_SEEK_CUR);
+				formatTag = SDL_ReadLE16(mFile);
+			}
+		}
+		else if (memcmp(id, "data", 4) == 0) {
+			mDataStart = (Uint32)SDL_RWtell(mFile);
+			mDataLength = size;
+		}
+		SDL_RWseek(mFile, mDataStart == 0 ? next : mDataStart, RW_SEEK_SET);
+	}
+
+	// Only plain PCM and float samples are streamed
+	SDL_AudioFormat format = 0;
+	if (formatTag == 1 && bits == 8) {
+		format = AUDIO_U8;
+	}
+	else if (formatTag == 1 && bits == 16) {
+		format = AUDIO_S16LSB;
+	}
+	else if (formatTag == 1 && bits == 32) {
+		format = AUDIO_S32LSB;
+	}
+	else if (formatTag == 3 && bits == 32) {
+		format = AUDIO_F32LSB;
+	}
+	if (format == 0 || channels == 0 || mBlockAlign == 0 || mDataLength < (Uint32)mBlockAlign) {
+		printf("Unable to stream %s! Unsupported sample format\n", path.c_str());
+		close();
+		return false;
+	}
+
+	// Convert to float at the mixer frequency, keeping mono sources mono
+	mChannels = channels > 1 ? 2 : 1;
+	mConverter = SDL_NewAudioStream(format, (Uint8)channels, rate, AUDIO_F32SYS, (Uint8)mChannels, frequency);
+	if (mConverter == NULL) {
+		printf("Unable to convert stream %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		close();
+		return false;
+	}
+
+	// The buffers never grow, this is all the memory the stream uses
+	mChunk = new Uint8[STREAM_CHUNK_FRAMES * mBlockAlign];
+	mBuffer = new float[STREAM_BUFFER_FRAMES * mChannels];
+	mSourceRate = rate;
+	mLoop = loop;
+	return true;
+}
+
+void LAudioStream::close() {
+	// Free the file, converter and buffers
+	if (mFile != NULL) {
+		SDL_RWclose(mFile);
+		mFile = NULL;
+	}
+	if (mConverter != NULL) {
+		SDL_FreeAudioStream(mConverter);
+		mConverter = NULL;
+	}
+	delete[] mChunk;
+	mChunk = NULL;
+	delete[] mBuffer;
+	mBuffer = NULL;
+
+	// Reset the positions
+	mDataStart = 0;
+	mDataLength = 0;
+	mDataPosition = 0;
+	mBlockAlign = 0;
+	mSourceRate = 0;
+	mSourceDone = false;
+	mChannels = 0;
+	SDL_AtomicSet(&mReadPosition, 0);
+	SDL_AtomicSet(&mWritePosition, 0);
+	mPeekPosition = 0;
+	SDL_AtomicSet(&mSeekFrame, 0);
+	SDL_AtomicSet(&mSeekRequested, 0);
+	SDL_AtomicSet(&mSeekDropped, 0);
+	SDL_AtomicSet(&mSeekApplied, 0);
+	SDL_AtomicSet(&mSeekStart, 0);
+	mSeekPlayed = 0;
+	SDL_AtomicSet(&mEnded, 0);
+}
+
+void LAudioStream::seek(double seconds) {
+	// The decoder picks this up on its next pass, the mixer holds off until then
+	SDL_AtomicSet(&mSeekFrame, seconds > 0.0 ? (int)(seconds * mSourceRate) : 0);
+	SDL_AtomicAdd(&mSeekRequested, 1);
+}
+
+int LAudioStream::getChannels() {
+	return mChannels;
+}
+
+int LAudioStream::getBufferBytes() {
+	return mBuffer != NULL ? STREAM_BUFFER_FRAMES * mChannels * sizeof(float) + STREAM_CHUNK_FRAMES * mBlockAlign : 0;
+}
+
+int LAudioStream::getUnderruns() {
+	return SDL_AtomicSet(&mUnderruns, 0);
+}
+
+bool LAudioStream::decode() {
+	if (mBuffer == NULL) {
+		return false;
+	}
+
+	// Restart from a new position, the mixer drops what was decoded from the old one
+	bool decoded = false;
+	int seekDropped = SDL_AtomicGet(&mSeekDropped);
+	if (seekDropped != SDL_AtomicGet(&mSeekApplied)) {
+		// Looping streams wrap the position around, others stop at the end
+		Uint32 seekFrame = (Uint32)SDL_AtomicGet(&mSeekFrame);
+		Uint32 frames = mDataLength / mBlockAlign;
+		mDataPosition = (seekFrame < frames ? seekFrame : (mLoop ? seekFrame % frames : frames)) * mBlockAlign;
+		SDL_RWseek(mFile, mDataStart + mDataPosition, RW_SEEK_SET);
+		SDL_AudioStreamClear(mConverter);
+		mSourceDone = false;
+		SDL_AtomicSet(&mEnded, 0);
+
+		// Frames published after the mixer dropped the ring are stale too, it skips them once it sees this
+		SDL_AtomicSet(&mSeekStart, SDL_AtomicGet(&mWritePosition));
+		SDL_AtomicSet(&mSeekApplied, seekDropped);
+		decoded = true;
+	}
+
+	// Top up the ring a chunk at a time
+	int frameBytes = mChannels * sizeof(float);
+	while (SDL_AtomicGet(&mEnded) == 0) {
+		Uint32 write = SDL_AtomicGet(&mWritePosition);
+		Uint32 space = STREAM_BUFFER_FRAMES - (write - (Uint32)SDL_AtomicGet(&mReadPosition));
+		if (space < (Uint32)STREAM_CHUNK_FRAMES) {
+			break;
+		}
+
+		// Feed the converter until it has a chunk ready or the file is done
+		while (!mSourceDone && SDL_AudioStreamAvailable(mConverter) < STREAM_CHUNK_FRAMES * frameBytes) {
+			readChunk();
+		}
+		Uint32 frames = SDL_AudioStreamAvailable(mConverter) / frameBytes;
+		if (frames > space) {
+			frames = space;
+		}
+		if (frames == 0) {
+			// Nothing more will come
+			SDL_AtomicSet(&mEnded, 1);
+			break;
+		}
+
+		// Copy into the ring in at most two pieces
+		Uint32 index = write & (STREAM_BUFFER_FRAMES - 1);
+		Uint32 first = frames < STREAM_BUFFER_FRAMES - index ? frames : STREAM_BUFFER_FRAMES - index;
+		SDL_AudioStreamGet(mConverter, mBuffer + index * mChannels, first * frameBytes);
+		if (frames > first) {
+			SDL_AudioStreamGet(mConverter, mBuffer, (frames - first) * frameBytes);
+		}
+
+		// Publish the frames to the mixer
+		SDL_AtomicSet(&mWritePosition, write + frames);
+		decoded = true;
+	}
+
+	return decoded;
+}
+
+void LAudioStream::readChunk() {
+	// Read whole frames up to the end of the sample data
+	Uint32 length = mDataLength - mDataPosition;
+	if (length > (Uint32)(STREAM_CHUNK_FRAMES * mBlockAlign)) {
+		length = STREAM_CHUNK_FRAMES * mBlockAlign;
+	}
+	size_t read = SDL_RWread(mFile, mChunk, 1, length);
+	read -= read % mBlockAlign;
+	mDataPosition += read;
+	if (read > 0) {
+		SDL_AudioStreamPut(mConverter, mChunk, (int)read);
+	}
+
+	// At the end either wrap around seamlessly or drain the converter
+	if (read < length || mDataPosition >= mDataLength) {
+		if (mLoop && (read > 0 || mDataPosition > 0)) {
+			mDataPosition = 0;
+			SDL_RWseek(mFile, mDataStart, RW_SEEK_SET);
+		}
+		else {
+			SDL_AudioStreamFlush(mConverter);
+			mSourceDone = true;
+		}
+	}
+}
+
+int LAudioStream::peek(const float** samples, int frames) {
+	if (mBuffer == NULL) {
+		return 0;
+	}
+
+	// Skip the frames decoded before the latest seek the decoder has taken up, never moving backwards
+	int seekApplied = SDL_AtomicGet(&mSeekApplied);
+	if (seekApplied != mSeekPlayed) {
+		Uint32 start = SDL_AtomicGet(&mSeekStart);
+		if ((Sint32)(start - (Uint32)SDL_AtomicGet(&mReadPosition)) > 0) {
+			SDL_AtomicSet(&mReadPosition, start);
+		}
+		mSeekPlayed = seekApplied;
+	}
+
+	// Drop everything decoded so far when a seek comes in, then let the decoder go ahead
+	int seekRequested = SDL_AtomicGet(&mSeekRequested);
+	if (seekRequested != SDL_AtomicGet(&mSeekDropped)) {
+		SDL_AtomicSet(&mReadPosition, SDL_AtomicGet(&mWritePosition));
+		SDL_AtomicSet(&mSeekDropped, seekRequested);
+	}
+
+	// Play nothing from the old position while a seek is still waiting for the decoder
+	if (seekRequested != seekApplied) {
+		*samples = NULL;
+		return 0;
+	}
+
+	// Frames ready without wrapping around the end of the ring
+	mPeekPosition = SDL_AtomicGet(&mReadPosition);
+	Uint32 available = (Uint32)SDL_AtomicGet(&mWritePosition) - mPeekPosition;
+	Uint32 index = mPeekPosition & (STREAM_BUFFER_FRAMES - 1);
+	if (available > STREAM_BUFFER_FRAMES - index) {
+		available = STREAM_BUFFER_FRAMES - index;
+	}
+	if ((Uint32)frames > available) {
+		frames = available;
+	}
+
+	// The decoder fell behind
+	if (frames == 0 && SDL_AtomicGet(&mEnded) == 0) {
+		SDL_AtomicAdd(&mUnderruns, 1);
+	}
+
+	*samples = mBuffer + index * mChannels;
+	return frames;
+}
+
+void LAudioStream::consume(int frames) {
+	// Hand the space back to the decoder
+	SDL_AtomicSet(&mReadPosition, mPeekPosition + frames);
+}
+
+bool LAudioStream::isFinished() {
+	// A pending seek brings the stream back to life
+	return SDL_AtomicGet(&mSeekRequested) == SDL_AtomicGet(&mSeekApplied) && SDL_AtomicGet(&mEnded) != 0 && SDL_AtomicGet(&mReadPosition) == SDL_AtomicGet(&mWritePosition);
+}
+
+LStreamThread::LStreamThread() {
+	// Initialize
+	mThread = NULL;
+	mLock = NULL;
+	mDecoded = NULL;
+	mWake = NULL;
+	mDecoding = NULL;
+	SDL_AtomicSet(&mQuit, 0);
+}
+
+LStreamThread::~LStreamThread() {
+	// Stop decoding
+	stop();
+}
+
+bool LStreamThread::start() {
+	// Get rid of a running thread
+	stop();
+
+	mLock = SDL_CreateMutex();
+	mDecoded = SDL_CreateCond();
+	mWake = SDL_CreateSemaphore(0);
+	SDL_AtomicSet(&mQuit, 0);
+	mThread = mLock != NULL && mDecoded != NULL && mWake != NULL ? SDL_CreateThread(run, "Stream decoder", this) : NULL;
+	if (mThread == NULL) {
+		printf("Unable to start stream decoder! SDL Error: %s\n", SDL_GetError());
+		stop();
+		return false;
+	}
+	return true;
+}
+
+void LStreamThread::stop() {
+	// Let the thread finish its pass and quit
+	if (mThread != NULL) {
+		SDL_AtomicSet(&mQuit, 1);
+		SDL_SemPost(mWake);
+		SDL_WaitThread(mThread, NULL);
+		mThread = NULL;
+	}
+	if (mLock != NULL) {
+		SDL_DestroyMutex(mLock);
+		mLock = NULL;
+	}
+	if (mDecoded != NULL) {
+		SDL_DestroyCond(mDecoded);
+		mDecoded = NULL;
+	}
+	if (mWake != NULL) {
+		SDL_DestroySemaphore(mWake);
+		mWake = NULL;
+	}
+	mStreams.clear();
+}
+
+void LStreamThread::add(LAudioStream* stream) {
+	// Fill the new stream right away
+	SDL_LockMutex(mLock);
+	mStreams.push_back(stream);
+	SDL_UnlockMutex(mLock);
+	SDL_SemPost(mWake);
+}
+
+void LStreamThread::remove(LAudioStream* stream) {
+	SDL_LockMutex(mLock);
+	for (size_t i = 0; i < mStreams.size(); ++i) {
+		if (mStreams[i] == stream) {
+			mStreams.erase(mStreams.begin() + i);
+			break;
+		}
+	}
+
+	// Only waits if the thread is decoding this very stream
+	while (mDecoding == stream) {
+		SDL_CondWait(mDecoded, mLock);
+	}
+	SDL_UnlockMutex(mLock);
+}
+
+int LStreamThread::run(void* data) {
+	LStreamThread* thread = (LStreamThread*)data;
+	std::vector<LAudioStream*> streams;
+	while (SDL_AtomicGet(&thread->mQuit) == 0) {
+		// Copy the list so the file reads happen outside the lock
+		SDL_LockMutex(thread->mLock);
+		streams = thread->mStreams;
+		SDL_UnlockMutex(thread->mLock);
+
+		// Top up every stream that wasn't removed meanwhile
+		for (size_t i = 0; i < streams.size(); ++i) {
+			SDL_LockMutex(thread->mLock);
+			bool listed = std::find(thread->mStreams.begin(), thread->mStreams.end(), streams[i]) != thread->mStreams.end();
+			thread->mDecoding = listed ? streams[i] : NULL;
+			SDL_UnlockMutex(thread->mLock);
+			if (!listed) {
+				continue;
+			}
+
+			streams[i]->decode();
+
+			// Let a waiting remove go ahead
+			SDL_LockMutex(thread->mLock);
+			thread->mDecoding = NULL;
+			SDL_CondBroadcast(thread->mDecoded);
+			SDL_UnlockMutex(thread->mLock);
+		}
+
+		// Sleep until the mixer has used up some of the buffers
+		SDL_SemWaitTimeout(thread->mWake, STREAM_POLL_MS);
+	}
+	return 0;
+}
+
+LAudioMixer::LAudioMixer() {
+	// Initialize
+	mDevice = 0;
+	SDL_zero(mSpec);
+	mCounterFrequency = 1;
+	SDL_zero(mVoices);
+	SDL_zero(mSlotHandles);
+	SDL_zero(mSlotPriorities);
+	SDL_zero(mSlotStarts);
+	mStartCount = 0;
+	SDL_zero(mSlotEnded);
+	SDL_zero(mCommands);
+	SDL_zero(mCommandHead);
+	SDL_zero(mCommandTail);
+	SDL_zero(mStatCallbacks);
+	SDL_zero(mStatMixMicroseconds);
+	SDL_zero(mStatPeakMicroseconds);
+	SDL_zero(mStatActiveVoices);
+	mStolenVoices = 0;
+	mRejectedVoices = 0;
+	mDroppedCommands = 0;
+}
+
+LAudioMixer::~LAudioMixer() {
+	// Stop the callback before the voices go away
+	close();
+}
+
+bool LAudioMixer::open() {
+	// Get rid of a preexisting device
+	close();
+
+	// Ask for stereo float so the callback can mix straight into the device buffer
+	SDL_AudioSpec desiredSpec;
+	SDL_zero(desiredSpec);
+	desiredSpec.freq = MIXER_FREQUENCY;
+	desiredSpec.format = AUDIO_F32SYS;
+	desiredSpec.channels = 2;
+	desiredSpec.samples = MIXER_SAMPLES;
+	desiredSpec.callback = audioCallback;
+	desiredSpec.userdata = this;
+
+	// Let SDL convert the format, only the frequency and buffer size may change
+	mDevice = SDL_OpenAudioDevice(NULL, SDL_FALSE, &desiredSpec, &mSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+	if (mDevice == 0) {
+		printf("Unable to open audio device! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	mCounterFrequency = SDL_GetPerformanceFrequency();
+
+	// Start mixing
+	SDL_PauseAudioDevice(mDevice, SDL_FALSE);
+	return true;
+}
+
+void LAudioMixer::close() {
+	// Closing waits for a running callback to return
+	if (mDevice != 0) {
+		SDL_CloseAudioDevice(mDevice);
+		mDevice = 0;
+	}
+
+	// Forget all voices and pending commands
+	SDL_zero(mVoices);
+	SDL_zero(mSlotHandles);
+	SDL_zero(mSlotEnded);
+	SDL_AtomicSet(&mCommandHead, 0);
+	SDL_AtomicSet(&mCommandTail, 0);
+}
+
+int LAudioMixer::getFrequency() {
+	return mSpec.freq;
+}
+
+VoiceHandle LAudioMixer::play(LSound* sound, float volume, float pan, int priority, bool loop) {
+	// Nothing to play
+	if (sound == NULL || sound->getFrames() == 0) {
+		return 0;
+	}
+	return startVoice(sound, NULL, volume, pan, priority, loop);
+}
+
+VoiceHandle LAudioMixer::play(LAudioStream* stream, float volume, float pan, int priority) {
+	// Nothing to play
+	if (stream == NULL || stream->getChannels() == 0) {
+		return 0;
+	}
+	return startVoice(NULL, stream, volume, pan, priority, false);
+}
+
+VoiceHandle LAudioMixer::startVoice(LSound* sound, LAudioStream* stream, float volume, float pan, int priority, bool loop) {
+	if (mDevice == 0) {
+		return 0;
+	}
+
+	// Use a free slot, otherwise the oldest of the lowest priority voices
+	int slot = -1;
+	int victim = -1;
+	for (int i = 0; i < MAX_VOICES && slot == -1; ++i) {
+		if (!isPlaying(mSlotHandles[i])) {
+			slot = i;
+		}
+		else if (victim == -1 || mSlotPriorities[i] < mSlotPriorities[victim] || (mSlotPriorities[i] == mSlotPriorities[victim] && mSlotStarts[i] < mSlotStarts[victim])) {
+			victim = i;
+		}
+	}
+	if (slot == -1) {
+		// Never cut off something more important
+		if (mSlotPriorities[victim] > priority) {
+			++mRejectedVoices;
+			return 0;
+		}
+		slot = victim;
+	}
+
+	// Bump the slot's generation so old handles to it go stale
+	Uint32 generation = (mSlotHandles[slot] >> 16) + 1;
+	if (generation > 0xFFFF) {
+		generation = 1;
+	}
+
+	MixerCommand command;
+	SDL_zero(command);
+	command.type = MIXER_PLAY;
+	command.handle = (generation << 16) | slot;
+	command.sound = sound;
+	command.stream = stream;
+	command.loop = loop;
+	getGains(volume, pan, command.gainLeft, command.gainRight);
+	if (!pushCommand(command)) {
+		return 0;
+	}
+
+	// Remember what now owns the slot
+	if (slot == victim) {
+		++mStolenVoices;
+	}
+	mSlotHandles[slot] = command.handle;
+	mSlotPriorities[slot] = priority;
+	mSlotStarts[slot] = mStartCount++;
+	return command.handle;
+}
+
+void LAudioMixer::stop(VoiceHandle voice) {
+	if (isPlaying(voice)) {
+		MixerCommand command;
+		SDL_zero(command);
+		command.type = MIXER_STOP;
+		command.handle = voice;
+		pushCommand(command);
+	}
+}
+
+void LAudioMixer::setVolume(VoiceHandle voice, float volume, float pan) {
+	if (isPlaying(voice)) {
+		MixerCommand command;
+		SDL_zero(command);
+		command.type = MIXER_SET_GAIN;
+		command.handle = voice;
+		getGains(volume, pan, command.gainLeft, command.gainRight);
+		pushCommand(command);
+	}
+}
+
+void LAudioMixer::setPaused(VoiceHandle voice, bool paused) {
+	if (isPlaying(voice)) {
+		MixerCommand command;
+		SDL_zero(command);
+		command.type = MIXER_PAUSE;
+		command.handle = voice;
+		command.paused = paused;
+		pushCommand(command);
+	}
+}
+
+bool LAudioMixer::isPlaying(VoiceHandle voice) {
+	// The handle must still own its slot and the audio thread must not have finished it
+	Uint32 slot = voice & 0xFFFF;
+	return voice != 0 && slot < MAX_VOICES && mSlotHandles[slot] == voice && (VoiceHandle)SDL_AtomicGet(&mSlotEnded[slot]) != voice;
+}
+
+MixerStats LAudioMixer::getStats() {
+	MixerStats stats;
+
+	// Take the audio thread's counters and start a new window
+	stats.callbacks = SDL_AtomicSet(&mStatCallbacks, 0);
+	int mixMicroseconds = SDL_AtomicSet(&mStatMixMicroseconds, 0);
+	stats.averageMs = stats.callbacks > 0 ? mixMicroseconds / 1000.0 / stats.callbacks : 0.0;
+	stats.peakMs = SDL_AtomicSet(&mStatPeakMicroseconds, 0) / 1000.0;
+	stats.budgetMs = mSpec.freq > 0 ? mSpec.samples * 1000.0 / mSpec.freq : 0.0;
+	stats.activeVoices = SDL_AtomicGet(&mStatActiveVoices);
+
+	// Same for the game side counters
+	stats.stolenVoices = mStolenVoices;
+	stats.rejectedVoices = mRejectedVoices;
+	stats.droppedCommands = mDroppedCommands;
+	mStolenVoices = 0;
+	mRejectedVoices = 0;
+	mDroppedCommands = 0;
+
+	return stats;
+}
+
+void SDLCALL LAudioMixer::audioCallback(void* userdata, Uint8* stream, int len) {
+	// The device was opened as stereo float
+	LAudioMixer* mixer = (LAudioMixer*)userdata;
+	mixer->mix((float*)stream, len / (2 * sizeof(float)));
+}
+
+void LAudioMixer::mix(float* output, int frames) {
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	// Pick up what the game asked for
+	applyCommands();
+
+	// Add every running voice on top of silence
+	SDL_memset(output, 0, frames * 2 * sizeof(float));
+	int activeVoices = 0;
+	for (int i = 0; i < MAX_VOICES; ++i) {
+		if (mVoices[i].handle != 0 && !mVoices[i].paused) {
+			mixVoice(mVoices[i], output, frames);
+			++activeVoices;
+		}
+	}
+
+	// Clip the sum
+	int i = 0;
+#if defined(MIXER_SSE)
+	__m128 high = _mm_set1_ps(1.f);
+	__m128 low = _mm_set1_ps(-1.f);
+	for (; i + 4 <= frames * 2; i += 4) {
+		_mm_storeu_ps(output + i, _mm_max_ps(low, _mm_min_ps(high, _mm_loadu_ps(output + i))));
+	}
+#endif
+	for (; i < frames * 2; ++i) {
+		output[i] = output[i] > 1.f ? 1.f : (output[i] < -1.f ? -1.f : output[i]);
+	}
+
+	// Publish the timing
+	int microseconds = (int)((SDL_GetPerformanceCounter() - start) * 1000000 / mCounterFrequency);
+	SDL_AtomicAdd(&mStatCallbacks, 1);
+	SDL_AtomicAdd(&mStatMixMicroseconds, microseconds);
+	SDL_AtomicSet(&mStatActiveVoices, activeVoices);
+	int peak = SDL_AtomicGet(&mStatPeakMicroseconds);
+	while (microseconds > peak && !SDL_AtomicCAS(&mStatPeakMicroseconds, peak, microseconds)) {
+		peak = SDL_AtomicGet(&mStatPeakMicroseconds);
+	}
+}
+
+void LAudioMixer::applyCommands() {
+	Uint32 head = SDL_AtomicGet(&mCommandHead);
+	Uint32 tail = SDL_AtomicGet(&mCommandTail);
+	while (tail != head) {
+		MixerCommand& command = mCommands[tail & (MIXER_COMMAND_QUEUE_SIZE - 1)];
+		Voice& voice = mVoices[command.handle & 0xFFFF];
+
+		// Playing takes over the slot, even if it still holds a voice being stolen
+		if (command.type == MIXER_PLAY) {
+			voice.handle = command.handle;
+			voice.sound = command.sound;
+			voice.stream = command.stream;
+			voice.position = 0;
+			voice.gainLeft = voice.targetLeft = command.gainLeft;
+			voice.gainRight = voice.targetRight = command.gainRight;
+			voice.loop = command.loop;
+			voice.paused = false;
+		}
+		// Everything else is dropped if the voice ended or was stolen meanwhile
+		else if (voice.handle == command.handle) {
+			switch (command.type) {
+			case MIXER_STOP:
+				finishVoice(voice);
+				break;
+			case MIXER_SET_GAIN:
+				voice.targetLeft = command.gainLeft;
+				voice.targetRight = command.gainRight;
+				break;
+			case MIXER_PAUSE:
+				voice.paused = command.paused;
+				break;
+			default:
+				break;
+			}
+		}
+		++tail;
+	}
+	SDL_AtomicSet(&mCommandTail, tail);
+}
+
+void LAudioMixer::mixVoice(Voice& voice, float* output, int frames) {
+	int channels = voice.stream != NULL ? voice.stream->getChannels() : voice.sound->getChannels();
+
+	// Ramp gain changes over the whole buffer so they don't click
+	float stepLeft = (voice.targetLeft - voice.gainLeft) / frames;
+	float stepRight = (voice.targetRight - voice.gainRight) / frames;
+
+	// Mix one contiguous piece of the source at a time
+	int mixed = 0;
+	while (mixed < frames && voice.handle != 0) {
+		const float* input = NULL;
+		int count = frames - mixed;
+		if (voice.stream != NULL) {
+			// Take what the decoder has ready, up to the end of its ring
+			count = voice.stream->peek(&input, count);
+			if (count == 0) {
+				if (voice.stream->isFinished()) {
+					finishVoice(voice);
+				}
+				break;
+			}
+		}
+		else {
+			// Mix up to the end of the sound
+			Uint32 length = voice.sound->getFrames();
+			if ((Uint32)count > length - voice.position) {
+				count = length - voice.position;
+			}
+			input = voice.sound->getSamples() + voice.position * channels;
+		}
+
+		float gainLeft = voice.gainLeft + stepLeft * mixed;
+		float gainRight = voice.gainRight + stepRight * mixed;
+		if (channels == 1) {
+			mixMono(output + mixed * 2, input, count, gainLeft, gainRight, stepLeft, stepRight);
+		}
+		else {
+			mixStereo(output + mixed * 2, input, count, gainLeft, gainRight, stepLeft, stepRight);
+		}
+		mixed += count;
+
+		if (voice.stream != NULL) {
+			voice.stream->consume(count);
+		}
+		else {
+			// Wrap around when looping
+			voice.position += count;
+			if (voice.position >= voice.sound->getFrames()) {
+				if (voice.loop) {
+					voice.position = 0;
+				}
+				else {
+					finishVoice(voice);
+				}
+			}
+		}
+	}
+
+	voice.gainLeft = voice.targetLeft;
+	voice.gainRight = voice.targetRight;
+}
+
+void LAudioMixer::mixMono(float* output, const float* input, int frames, float gainLeft, float gainRight, float stepLeft, float stepRight) {
+	int i = 0;
+#if defined(MIXER_SSE)
+	// Four frames at a time, interleaving the left and right products
+	__m128 left = _mm_setr_ps(gainLeft, gainLeft + stepLeft, gainLeft + 2 * stepLeft, gainLeft + 3 * stepLeft);
+	__m128 right = _mm_setr_ps(gainRight, gainRight + stepRight, gainRight + 2 * stepRight, gainRight + 3 * stepRight);
+	__m128 leftStep = _mm_set1_ps(4 * stepLeft);
+	__m128 rightStep = _mm_set1_ps(4 * stepRight);
+	for (; i + 4 <= frames; i += 4) {
+		__m128 in = _mm_loadu_ps(input + i);
+		__m128 l = _mm_mul_ps(in, left);
+		__m128 r = _mm_mul_ps(in, right);
+		_mm_storeu_ps(output + i * 2, _mm_add_ps(_mm_loadu_ps(output + i * 2), _mm_unpacklo_ps(l, r)));
+		_mm_storeu_ps(output + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(output + i * 2 + 4), _mm_unpackhi_ps(l, r)));
+		left = _mm_add_ps(left, leftStep);
+		right = _mm_add_ps(right, rightStep);
+	}
+	gainLeft += stepLeft * i;
+	gainRight += stepRight * i;
+#endif
+
+	// Remaining frames
+	for (; i < frames; ++i) {
+		output[i * 2] += input[i] * gainLeft;
+		output[i * 2 + 1] += input[i] * gainRight;
+		gainLeft += stepLeft;
+		gainRight += stepRight;
+	}
+}
+
+void LAudioMixer::mixStereo(float* output, const float* input, int frames, float gainLeft, float gainRight, float stepLeft, float stepRight) {
+	int i = 0;
+#if defined(MIXER_SSE)
+	// Four frames at a time, the input is already interleaved like the output
+	__m128 first = _mm_setr_ps(gainLeft, gainRight, gainLeft + stepLeft, gainRight + stepRight);
+	__m128 second = _mm_setr_ps(gainLeft + 2 * stepLeft, gainRight + 2 * stepRight, gainLeft + 3 * stepLeft, gainRight + 3 * stepRight);
+	__m128 step = _mm_setr_ps(4 * stepLeft, 4 * stepRight, 4 * stepLeft, 4 * stepRight);
+	for (; i + 4 <= frames; i += 4) {
+		_mm_storeu_ps(output + i * 2, _mm_add_ps(_mm_loadu_ps(output + i * 2), _mm_mul_ps(_mm_loadu_ps(input + i * 2), first)));
+		_mm_storeu_ps(output + i * 2 + 4, _mm_add_ps(_mm_loadu_ps(output + i * 2 + 4), _mm_mul_ps(_mm_loadu_ps(input + i * 2 + 4), second)));
+		first = _mm_add_ps(first, step);
+		second = _mm_add_ps(second, step);
+	}
+	gainLeft += stepLeft * i;
+	gainRight += stepRight * i;
+#endif
+
+	// Remaining frames
+	for (; i < frames; ++i) {
+		output[i * 2] += input[i * 2] * gainLeft;
+		output[i * 2 + 1] += input[i * 2 + 1] * gainRight;
+		gainLeft += stepLeft;
+		gainRight += stepRight;
+	}
+}
+
+void LAudioMixer::finishVoice(Voice& voice) {
+	// Tell the game the slot is free again
+	SDL_AtomicSet(&mSlotEnded[voice.handle & 0xFFFF], voice.handle);
+	voice.handle = 0;
+}
+
+bool LAudioMixer::pushCommand(MixerCommand& command) {
+	// Full queue means the audio thread has stalled, drop rather than block
+	Uint32 head = SDL_AtomicGet(&mCommandHead);
+	if (head - (Uint32)SDL_AtomicGet(&mCommandTail) >= (Uint32)MIXER_COMMAND_QUEUE_SIZE) {
+		++mDroppedCommands;
+		return false;
+	}
+
+	// Fill the entry before publishing it
+	mCommands[head & (MIXER_COMMAND_QUEUE_SIZE - 1)] = command;
+	SDL_AtomicSet(&mCommandHead, head + 1);
+	return true;
+}
+
+void LAudioMixer::getGains(float volume, float pan, float& left, float& right) {
+	// Equal power pan keeps the loudness constant across the stereo field
+	pan = pan < -1.f ? -1.f : (pan > 1.f ? 1.f : pan);
+	float angle = (pan + 1.f) * 0.785398163f;
+	left = volume * cosf(angle);
+	right = volume * sinf(angle);
+}
+
+LSpatialAudio::LSpatialAudio() {
+	// Initialize
+	mListenerX = 0.f;
+	mListenerY = 0.f;
+	SDL_zero(mEmitters);
+	mEmitterCount = 0;
+	for (int i = MAX_EMITTERS - 1; i >= 0; --i) {
+		mFreeSlots.push_back(i);
+	}
+	mAudible.reserve(MAX_EMITTERS);
+	SDL_zero(mStats);
+}
+
+EmitterHandle LSpatialAudio::addEmitter(LSound* sound, float x, float y, float volume, bool loop, int priority, float minDistance, float maxDistance) {
+	if (sound == NULL || mFreeSlots.empty()) {
+		return 0;
+	}
+	int slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+
+	// Bump the slot's generation so old handles to it go stale
+	Emitter& emitter = mEmitters[slot];
+	Uint32 generation = (emitter.handle >> 16) + 1;
+	if (generation > 0xFFFF) {
+		generation = 1;
+	}
+
+	EmitterHandle handle = (generation << 16) | slot;
+	SDL_zero(emitter);
+	emitter.handle = handle;
+	emitter.sound = sound;
+	emitter.x = x;
+	emitter.y = y;
+	emitter.volume = volume;
+	emitter.minDistance = minDistance;
+	emitter.maxDistance = maxDistance > minDistance ? maxDistance : minDistance + 1.f;
+	emitter.priority = priority;
+	emitter.loop = loop;
+	++mEmitterCount;
+	return handle;
+}
+
+void LSpatialAudio::removeEmitter(EmitterHandle handle) {
+	Emitter* emitter = getEmitter(handle);
+	if (emitter != NULL) {
+		gMixer.stop(emitter->voice);
+
+		// Keep the handle so the generation carries on
+		emitter->sound = NULL;
+		emitter->voice = 0;
+		mFreeSlots.push_back(handle & 0xFFFF);
+		--mEmitterCount;
+	}
+}
+
+void LSpatialAudio::clear() {
+	for (int i = 0; i < MAX_EMITTERS; ++i) {
+		removeEmitter(mEmitters[i].handle);
+	}
+}
+
+void LSpatialAudio::setPosition(EmitterHandle handle, float x, float y) {
+	Emitter* emitter = getEmitter(handle);
+	if (emitter != NULL) {
+		emitter->x = x;
+		emitter->y = y;
+	}
+}
+
+void LSpatialAudio::setListener(float x, float y) {
+	mListenerX = x;
+	mListenerY = y;
+}
+
+void LSpatialAudio::update() {
+	SDL_zero(mStats);
+	mStats.emitters = mEmitterCount;
+	mAudible.clear();
+
+	for (int i = 0; i < MAX_EMITTERS; ++i) {
+		Emitter& emitter = mEmitters[i];
+		if (emitter.sound == NULL) {
+			continue;
+		}
+
+		// One shots are done once their voice has finished
+		if (emitter.started && !emitter.loop && !gMixer.isPlaying(emitter.voice)) {
+			removeEmitter(emitter.handle);
+			continue;
+		}
+
+		// Skip the square root for anything out of range
+		float dx = emitter.x - mListenerX;
+		float dy = emitter.y - mListenerY;
+		float distanceSquared = dx * dx + dy * dy;
+		emitter.gain = 0.f;
+		if (distanceSquared < emitter.maxDistance * emitter.maxDistance) {
+			// Full volume up close, fading linearly to silence at the maximum distance
+			float distance = sqrtf(distanceSquared);
+			float attenuation = distance <= emitter.minDistance ? 1.f : (emitter.maxDistance - distance) / (emitter.maxDistance - emitter.minDistance);
+			emitter.gain = emitter.volume * attenuation;
+		}
+		emitter.pan = dx / SPATIAL_PAN_DISTANCE;
+		emitter.pan = emitter.pan < -1.f ? -1.f : (emitter.pan > 1.f ? 1.f : emitter.pan);
+
+		if (emitter.gain < SPATIAL_AUDIBLE_GAIN) {
+			++mStats.culledSilent;
+			cull(emitter);
+		}
+		else {
+			mAudible.push_back(i);
+		}
+	}
+
+	// Only the loudest emitters get a voice, so the pool doesn't thrash on stealing
+	if ((int)mAudible.size() > SPATIAL_MAX_VOICES) {
+		Emitter* emitters = mEmitters;
+		std::nth_element(mAudible.begin(), mAudible.begin() + SPATIAL_MAX_VOICES, mAudible.end(), [emitters](int a, int b) {
+			return emitters[a].gain * emitters[a].priority > emitters[b].gain * emitters[b].priority;
+		});
+		for (size_t i = SPATIAL_MAX_VOICES; i < mAudible.size(); ++i) {
+			++mStats.culledBudget;
+			cull(mEmitters[mAudible[i]]);
+		}
+		mAudible.resize(SPATIAL_MAX_VOICES);
+	}
+
+	for (size_t i = 0; i < mAudible.size(); ++i) {
+		Emitter& emitter = mEmitters[mAudible[i]];
+
+		// Start audible emitters that don't have a voice yet, one shots only get the one chance
+		if (!gMixer.isPlaying(emitter.voice)) {
+			if (emitter.started && !emitter.loop) {
+				removeEmitter(emitter.handle);
+				continue;
+			}
+			emitter.voice = gMixer.play(emitter.sound, emitter.gain, emitter.pan, emitter.priority, emitter.loop);
+			emitter.sentGain = emitter.gain;
+			emitter.sentPan = emitter.pan;
+			emitter.started = true;
+		}
+		// Only send changes the ear would notice
+		else if (fabsf(emitter.gain - emitter.sentGain) > SPATIAL_GAIN_EPSILON || fabsf(emitter.pan - emitter.sentPan) > SPATIAL_GAIN_EPSILON) {
+			gMixer.setVolume(emitter.voice, emitter.gain, emitter.pan);
+			emitter.sentGain = emitter.gain;
+			emitter.sentPan = emitter.pan;
+			++mStats.gainUpdates;
+		}
+		if (gMixer.isPlaying(emitter.voice)) {
+			++mStats.audibleVoices;
+		}
+	}
+}
+
+SpatialStats LSpatialAudio::getStats() {
+	return mStats;
+}
+
+LSpatialAudio::Emitter* LSpatialAudio::getEmitter(EmitterHandle handle) {
+	Uint32 slot = handle & 0xFFFF;
+	if (handle == 0 || slot >= MAX_EMITTERS || mEmitters[slot].handle != handle || mEmitters[slot].sound == NULL) {
+		return NULL;
+	}
+	return &mEmitters[slot];
+}
+
+void LSpatialAudio::cull(Emitter& emitter) {
+	// Looping emitters start over once audible again, a culled one shot is gone for good
+	gMixer.stop(emitter.voice);
+	emitter.voice = 0;
+	if (!emitter.loop) {
+		removeEmitter(emitter.handle);
+	}
+}
+
+void spawnDot(LSound* sound) {
+	// Somewhere on screen heading in a random direction
+	SpatialDot dot;
+	dot.x = (float)(rand() % SCREEN_WIDTH);
+	dot.y = (float)(rand() % SCREEN_HEIGHT);
+	float angle = rand() / (float)RAND_MAX * 6.2831853f;
+	float speed = 60.f + rand() % 180;
+	dot.velX = cosf(angle) * speed;
+	dot.velY = sinf(angle) * speed;
+	dot.emitter = gSpatial.addEmitter(sound, dot.x, dot.y, 0.5f);
+	if (dot.emitter != 0) {
+		gDots.push_back(dot);
+	}
+}
+
+void moveDots(float seconds) {
+	for (size_t i = 0; i < gDots.size(); ++i) {
+		SpatialDot& dot = gDots[i];
+
+		// Bounce off the screen edges
+		dot.x += dot.velX * seconds;
+		dot.y += dot.velY * seconds;
+		if ((dot.x < 0.f && dot.velX < 0.f) || (dot.x > SCREEN_WIDTH && dot.velX > 0.f)) {
+			dot.velX = -dot.velX;
+		}
+		if ((dot.y < 0.f && dot.velY < 0.f) || (dot.y > SCREEN_HEIGHT && dot.velY > 0.f)) {
+			dot.velY = -dot.velY;
+		}
+
+		// Emitters follow their entity
+		gSpatial.setPosition(dot.emitter, dot.x, dot.y);
+	}
+}
+
+void clearDots() {
+	gSpatial.clear();
+	gDots.clear();
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -262,9 +1870,10 @@ bool init() {
 					printf("SDL_Image could not initialize! SDL_Image Error: %s\n", IMG_GetError());
 					success = false;
 				}
-				// Initialize SDL_Mixer
-				if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, 2, 2048) > 0) {
-					printf("SDL_mixer could not initialize! SDL_mixer Error: %s\n", Mix_GetError());
+				// Start the mixer and the stream decoder
+				if (!gMixer.open() || !gStreamThread.start()) {
+					printf("Mixer could not initialize!\n");
+					success = false;
 				}
 
 #if defined(SDL_TTF_MAJOR_VERSION)
@@ -292,32 +1901,30 @@ bool loadMedia() {
 		success = false;
 	}
 
-	// Load music
-	gMusic = Mix_LoadMUS("21_sound_effects_and_music/beat.wav");
-	if (gMusic == NULL) {
-		printf("Failed to load beat music! SDL_mixer Error: %s\n", Mix_GetError());
+	// Open the music for streaming
+	if (!gMusic.open("21_sound_effects_and_music/beat.wav", gMixer.getFrequency(), true)) {
+		printf("Failed to open beat music!\n");
 		success = false;
 	}
+	else {
+		gStreamThread.add(&gMusic);
+	}
 
 	// Load sound effects
-	gScratch = Mix_LoadWAV("21_sound_effects_and_music/scratch.wav");
-	if (gScratch == NULL) {
-		printf("Failed to load scratch sound effect! SDL_mixer Error: %s\n", Mix_GetError());
+	if (!gScratch.loadFromFile("21_sound_effects_and_music/scratch.wav", gMixer.getFrequency())) {
+		printf("Failed to load scratch sound effect!\n");
 		success = false;
 	}
-	gHigh = Mix_LoadWAV("21_sound_effects_and_music/high.wav");
-	if (gHigh == NULL) {
-		printf("Failed to load high sound effect! SDL_mixer Error: %s\n", Mix_GetError());
+	if (!gHigh.loadFromFile("21_sound_effects_and_music/high.wav", gMixer.getFrequency())) {
+		printf("Failed to load high sound effect!\n");
 		success = false;
 	}
-	gMedium = Mix_LoadWAV("21_sound_effects_and_music/medium.wav");
-	if (gMedium == NULL) {
-		printf("Failed to load medium sound effect! SDL_mixer Error: %s\n", Mix_GetError());
+	if (!gMedium.loadFromFile("21_sound_effects_and_music/medium.wav", gMixer.getFrequency())) {
+		printf("Failed to load medium sound effect!\n");
 		success = false;
 	}
-	gLow = Mix_LoadWAV("21_sound_effects_and_music/low.wav");
-	if (gLow == NULL) {
-		printf("Failed to load low sound effect! SDL_mixer Error: %s\n", Mix_GetError());
+	if (!gLow.loadFromFile("21_sound_effects_and_music/low.wav", gMixer.getFrequency())) {
+		printf("Failed to load low sound effect!\n");
 		success = false;
 	}
 
@@ -334,19 +1941,20 @@ void close() {
 	gFont = NULL;
 #endif
 
+	// Stop mixing and decoding before the sounds go away
+	clearDots();
+	gMixer.close();
+	gStreamThread.stop();
+	gMusicVoice = 0;
+
 	// Free the sound effects
-	Mix_FreeChunk(gScratch);
-	Mix_FreeChunk(gHigh);
-	Mix_FreeChunk(gMedium);
-	Mix_FreeChunk(gLow);
-	gScratch = NULL;
-	gHigh = NULL;
-	gMedium = NULL;
-	gLow = NULL;
+	gScratch.free();
+	gHigh.free();
+	gMedium.free();
+	gLow.free();
 
 	// Free the music 
-	Mix_FreeMusic(gMusic);
-	gMusic = NULL;
+	gMusic.close();
 
 	// Destroy window
 	SDL_DestroyRenderer(gRenderer);
@@ -357,12 +1965,120 @@ void close() {
 	// Quit SDL subsystems
 	SDL_Quit();
 	IMG_Quit();
-	Mix_Quit();
 #if defined(SDL_TTF_MAJOR_VERSION)
 	TTF_Quit();
 #endif
 }
 
+void runMixerBenchmark(int voices) {
+	// Loop the requested number of quiet background voices across the stereo field
+	LSound* sounds[] = { &gScratch, &gHigh, &gMedium, &gLow };
+	for (int i = 0; i < voices; ++i) {
+		gMixer.play(sounds[i % 4], 1.f / voices, voices > 1 ? -1.f + 2.f * i / (voices - 1) : 0.f, PRIORITY_AMBIENT, true);
+	}
+
+	// Fire effects on top every frame so a full pool has to steal
+	for (int second = 0; second < BENCHMARK_SECONDS; ++second) {
+		Uint32 start = SDL_GetTicks();
+		while (SDL_GetTicks() - start < 1000) {
+			gMixer.play(sounds[rand() % 4], 0.25f, rand() / (float)RAND_MAX * 2.f - 1.f);
+			SDL_Delay(16);
+		}
+
+		MixerStats stats = gMixer.getStats();
+		printf("%s: %d callbacks, %.3f ms average, %.3f ms peak of %.3f ms, %d voices, %d stolen, %d rejected\n", SDL_GetCurrentAudioDriver(), stats.callbacks, stats.averageMs, stats.peakMs, stats.budgetMs, stats.activeVoices, stats.stolenVoices, stats.rejectedVoices);
+	}
+}
+
+void runStreamBenchmark(int count) {
+	// Open the music once per stream, each with its own file and buffers
+	std::vector<LAudioStream*> streams;
+	int bufferBytes = 0;
+	for (int i = 0; i < count; ++i) {
+		LAudioStream* stream = new LAudioStream();
+		if (!stream->open("21_sound_effects_and_music/beat.wav", gMixer.getFrequency(), true)) {
+			delete stream;
+			break;
+		}
+		bufferBytes += stream->getBufferBytes();
+		gStreamThread.add(stream);
+		streams.push_back(stream);
+	}
+
+	// Give the decoder a pass over the new streams, then play them all spread across the stereo field
+	SDL_Delay(STREAM_POLL_MS * 2);
+	for (size_t i = 0; i < streams.size(); ++i) {
+		gMixer.play(streams[i], 1.f / streams.size(), streams.size() > 1 ? -1.f + 2.f * i / (streams.size() - 1) : 0.f, PRIORITY_AMBIENT);
+	}
+	printf("%d streams, %d KB buffered each\n", (int)streams.size(), streams.empty() ? 0 : bufferBytes / (int)streams.size() / 1024);
+
+	for (int second = 0; second < BENCHMARK_SECONDS; ++second) {
+		// Jump one stream around every frame to exercise seeking
+		Uint32 start = SDL_GetTicks();
+		while (SDL_GetTicks() - start < 1000) {
+			if (!streams.empty()) {
+				streams[rand() % streams.size()]->seek(rand() % 4);
+			}
+			SDL_Delay(16);
+		}
+
+		int underruns = 0;
+		for (size_t i = 0; i < streams.size(); ++i) {
+			underruns += streams[i]->getUnderruns();
+		}
+		MixerStats stats = gMixer.getStats();
+		printf("%s: %.3f ms average, %.3f ms peak of %.3f ms, %d voices, %d underruns\n", SDL_GetCurrentAudioDriver(), stats.averageMs, stats.peakMs, stats.budgetMs, stats.activeVoices, underruns);
+	}
+
+	// Stop the voices before the streams go away
+	gMixer.close();
+	for (size_t i = 0; i < streams.size(); ++i) {
+		gStreamThread.remove(streams[i]);
+		delete streams[i];
+	}
+}
+
+void runSpatialBenchmark(int count) {
+	// Scatter moving emitters over the screen
+	LSound* sounds[] = { &gScratch, &gHigh, &gMedium, &gLow };
+	for (int i = 0; i < count; ++i) {
+		spawnDot(sounds[i % 4]);
+	}
+	printf("%d emitters\n", (int)gDots.size());
+
+	// Tick the game at 60Hz with the listener circling the middle of the screen
+	Uint32 tick = 0;
+	for (int second = 0; second < BENCHMARK_SECONDS; ++second) {
+		Uint64 updateCounter = 0;
+		int updates = 0;
+		int culledSilent = 0;
+		int culledBudget = 0;
+		int gainUpdates = 0;
+		Uint32 start = SDL_GetTicks();
+		while (SDL_GetTicks() - start < 1000) {
+			float angle = tick++ * 0.02f;
+			Uint64 updateStart = SDL_GetPerformanceCounter();
+			moveDots(1.f / 60.f);
+			gSpatial.setListener(SCREEN_WIDTH / 2 + cosf(angle) * SCREEN_WIDTH / 3, SCREEN_HEIGHT / 2 + sinf(angle) * SCREEN_HEIGHT / 3);
+			gSpatial.update();
+			updateCounter += SDL_GetPerformanceCounter() - updateStart;
+
+			SpatialStats spatial = gSpatial.getStats();
+			culledSilent += spatial.culledSilent;
+			culledBudget += spatial.culledBudget;
+			gainUpdates += spatial.gainUpdates;
+			++updates;
+			SDL_Delay(16);
+		}
+
+		SpatialStats spatial = gSpatial.getStats();
+		MixerStats stats = gMixer.getStats();
+		printf("%s: %.3f ms update, %.3f ms mix average, %.3f ms peak of %.3f ms, %d voices, %.1f culled silent, %.1f culled over budget, %.1f gain updates per tick\n", SDL_GetCurrentAudioDriver(), updateCounter * 1000.0 / SDL_GetPerformanceFrequency() / updates, stats.averageMs, stats.peakMs, stats.budgetMs, spatial.audibleVoices, culledSilent / (double)updates, culledBudget / (double)updates, gainUpdates / (double)updates);
+	}
+
+	clearDots();
+}
+
 SDL_Texture* loadTexture(std::string path) {
 
 	// Load texture at specified path
@@ -387,6 +2103,16 @@ int main(int argc, char* args[]) {
 		if (!loadMedia()) {
 			printf("Failed to load media!\n");
 		}
+		// Measure the mixer instead of running the lesson
+		else if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+			runMixerBenchmark(argc > 2 ? atoi(args[2]) : BENCHMARK_VOICES);
+		}
+		else if (argc > 1 && strcmp(args[1], "--streams") == 0) {
+			runStreamBenchmark(argc > 2 ? atoi(args[2]) : BENCHMARK_STREAMS);
+		}
+		else if (argc > 1 && strcmp(args[1], "--spatial") == 0) {
+			runSpatialBenchmark(argc > 2 ? atoi(args[2]) : BENCHMARK_EMITTERS);
+		}
 		else {
 
 			// Main loop flag
@@ -401,6 +2127,12 @@ int main(int argc, char* args[]) {
 			// Flip type
 			SDL_RendererFlip flipType = SDL_FLIP_NONE;
 
+			// Time the mixer stats were last shown
+			Uint32 statsTime = 0;
+
+			// Time of the last game tick
+			Uint32 tickTime = SDL_GetTicks();
+
 			// While application is running
 			while (!quit) {
 
@@ -416,59 +2148,88 @@ int main(int argc, char* args[]) {
 						switch (e.key.keysym.sym) {
 						// Play high sound effect
 						case SDLK_1:
-							Mix_PlayChannel(-1, gHigh, 0);
+							gMixer.play(&gHigh);
 							break;
 						// Play Medium sound effect
 						case SDLK_2:
-							Mix_PlayChannel(-1, gMedium, 0);
+							gMixer.play(&gMedium);
 							break;
 						// Play Low sound effect
 						case SDLK_3:
-							Mix_PlayChannel(-1, gLow, 0);
+							gMixer.play(&gLow);
 							break;
 						// Play Scratch sound effect
 						case SDLK_4:
-							Mix_PlayChannel(-1, gScratch, 0);
+							gMixer.play(&gScratch);
 							break;
 						case SDLK_9:
 						// If there is no music playing
-							if (Mix_PlayingMusic() == 0) {
-								// Play the music 
-								Mix_PlayMusic(gMusic, -1);
+							if (!gMixer.isPlaying(gMusicVoice)) {
+								// Play the music from the start
+								gMusic.seek(0.0);
+								gMusicVoice = gMixer.play(&gMusic, 1.f, 0.f, PRIORITY_MUSIC);
+								gMusicPaused = false;
 						}
 						// If music is playing
 							else {
-								// If the music is paused
-								if (Mix_PausedMusic() == 1) {
-									// Resume the music
-									Mix_ResumeMusic();
-								}
-								// If the music is playing
-								else {
-									// Pause the music
-									Mix_PauseMusic();
-								}
+								// Pause or resume the music
+								gMusicPaused = !gMusicPaused;
+								gMixer.setPaused(gMusicVoice, gMusicPaused);
 							}
 							break;
 						case SDLK_0:
 							// Stop the music
-							Mix_HaltMusic();
+							gMixer.stop(gMusicVoice);
+							break;
+						// Add a moving looping sound
+						case SDLK_5: {
+							LSound* sounds[] = { &gScratch, &gHigh, &gMedium, &gLow };
+							spawnDot(sounds[rand() % 4]);
 							break;
 						}
-						
-
-						// Clear screen
-						SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-						SDL_RenderClear(gRenderer);
+						// Remove all moving sounds
+						case SDLK_6:
+							clearDots();
+							break;
+						}
+					}
+				}
 
-						// Render joystick 8 way angle
-						gPromptTexture.render(0, 0);
+				// Move the dots and hear them from the mouse
+				Uint32 now = SDL_GetTicks();
+				moveDots((now - tickTime) / 1000.f);
+				tickTime = now;
+				int mouseX = 0;
+				int mouseY = 0;
+				SDL_GetMouseState(&mouseX, &mouseY);
+				gSpatial.setListener((float)mouseX, (float)mouseY);
+				gSpatial.update();
+
+				// Clear screen
+				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+				SDL_RenderClear(gRenderer);
 
+				// Render prompt
+				gPromptTexture.render(0, 0);
 
-						// Update screen
-						SDL_RenderPresent(gRenderer);
+				// Render the dots
+				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0x00, 0x00, 0xFF);
+				for (size_t i = 0; i < gDots.size(); ++i) {
+					SDL_Rect dotRect = { (int)gDots[i].x - 2, (int)gDots[i].y - 2, 5, 5 };
+					SDL_RenderFillRect(gRenderer, &dotRect);
+				}
 
-					}
+				// Update screen
+				SDL_RenderPresent(gRenderer);
+
+				// Show the mixer load once a second
+				if (SDL_GetTicks() - statsTime >= 1000) {
+					MixerStats stats = gMixer.getStats();
+					SpatialStats spatial = gSpatial.getStats();
+					std::stringstream caption;
+					caption << "SDL Tutorial - Mix: " << stats.averageMs << " ms Peak: " << stats.peakMs << " of " << stats.budgetMs << " ms Voices: " << stats.activeVoices << " Stolen: " << stats.stolenVoices << " Emitters: " << spatial.emitters << " Culled: " << spatial.culledSilent + spatial.culledBudget;
+					SDL_SetWindowTitle(gWindow, caption.str().c_str());
+					statsTime = SDL_GetTicks();
 				}
 			}
 		}
@@ -2,6 +2,7 @@
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <sstream>
 
@@ -9,6 +10,14 @@
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Frame rate cap used when the display's refresh rate is unknown
+const int SCREEN_FPS = 60;
+
+// How close to the deadline the pacer stops sleeping and starts spinning
+const Uint64 PACER_SPIN_MICROSECONDS = 2000;
+
+// Frames paced by the benchmark
+const int BENCHMARK_FRAMES = 300;
 
 // Starts up SDL and creates window
 bool init();
@@ -19,6 +28,9 @@ bool loadMedia();
 // Frees media and shuts down SDL
 void close();
 
+// Compares millisecond capping against the frame pacer
+void runPacingBenchmark();
+
 // Texture wrapper class
 class LTexture {
 public:
@@ -94,12 +106,57 @@ private:
 	bool mStarted;
 };
 
+// Holds frames to a target rate on the performance counter, sleeping most of the wait and spinning the rest
+class LFramePacer {
+public:
+	// Initializes variables
+	LFramePacer();
+
+	// Sets the frame rate to pace to, 0 turns pacing off
+	void setTargetRate(int framesPerSecond);
+
+	// Matches the target to the refresh rate of the window's display, returns false if it is unknown
+	bool setTargetFromWindow(SDL_Window* window);
+
+	// Gets the frame rate being paced to
+	int getTargetRate();
+
+	// Starts timing frames from now
+	void start();
+
+	// Waits until the next frame is due
+	void wait();
+
+	// Gets how late frames were on average and at worst, in microseconds
+	double getAverageError();
+	double getMaxError();
+
+private:
+	// Performance counter ticks per second and per frame
+	Uint64 mFrequency;
+	Uint64 mFrameTicks;
+
+	// When the next frame is due
+	Uint64 mDeadline;
+
+	// The frame rate being paced to
+	int mTargetRate;
+
+	// Lateness of paced frames
+	Uint64 mErrorTicks;
+	Uint64 mMaxErrorTicks;
+	int mPacedFrames;
+};
+
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
 // The surface contained by the window
 SDL_Renderer* gRenderer = NULL;
 
+// Paces the main loop to the cap
+LFramePacer gFramePacer;
+
 // Scene textures
 LTexture gFPSTextTexture;
 LTexture gTimeTextTexture;
@@ -319,6 +376,133 @@ int LTexture::getHeight() {
 	return mHeight;
 }
 
+LFramePacer::LFramePacer() {
+	// Initialize the variables
+	mFrequency = SDL_GetPerformanceFrequency();
+	mFrameTicks = 0;
+	mDeadline = 0;
+	mTargetRate = 0;
+
+	mErrorTicks = 0;
+	mMaxErrorTicks = 0;
+	mPacedFrames = 0;
+}
+
+void LFramePacer::setTargetRate(int framesPerSecond) {
+	mTargetRate = framesPerSecond > 0 ? framesPerSecond : 0;
+	mFrameTicks = mTargetRate > 0 ? mFrequency / mTargetRate : 0;
+
+	// Time the new rate from now
+	start();
+}
+
+bool LFramePacer::setTargetFromWindow(SDL_Window* window) {
+	// Get the mode of the display the window is mostly on
+	SDL_DisplayMode mode;
+	int display = SDL_GetWindowDisplayIndex(window);
+	if (display < 0 || SDL_GetCurrentDisplayMode(display, &mode) != 0 || mode.refresh_rate <= 0) {
+		return false;
+	}
+
+	// Only retime if the rate actually changed
+	if (mode.refresh_rate != mTargetRate) {
+		setTargetRate(mode.refresh_rate);
+	}
+	return true;
+}
+
+int LFramePacer::getTargetRate() {
+	return mTargetRate;
+}
+
+void LFramePacer::start() {
+	mDeadline = SDL_GetPerformanceCounter() + mFrameTicks;
+
+	mErrorTicks = 0;
+	mMaxErrorTicks = 0;
+	mPacedFrames = 0;
+}
+
+void LFramePacer::wait() {
+	// Pacing is off
+	if (mFrameTicks == 0) {
+		return;
+	}
+
+	// Sleep off whole milliseconds while the deadline is comfortably far away
+	Uint64 spinTicks = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+	Uint64 now = SDL_GetPerformanceCounter();
+	if (now + spinTicks < mDeadline) {
+		SDL_Delay((Uint32)((mDeadline - now - spinTicks) * 1000 / mFrequency));
+	}
+
+	// Spin out the rest, sleep can't be trusted to wake on time
+	now = SDL_GetPerformanceCounter();
+	while (now < mDeadline) {
+		now = SDL_GetPerformanceCounter();
+	}
+
+	// Record how late this frame was
+	Uint64 error = now - mDeadline;
+	mErrorTicks += error;
+	if (error > mMaxErrorTicks) {
+		mMaxErrorTicks = error;
+	}
+	++mPacedFrames;
+
+	// Schedule from the deadline so rounding doesn't drift, unless we fell a whole frame behind
+	mDeadline += mFrameTicks;
+	if (now >= mDeadline) {
+		mDeadline = now + mFrameTicks;
+	}
+}
+
+double LFramePacer::getAverageError() {
+	if (mPacedFrames == 0) {
+		return 0.0;
+	}
+	return mErrorTicks * 1000000.0 / mFrequency / mPacedFrames;
+}
+
+double LFramePacer::getMaxError() {
+	return mMaxErrorTicks * 1000000.0 / mFrequency;
+}
+
+void runPacingBenchmark() {
+	// The performance counter works without video
+	SDL_Init(SDL_INIT_TIMER);
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	Uint64 targetTicks = frequency / SCREEN_FPS;
+
+	// Capping with a whole millisecond delay per frame
+	Uint32 ticksPerFrame = 1000 / SCREEN_FPS;
+	LTimer capTimer;
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_FRAMES; ++i) {
+		capTimer.start();
+		Uint32 frameTicks = capTimer.getTicks();
+		if (frameTicks < ticksPerFrame) {
+			SDL_Delay(ticksPerFrame - frameTicks);
+		}
+	}
+	double cappedMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+	// Pacing to deadlines on the performance counter
+	LFramePacer pacer;
+	pacer.setTargetRate(SCREEN_FPS);
+	start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_FRAMES; ++i) {
+		pacer.wait();
+	}
+	double pacedMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency / BENCHMARK_FRAMES;
+
+	printf("%d frames at %d fps, target %.3f ms per frame\n", BENCHMARK_FRAMES, SCREEN_FPS, targetTicks * 1000.0 / frequency);
+	printf("millisecond cap: %.3f ms per frame\n", cappedMs);
+	printf("frame pacer:     %.3f ms per frame, %.1f us late on average, %.1f us at worst\n", pacedMs, pacer.getAverageError(), pacer.getMaxError());
+
+	SDL_Quit();
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -342,8 +526,8 @@ bool init() {
 			success = false;
 		}
 		else {
-			// Create renderer for window
-			gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+			// Create renderer for window, without vsync since the frame pacer caps the rate
+			gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED);
 			if (gRenderer == NULL) {
 				printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
 				success = false;
@@ -431,6 +615,12 @@ SDL_Texture* loadTexture(std::string path) {
 
 int main(int argc, char* args[]) {
 
+	// Measure pacing accuracy instead of running the lesson
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0) {
+		runPacingBenchmark();
+		return 0;
+	}
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -458,9 +648,15 @@ int main(int argc, char* args[]) {
 			// In memory text stream
 			std::stringstream timeText;
 
+			// Cap to the display's refresh rate, or the default cap if it won't say
+			if (!gFramePacer.setTargetFromWindow(gWindow)) {
+				gFramePacer.setTargetRate(SCREEN_FPS);
+			}
+
 			// Start counting frames per second
 			int countedFrames = 0;
 			fpsTimer.start();
+			gFramePacer.start();
 
 			// While application is running
 			while (!quit) {
@@ -473,6 +669,15 @@ int main(int argc, char* args[]) {
 					{
 						quit = true;
 					}
+					// Retarget when the window moves to another display
+					else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_MOVED) {
+						gFramePacer.setTargetFromWindow(gWindow);
+					}
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+					else if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+						gFramePacer.setTargetFromWindow(gWindow);
+					}
+#endif
 				}
 
 				float avgFPS = countedFrames / (fpsTimer.getTicks() / 1000.f);
@@ -496,7 +701,8 @@ int main(int argc, char* args[]) {
 				//Render textures
 				gFPSTextTexture.render((SCREEN_WIDTH - gFPSTextTexture.getWidth()) / 2, (SCREEN_HEIGHT - gFPSTextTexture.getHeight()) / 2);
 
-				//Update screen
+				//Wait out the rest of the frame then update screen
+				gFramePacer.wait();
 				SDL_RenderPresent(gRenderer);
 				++countedFrames;
 			}
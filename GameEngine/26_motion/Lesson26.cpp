@@ -3,7 +3,10 @@
 #include <SDL_ttf.h>
 #include <stdio.h>
 #include <string>
+#include <string.h>
 #include <sstream>
+#include <vector>
+#include <cmath>
 
 // Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -94,6 +97,85 @@ private:
 	bool mStarted;
 };
 
+// Game actions, each one a bit in the input snapshot
+enum InputAction {
+	ACTION_UP,
+	ACTION_DOWN,
+	ACTION_LEFT,
+	ACTION_RIGHT,
+	ACTION_FIRE,
+	TOTAL_ACTIONS
+};
+
+// Analog axes, -1 to 1
+enum InputAxis {
+	AXIS_MOVE_X,
+	AXIS_MOVE_Y,
+	TOTAL_AXES
+};
+
+// Folds keyboard, mouse and joystick into a per tick snapshot of actions and axes
+class LInput {
+public:
+	// Mouse and joystick buttons that can be bound
+	static const int MAX_MOUSE_BUTTONS = 8;
+	static const int MAX_JOYSTICK_BUTTONS = 32;
+
+	// Initializes variables
+	LInput();
+
+	// Binds a key or button to an action, a key can drive several actions
+	void bindKey(SDL_Scancode key, int action);
+	void bindMouseButton(int button, int action);
+	void bindJoystickButton(int button, int action);
+
+	// Sets how far from centre the stick must be pushed before it registers, from 0 to 32766
+	void setDeadZone(int deadZone);
+
+	// Folds an event into the raw input state
+	void handleEvent(SDL_Event& e);
+
+	// Takes this tick's snapshot, call once per tick after handling events
+	void update();
+
+	// Action state in the last snapshot
+	bool isDown(int action);
+	bool wasPressed(int action);
+	bool wasReleased(int action);
+
+	// Gets an axis from the last snapshot
+	float getAxis(int axis);
+
+private:
+	// Marks an action's source as going down or up
+	void press(Uint32 actions);
+	void release(Uint32 actions);
+
+	// Bound actions of each source, as action bits
+	Uint32 mKeyBindings[SDL_NUM_SCANCODES];
+	Uint32 mMouseBindings[MAX_MOUSE_BUTTONS];
+	Uint32 mJoystickBindings[MAX_JOYSTICK_BUTTONS];
+
+	// How many held sources drive each action
+	Uint8 mHoldCounts[TOTAL_ACTIONS];
+
+	// Actions held now, and actions pressed since the last snapshot so taps aren't lost
+	Uint32 mHeld;
+	Uint32 mLatched;
+
+	// Joystick buttons held, so they can be let go if the joystick is unplugged
+	Uint32 mJoystickHeld;
+
+	// Raw stick position
+	int mStickX, mStickY;
+	int mDeadZone;
+
+	// This tick's and last tick's snapshots
+	Uint32 mCurrent;
+	Uint32 mPrevious;
+	float mAxes[TOTAL_AXES];
+};
+
 class Dot {
 public:
 	// The dimensions of the dot 
@@ -106,8 +188,8 @@ public:
 	// Initializes the variables
 	Dot();
 
-	// Takes key presses and adjusts the dot's velocity
-	void handleEvent(SDL_Event& e);
+	// Sets the dot's velocity from this tick's input
+	void handleInput(LInput& input);
 
 	// Moves the dot
 	void move();
@@ -122,6 +204,83 @@ private:
 	// The velocity of the dot
 	int mVelX, mVelY;
 };
+
+// Records input events with their frame numbers to a compact binary log and replays them at the same frames
+class LInputLog {
+public:
+	// Initializes variables
+	LInputLog();
+
+	// Finishes any recording
+	~LInputLog();
+
+	// Starts recording polled events to the given file
+	bool startRecording(std::string path);
+
+	// Loads a log and starts pushing its events back, live input is dropped meanwhile
+	bool startReplay(std::string path);
+
+	// Flushes a recording and stops recording or replaying
+	void stop();
+
+	// Pushes the replayed events due this frame, call before polling
+	void beginFrame();
+
+	// Logs a polled event when recording
+	void recordEvent(SDL_Event& e);
+
+	// Advances the frame counter, call once per frame after polling
+	void endFrame();
+
+	// Gets the current frame
+	Uint32 getFrame();
+
+	// Checks status of the log
+	bool isRecording();
+	bool isReplaying();
+	bool isReplayFinished();
+
+private:
+	// Drops live input while a replay is running
+	static int SDLCALL filterLiveInput(void* userdata, SDL_Event* e);
+
+	// Checks whether an event type is stored in the log
+	static bool isLoggedType(Uint32 type);
+
+	// Serialization helpers, signed values are zigzag encoded
+	void writeVarint(Uint32 value);
+	void writeSigned(Sint32 value);
+	void writeByte(Uint8 value);
+	Uint32 readVarint();
+	Sint32 readSigned();
+	Uint8 readByte();
+
+	// Writes the buffered records to the file
+	void flush();
+
+	// Reads the frame of the next replayed record
+	void readNextFrame();
+
+	// Log file being recorded
+	SDL_RWops* mFile;
+
+	// Recording buffer, or the whole log when replaying
+	std::vector<Uint8> mBuffer;
+	size_t mReadPosition;
+
+	// Frame counters
+	Uint32 mFrame;
+	Uint32 mLastRecordedFrame;
+	Uint32 mNextReplayFrame;
+
+	// Status
+	bool mRecording;
+	bool mReplaying;
+	bool mReplayFinished;
+
+	// Set while replayed events are being pushed so the filter lets them through
+	bool mInjecting;
+};
 // The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -132,6 +291,19 @@ SDL_Renderer* gRenderer = NULL;
 LTexture gDotTexture;
 LTexture gTimeTextTexture;
 
+// Input recorder and replayer
+LInputLog gInputLog;
+
+// Input snapshot for the current tick
+LInput gInput;
+
+// Input log file signature and version
+const char INPUT_LOG_MAGIC[4] = { 'I', 'N', 'P', 'L' };
+const Uint8 INPUT_LOG_VERSION = 1;
+
+// Recorded bytes kept in memory before they are written out
+const size_t INPUT_LOG_FLUSH_SIZE = 64 * 1024;
+
 #if defined(SDL_TTF_MAJOR_VERSION)
 // Globally used font
 TTF_Font* gFont = NULL;
@@ -147,28 +319,204 @@ Dot::Dot() {
 	mVelY = 0;
 }
 
-void Dot::handleEvent(SDL_Event &e) {
-	// If a key was pressed
-	if (e.type ==  SDL_KEYDOWN && e.key.repeat == 0) {
-		// Adjust the velocity
-		switch (e.key.keysym.sym) {
-		case SDLK_UP: mVelY -= DOT_VEL; break;
-		case SDLK_DOWN: mVelY += DOT_VEL; break;
-		case SDLK_LEFT: mVelX -= DOT_VEL; break;
-		case SDLK_RIGHT: mVelX += DOT_VEL; break;
+LInput::LInput() {
+	// Nothing bound and nothing held
+	memset(mKeyBindings, 0, sizeof(mKeyBindings));
+	memset(mMouseBindings, 0, sizeof(mMouseBindings));
+	memset(mJoystickBindings, 0, sizeof(mJoystickBindings));
+	memset(mHoldCounts, 0, sizeof(mHoldCounts));
+	mHeld = 0;
+	mLatched = 0;
+	mJoystickHeld = 0;
+
+	mStickX = 0;
+	mStickY = 0;
+	mDeadZone = 8000;
+
+	mCurrent = 0;
+	mPrevious = 0;
+	for (int i = 0; i < TOTAL_AXES; ++i) {
+		mAxes[i] = 0.f;
+	}
+}
+
+void LInput::bindKey(SDL_Scancode key, int action) {
+	if (key >= 0 && key < SDL_NUM_SCANCODES && action >= 0 && action < TOTAL_ACTIONS) {
+		mKeyBindings[key] |= 1u << action;
+	}
+}
+
+void LInput::bindMouseButton(int button, int action) {
+	if (button >= 0 && button < MAX_MOUSE_BUTTONS && action >= 0 && action < TOTAL_ACTIONS) {
+		mMouseBindings[button] |= 1u << action;
+	}
+}
+
+void LInput::bindJoystickButton(int button, int action) {
+	if (button >= 0 && button < MAX_JOYSTICK_BUTTONS && action >= 0 && action < TOTAL_ACTIONS) {
+		mJoystickBindings[button] |= 1u << action;
+	}
+}
+
+void LInput::setDeadZone(int deadZone) {
+	// A full size dead zone would leave nothing to rescale the stick into
+	mDeadZone = deadZone < 0 ? 0 : (deadZone > 32766 ? 32766 : deadZone);
+}
+
+void LInput::press(Uint32 actions) {
+	// Count every source so letting go of one of two bound keys keeps the action held
+	for (int i = 0; actions != 0; ++i, actions >>= 1) {
+		if ((actions & 1) && mHoldCounts[i]++ == 0) {
+			mHeld |= 1u << i;
+			mLatched |= 1u << i;
+		}
+	}
+}
+
+void LInput::release(Uint32 actions) {
+	for (int i = 0; actions != 0; ++i, actions >>= 1) {
+		if ((actions & 1) && mHoldCounts[i] > 0 && --mHoldCounts[i] == 0) {
+			mHeld &= ~(1u << i);
+		}
+	}
+}
+
+void LInput::handleEvent(SDL_Event& e) {
+	switch (e.type) {
+	case SDL_KEYDOWN:
+		if (e.key.repeat == 0) {
+			press(mKeyBindings[e.key.keysym.scancode]);
 		}
+		break;
+
+	case SDL_KEYUP:
+		if (e.key.repeat == 0) {
+			release(mKeyBindings[e.key.keysym.scancode]);
+		}
+		break;
+
+	case SDL_MOUSEBUTTONDOWN:
+		if (e.button.button < MAX_MOUSE_BUTTONS) {
+			press(mMouseBindings[e.button.button]);
+		}
+		break;
+
+	case SDL_MOUSEBUTTONUP:
+		if (e.button.button < MAX_MOUSE_BUTTONS) {
+			release(mMouseBindings[e.button.button]);
+		}
+		break;
+
+	case SDL_JOYBUTTONDOWN:
+		if (e.jbutton.which == 0 && e.jbutton.button < MAX_JOYSTICK_BUTTONS && !(mJoystickHeld & (1u << e.jbutton.button))) {
+			mJoystickHeld |= 1u << e.jbutton.button;
+			press(mJoystickBindings[e.jbutton.button]);
+		}
+		break;
+
+	case SDL_JOYBUTTONUP:
+		if (e.jbutton.which == 0 && e.jbutton.button < MAX_JOYSTICK_BUTTONS && (mJoystickHeld & (1u << e.jbutton.button))) {
+			mJoystickHeld &= ~(1u << e.jbutton.button);
+			release(mJoystickBindings[e.jbutton.button]);
+		}
+		break;
+
+	case SDL_JOYAXISMOTION:
+		// Left stick of the first controller
+		if (e.jaxis.which == 0) {
+			if (e.jaxis.axis == 0) {
+				mStickX = e.jaxis.value;
+			}
+			else if (e.jaxis.axis == 1) {
+				mStickY = e.jaxis.value;
+			}
+		}
+		break;
+
+	case SDL_JOYDEVICEREMOVED:
+		// Unplugged mid press, let go of everything it was holding
+		if (e.jdevice.which == 0) {
+			for (int i = 0; i < MAX_JOYSTICK_BUTTONS; ++i) {
+				if (mJoystickHeld & (1u << i)) {
+					release(mJoystickBindings[i]);
+				}
+			}
+			mJoystickHeld = 0;
+			mStickX = 0;
+			mStickY = 0;
+		}
+		break;
 	}
-	else if (e.type == SDL_KEYUP && e.key.repeat == 0) {
-		// Adjust the velocity
-		switch (e.key.keysym.sym) {
-			case SDLK_UP: mVelY += DOT_VEL; break;
-			case SDLK_DOWN: mVelY -= DOT_VEL; break;
-			case SDLK_LEFT: mVelX += DOT_VEL; break;
-			case SDLK_RIGHT: mVelX -= DOT_VEL; break;
+}
+
+void LInput::update() {
+	// Keys and buttons held or tapped since the last tick
+	Uint32 buttons = mHeld | mLatched;
+	mLatched = 0;
+
+	// Digital directions give a full axis
+	float x = (float)((int)((buttons >> ACTION_RIGHT) & 1) - (int)((buttons >> ACTION_LEFT) & 1));
+	float y = (float)((int)((buttons >> ACTION_DOWN) & 1) - (int)((buttons >> ACTION_UP) & 1));
+
+	// Radial dead zone so diagonals aren't cut off, rescaled to start from 0 at its edge
+	float stickX = mStickX / 32767.f;
+	float stickY = mStickY / 32767.f;
+	float length = sqrtf(stickX * stickX + stickY * stickY);
+	float deadZone = mDeadZone / 32767.f;
+	Uint32 stickActions = 0;
+	if (length > deadZone && deadZone < 1.f) {
+		float magnitude = length > 1.f ? 1.f : length;
+		float scale = (magnitude - deadZone) / (1.f - deadZone) / length;
+		stickX *= scale;
+		stickY *= scale;
+		x += stickX;
+		y += stickY;
+
+		// The stick drives the direction actions past halfway
+		if (stickX < -0.5f) {
+			stickActions |= 1u << ACTION_LEFT;
+		}
+		else if (stickX > 0.5f) {
+			stickActions |= 1u << ACTION_RIGHT;
+		}
+		if (stickY < -0.5f) {
+			stickActions |= 1u << ACTION_UP;
+		}
+		else if (stickY > 0.5f) {
+			stickActions |= 1u << ACTION_DOWN;
 		}
 	}
+
+	// Keep the combined axes in range
+	mAxes[AXIS_MOVE_X] = x < -1.f ? -1.f : (x > 1.f ? 1.f : x);
+	mAxes[AXIS_MOVE_Y] = y < -1.f ? -1.f : (y > 1.f ? 1.f : y);
+
+	// Shift the snapshots along
+	mPrevious = mCurrent;
+	mCurrent = buttons | stickActions;
+}
+
+bool LInput::isDown(int action) {
+	return (mCurrent >> action) & 1;
+}
+
+bool LInput::wasPressed(int action) {
+	return ((mCurrent & ~mPrevious) >> action) & 1;
+}
+
+bool LInput::wasReleased(int action) {
+	return ((mPrevious & ~mCurrent) >> action) & 1;
+}
+
+float LInput::getAxis(int axis) {
+	return mAxes[axis];
 }
 
+void Dot::handleInput(LInput& input) {
+	// Full speed on keys, proportional on a stick
+	mVelX = (int)(DOT_VEL * input.getAxis(AXIS_MOVE_X));
+	mVelY = (int)(DOT_VEL * input.getAxis(AXIS_MOVE_Y));
+}
 void Dot::move() {
 	 // Move teh dot left or right
 	mPosX += mVelX;
@@ -403,6 +751,387 @@ int LTexture::getHeight() {
 	return mHeight;
 }
 
+LInputLog::LInputLog() {
+	// Initialize
+	mFile = NULL;
+	mReadPosition = 0;
+	mFrame = 0;
+	mLastRecordedFrame = 0;
+	mNextReplayFrame = 0;
+	mRecording = false;
+	mReplaying = false;
+	mReplayFinished = false;
+	mInjecting = false;
+}
+
+LInputLog::~LInputLog() {
+	// Make sure a recording reaches the disk
+	stop();
+}
+
+bool LInputLog::startRecording(std::string path) {
+	// Get rid of any previous session
+	stop();
+
+	// Open the log for writing
+	mFile = SDL_RWFromFile(path.c_str(), "wb");
+	if (mFile == NULL) {
+		printf("Unable to create input log %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+
+	// Write the header
+	mBuffer.clear();
+	mBuffer.insert(mBuffer.end(), INPUT_LOG_MAGIC, INPUT_LOG_MAGIC + 4);
+	writeByte(INPUT_LOG_VERSION);
+
+	mFrame = 0;
+	mLastRecordedFrame = 0;
+	mRecording = true;
+	return true;
+}
+
+bool LInputLog::startReplay(std::string path) {
+	// Get rid of any previous session
+	stop();
+
+	// Read the whole log, it is only a few bytes per event
+	SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+	if (file == NULL) {
+		printf("Unable to open input log %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+	Sint64 size = SDL_RWsize(file);
+	mBuffer.resize(size > 0 ? (size_t)size : 0);
+	size_t read = mBuffer.empty() ? 0 : SDL_RWread(file, &mBuffer[0], mBuffer.size(), 1);
+	SDL_RWclose(file);
+
+	// Check the header
+	if (read != 1 || mBuffer.size() < 5 || memcmp(&mBuffer[0], INPUT_LOG_MAGIC, 4) != 0 || mBuffer[4] != INPUT_LOG_VERSION) {
+		printf("Input log %s is not a valid version %d log!\n", path.c_str(), INPUT_LOG_VERSION);
+		mBuffer.clear();
+		return false;
+	}
+	mReadPosition = 5;
+
+	// Find the first frame and start dropping live input
+	mFrame = 0;
+	mNextReplayFrame = 0;
+	mReplaying = true;
+	mReplayFinished = false;
+	readNextFrame();
+	SDL_SetEventFilter(filterLiveInput, this);
+	return true;
+}
+
+void LInputLog::stop() {
+	// Write out the rest of a recording
+	if (mRecording) {
+		flush();
+		SDL_RWclose(mFile);
+		mFile = NULL;
+		mRecording = false;
+	}
+
+	// Let live input through again
+	if (mReplaying) {
+		SDL_SetEventFilter(NULL, NULL);
+		mReplaying = false;
+	}
+
+	mBuffer.clear();
+	mReadPosition = 0;
+}
+
+void LInputLog::beginFrame() {
+	// Push every record due this frame
+	mInjecting = true;
+	while (mReplaying && !mReplayFinished && mNextReplayFrame == mFrame) {
+		SDL_Event e;
+		SDL_zero(e);
+		e.type = readVarint();
+
+		// Rebuild the event from its payload
+		switch (e.type) {
+		case SDL_KEYDOWN:
+		case SDL_KEYUP:
+			e.key.state = e.type == SDL_KEYDOWN ? 1 : 0;
+			e.key.keysym.scancode = (SDL_Scancode)readVarint();
+			e.key.keysym.sym = (SDL_Keycode)readVarint();
+			e.key.keysym.mod = (Uint16)readVarint();
+			e.key.repeat = readByte();
+			break;
+
+		case SDL_TEXTINPUT:
+		{
+			Uint8 length = readByte();
+			for (Uint8 i = 0; i < length && i < sizeof(e.text.text) - 1; ++i) {
+				e.text.text[i] = (char)readByte();
+			}
+			break;
+		}
+
+		case SDL_MOUSEMOTION:
+			e.motion.state = readVarint();
+			e.motion.x = readSigned();
+			e.motion.y = readSigned();
+			e.motion.xrel = readSigned();
+			e.motion.yrel = readSigned();
+			break;
+
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+			e.button.state = e.type == SDL_MOUSEBUTTONDOWN ? 1 : 0;
+			e.button.button = readByte();
+			e.button.clicks = readByte();
+			e.button.x = readSigned();
+			e.button.y = readSigned();
+			break;
+
+		case SDL_MOUSEWHEEL:
+			e.wheel.x = readSigned();
+			e.wheel.y = readSigned();
+			e.wheel.direction = readVarint();
+			break;
+
+		case SDL_JOYAXISMOTION:
+		case SDL_CONTROLLERAXISMOTION:
+			e.jaxis.which = readSigned();
+			e.jaxis.axis = readByte();
+			e.jaxis.value = (Sint16)readSigned();
+			break;
+
+		case SDL_JOYBUTTONDOWN:
+		case SDL_JOYBUTTONUP:
+		case SDL_CONTROLLERBUTTONDOWN:
+		case SDL_CONTROLLERBUTTONUP:
+			e.jbutton.which = readSigned();
+			e.jbutton.button = readByte();
+			e.jbutton.state = (e.type == SDL_JOYBUTTONDOWN || e.type == SDL_CONTROLLERBUTTONDOWN) ? 1 : 0;
+			break;
+
+		case SDL_JOYHATMOTION:
+			e.jhat.which = readSigned();
+			e.jhat.hat = readByte();
+			e.jhat.value = readByte();
+			break;
+
+		case SDL_WINDOWEVENT:
+			e.window.windowID = SDL_GetWindowID(gWindow);
+			e.window.event = readByte();
+			e.window.data1 = readSigned();
+			e.window.data2 = readSigned();
+			break;
+		}
+
+		// Key and mouse events belong to the lesson window
+		if (e.type != SDL_QUIT && e.type < SDL_JOYAXISMOTION) {
+			e.key.windowID = SDL_GetWindowID(gWindow);
+		}
+
+		SDL_PushEvent(&e);
+		readNextFrame();
+	}
+	mInjecting = false;
+}
+
+void LInputLog::recordEvent(SDL_Event& e) {
+	// Only input events are logged
+	if (!mRecording || !isLoggedType(e.type)) {
+		return;
+	}
+
+	// Frames are stored as the distance from the previous record
+	writeVarint(mFrame - mLastRecordedFrame);
+	mLastRecordedFrame = mFrame;
+	writeVarint(e.type);
+
+	// Store only the fields needed to rebuild the event
+	switch (e.type) {
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+		writeVarint(e.key.keysym.scancode);
+		writeVarint(e.key.keysym.sym);
+		writeVarint(e.key.keysym.mod);
+		writeByte(e.key.repeat);
+		break;
+
+	case SDL_TEXTINPUT:
+	{
+		Uint8 length = (Uint8)strlen(e.text.text);
+		writeByte(length);
+		mBuffer.insert(mBuffer.end(), e.text.text, e.text.text + length);
+		break;
+	}
+
+	case SDL_MOUSEMOTION:
+		writeVarint(e.motion.state);
+		writeSigned(e.motion.x);
+		writeSigned(e.motion.y);
+		writeSigned(e.motion.xrel);
+		writeSigned(e.motion.yrel);
+		break;
+
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		writeByte(e.button.button);
+		writeByte(e.button.clicks);
+		writeSigned(e.button.x);
+		writeSigned(e.button.y);
+		break;
+
+	case SDL_MOUSEWHEEL:
+		writeSigned(e.wheel.x);
+		writeSigned(e.wheel.y);
+		writeVarint(e.wheel.direction);
+		break;
+
+	case SDL_JOYAXISMOTION:
+	case SDL_CONTROLLERAXISMOTION:
+		writeSigned(e.jaxis.which);
+		writeByte(e.jaxis.axis);
+		writeSigned(e.jaxis.value);
+		break;
+
+	case SDL_JOYBUTTONDOWN:
+	case SDL_JOYBUTTONUP:
+	case SDL_CONTROLLERBUTTONDOWN:
+	case SDL_CONTROLLERBUTTONUP:
+		writeSigned(e.jbutton.which);
+		writeByte(e.jbutton.button);
+		break;
+
+	case SDL_JOYHATMOTION:
+		writeSigned(e.jhat.which);
+		writeByte(e.jhat.hat);
+		writeByte(e.jhat.value);
+		break;
+
+	case SDL_WINDOWEVENT:
+		writeByte(e.window.event);
+		writeSigned(e.window.data1);
+		writeSigned(e.window.data2);
+		break;
+	}
+
+	// Write out in large chunks so recording never touches the disk per event
+	if (mBuffer.size() >= INPUT_LOG_FLUSH_SIZE) {
+		flush();
+	}
+}
+
+void LInputLog::endFrame() {
+	++mFrame;
+}
+
+Uint32 LInputLog::getFrame() {
+	return mFrame;
+}
+
+bool LInputLog::isRecording() {
+	return mRecording;
+}
+
+bool LInputLog::isReplaying() {
+	return mReplaying;
+}
+
+bool LInputLog::isReplayFinished() {
+	return mReplayFinished;
+}
+
+int SDLCALL LInputLog::filterLiveInput(void* userdata, SDL_Event* e) {
+	// Let replayed events and everything that is not input through
+	LInputLog* log = (LInputLog*)userdata;
+	if (log->mInjecting || !isLoggedType(e->type)) {
+		return 1;
+	}
+
+	// Live quit stays available so a replay can be closed
+	return e->type == SDL_QUIT ? 1 : 0;
+}
+
+bool LInputLog::isLoggedType(Uint32 type) {
+	switch (type) {
+	case SDL_QUIT:
+	case SDL_WINDOWEVENT:
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+	case SDL_TEXTINPUT:
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+	case SDL_JOYAXISMOTION:
+	case SDL_JOYHATMOTION:
+	case SDL_JOYBUTTONDOWN:
+	case SDL_JOYBUTTONUP:
+	case SDL_CONTROLLERAXISMOTION:
+	case SDL_CONTROLLERBUTTONDOWN:
+	case SDL_CONTROLLERBUTTONUP:
+		return true;
+	}
+	return false;
+}
+
+void LInputLog::writeVarint(Uint32 value) {
+	// Seven bits per byte, high bit set on all but the last
+	while (value >= 0x80) {
+		mBuffer.push_back((Uint8)(value | 0x80));
+		value >>= 7;
+	}
+	mBuffer.push_back((Uint8)value);
+}
+
+void LInputLog::writeSigned(Sint32 value) {
+	// Zigzag so small negative values stay small
+	writeVarint(((Uint32)value << 1) ^ (Uint32)(value >> 31));
+}
+
+void LInputLog::writeByte(Uint8 value) {
+	mBuffer.push_back(value);
+}
+
+Uint32 LInputLog::readVarint() {
+	Uint32 value = 0;
+	for (int shift = 0; shift < 35 && mReadPosition < mBuffer.size(); shift += 7) {
+		Uint8 byte = mBuffer[mReadPosition++];
+		value |= (Uint32)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0) {
+			break;
+		}
+	}
+	return value;
+}
+
+Sint32 LInputLog::readSigned() {
+	Uint32 value = readVarint();
+	return (Sint32)(value >> 1) ^ -(Sint32)(value & 1);
+}
+
+Uint8 LInputLog::readByte() {
+	return mReadPosition < mBuffer.size() ? mBuffer[mReadPosition++] : 0;
+}
+
+void LInputLog::flush() {
+	// Write the buffered records in one go
+	if (mFile != NULL && !mBuffer.empty()) {
+		if (SDL_RWwrite(mFile, &mBuffer[0], mBuffer.size(), 1) != 1) {
+			printf("Unable to write input log! SDL Error: %s\n", SDL_GetError());
+		}
+		mBuffer.clear();
+	}
+}
+
+void LInputLog::readNextFrame() {
+	// The log ends when no record is left
+	if (mReadPosition >= mBuffer.size()) {
+		mReplayFinished = true;
+		return;
+	}
+	mNextReplayFrame += readVarint();
+}
+
 bool init() {
 	// Initialization flag
 	bool success = true;
@@ -509,6 +1238,12 @@ SDL_Texture* loadTexture(std::string path) {
 
 int main(int argc, char* args[]) {
 
+	// Replays run as fast as possible so the frame time can be benchmarked
+	bool replay = argc > 2 && strcmp(args[1], "--replay") == 0;
+	if (replay) {
+		SDL_SetHint(SDL_HINT_RENDER_VSYNC, "0");
+	}
+
 	// Start up SDL and create window
 	if (!init()) {
 		printf("Failed to initialize!\n");
@@ -536,9 +1271,29 @@ int main(int argc, char* args[]) {
 			// In memory text stream
 			std::stringstream timeText;
 
+			// Arrow keys steer the dot
+			gInput.bindKey(SDL_SCANCODE_UP, ACTION_UP);
+			gInput.bindKey(SDL_SCANCODE_DOWN, ACTION_DOWN);
+			gInput.bindKey(SDL_SCANCODE_LEFT, ACTION_LEFT);
+			gInput.bindKey(SDL_SCANCODE_RIGHT, ACTION_RIGHT);
+
+			// Record or replay the session's input
+			if (argc > 2 && strcmp(args[1], "--record") == 0) {
+				gInputLog.startRecording(args[2]);
+			}
+			else if (replay && !gInputLog.startReplay(args[2])) {
+				quit = true;
+			}
+
+			// Start of the replay for the frame time report
+			Uint64 replayStart = SDL_GetPerformanceCounter();
+
 			// While application is running
 			while (!quit) {
 
+				// Push the replayed input due this frame
+				gInputLog.beginFrame();
+
 				//Handle events on queue
 				while (SDL_PollEvent(&e) != 0)
 				{
@@ -547,9 +1302,12 @@ int main(int argc, char* args[]) {
 					{
 						quit = true;
 					}
-					dot.handleEvent(e);
+					gInputLog.recordEvent(e);
+					gInput.handleEvent(e);
 				}
-				// Move the dot
+				// Snapshot this tick's input and move the dot
+				gInput.update();
+				dot.handleInput(gInput);
 				dot.move();
 
 				//Clear screen
@@ -562,7 +1320,19 @@ int main(int argc, char* args[]) {
 				//Update screen
 				SDL_RenderPresent(gRenderer);
 
+				// Finish once the whole log has been played back
+				gInputLog.endFrame();
+				if (gInputLog.isReplaying() && gInputLog.isReplayFinished()) {
+					quit = true;
+				}
+			}
+
+			// Report the replay timings
+			if (gInputLog.isReplaying()) {
+				double totalMs = (double)(SDL_GetPerformanceCounter() - replayStart) * 1000.0 / SDL_GetPerformanceFrequency();
+				printf("Replayed %u frames in %.1f ms, %.3f ms per frame\n", gInputLog.getFrame(), totalMs, totalMs / (gInputLog.getFrame() > 0 ? gInputLog.getFrame() : 1));
 			}
+			gInputLog.stop();
 		}
 	}
 
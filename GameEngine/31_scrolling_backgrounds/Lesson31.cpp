@@ -1,11 +1,13 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2022)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, vectors, and strings
+//Using SDL, SDL_image, standard IO, math, and strings
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <math.h>
 #include <string>
+#include <string.h>
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -15,6 +17,12 @@ const int SCREEN_HEIGHT = 480;
 const int LEVEL_WIDTH = 1280;
 const int LEVEL_HEIGHT = 960;
 
+// Parallax benchmark constants
+const int BENCHMARK_WIDTH = 3840;
+const int BENCHMARK_HEIGHT = 2160;
+const int BENCHMARK_LAYERS = 8;
+const int BENCHMARK_FRAMES = 120;
+
 //A circle stucture
 struct Circle
 {
@@ -100,6 +108,52 @@ private:
 
 };
 
+// Background layer that wraps seamlessly, pre-baked into a strip covering the viewport
+class LParallaxLayer
+{
+public:
+	// Initializes variables
+	LParallaxLayer();
+
+	// Deallocates memory
+	~LParallaxLayer();
+
+	// Loads a tile image and bakes it into a strip at least one tile larger than the view on wrapped axes
+	bool loadFromFile(std::string path, int viewWidth, int viewHeight, bool wrapX, bool wrapY, bool colorKey);
+
+	// Deallocates the strip and tile
+	void free();
+
+	// Sets the scroll speed in pixels per second
+	void setSpeed(float speedX, float speedY);
+
+	// Advances the sub-pixel offset
+	void update(float seconds);
+
+	// Renders the whole view with a single copy from the strip
+	void render();
+
+	// Renders the view one tile at a time, the baseline the strip replaces
+	void renderTiled();
+
+private:
+	// Baked strip and the original tile
+	SDL_Texture* mStrip;
+	SDL_Texture* mTile;
+
+	// Strip, tile and view dimensions
+	int mStripWidth, mStripHeight;
+	int mTileWidth, mTileHeight;
+	int mViewWidth, mViewHeight;
+
+	// Scroll offset and speed
+	float mOffsetX, mOffsetY;
+	float mSpeedX, mSpeedY;
+
+	// Wrapped axes
+	bool mWrapX, mWrapY;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -118,6 +172,9 @@ bool checkCollision(Circle& a, SDL_Rect& b);
 //Calculates distance squared between two points
 double distanceSquared(int x1, int y1, int x2, int y2);
 
+// Renders parallax layers headlessly at 4K on the software renderer and reports the timings
+void runParallaxBenchmark();
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -126,7 +183,10 @@ SDL_Renderer* gRenderer = NULL;
 
 //Scene textures
 LTexture gDotTexture;
-LTexture gBGTexture;
+
+// Background layers, far to near
+LParallaxLayer gBGLayer;
+LParallaxLayer gStarLayer;
 
 LTexture::LTexture()
 {
@@ -276,6 +336,202 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
+LParallaxLayer::LParallaxLayer()
+{
+	//Initialize
+	mStrip = NULL;
+	mTile = NULL;
+	mStripWidth = 0;
+	mStripHeight = 0;
+	mTileWidth = 0;
+	mTileHeight = 0;
+	mViewWidth = 0;
+	mViewHeight = 0;
+	mOffsetX = 0.f;
+	mOffsetY = 0.f;
+	mSpeedX = 0.f;
+	mSpeedY = 0.f;
+	mWrapX = false;
+	mWrapY = false;
+}
+
+LParallaxLayer::~LParallaxLayer()
+{
+	//Deallocate
+	free();
+}
+
+bool LParallaxLayer::loadFromFile(std::string path, int viewWidth, int viewHeight, bool wrapX, bool wrapY, bool colorKey)
+{
+	//Get rid of preexisting layer
+	free();
+
+	//Load image at specified path
+	SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+	if (loadedSurface == NULL)
+	{
+		printf("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
+		return false;
+	}
+
+	//Color key image
+	if (colorKey)
+	{
+		SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, 0, 0xFF, 0xFF));
+	}
+
+	// Copy pixels as they are, keyed pixels stay transparent in the strip
+	SDL_SetSurfaceBlendMode(loadedSurface, SDL_BLENDMODE_NONE);
+
+	mTileWidth = loadedSurface->w;
+	mTileHeight = loadedSurface->h;
+	mViewWidth = viewWidth;
+	mViewHeight = viewHeight;
+	mWrapX = wrapX;
+	mWrapY = wrapY;
+
+	// A wrapped axis needs the view plus one tile so any offset is a single source rectangle
+	mStripWidth = mWrapX ? (viewWidth + 2 * mTileWidth - 1) / mTileWidth * mTileWidth : mTileWidth;
+	mStripHeight = mWrapY ? (viewHeight + 2 * mTileHeight - 1) / mTileHeight * mTileHeight : mTileHeight;
+
+	// Bake the tiled strip
+	SDL_Surface* stripSurface = SDL_CreateRGBSurfaceWithFormat(0, mStripWidth, mStripHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (stripSurface == NULL)
+	{
+		printf("Unable to create strip for %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+	}
+	else
+	{
+		SDL_FillRect(stripSurface, NULL, 0);
+		for (int y = 0; y < mStripHeight; y += mTileHeight)
+		{
+			for (int x = 0; x < mStripWidth; x += mTileWidth)
+			{
+				SDL_Rect tileQuad = { x, y, mTileWidth, mTileHeight };
+				SDL_BlitSurface(loadedSurface, NULL, stripSurface, &tileQuad);
+			}
+		}
+
+		//Create textures from surface pixels
+		mStrip = SDL_CreateTextureFromSurface(gRenderer, stripSurface);
+		mTile = SDL_CreateTextureFromSurface(gRenderer, loadedSurface);
+		if (mStrip == NULL || mTile == NULL)
+		{
+			printf("Unable to create texture from %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		}
+
+		//Get rid of strip surface
+		SDL_FreeSurface(stripSurface);
+	}
+
+	//Get rid of old loaded surface
+	SDL_FreeSurface(loadedSurface);
+
+	//Return success
+	if (mStrip == NULL || mTile == NULL)
+	{
+		free();
+		return false;
+	}
+	return true;
+}
+
+void LParallaxLayer::free()
+{
+	//Free textures if they exist
+	if (mStrip != NULL)
+	{
+		SDL_DestroyTexture(mStrip);
+		mStrip = NULL;
+	}
+	if (mTile != NULL)
+	{
+		SDL_DestroyTexture(mTile);
+		mTile = NULL;
+	}
+	mStripWidth = 0;
+	mStripHeight = 0;
+	mTileWidth = 0;
+	mTileHeight = 0;
+}
+
+void LParallaxLayer::setSpeed(float speedX, float speedY)
+{
+	mSpeedX = speedX;
+	mSpeedY = speedY;
+}
+
+void LParallaxLayer::update(float seconds)
+{
+	// Scroll
+	mOffsetX += mSpeedX * seconds;
+	mOffsetY += mSpeedY * seconds;
+
+	// Keep wrapped offsets inside one tile so they never lose float precision
+	if (mWrapX && mTileWidth > 0)
+	{
+		mOffsetX = fmodf(mOffsetX, (float)mTileWidth);
+		if (mOffsetX < 0.f)
+		{
+			mOffsetX += mTileWidth;
+		}
+	}
+	if (mWrapY && mTileHeight > 0)
+	{
+		mOffsetY = fmodf(mOffsetY, (float)mTileHeight);
+		if (mOffsetY < 0.f)
+		{
+			mOffsetY += mTileHeight;
+		}
+	}
+}
+
+void LParallaxLayer::render()
+{
+	SDL_Rect clip = { 0, 0, mStripWidth, mStripHeight };
+	SDL_FRect renderQuad = { -mOffsetX, -mOffsetY, (float)mStripWidth, (float)mStripHeight };
+
+	// Wrapped axes copy a view sized window out of the strip, one extra pixel for the sub-pixel shift
+	if (mWrapX)
+	{
+		float whole = floorf(mOffsetX);
+		clip.x = (int)whole;
+		clip.w = mViewWidth + 1;
+		renderQuad.x = whole - mOffsetX;
+		renderQuad.w = (float)clip.w;
+	}
+	if (mWrapY)
+	{
+		float whole = floorf(mOffsetY);
+		clip.y = (int)whole;
+		clip.h = mViewHeight + 1;
+		renderQuad.y = whole - mOffsetY;
+		renderQuad.h = (float)clip.h;
+	}
+
+	//Render to screen
+	SDL_RenderCopyF(gRenderer, mStrip, &clip, &renderQuad);
+}
+
+void LParallaxLayer::renderTiled()
+{
+	// Start at the tile under the view origin, unwrapped axes only get the one tile
+	int startX = -(int)mOffsetX;
+	int startY = -(int)mOffsetY;
+	int endX = mWrapX ? mViewWidth : startX + mTileWidth;
+	int endY = mWrapY ? mViewHeight : startY + mTileHeight;
+
+	// Copy the tile over every cell of the view
+	for (int y = startY; y < endY; y += mTileHeight)
+	{
+		for (int x = startX; x < endX; x += mTileWidth)
+		{
+			SDL_Rect renderQuad = { x, y, mTileWidth, mTileHeight };
+			SDL_RenderCopy(gRenderer, mTile, NULL, &renderQuad);
+		}
+	}
+}
+
 Dot::Dot()
 {
 	//Initialize the offsets
@@ -412,12 +668,21 @@ bool loadMedia()
 		success = false;
 	}
 
-	//Load background texture
-	if (!gBGTexture.loadFromFile("31_scrolling_backgrounds/bg.png"))
+	//Load background layers
+	if (!gBGLayer.loadFromFile("31_scrolling_backgrounds/bg.png", SCREEN_WIDTH, SCREEN_HEIGHT, true, false, false))
 	{
 		printf("Failed to load background texture!\n");
 		success = false;
 	}
+	if (!gStarLayer.loadFromFile("31_scrolling_backgrounds/dot.bmp", SCREEN_WIDTH, SCREEN_HEIGHT, true, true, true))
+	{
+		printf("Failed to load star layer texture!\n");
+		success = false;
+	}
+
+	// Near layers scroll faster
+	gBGLayer.setSpeed(60.f, 0.f);
+	gStarLayer.setSpeed(150.f, 25.f);
 
 	return success;
 }
@@ -426,6 +691,8 @@ void close()
 {
 	//Free loaded images
 	gDotTexture.free();
+	gBGLayer.free();
+	gStarLayer.free();
 
 	//Destroy window	
 	SDL_DestroyRenderer(gRenderer);
@@ -506,8 +773,86 @@ double distanceSquared(int x1, int y1, int x2, int y2)
 	return deltaX * deltaX + deltaY * deltaY;
 }
 
+void runParallaxBenchmark()
+{
+	// Render into a 4K surface so no window or GPU is involved
+	SDL_Surface* target = SDL_CreateRGBSurfaceWithFormat(0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	gRenderer = target != NULL ? SDL_CreateSoftwareRenderer(target) : NULL;
+	if (gRenderer == NULL)
+	{
+		printf("Unable to create software renderer! SDL Error: %s\n", SDL_GetError());
+		SDL_FreeSurface(target);
+		return;
+	}
+
+	// Alternate opaque background and keyed sprite layers, nearer layers scroll faster
+	LParallaxLayer layers[BENCHMARK_LAYERS];
+	bool success = true;
+	for (int i = 0; i < BENCHMARK_LAYERS && success; ++i)
+	{
+		bool sprites = i % 2 == 1;
+		success = layers[i].loadFromFile(sprites ? "31_scrolling_backgrounds/dot.bmp" : "31_scrolling_backgrounds/bg.png", BENCHMARK_WIDTH, BENCHMARK_HEIGHT, true, true, sprites);
+		layers[i].setSpeed(37.5f * (i + 1), 11.25f * (i + 1));
+	}
+
+	if (success)
+	{
+		// Time both render paths over the same scroll
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			Uint64 start = SDL_GetPerformanceCounter();
+			for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame)
+			{
+				SDL_RenderClear(gRenderer);
+				for (int i = 0; i < BENCHMARK_LAYERS; ++i)
+				{
+					layers[i].update(1.f / 60.f);
+					if (pass == 0)
+					{
+						layers[i].renderTiled();
+					}
+					else
+					{
+						layers[i].render();
+					}
+				}
+				SDL_RenderPresent(gRenderer);
+			}
+			Uint64 end = SDL_GetPerformanceCounter();
+
+			double frameMs = (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency() / BENCHMARK_FRAMES;
+			printf("%s: %d layers at %dx%d, %.3f ms per frame\n", pass == 0 ? "Per tile copies" : "Baked strips", BENCHMARK_LAYERS, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, frameMs);
+		}
+	}
+
+	// Free the layers before their renderer
+	for (int i = 0; i < BENCHMARK_LAYERS; ++i)
+	{
+		layers[i].free();
+	}
+	SDL_DestroyRenderer(gRenderer);
+	gRenderer = NULL;
+	SDL_FreeSurface(target);
+}
+
 int main(int argc, char* args[])
 {
+	// Run the headless parallax benchmark
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0)
+	{
+		if (SDL_Init(0) < 0 || !(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG))
+		{
+			printf("Failed to initialize! SDL Error: %s\n", SDL_GetError());
+		}
+		else
+		{
+			runParallaxBenchmark();
+		}
+		IMG_Quit();
+		SDL_Quit();
+		return 0;
+	}
+
 	//Start up SDL and create window
 	if (!init())
 	{
@@ -531,9 +876,8 @@ int main(int argc, char* args[])
 			//The dot that will be moving around on the screen
 			Dot dot;
 
-			// The background scrolling offset
-			int scrollingOffset = 0;
-
+			// Time of the previous frame for sub-pixel scrolling
+			Uint64 lastTime = SDL_GetPerformanceCounter();
 
 			//While application is running
 			while (!quit)
@@ -554,18 +898,20 @@ int main(int argc, char* args[])
 				// Move the dot
 				dot.move();
 
-				// Scroll background
-				--scrollingOffset;
-				if (scrollingOffset < -gBGTexture.getWidth()) {
-					scrollingOffset = 0;
-				}
+				// Scroll background layers by the elapsed time
+				Uint64 time = SDL_GetPerformanceCounter();
+				float seconds = (float)(time - lastTime) / SDL_GetPerformanceFrequency();
+				lastTime = time;
+				gBGLayer.update(seconds);
+				gStarLayer.update(seconds);
+
 				//Clear screen
 				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
 				SDL_RenderClear(gRenderer);
 
-				// Render background
-				gBGTexture.render(scrollingOffset, 0);
-				gBGTexture.render(scrollingOffset + gBGTexture.getWidth(), 0);
+				// Render background layers, one copy each
+				gBGLayer.render();
+				gStarLayer.render();
 
 
 				//Render objets
@@ -6,7 +6,9 @@ and may not be redistributed without written permission.*/
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <vector>
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -16,6 +18,11 @@ const int SCREEN_HEIGHT = 480;
 const int LEVEL_WIDTH = 1280;
 const int LEVEL_HEIGHT = 960;
 
+//Text size and keystrokes timed by the benchmark
+const int BENCHMARK_TEXT_LENGTH = 100000;
+const int BENCHMARK_KEYSTROKES = 100000;
+const int BENCHMARK_NAIVE_KEYSTROKES = 200;
+
 //A circle stucture
 struct Circle
 {
@@ -101,6 +108,114 @@ private:
 
 };
 
+//A line of the text buffer and its cached layout
+struct TextLine
+{
+	//Bytes in the line, not counting the newline
+	int length;
+
+	//Laid out width in pixels, -1 until the line is laid out again
+	int width;
+};
+
+//Gap buffer of UTF-8 text, edits happen at the cursor and only touch the cursor's line
+class LTextBuffer
+{
+public:
+	//Initializes variables
+	LTextBuffer();
+
+	//Replaces the text and puts the cursor at the end
+	void setText(const char* text);
+
+	//Gets a copy of the whole text
+	std::string getText();
+
+	//Inserts text at the cursor
+	void insert(const char* text);
+
+	//Removes the character before the cursor
+	void erase();
+
+	//Moves the cursor a character at a time
+	void moveLeft();
+	void moveRight();
+
+	//Gets a byte of the text
+	char at(int index);
+
+	//Gets the text and cursor dimensions
+	int getLength();
+	int getCursor();
+	int getCursorLine();
+	int getCursorColumn();
+	int getLineCount();
+
+	//Gets a line's cached layout
+	TextLine& getLine(int line);
+
+private:
+	//Makes room for at least this many more bytes
+	void reserve(int bytes);
+
+	//Moves the cursor one byte, keeping the line position in step
+	void stepLeft();
+	void stepRight();
+
+	//Text before the gap, the gap, and text after the gap
+	std::vector<char> mText;
+	int mGapStart;
+	int mGapEnd;
+
+	//Line table and the cursor's place in it
+	std::vector<TextLine> mLines;
+	int mCursorLine;
+	int mCursorColumn;
+};
+
+//Lays out and draws a text buffer from a glyph atlas, lines are only measured again after they change
+class LTextView
+{
+public:
+	//Printable glyphs in the atlas
+	static const int FIRST_GLYPH = 32;
+	static const int LAST_GLYPH = 126;
+
+	//Initializes variables
+	LTextView();
+
+	//Deallocates memory
+	~LTextView();
+
+	//Reads glyph advances from a font
+	bool loadMetrics(TTF_Font* font);
+
+	//Renders the glyphs into the atlas
+	bool loadAtlas(TTF_Font* font, SDL_Color color);
+
+	//Deallocates the atlas
+	void free();
+
+	//Gets a line's width, laying it out if it changed
+	int getLineWidth(LTextBuffer& buffer, int line, int start);
+
+	//Draws the lines around the cursor centred in the given area, along with the cursor
+	void render(LTextBuffer& buffer, int y, int height);
+
+private:
+	//Gets the glyph a byte is drawn with, continuation bytes aren't drawn
+	int glyphFor(char c);
+
+	//Glyph atlas and where each glyph sits in it
+	SDL_Texture* mAtlas;
+	SDL_Rect mGlyphClips[LAST_GLYPH + 1];
+	int mAdvances[LAST_GLYPH + 1];
+	int mLineSkip;
+
+	//First line shown
+	int mTopLine;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -119,6 +234,9 @@ bool checkCollision(Circle& a, SDL_Rect& b);
 //Calculates distance squared between two points
 double distanceSquared(int x1, int y1, int x2, int y2);
 
+//Times keystrokes on a large buffer against editing and measuring a whole string
+void runTextBenchmark();
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -130,7 +248,10 @@ TTF_Font* gFont = NULL;
 
 //Scene textures
 LTexture gPromptTextTexture;
-LTexture gInputTextTexture;
+
+//The text being edited and its layout
+LTextBuffer gInputText;
+LTextView gInputView;
 
 LTexture::LTexture()
 {
@@ -342,6 +463,505 @@ void Dot::move()
 	}
 }
 
+LTextBuffer::LTextBuffer()
+{
+	//Start with an empty line
+	setText("");
+}
+
+void LTextBuffer::setText(const char* text)
+{
+	//Drop the old text
+	mText.clear();
+	mGapStart = 0;
+	mGapEnd = 0;
+
+	//Reset the line table
+	TextLine empty = { 0, -1 };
+	mLines.assign(1, empty);
+	mCursorLine = 0;
+	mCursorColumn = 0;
+
+	insert(text);
+}
+
+std::string LTextBuffer::getText()
+{
+	//Join the text either side of the gap
+	std::string text(mText.begin(), mText.begin() + mGapStart);
+	text.append(mText.begin() + mGapEnd, mText.end());
+	return text;
+}
+
+void LTextBuffer::insert(const char* text)
+{
+	int length = (int)strlen(text);
+	reserve(length);
+
+	for (int i = 0; i < length; ++i)
+	{
+		//Fill the gap
+		char c = text[i];
+		mText[mGapStart++] = c;
+
+		//Split the line at the cursor
+		if (c == '\n')
+		{
+			TextLine tail = { mLines[mCursorLine].length - mCursorColumn, -1 };
+			mLines[mCursorLine].length = mCursorColumn;
+			mLines[mCursorLine].width = -1;
+			mLines.insert(mLines.begin() + mCursorLine + 1, tail);
+			++mCursorLine;
+			mCursorColumn = 0;
+		}
+		else
+		{
+			++mLines[mCursorLine].length;
+			mLines[mCursorLine].width = -1;
+			++mCursorColumn;
+		}
+	}
+}
+
+void LTextBuffer::erase()
+{
+	//Remove bytes back to the start of the character
+	char c = 0;
+	while (mGapStart > 0)
+	{
+		c = mText[--mGapStart];
+
+		//Join with the line above
+		if (c == '\n')
+		{
+			mCursorColumn = mLines[mCursorLine - 1].length;
+			mLines[mCursorLine - 1].length += mLines[mCursorLine].length;
+			mLines.erase(mLines.begin() + mCursorLine);
+			--mCursorLine;
+		}
+		else
+		{
+			--mLines[mCursorLine].length;
+			--mCursorColumn;
+		}
+		mLines[mCursorLine].width = -1;
+
+		//Stop once a lead byte is gone
+		if ((c & 0xC0) != 0x80)
+		{
+			break;
+		}
+	}
+}
+
+void LTextBuffer::moveLeft()
+{
+	//Step back over the whole character
+	while (mGapStart > 0)
+	{
+		stepLeft();
+		if ((mText[mGapEnd] & 0xC0) != 0x80)
+		{
+			break;
+		}
+	}
+}
+
+void LTextBuffer::moveRight()
+{
+	//Step over the lead byte and any continuation bytes after it
+	if (mGapEnd < (int)mText.size())
+	{
+		stepRight();
+		while (mGapEnd < (int)mText.size() && (mText[mGapEnd] & 0xC0) == 0x80)
+		{
+			stepRight();
+		}
+	}
+}
+
+char LTextBuffer::at(int index)
+{
+	return index < mGapStart ? mText[index] : mText[index + mGapEnd - mGapStart];
+}
+
+int LTextBuffer::getLength()
+{
+	return (int)mText.size() - (mGapEnd - mGapStart);
+}
+
+int LTextBuffer::getCursor()
+{
+	return mGapStart;
+}
+
+int LTextBuffer::getCursorLine()
+{
+	return mCursorLine;
+}
+
+int LTextBuffer::getCursorColumn()
+{
+	return mCursorColumn;
+}
+
+int LTextBuffer::getLineCount()
+{
+	return (int)mLines.size();
+}
+
+TextLine& LTextBuffer::getLine(int line)
+{
+	return mLines[line];
+}
+
+void LTextBuffer::reserve(int bytes)
+{
+	//Gap is already big enough
+	int gap = mGapEnd - mGapStart;
+	if (gap >= bytes)
+	{
+		return;
+	}
+
+	//Grow geometrically so typing is amortized constant, then slide the tail to the end
+	int oldSize = (int)mText.size();
+	int tail = oldSize - mGapEnd;
+	int newSize = oldSize * 2 > oldSize + bytes - gap + 64 ? oldSize * 2 : oldSize + bytes - gap + 64;
+	mText.resize(newSize);
+	if (tail > 0)
+	{
+		memmove(&mText[newSize - tail], &mText[mGapEnd], tail);
+	}
+	mGapEnd = newSize - tail;
+}
+
+void LTextBuffer::stepLeft()
+{
+	//Move the byte before the gap to after it
+	char c = mText[--mGapStart];
+	mText[--mGapEnd] = c;
+
+	if (c == '\n')
+	{
+		--mCursorLine;
+		mCursorColumn = mLines[mCursorLine].length;
+	}
+	else
+	{
+		--mCursorColumn;
+	}
+}
+
+void LTextBuffer::stepRight()
+{
+	//Move the byte after the gap to before it
+	char c = mText[mGapEnd++];
+	mText[mGapStart++] = c;
+
+	if (c == '\n')
+	{
+		++mCursorLine;
+		mCursorColumn = 0;
+	}
+	else
+	{
+		++mCursorColumn;
+	}
+}
+
+LTextView::LTextView()
+{
+	//Initialize
+	mAtlas = NULL;
+	mLineSkip = 0;
+	mTopLine = 0;
+	for (int i = 0; i <= LAST_GLYPH; ++i)
+	{
+		mGlyphClips[i].x = 0;
+		mGlyphClips[i].y = 0;
+		mGlyphClips[i].w = 0;
+		mGlyphClips[i].h = 0;
+		mAdvances[i] = 0;
+	}
+}
+
+LTextView::~LTextView()
+{
+	//Deallocate
+	free();
+}
+
+bool LTextView::loadMetrics(TTF_Font* font)
+{
+	//Advance of each printable glyph
+	for (int c = FIRST_GLYPH; c <= LAST_GLYPH; ++c)
+	{
+		int minX, maxX, minY, maxY;
+		if (TTF_GlyphMetrics(font, (Uint16)c, &minX, &maxX, &minY, &maxY, &mAdvances[c]) != 0)
+		{
+			printf("Unable to get metrics of glyph %d! SDL_ttf Error: %s\n", c, TTF_GetError());
+			return false;
+		}
+	}
+	mLineSkip = TTF_FontLineSkip(font);
+
+	return true;
+}
+
+bool LTextView::loadAtlas(TTF_Font* font, SDL_Color color)
+{
+	//Get rid of preexisting atlas
+	free();
+
+	//Render each glyph on its own
+	SDL_Surface* glyphs[LAST_GLYPH + 1] = { NULL };
+	int atlasWidth = 0;
+	int atlasHeight = 0;
+	bool success = true;
+	for (int c = FIRST_GLYPH; c <= LAST_GLYPH && success; ++c)
+	{
+		glyphs[c] = TTF_RenderGlyph_Solid(font, (Uint16)c, color);
+		if (glyphs[c] == NULL)
+		{
+			printf("Unable to render glyph %d! SDL_ttf Error: %s\n", c, TTF_GetError());
+			success = false;
+		}
+		else
+		{
+			mGlyphClips[c].x = atlasWidth;
+			mGlyphClips[c].y = 0;
+			mGlyphClips[c].w = glyphs[c]->w;
+			mGlyphClips[c].h = glyphs[c]->h;
+			atlasWidth += glyphs[c]->w;
+			atlasHeight = glyphs[c]->h > atlasHeight ? glyphs[c]->h : atlasHeight;
+		}
+	}
+
+	//Pack them in a row so the whole buffer draws from one texture
+	if (success)
+	{
+		SDL_Surface* atlasSurface = SDL_CreateRGBSurfaceWithFormat(0, atlasWidth, atlasHeight, 32, SDL_PIXELFORMAT_RGBA32);
+		if (atlasSurface == NULL)
+		{
+			printf("Unable to create glyph atlas surface! SDL Error: %s\n", SDL_GetError());
+			success = false;
+		}
+		else
+		{
+			for (int c = FIRST_GLYPH; c <= LAST_GLYPH; ++c)
+			{
+				SDL_BlitSurface(glyphs[c], NULL, atlasSurface, &mGlyphClips[c]);
+			}
+
+			mAtlas = SDL_CreateTextureFromSurface(gRenderer, atlasSurface);
+			if (mAtlas == NULL)
+			{
+				printf("Unable to create glyph atlas texture! SDL Error: %s\n", SDL_GetError());
+				success = false;
+			}
+			SDL_FreeSurface(atlasSurface);
+		}
+	}
+
+	//Get rid of the glyph surfaces
+	for (int c = FIRST_GLYPH; c <= LAST_GLYPH; ++c)
+	{
+		if (glyphs[c] != NULL)
+		{
+			SDL_FreeSurface(glyphs[c]);
+		}
+	}
+
+	return success;
+}
+
+void LTextView::free()
+{
+	//Free atlas if it exists
+	if (mAtlas != NULL)
+	{
+		SDL_DestroyTexture(mAtlas);
+		mAtlas = NULL;
+	}
+}
+
+int LTextView::glyphFor(char c)
+{
+	Uint8 byte = (Uint8)c;
+	if (byte >= FIRST_GLYPH && byte <= LAST_GLYPH)
+	{
+		return byte;
+	}
+
+	//Continuation bytes belong to the character before, anything else outside the atlas shows as '?'
+	return (byte & 0xC0) == 0x80 ? -1 : '?';
+}
+
+int LTextView::getLineWidth(LTextBuffer& buffer, int line, int start)
+{
+	//Only lay out lines that changed
+	TextLine& textLine = buffer.getLine(line);
+	if (textLine.width < 0)
+	{
+		int width = 0;
+		for (int i = start; i < start + textLine.length; ++i)
+		{
+			int glyph = glyphFor(buffer.at(i));
+			if (glyph >= 0)
+			{
+				width += mAdvances[glyph];
+			}
+		}
+		textLine.width = width;
+	}
+
+	return textLine.width;
+}
+
+void LTextView::render(LTextBuffer& buffer, int y, int height)
+{
+	//Scroll to keep the cursor's line in view
+	int visibleLines = mLineSkip > 0 && height > mLineSkip ? height / mLineSkip : 1;
+	int cursorLine = buffer.getCursorLine();
+	if (cursorLine < mTopLine)
+	{
+		mTopLine = cursorLine;
+	}
+	else if (cursorLine >= mTopLine + visibleLines)
+	{
+		mTopLine = cursorLine - visibleLines + 1;
+	}
+	if (mTopLine >= buffer.getLineCount())
+	{
+		mTopLine = buffer.getLineCount() - 1;
+	}
+
+	//Walk back from the cursor to where the first shown line starts
+	int start = buffer.getCursor() - buffer.getCursorColumn();
+	for (int line = cursorLine; line > mTopLine; --line)
+	{
+		start -= buffer.getLine(line - 1).length + 1;
+	}
+
+	//Draw each shown line centred
+	int lastLine = mTopLine + visibleLines < buffer.getLineCount() ? mTopLine + visibleLines : buffer.getLineCount();
+	for (int line = mTopLine; line < lastLine; ++line)
+	{
+		int x = (SCREEN_WIDTH - getLineWidth(buffer, line, start)) / 2;
+		int lineY = y + (line - mTopLine) * mLineSkip;
+		int length = buffer.getLine(line).length;
+		int cursorX = x;
+
+		for (int i = start; i < start + length; ++i)
+		{
+			//Note where the cursor falls
+			if (line == cursorLine && i == buffer.getCursor())
+			{
+				cursorX = x;
+			}
+
+			int glyph = glyphFor(buffer.at(i));
+			if (glyph >= 0)
+			{
+				//Only draw what's on screen
+				if (x < SCREEN_WIDTH && x + mGlyphClips[glyph].w > 0)
+				{
+					SDL_Rect renderQuad = { x, lineY, mGlyphClips[glyph].w, mGlyphClips[glyph].h };
+					SDL_RenderCopy(gRenderer, mAtlas, &mGlyphClips[glyph], &renderQuad);
+				}
+				x += mAdvances[glyph];
+			}
+		}
+
+		//Draw the cursor
+		if (line == cursorLine)
+		{
+			if (buffer.getCursor() == start + length)
+			{
+				cursorX = x;
+			}
+			SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0x00, 0xFF);
+			SDL_RenderDrawLine(gRenderer, cursorX, lineY, cursorX, lineY + mLineSkip - 1);
+		}
+
+		//Skip the newline
+		start += length + 1;
+	}
+}
+
+void runTextBenchmark()
+{
+	//Only glyph metrics are needed, so no window
+	if (TTF_Init() == -1)
+	{
+		printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+		return;
+	}
+	TTF_Font* font = TTF_OpenFont("32_text_input_and_clipboard_handling/lazy.ttf", 28);
+	LTextView view;
+	if (font == NULL || !view.loadMetrics(font))
+	{
+		printf("Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError());
+		TTF_Quit();
+		return;
+	}
+
+	//A console's worth of short lines
+	std::string text;
+	while ((int)text.length() < BENCHMARK_TEXT_LENGTH)
+	{
+		text += "The quick brown fox jumps over the lazy dog, again and again.\n";
+	}
+
+	//Whole string edits, measured the way the lesson used to render it every keystroke
+	std::string naive = text;
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_NAIVE_KEYSTROKES; ++i)
+	{
+		if (i % 2 == 0)
+		{
+			naive.insert(naive.length() / 2, "a");
+		}
+		else
+		{
+			naive.erase(naive.length() / 2 - 1, 1);
+		}
+		int w = 0, h = 0;
+		TTF_SizeText(font, naive.c_str(), &w, &h);
+	}
+	double naiveUs = (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency() / BENCHMARK_NAIVE_KEYSTROKES;
+
+	//Gap buffer edits in the middle, laying out only the edited line
+	LTextBuffer buffer;
+	buffer.setText(text.c_str());
+	while (buffer.getCursor() > buffer.getLength() / 2)
+	{
+		buffer.moveLeft();
+	}
+	start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < BENCHMARK_KEYSTROKES; ++i)
+	{
+		if (i % 2 == 0)
+		{
+			buffer.insert("a");
+		}
+		else
+		{
+			buffer.erase();
+		}
+		view.getLineWidth(buffer, buffer.getCursorLine(), buffer.getCursor() - buffer.getCursorColumn());
+	}
+	double bufferUs = (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency() / BENCHMARK_KEYSTROKES;
+
+	printf("%d characters, %d lines\n", buffer.getLength(), buffer.getLineCount());
+	printf("string and full measure: %.2f us per keystroke\n", naiveUs);
+	printf("gap buffer and line layout: %.3f us per keystroke\n", bufferUs);
+
+	TTF_CloseFont(font);
+	TTF_Quit();
+}
+
 bool init()
 {
 	//Initialization flag
@@ -424,6 +1044,13 @@ bool loadMedia()
 			printf("Failed to render prompt text!\n");
 			success = false;
 		}
+
+		//Build the glyphs the input text is drawn with
+		if (!gInputView.loadMetrics(gFont) || !gInputView.loadAtlas(gFont, textColor))
+		{
+			printf("Failed to build input text glyphs!\n");
+			success = false;
+		}
 	}
 
 	return success;
@@ -433,7 +1060,11 @@ void close()
 {
 	//Free loaded images
 	gPromptTextTexture.free();
-	gInputTextTexture.free();
+	gInputView.free();
+
+	//Free global font
+	TTF_CloseFont(gFont);
+	gFont = NULL;
 
 	//Destroy window	
 	SDL_DestroyRenderer(gRenderer);
@@ -517,122 +1148,116 @@ double distanceSquared(int x1, int y1, int x2, int y2)
 
 int main(int argc, char* args[])
 {
+	//Time text editing instead of running the lesson
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0)
+	{
+		runTextBenchmark();
+		return 0;
+	}
+
+	//Start up SDL and create window
+	if (!init())
 	{
-		//Start up SDL and create window
-		if (!init())
+		printf("Failed to initialize!\n");
+	}
+	else
+	{
+		//Load media
+		if (!loadMedia())
 		{
-			printf("Failed to initialize!\n");
+			printf("Failed to load media!\n");
 		}
 		else
 		{
-			//Load media
-			if (!loadMedia())
-			{
-				printf("Failed to load media!\n");
-			}
-			else
-			{
-				//Main loop flag
-				bool quit = false;
+			//Main loop flag
+			bool quit = false;
 
-				//Event handler
-				SDL_Event e;
+			//Event handler
+			SDL_Event e;
 
-				//Set text color as black
-				SDL_Color textColor = { 0, 0, 0, 0xFF };
+			//The current input text
+			gInputText.setText("Some Text");
 
-				//The current input text.
-				std::string inputText = "Some Text";
-				gInputTextTexture.loadFromRenderedText(inputText.c_str(), textColor);
+			//Enable text input
+			SDL_StartTextInput();
 
-				//Enable text input
-				SDL_StartTextInput();
-
-				//While application is running
-				while (!quit)
+			//While application is running
+			while (!quit)
+			{
+				//Handle events on queue
+				while (SDL_PollEvent(&e) != 0)
 				{
-					//The rerender text flag
-					bool renderText = false;
-
-					//Handle events on queue
-					while (SDL_PollEvent(&e) != 0)
+					//User requests quit
+					if (e.type == SDL_QUIT)
+					{
+						quit = true;
+					}
+					//Special key input
+					else if (e.type == SDL_KEYDOWN)
 					{
-						//User requests quit
-						if (e.type == SDL_QUIT)
+						//Handle backspace
+						if (e.key.keysym.sym == SDLK_BACKSPACE)
 						{
-							quit = true;
+							gInputText.erase();
 						}
-						//Special key input
-						else if (e.type == SDL_KEYDOWN)
+						//Handle new line
+						else if (e.key.keysym.sym == SDLK_RETURN)
 						{
-							//Handle backspace
-							if (e.key.keysym.sym == SDLK_BACKSPACE && inputText.length() > 0)
-							{
-								//lop off character
-								inputText.pop_back();
-								renderText = true;
-							}
-							//Handle copy
-							else if (e.key.keysym.sym == SDLK_c && SDL_GetModState() & KMOD_CTRL)
-							{
-								SDL_SetClipboardText(inputText.c_str());
-							}
-							//Handle paste
-							else if (e.key.keysym.sym == SDLK_v && SDL_GetModState() & KMOD_CTRL)
-							{
-								inputText = SDL_GetClipboardText();
-								renderText = true;
-							}
+							gInputText.insert("\n");
 						}
-						//Special text input event
-						else if (e.type == SDL_TEXTINPUT)
+						//Handle cursor movement
+						else if (e.key.keysym.sym == SDLK_LEFT)
 						{
-							//Not copy or pasting
-							if (!(SDL_GetModState() & KMOD_CTRL && (e.text.text[0] == 'c' || e.text.text[0] == 'C' || e.text.text[0] == 'v' || e.text.text[0] == 'V')))
-							{
-								//Append character
-								inputText += e.text.text;
-								renderText = true;
-							}
+							gInputText.moveLeft();
 						}
-					}
-
-					//Rerender text if needed
-					if (renderText)
-					{
-						//Text is not empty
-						if (inputText != "")
+						else if (e.key.keysym.sym == SDLK_RIGHT)
+						{
+							gInputText.moveRight();
+						}
+						//Handle copy
+						else if (e.key.keysym.sym == SDLK_c && SDL_GetModState() & KMOD_CTRL)
 						{
-							//Render new text
-							gInputTextTexture.loadFromRenderedText(inputText.c_str(), textColor);
+							SDL_SetClipboardText(gInputText.getText().c_str());
 						}
-						//Text is empty
-						else
+						//Handle paste
+						else if (e.key.keysym.sym == SDLK_v && SDL_GetModState() & KMOD_CTRL)
 						{
-							//Render space texture
-							gInputTextTexture.loadFromRenderedText(" ", textColor);
+							char* clipboardText = SDL_GetClipboardText();
+							gInputText.insert(clipboardText);
+							SDL_free(clipboardText);
 						}
 					}
+					//Special text input event
+					else if (e.type == SDL_TEXTINPUT)
+					{
+						//Not copy or pasting
+						if (!(SDL_GetModState() & KMOD_CTRL && (e.text.text[0] == 'c' || e.text.text[0] == 'C' || e.text.text[0] == 'v' || e.text.text[0] == 'V')))
+						{
+							//Insert character
+							gInputText.insert(e.text.text);
+						}
+					}
+				}
 
-					//Clear screen
-					SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-					SDL_RenderClear(gRenderer);
-
-					//Render text textures
-					gPromptTextTexture.render((SCREEN_WIDTH - gPromptTextTexture.getWidth()) / 2, 0);
-					gInputTextTexture.render((SCREEN_WIDTH - gInputTextTexture.getWidth()) / 2, gPromptTextTexture.getHeight());
+				//Clear screen
+				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+				SDL_RenderClear(gRenderer);
 
-					//Update screen
-					SDL_RenderPresent(gRenderer);
-				}
+				//Render prompt and the visible input lines
+				gPromptTextTexture.render((SCREEN_WIDTH - gPromptTextTexture.getWidth()) / 2, 0);
+				gInputView.render(gInputText, gPromptTextTexture.getHeight(), SCREEN_HEIGHT - gPromptTextTexture.getHeight());
 
-				//Disable text input
-				SDL_StopTextInput();
+				//Update screen
+				SDL_RenderPresent(gRenderer);
 			}
+
+			//Disable text input
+			SDL_StopTextInput();
 		}
+	}
 
-		//Free resources and close SDL
-		close();
+	//Free resources and close SDL
+	close();
 
-		return 0;
+	return 0;
 }
\ No newline at end of file
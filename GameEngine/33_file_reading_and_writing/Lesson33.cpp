@@ -6,7 +6,18 @@ and may not be redistributed without written permission.*/
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <set>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -22,6 +33,47 @@ const int TOTAL_DATA = 10;
 // Data points
 Sint32 gData[TOTAL_DATA];
 
+//Where the data is saved, the journal sits next to it
+const std::string SAVE_PATH = "33_file_reading_and_writing/numbs.bin";
+
+//Save file identifiers and format version
+const Uint32 SAVE_SNAPSHOT_MAGIC = 0x5641534C; //"LSAV"
+const Uint32 SAVE_JOURNAL_MAGIC = 0x4C4E4A4C; //"LJNL"
+const Uint32 SAVE_FORMAT_VERSION = 2;
+
+//First format version whose snapshot records are compressed
+const Uint32 SAVE_COMPRESSED_VERSION = 2;
+
+//Header and per record overhead in bytes
+const int SAVE_HEADER_BYTES = 16;
+const int SAVE_RECORD_HEADER_BYTES = 16;
+
+//Record holding the data points and the layout version of its payload
+const Uint32 SAVE_KEY_DATA = 1;
+const Uint32 SAVE_DATA_VERSION = 1;
+
+//Compressed streams are split into blocks of at most this many bytes
+const int LZ_BLOCK_BYTES = 64 * 1024;
+
+//Compressed stream identifier, "LZB1"
+const Uint32 LZ_STREAM_MAGIC = 0x31425A4C;
+
+//Block headers with this bit set hold the block uncompressed
+const Uint32 LZ_STORED_BLOCK = 0x80000000;
+
+//Match finder hash size, shortest match, and how close to the end matches may reach, as LZ4 requires
+const int LZ_HASH_BITS = 14;
+const int LZ_MIN_MATCH = 4;
+const int LZ_MAX_OFFSET = 65535;
+const int LZ_LAST_LITERALS = 5;
+const int LZ_MATCH_LIMIT = 12;
+
+//Benchmark world size and how much of it changes per save
+const int BENCHMARK_RECORD_BYTES = 64 * 1024;
+const int BENCHMARK_RECORDS = 1600;
+const int BENCHMARK_DIRTY_RECORDS = 4;
+const int BENCHMARK_COMMITS = 300;
+
 //A circle stucture
 struct Circle
 {
@@ -107,6 +159,208 @@ private:
 
 };
 
+//Block compressor, LZ4 block format with 64KB independent blocks
+class LBlockCompressor
+{
+public:
+	//Initializes variables
+	LBlockCompressor();
+
+	//Compresses one block, returns the compressed size or 0 if it doesn't fit in capacity
+	int compressBlock(const Uint8* source, int size, Uint8* destination, int capacity);
+
+	//Decompresses one block, returns the decompressed size or -1 if the data is damaged
+	static int decompressBlock(const Uint8* source, int size, Uint8* destination, int capacity);
+
+	//Appends a buffer as a stream of compressed blocks, readable through openCompressedRW
+	void compressStream(const Uint8* source, size_t size, std::vector<Uint8>& output);
+
+	//Worst case compressed size of a block
+	static int getBound(int size);
+
+private:
+	//Positions of recently seen 4 byte sequences by hash
+	Uint32 mTable[1 << LZ_HASH_BITS];
+};
+
+//Opens a compressed stream for reading, blocks are decompressed as they are read and closing it closes source
+SDL_RWops* openCompressedRW(SDL_RWops* source);
+
+//Timings of the last save
+struct SaveStats
+{
+	//Main thread time spent copying records into the staging arena
+	double snapshotMs;
+
+	//I/O thread time spent checksumming and writing them
+	double writeMs;
+
+	//Bytes staged by the last save, and what they took on disk
+	Uint32 bytes;
+	Uint32 diskBytes;
+
+	//Saves and loads not finished yet
+	int pendingJobs;
+
+	//Bytes appended to the journal since the last snapshot
+	Uint32 journalBytes;
+};
+
+//Keyed, versioned and checksummed records saved as a snapshot plus an append only journal by an I/O thread
+class LSaveFile
+{
+public:
+	//Initializes variables
+	LSaveFile();
+
+	//Waits for pending saves and stops the I/O thread
+	~LSaveFile();
+
+	//Queues loading the snapshot at path and replaying its journal over it, returns a ticket or 0 on failure
+	Uint32 loadAsync(std::string path);
+
+	//Copies the records changed since the last save and queues appending them to the journal
+	Uint32 commitAsync();
+
+	//Copies every record and queues writing them to a new snapshot that replaces the old one
+	Uint32 saveSnapshotAsync();
+
+	//Blocking versions of the above
+	bool load(std::string path);
+	bool commit();
+	bool saveSnapshot();
+
+	//Checks if the job behind a ticket has finished, picking up finished loads
+	bool isDone(Uint32 ticket);
+
+	//Checks if the job behind a finished ticket failed
+	bool failed(Uint32 ticket);
+
+	//Blocks until the job behind a ticket has finished, returns whether it succeeded
+	bool wait(Uint32 ticket);
+
+	//Waits for pending jobs, stops the I/O thread and forgets all records
+	void close();
+
+	//Gets a record's payload, NULL if there is no such record
+	const Uint8* getRecord(Uint32 key, Uint32* version, Uint32* size);
+
+	//Replaces a record's payload in memory, it reaches disk on the next commit or snapshot
+	void setRecord(Uint32 key, Uint32 version, const void* data, Uint32 size);
+
+	//Gets the timings of the last save
+	SaveStats getStats();
+
+private:
+	struct SaveRecord
+	{
+		Uint32 version;
+		std::vector<Uint8> data;
+		bool dirty;
+	};
+
+	enum SaveJobType
+	{
+		SAVE_JOB_LOAD,
+		SAVE_JOB_JOURNAL,
+		SAVE_JOB_SNAPSHOT
+	};
+
+	//Work handed to the I/O thread, recycled so the arena keeps its capacity
+	struct SaveJob
+	{
+		SaveJobType type;
+		Uint32 ticket;
+		std::string path;
+
+		//Staged records to write, or the files read by a load
+		std::vector<Uint8> arena;
+
+		//Records parsed by a load
+		std::map<Uint32, SaveRecord> records;
+
+		bool success;
+		double writeMs;
+		Uint32 diskBytes;
+	};
+
+	//Takes a recycled job or makes a new one
+	SaveJob* newJob(SaveJobType type);
+
+	//Hands a job to the I/O thread, starting it if needed
+	Uint32 queueJob(SaveJob* job);
+
+	//Applies finished jobs on the main thread
+	void retireJobs();
+
+	//Copies records into an arena in the on-disk layout, leaving the checksums to the I/O thread
+	static Uint8* stageHeader(Uint8* out, Uint32 magic, Uint32 generation, Uint32 count);
+	static Uint8* stageRecord(Uint8* out, Uint32 key, const SaveRecord& record);
+
+	//I/O thread
+	static int run(void* data);
+	void runJob(SaveJob& job);
+	bool loadFiles(SaveJob& job);
+	bool writeJournal(SaveJob& job);
+	bool writeSnapshot(SaveJob& job);
+
+	//Fills in the checksums of staged records
+	static void sealRecords(std::vector<Uint8>& arena, Uint32 offset);
+
+	//Reads a whole file, false if it can't be opened
+	static bool readFile(std::string path, std::vector<Uint8>& bytes);
+
+	//Reads a little endian word that may not be aligned
+	static Uint32 readLE32(const std::vector<Uint8>& bytes, size_t offset);
+
+	//Writes a buffer to a temporary file and renames it over path
+	static bool replaceFile(std::string path, const std::vector<Uint8>& bytes);
+
+	//Reads records until the end or the first damaged one, returns the bytes read
+	static Uint32 parseRecords(const std::vector<Uint8>& bytes, Uint32 offset, std::map<Uint32, SaveRecord>& records);
+
+	//Opens the journal for appending, writing a header first if it is new
+	bool openJournal(bool create);
+
+	//Checksum of a span of bytes
+	static Uint32 crc32(const Uint8* data, Uint32 size, Uint32 crc = 0);
+
+	//Records by key, only touched by the main thread
+	std::map<Uint32, SaveRecord> mRecords;
+
+	//Main thread job bookkeeping
+	std::vector<SaveJob*> mSpareJobs;
+	Uint32 mNextTicket;
+	Uint32 mRetiredTicket;
+	SaveStats mStats;
+
+	//I/O thread and the jobs passed to and from it
+	SDL_Thread* mThread;
+	SDL_mutex* mLock;
+	SDL_cond* mWake;
+	SDL_cond* mFinishedCondition;
+	std::vector<SaveJob*> mQueue;
+	std::vector<SaveJob*> mFinished;
+	Uint32 mFinishedTicket;
+	std::set<Uint32> mFailedTickets;
+	bool mQuit;
+
+	//Files, only touched by the I/O thread
+	std::string mPath;
+	std::string mJournalPath;
+	SDL_RWops* mJournal;
+
+	//Bumped by every snapshot so a journal from before it is ignored
+	Uint32 mGeneration;
+
+	//Snapshot compression, kept to reuse the match table and buffer
+	LBlockCompressor mCompressor;
+	std::vector<Uint8> mCompressed;
+
+	//Journal size, written by the I/O thread
+	SDL_atomic_t mJournalBytes;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -125,6 +379,15 @@ bool checkCollision(Circle& a, SDL_Rect& b);
 //Calculates distance squared between two points
 double distanceSquared(int x1, int y1, int x2, int y2);
 
+//Saves a large world snapshot and journal and prints the timings
+void runSaveBenchmark();
+
+//Puts the data points in the save's record
+void storeData();
+
+//Takes the data points from the save's record
+void applyData();
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -138,6 +401,12 @@ TTF_Font* gFont = NULL;
 LTexture gPromptTextTexture;
 LTexture gDataTextures[TOTAL_DATA];
 
+//The save file
+LSaveFile gSave;
+
+//Ticket of the load in flight, 0 once loaded
+Uint32 gLoadTicket = 0;
+
 
 LTexture::LTexture()
 {
@@ -349,218 +618,1325 @@ void Dot::move()
 	}
 }
 
-bool init()
+LSaveFile::LSaveFile()
 {
-	//Initialization flag
-	bool success = true;
+	//Initialize
+	mNextTicket = 1;
+	mRetiredTicket = 0;
+	SDL_zero(mStats);
+	mThread = NULL;
+	mLock = NULL;
+	mWake = NULL;
+	mFinishedCondition = NULL;
+	mFinishedTicket = 0;
+	mQuit = false;
+	mJournal = NULL;
+	mGeneration = 0;
+	SDL_AtomicSet(&mJournalBytes, 0);
+}
 
-	//Initialize SDL
-	if (SDL_Init(SDL_INIT_VIDEO) < 0)
-	{
-		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
-		success = false;
-	}
-	else
+LSaveFile::~LSaveFile()
+{
+	//Deallocate
+	close();
+}
+
+Uint32 LSaveFile::loadAsync(std::string path)
+{
+	//The load replaces everything on the I/O thread's side
+	SaveJob* job = newJob(SAVE_JOB_LOAD);
+	job->path = path;
+	return queueJob(job);
+}
+
+Uint32 LSaveFile::commitAsync()
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	//Size up the changed records
+	size_t bytes = 0;
+	for (std::map<Uint32, SaveRecord>::iterator record = mRecords.begin(); record != mRecords.end(); ++record)
 	{
-		//Set texture filtering to linear
-		if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1"))
+		if (record->second.dirty)
 		{
-			printf("Warning: Linear texture filtering not enabled!");
+			bytes += SAVE_RECORD_HEADER_BYTES + record->second.data.size();
 		}
+	}
+	if (bytes == 0)
+	{
+		return queueJob(newJob(SAVE_JOB_JOURNAL));
+	}
 
-		//Create window
-		gWindow = SDL_CreateWindow("SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-		if (gWindow == NULL)
-		{
-			printf("Window could not be created! SDL Error: %s\n", SDL_GetError());
-			success = false;
-		}
-		else
+	//Copy them out so the game can keep changing them
+	SaveJob* job = newJob(SAVE_JOB_JOURNAL);
+	job->arena.resize(bytes);
+	Uint8* out = &job->arena[0];
+	for (std::map<Uint32, SaveRecord>::iterator record = mRecords.begin(); record != mRecords.end(); ++record)
+	{
+		if (record->second.dirty)
 		{
-			//Create vsynced renderer for window
-			gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-			if (gRenderer == NULL)
-			{
-				printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
-				success = false;
-			}
-			else
-			{
-				//Initialize renderer color
-				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-
-				//Initialize PNG loading
-				int imgFlags = IMG_INIT_PNG;
-				if (!(IMG_Init(imgFlags) & imgFlags))
-				{
-					printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
-					success = false;
-				}
-
-				//Initialize SDL_ttf
-				if (TTF_Init() == -1)
-				{
-					printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
-					success = false;
-				}
-			}
+			out = stageRecord(out, record->first, record->second);
+			record->second.dirty = false;
 		}
 	}
 
-	return success;
+	mStats.snapshotMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	mStats.bytes = (Uint32)bytes;
+	return queueJob(job);
 }
 
-bool loadMedia()
-{//Text rendering color
-	SDL_Color textColor = { 0, 0, 0, 0xFF };
-	SDL_Color highlightColor = { 0xFF, 0, 0, 0xFF };
-
-	//Loading success flag
-	bool success = true;
+Uint32 LSaveFile::saveSnapshotAsync()
+{
+	Uint64 start = SDL_GetPerformanceCounter();
 
-	//Open the font
-	gFont = TTF_OpenFont("33_file_reading_and_writing/lazy.ttf", 28);
-	if (gFont == NULL)
+	//Size up every record
+	size_t bytes = SAVE_HEADER_BYTES;
+	for (std::map<Uint32, SaveRecord>::iterator record = mRecords.begin(); record != mRecords.end(); ++record)
 	{
-		printf("Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError());
-		success = false;
+		bytes += SAVE_RECORD_HEADER_BYTES + record->second.data.size();
 	}
-	else
+
+	//One memcpy per record into the staging arena, the generation is filled in by the I/O thread
+	SaveJob* job = newJob(SAVE_JOB_SNAPSHOT);
+	job->arena.resize(bytes);
+	Uint8* out = stageHeader(&job->arena[0], SAVE_SNAPSHOT_MAGIC, 0, (Uint32)mRecords.size());
+	for (std::map<Uint32, SaveRecord>::iterator record = mRecords.begin(); record != mRecords.end(); ++record)
 	{
-		//Render the prompt
-		if (!gPromptTextTexture.loadFromRenderedText("Enter Data:", textColor))
-		{
-			printf("Failed to render prompt text!\n");
-			success = false;
-		}
+		out = stageRecord(out, record->first, record->second);
+		record->second.dirty = false;
 	}
 
-	//Open file for reading in binary
-	SDL_RWops* file = SDL_RWFromFile("33_file_reading_and_writing/numbs.bin", "r+b");
+	mStats.snapshotMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	mStats.bytes = (Uint32)bytes;
+	return queueJob(job);
+}
 
-	//File does not exist
-	if (file == NULL)
-	{
-		printf("Warning: Unable to open file! SDL Error: %s\n", SDL_GetError());
+bool LSaveFile::load(std::string path)
+{
+	return wait(loadAsync(path));
+}
 
-		//Create file for writing
-		file = SDL_RWFromFile("33_file_reading_and_writing/nums.bin", "w+b");
-		if (file != NULL)
-		{
-			printf("New file created!\n");
+bool LSaveFile::commit()
+{
+	return wait(commitAsync());
+}
 
-			//Initialize data
-			for (int i = 0; i < TOTAL_DATA; ++i)
-			{
-				gData[i] = 0;
-				SDL_RWwrite(file, &gData[i], sizeof(Sint32), 1);
-			}
+bool LSaveFile::saveSnapshot()
+{
+	return wait(saveSnapshotAsync());
+}
 
-			//Close file handler
-			SDL_RWclose(file);
-		}
-		else
-		{
-			printf("Error: Unable to create file! SDL Error: %s\n", SDL_GetError());
-			success = false;
-		}
-	}
-	//File exists
-	else
-	{
-		//Load data
-		printf("Reading file...!\n");
-		for (int i = 0; i < TOTAL_DATA; ++i)
-		{
-			SDL_RWread(file, &gData[i], sizeof(Sint32), 1);
-		}
+bool LSaveFile::isDone(Uint32 ticket)
+{
+	retireJobs();
+	return ticket <= mRetiredTicket;
+}
 
-		//Close file handler
-		SDL_RWclose(file);
+bool LSaveFile::wait(Uint32 ticket)
+{
+	if (ticket == 0 || mThread == NULL)
+	{
+		return false;
 	}
 
-	//Initialize data textures
-	gDataTextures[0].loadFromRenderedText(std::to_string(gData[0]), highlightColor);
-	for (int i = 1; i < TOTAL_DATA; ++i)
+	//Jobs finish in the order they were queued
+	SDL_LockMutex(mLock);
+	while (mFinishedTicket < ticket)
 	{
-		gDataTextures[i].loadFromRenderedText(std::to_string(gData[i]), textColor);
+		SDL_CondWait(mFinishedCondition, mLock);
 	}
+	SDL_UnlockMutex(mLock);
 
-	return success;
+	retireJobs();
+	return !failed(ticket);
 }
 
-void close()
+bool LSaveFile::failed(Uint32 ticket)
 {
-	// Open data for writing
-	SDL_RWops* file = SDL_RWFromFile("33_file_reading_and_writing/numbs.bin", "w+b");
-	if (file != NULL) {
-		// Save data
-		for (int i = 0; i < TOTAL_DATA; i++) {
-			SDL_RWwrite(file, &gData[i], sizeof(Sint32), 1);
-		}
-		// Close file Handler
-		SDL_RWclose(file);
+	//No job, or no thread that could have failed it
+	if (ticket == 0)
+	{
+		return true;
 	}
-	else {
-		printf("Error: Unable to save file! %s\n", SDL_GetError());
+	if (mLock == NULL)
+	{
+		return false;
 	}
-	//Free loaded images
-	gPromptTextTexture.free();
-
-	//Destroy window	
-	SDL_DestroyRenderer(gRenderer);
-	SDL_DestroyWindow(gWindow);
-	gWindow = NULL;
-	gRenderer = NULL;
 
-	//Quit SDL subsystems
-	IMG_Quit();
-	SDL_Quit();
-	TTF_Quit();
+	SDL_LockMutex(mLock);
+	bool result = mFailedTickets.count(ticket) != 0;
+	SDL_UnlockMutex(mLock);
+	return result;
 }
 
-bool checkCollision(Circle& a, Circle& b)
+void LSaveFile::close()
 {
-	//Calculate total radius squared
-	int totalRadiusSquared = a.r + b.r;
-	totalRadiusSquared = totalRadiusSquared * totalRadiusSquared;
-
-	//If the distance between the centers of the circles is less than the sum of their radii
-	if (distanceSquared(a.x, a.y, b.x, b.y) < (totalRadiusSquared))
+	//Let the I/O thread finish what it has, it closes the journal on the way out
+	if (mThread != NULL)
 	{
-		//The circles have collided
-		return true;
+		SDL_LockMutex(mLock);
+		mQuit = true;
+		SDL_CondSignal(mWake);
+		SDL_UnlockMutex(mLock);
+		SDL_WaitThread(mThread, NULL);
+		mThread = NULL;
+		retireJobs();
+
+		SDL_DestroyCond(mWake);
+		SDL_DestroyCond(mFinishedCondition);
+		SDL_DestroyMutex(mLock);
+		mWake = NULL;
+		mFinishedCondition = NULL;
+		mLock = NULL;
 	}
 
-	//If not
-	return false;
+	//Free the recycled jobs
+	for (size_t i = 0; i < mSpareJobs.size(); ++i)
+	{
+		delete mSpareJobs[i];
+	}
+	mSpareJobs.clear();
+
+	mRecords.clear();
+	mNextTicket = 1;
+	mRetiredTicket = 0;
+	mFinishedTicket = 0;
+	mFailedTickets.clear();
+	mQuit = false;
+	mGeneration = 0;
+	SDL_AtomicSet(&mJournalBytes, 0);
+	SDL_zero(mStats);
 }
 
-bool checkCollision(Circle& a, SDL_Rect& b)
+const Uint8* LSaveFile::getRecord(Uint32 key, Uint32* version, Uint32* size)
 {
-	//Closest point on collision box
-	int cX, cY;
-
-	//Find closest x offset
-	if (a.x < b.x)
+	std::map<Uint32, SaveRecord>::iterator record = mRecords.find(key);
+	if (record == mRecords.end())
 	{
-		cX = b.x;
+		return NULL;
 	}
-	else if (a.x > b.x + b.w)
+	*version = record->second.version;
+	*size = (Uint32)record->second.data.size();
+	return record->second.data.empty() ? NULL : &record->second.data[0];
+}
+
+void LSaveFile::setRecord(Uint32 key, Uint32 version, const void* data, Uint32 size)
+{
+	SaveRecord& record = mRecords[key];
+	record.version = version;
+	record.data.assign((const Uint8*)data, (const Uint8*)data + size);
+	record.dirty = true;
+}
+
+SaveStats LSaveFile::getStats()
+{
+	retireJobs();
+	mStats.pendingJobs = mNextTicket - 1 - mRetiredTicket;
+	mStats.journalBytes = SDL_AtomicGet(&mJournalBytes);
+	return mStats;
+}
+
+LSaveFile::SaveJob* LSaveFile::newJob(SaveJobType type)
+{
+	SaveJob* job = NULL;
+	if (mSpareJobs.empty())
 	{
-		cX = b.x + b.w;
+		job = new SaveJob();
 	}
 	else
 	{
-		cX = a.x;
+		job = mSpareJobs.back();
+		mSpareJobs.pop_back();
 	}
+	job->type = type;
+	job->ticket = 0;
+	job->path.clear();
+	job->arena.clear();
+	job->records.clear();
+	job->success = false;
+	job->writeMs = 0.0;
+	job->diskBytes = 0;
+	return job;
+}
 
-	//Find closest y offset
-	if (a.y < b.y)
+Uint32 LSaveFile::queueJob(SaveJob* job)
+{
+	//Start the I/O thread on first use
+	if (mThread == NULL)
 	{
-		cY = b.y;
+		mLock = SDL_CreateMutex();
+		mWake = SDL_CreateCond();
+		mFinishedCondition = SDL_CreateCond();
+		mQuit = false;
+		mThread = SDL_CreateThread(run, "Save", this);
+		if (mThread == NULL)
+		{
+			printf("Error: Unable to start save thread! SDL Error: %s\n", SDL_GetError());
+			SDL_DestroyCond(mWake);
+			SDL_DestroyCond(mFinishedCondition);
+			SDL_DestroyMutex(mLock);
+			mWake = NULL;
+			mFinishedCondition = NULL;
+			mLock = NULL;
+			mSpareJobs.push_back(job);
+			return 0;
+		}
 	}
-	else if (a.y > b.y + b.h)
+
+	job->ticket = mNextTicket++;
+	SDL_LockMutex(mLock);
+	mQueue.push_back(job);
+	SDL_CondSignal(mWake);
+	SDL_UnlockMutex(mLock);
+	return job->ticket;
+}
+
+void LSaveFile::retireJobs()
+{
+	if (mLock == NULL)
+	{
+		return;
+	}
+
+	//Take what the I/O thread finished
+	std::vector<SaveJob*> finished;
+	SDL_LockMutex(mLock);
+	finished.swap(mFinished);
+	SDL_UnlockMutex(mLock);
+
+	for (size_t i = 0; i < finished.size(); ++i)
+	{
+		SaveJob* job = finished[i];
+		if (job->type == SAVE_JOB_LOAD)
+		{
+			//Loaded records don't overwrite changes made while loading
+			for (std::map<Uint32, SaveRecord>::iterator record = job->records.begin(); record != job->records.end(); ++record)
+			{
+				std::map<Uint32, SaveRecord>::iterator current = mRecords.find(record->first);
+				if (current == mRecords.end() || !current->second.dirty)
+				{
+					mRecords[record->first].version = record->second.version;
+					mRecords[record->first].data.swap(record->second.data);
+					mRecords[record->first].dirty = record->second.dirty;
+				}
+			}
+		}
+		else
+		{
+			mStats.writeMs = job->writeMs;
+			mStats.diskBytes = job->diskBytes;
+
+			//Whatever didn't make it to disk goes out again with the next save
+			if (!job->success)
+			{
+				for (std::map<Uint32, SaveRecord>::iterator record = mRecords.begin(); record != mRecords.end(); ++record)
+				{
+					record->second.dirty = true;
+				}
+			}
+		}
+
+		mRetiredTicket = job->ticket;
+		mSpareJobs.push_back(job);
+	}
+}
+
+Uint8* LSaveFile::stageHeader(Uint8* out, Uint32 magic, Uint32 generation, Uint32 count)
+{
+	Uint32 header[4] = { SDL_SwapLE32(magic), SDL_SwapLE32(SAVE_FORMAT_VERSION), SDL_SwapLE32(generation), SDL_SwapLE32(count) };
+	memcpy(out, header, sizeof(header));
+	return out + sizeof(header);
+}
+
+Uint8* LSaveFile::stageRecord(Uint8* out, Uint32 key, const SaveRecord& record)
+{
+	//Key, version, size and a checksum covering all three and the payload
+	Uint32 header[4] = { SDL_SwapLE32(key), SDL_SwapLE32(record.version), SDL_SwapLE32((Uint32)record.data.size()), 0 };
+	memcpy(out, header, sizeof(header));
+	out += sizeof(header);
+	if (!record.data.empty())
+	{
+		memcpy(out, &record.data[0], record.data.size());
+	}
+	return out + record.data.size();
+}
+
+int LSaveFile::run(void* data)
+{
+	LSaveFile* save = (LSaveFile*)data;
+
+	SDL_LockMutex(save->mLock);
+	while (true)
+	{
+		//Sleep until there's work, quitting only once everything queued is written
+		while (save->mQueue.empty() && !save->mQuit)
+		{
+			SDL_CondWait(save->mWake, save->mLock);
+		}
+		if (save->mQueue.empty())
+		{
+			break;
+		}
+		SaveJob* job = save->mQueue.front();
+		save->mQueue.erase(save->mQueue.begin());
+		SDL_UnlockMutex(save->mLock);
+
+		//Do the slow part without holding the lock
+		Uint64 start = SDL_GetPerformanceCounter();
+		save->runJob(*job);
+		job->writeMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+
+		SDL_LockMutex(save->mLock);
+		save->mFinished.push_back(job);
+		save->mFinishedTicket = job->ticket;
+		if (!job->success)
+		{
+			save->mFailedTickets.insert(job->ticket);
+		}
+		SDL_CondBroadcast(save->mFinishedCondition);
+	}
+	SDL_UnlockMutex(save->mLock);
+
+	//Done with the files
+	if (save->mJournal != NULL)
+	{
+		SDL_RWclose(save->mJournal);
+		save->mJournal = NULL;
+	}
+	save->mPath.clear();
+	save->mJournalPath.clear();
+	return 0;
+}
+
+void LSaveFile::runJob(SaveJob& job)
+{
+	switch (job.type)
+	{
+	case SAVE_JOB_LOAD: job.success = loadFiles(job); break;
+	case SAVE_JOB_JOURNAL: job.success = writeJournal(job); break;
+	case SAVE_JOB_SNAPSHOT: job.success = writeSnapshot(job); break;
+	}
+}
+
+bool LSaveFile::loadFiles(SaveJob& job)
+{
+	//Get rid of a previously loaded save
+	if (mJournal != NULL)
+	{
+		SDL_RWclose(mJournal);
+		mJournal = NULL;
+	}
+	mPath = job.path;
+	mJournalPath = job.path + ".journal";
+	mGeneration = 0;
+	SDL_AtomicSet(&mJournalBytes, 0);
+
+	//No snapshot is a new save, which may only have a journal so far
+	bool success = true;
+	std::vector<Uint8>& bytes = job.arena;
+	if (!readFile(mPath, bytes))
+	{
+		printf("Warning: No save at %s, starting a new one\n", mPath.c_str());
+	}
+	//Read the snapshot, a bad one is reported and whatever was intact is kept
+	else if (bytes.size() >= (size_t)SAVE_HEADER_BYTES && readLE32(bytes, 0) == SAVE_SNAPSHOT_MAGIC && readLE32(bytes, 4) <= SAVE_FORMAT_VERSION)
+	{
+		mGeneration = readLE32(bytes, 8);
+		Uint32 count = readLE32(bytes, 12);
+		Uint32 offset = SAVE_HEADER_BYTES;
+
+		//Decompress the records as they're read, a damaged stream stops early and fails the parse
+		if (readLE32(bytes, 4) >= SAVE_COMPRESSED_VERSION)
+		{
+			std::vector<Uint8> records;
+			SDL_RWops* stream = openCompressedRW(SDL_RWFromConstMem(&bytes[0] + SAVE_HEADER_BYTES, (int)(bytes.size() - SAVE_HEADER_BYTES)));
+			if (stream != NULL)
+			{
+				size_t read = 0;
+				do
+				{
+					records.resize(records.size() + LZ_BLOCK_BYTES);
+					read = SDL_RWread(stream, &records[records.size() - LZ_BLOCK_BYTES], 1, LZ_BLOCK_BYTES);
+					records.resize(records.size() - LZ_BLOCK_BYTES + read);
+				} while (read > 0);
+				SDL_RWclose(stream);
+			}
+			bytes.swap(records);
+			offset = 0;
+		}
+		if (parseRecords(bytes, offset, job.records) != bytes.size() || job.records.size() != count)
+		{
+			printf("Error: Save %s is damaged!\n", mPath.c_str());
+			success = false;
+		}
+	}
+	//Saves from before the record format were the raw data points
+	else if (bytes.size() == TOTAL_DATA * sizeof(Sint32))
+	{
+		SaveRecord& record = job.records[SAVE_KEY_DATA];
+		record.version = SAVE_DATA_VERSION;
+		record.data = bytes;
+		record.dirty = true;
+	}
+	else
+	{
+		printf("Error: %s is not a save file!\n", mPath.c_str());
+		return false;
+	}
+
+	//Replay the journal if it belongs to this snapshot
+	std::vector<Uint8> journal;
+	if (!readFile(mJournalPath, journal) || journal.size() < (size_t)SAVE_HEADER_BYTES || readLE32(journal, 0) != SAVE_JOURNAL_MAGIC || readLE32(journal, 8) != mGeneration)
+	{
+		return openJournal(true) && success;
+	}
+	Uint32 validBytes = parseRecords(journal, SAVE_HEADER_BYTES, job.records);
+
+	//A crash mid append leaves a torn tail, cut it off so new entries follow good ones
+	if (validBytes != journal.size())
+	{
+		printf("Warning: Dropping %u bytes of unfinished journal\n", (Uint32)journal.size() - validBytes);
+		journal.resize(validBytes);
+		if (!replaceFile(mJournalPath, journal))
+		{
+			return false;
+		}
+	}
+	SDL_AtomicSet(&mJournalBytes, validBytes - SAVE_HEADER_BYTES);
+	return openJournal(false) && success;
+}
+
+bool LSaveFile::writeJournal(SaveJob& job)
+{
+	if (mJournal == NULL)
+	{
+		return false;
+	}
+	if (job.arena.empty())
+	{
+		return true;
+	}
+
+	//Append in one write, a crash part way through only loses this commit
+	sealRecords(job.arena, 0);
+	if (SDL_RWwrite(mJournal, &job.arena[0], job.arena.size(), 1) != 1)
+	{
+		printf("Error: Unable to write journal! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	SDL_AtomicAdd(&mJournalBytes, (int)job.arena.size());
+	return true;
+}
+
+bool LSaveFile::writeSnapshot(SaveJob& job)
+{
+	if (mPath.empty())
+	{
+		return false;
+	}
+
+	//Checksum the records, then compress everything after the header
+	Uint32 generation = SDL_SwapLE32(mGeneration + 1);
+	memcpy(&job.arena[8], &generation, sizeof(generation));
+	sealRecords(job.arena, SAVE_HEADER_BYTES);
+	mCompressed.assign(job.arena.begin(), job.arena.begin() + SAVE_HEADER_BYTES);
+	mCompressor.compressStream(&job.arena[0] + SAVE_HEADER_BYTES, job.arena.size() - SAVE_HEADER_BYTES, mCompressed);
+	job.diskBytes = (Uint32)mCompressed.size();
+
+	//The old snapshot and journal stay valid until the rename lands
+	if (!replaceFile(mPath, mCompressed))
+	{
+		return false;
+	}
+
+	//The old journal now has a stale generation, start over
+	++mGeneration;
+	return openJournal(true);
+}
+
+void LSaveFile::sealRecords(std::vector<Uint8>& arena, Uint32 offset)
+{
+	while (offset + SAVE_RECORD_HEADER_BYTES <= arena.size())
+	{
+		Uint32 header[4];
+		memcpy(header, &arena[offset], sizeof(header));
+		Uint32 size = SDL_SwapLE32(header[2]);
+		Uint32 crc = crc32(&arena[offset] + SAVE_RECORD_HEADER_BYTES, size, crc32((Uint8*)header, 12));
+		header[3] = SDL_SwapLE32(crc);
+		memcpy(&arena[offset], header, sizeof(header));
+		offset += SAVE_RECORD_HEADER_BYTES + size;
+	}
+}
+
+bool LSaveFile::readFile(std::string path, std::vector<Uint8>& bytes)
+{
+	SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	//Read it in one go
+	Sint64 size = SDL_RWsize(file);
+	bytes.resize(size > 0 ? (size_t)size : 0);
+	bool success = bytes.empty() || SDL_RWread(file, &bytes[0], bytes.size(), 1) == 1;
+	SDL_RWclose(file);
+	return success;
+}
+
+Uint32 LSaveFile::readLE32(const std::vector<Uint8>& bytes, size_t offset)
+{
+	Uint32 word;
+	memcpy(&word, &bytes[offset], sizeof(word));
+	return SDL_SwapLE32(word);
+}
+
+bool LSaveFile::replaceFile(std::string path, const std::vector<Uint8>& bytes)
+{
+	//Write everything next to the target first, with stdio so the data can be synced
+	std::string temporaryPath = path + ".tmp";
+	FILE* file = fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL)
+	{
+		printf("Error: Unable to create %s!\n", temporaryPath.c_str());
+		return false;
+	}
+	bool written = bytes.empty() || fwrite(&bytes[0], bytes.size(), 1, file) == 1;
+
+	//The data has to be on disk before the rename, or a crash can leave an empty file under the real name
+	written = written && fflush(file) == 0;
+#ifdef _WIN32
+	written = written && _commit(_fileno(file)) == 0;
+#else
+	written = written && fsync(fileno(file)) == 0;
+#endif
+	if (fclose(file) != 0 || !written)
+	{
+		printf("Error: Unable to write %s!\n", temporaryPath.c_str());
+		remove(temporaryPath.c_str());
+		return false;
+	}
+
+	//Then swap it in, readers see either the old or the new file and never half of one
+#ifdef _WIN32
+	bool renamed = MoveFileExA(temporaryPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool renamed = rename(temporaryPath.c_str(), path.c_str()) == 0;
+#endif
+	if (!renamed)
+	{
+		printf("Error: Unable to replace %s!\n", path.c_str());
+		remove(temporaryPath.c_str());
+	}
+	return renamed;
+}
+
+Uint32 LSaveFile::parseRecords(const std::vector<Uint8>& bytes, Uint32 offset, std::map<Uint32, SaveRecord>& records)
+{
+	while (offset + SAVE_RECORD_HEADER_BYTES <= bytes.size())
+	{
+		//Stop at a record that runs past the end or fails its checksum
+		Uint32 header[4];
+		memcpy(header, &bytes[offset], sizeof(header));
+		Uint32 size = SDL_SwapLE32(header[2]);
+		if (size > bytes.size() - offset - SAVE_RECORD_HEADER_BYTES)
+		{
+			break;
+		}
+		const Uint8* payload = &bytes[offset] + SAVE_RECORD_HEADER_BYTES;
+		if (crc32(payload, size, crc32((Uint8*)header, 12)) != SDL_SwapLE32(header[3]))
+		{
+			break;
+		}
+
+		//Later records replace earlier ones
+		SaveRecord& record = records[SDL_SwapLE32(header[0])];
+		record.version = SDL_SwapLE32(header[1]);
+		record.data.assign(payload, payload + size);
+		record.dirty = false;
+		offset += SAVE_RECORD_HEADER_BYTES + size;
+	}
+	return offset;
+}
+
+bool LSaveFile::openJournal(bool create)
+{
+	if (mJournal != NULL)
+	{
+		SDL_RWclose(mJournal);
+		mJournal = NULL;
+	}
+
+	//A fresh journal only holds the header naming its snapshot
+	if (create)
+	{
+		std::vector<Uint8> header(SAVE_HEADER_BYTES);
+		stageHeader(&header[0], SAVE_JOURNAL_MAGIC, mGeneration, 0);
+		if (!replaceFile(mJournalPath, header))
+		{
+			return false;
+		}
+		SDL_AtomicSet(&mJournalBytes, 0);
+	}
+
+	mJournal = SDL_RWFromFile(mJournalPath.c_str(), "ab");
+	if (mJournal == NULL)
+	{
+		printf("Error: Unable to open journal %s! SDL Error: %s\n", mJournalPath.c_str(), SDL_GetError());
+		return false;
+	}
+	return true;
+}
+
+Uint32 LSaveFile::crc32(const Uint8* data, Uint32 size, Uint32 crc)
+{
+	//Reflected CRC-32 table, built on first use
+	static Uint32 table[256];
+	static bool tableReady = false;
+	if (!tableReady)
+	{
+		for (Uint32 i = 0; i < 256; ++i)
+		{
+			Uint32 c = i;
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			}
+			table[i] = c;
+		}
+		tableReady = true;
+	}
+
+	crc = ~crc;
+	for (Uint32 i = 0; i < size; ++i)
+	{
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+LBlockCompressor::LBlockCompressor()
+{
+	//Initialize
+	SDL_zero(mTable);
+}
+
+int LBlockCompressor::getBound(int size)
+{
+	return size + size / 255 + 16;
+}
+
+//Reads 4 bytes that may not be aligned
+static Uint32 readWord(const Uint8* p)
+{
+	Uint32 word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+//Hashes 4 bytes into the match table
+static Uint32 hashWord(Uint32 word)
+{
+	return (word * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+//Writes a 4 bit length's overflow as a run of 255s and a remainder
+static Uint8* writeLength(Uint8* out, int length)
+{
+	while (length >= 255)
+	{
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (Uint8)length;
+	return out;
+}
+
+int LBlockCompressor::compressBlock(const Uint8* source, int size, Uint8* destination, int capacity)
+{
+	const Uint8* ip = source;
+	const Uint8* anchor = source;
+	const Uint8* end = source + size;
+	const Uint8* matchEnd = end - LZ_LAST_LITERALS;
+	const Uint8* searchEnd = end - LZ_MATCH_LIMIT;
+	Uint8* op = destination;
+	Uint8* opEnd = destination + capacity;
+
+	//Too short to hold a match, everything goes out as literals
+	if (size > LZ_MATCH_LIMIT)
+	{
+		SDL_zero(mTable);
+		++ip;
+
+		while (ip <= searchEnd)
+		{
+			//Look for a match, stepping faster the longer nothing turns up
+			const Uint8* match = NULL;
+			int attempts = 1 << 6;
+			while (ip <= searchEnd)
+			{
+				Uint32 word = readWord(ip);
+				Uint32 hash = hashWord(word);
+				match = source + mTable[hash];
+				mTable[hash] = (Uint32)(ip - source);
+				if (match < ip && ip - match <= LZ_MAX_OFFSET && readWord(match) == word)
+				{
+					break;
+				}
+				match = NULL;
+				ip += attempts++ >> 6;
+			}
+			if (match == NULL)
+			{
+				break;
+			}
+
+			//Grow the match backwards into the pending literals
+			while (ip > anchor && match > source && ip[-1] == match[-1])
+			{
+				--ip;
+				--match;
+			}
+
+			//And forwards as far as the format allows
+			int matchLength = LZ_MIN_MATCH;
+			while (ip + matchLength < matchEnd && ip[matchLength] == match[matchLength])
+			{
+				++matchLength;
+			}
+
+			//Token, literals, offset and the length overflows
+			int literalLength = (int)(ip - anchor);
+			if (op + 1 + literalLength + literalLength / 255 + 1 + 2 + matchLength / 255 + 1 > opEnd)
+			{
+				return 0;
+			}
+			Uint8* token = op++;
+			*token = (Uint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+			if (literalLength >= 15)
+			{
+				op = writeLength(op, literalLength - 15);
+			}
+			memcpy(op, anchor, literalLength);
+			op += literalLength;
+			int offset = (int)(ip - match);
+			*op++ = (Uint8)offset;
+			*op++ = (Uint8)(offset >> 8);
+			int extraLength = matchLength - LZ_MIN_MATCH;
+			*token |= (Uint8)(extraLength >= 15 ? 15 : extraLength);
+			if (extraLength >= 15)
+			{
+				op = writeLength(op, extraLength - 15);
+			}
+
+			//Carry on after the match, remembering a position inside it
+			ip += matchLength;
+			anchor = ip;
+			if (ip <= searchEnd)
+			{
+				mTable[hashWord(readWord(ip - 2))] = (Uint32)(ip - 2 - source);
+			}
+		}
+	}
+
+	//The rest goes out as literals
+	int literalLength = (int)(end - anchor);
+	if (op + 1 + literalLength + literalLength / 255 + 1 > opEnd)
+	{
+		return 0;
+	}
+	*op++ = (Uint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15)
+	{
+		op = writeLength(op, literalLength - 15);
+	}
+	memcpy(op, anchor, literalLength);
+	op += literalLength;
+	return (int)(op - destination);
+}
+
+int LBlockCompressor::decompressBlock(const Uint8* source, int size, Uint8* destination, int capacity)
+{
+	const Uint8* ip = source;
+	const Uint8* end = source + size;
+	Uint8* op = destination;
+	Uint8* opEnd = destination + capacity;
+
+	while (ip < end)
+	{
+		//Literals
+		int token = *ip++;
+		int literalLength = token >> 4;
+		if (literalLength == 15)
+		{
+			int extra = 255;
+			while (extra == 255)
+			{
+				if (ip >= end)
+				{
+					return -1;
+				}
+				extra = *ip++;
+				literalLength += extra;
+			}
+		}
+		if (literalLength > end - ip || literalLength > opEnd - op)
+		{
+			return -1;
+		}
+		memcpy(op, ip, literalLength);
+		op += literalLength;
+		ip += literalLength;
+
+		//The last sequence has no match
+		if (ip == end)
+		{
+			break;
+		}
+
+		//Match
+		if (end - ip < 2)
+		{
+			return -1;
+		}
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - destination)
+		{
+			return -1;
+		}
+		int matchLength = token & 15;
+		if (matchLength == 15)
+		{
+			int extra = 255;
+			while (extra == 255)
+			{
+				if (ip >= end)
+				{
+					return -1;
+				}
+				extra = *ip++;
+				matchLength += extra;
+			}
+		}
+		matchLength += LZ_MIN_MATCH;
+		if (matchLength > opEnd - op)
+		{
+			return -1;
+		}
+
+		//Overlapping matches repeat the last offset bytes, so they copy a byte at a time
+		const Uint8* match = op - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else
+		{
+			for (int i = 0; i < matchLength; ++i)
+			{
+				*op++ = *match++;
+			}
+		}
+	}
+	return (int)(op - destination);
+}
+
+void LBlockCompressor::compressStream(const Uint8* source, size_t size, std::vector<Uint8>& output)
+{
+	//Stream header
+	size_t start = output.size();
+	output.resize(start + sizeof(Uint32));
+	Uint32 magic = SDL_SwapLE32(LZ_STREAM_MAGIC);
+	memcpy(&output[start], &magic, sizeof(magic));
+
+	for (size_t offset = 0; offset < size; offset += LZ_BLOCK_BYTES)
+	{
+		int blockSize = size - offset < (size_t)LZ_BLOCK_BYTES ? (int)(size - offset) : LZ_BLOCK_BYTES;
+
+		//Compress straight into the output, keeping the block as is when that doesn't make it smaller
+		size_t headerOffset = output.size();
+		output.resize(headerOffset + sizeof(Uint32) + getBound(blockSize));
+		int compressedSize = compressBlock(source + offset, blockSize, &output[headerOffset + sizeof(Uint32)], blockSize - 1);
+		Uint32 header = (Uint32)compressedSize;
+		if (compressedSize == 0)
+		{
+			memcpy(&output[headerOffset + sizeof(Uint32)], source + offset, blockSize);
+			compressedSize = blockSize;
+			header = (Uint32)blockSize | LZ_STORED_BLOCK;
+		}
+		header = SDL_SwapLE32(header);
+		memcpy(&output[headerOffset], &header, sizeof(header));
+		output.resize(headerOffset + sizeof(Uint32) + compressedSize);
+	}
+
+	//An empty block header ends the stream
+	output.resize(output.size() + sizeof(Uint32), 0);
+}
+
+//Reading side of a compressed stream
+struct CompressedReader
+{
+	SDL_RWops* source;
+	Uint8 compressed[LZ_BLOCK_BYTES + LZ_BLOCK_BYTES / 255 + 16];
+	Uint8 block[LZ_BLOCK_BYTES];
+	int blockSize;
+	int blockOffset;
+	Sint64 position;
+	bool ended;
+};
+
+//Reads and decompresses the next block, false at the end of the stream or on damage
+static bool readCompressedBlock(CompressedReader* reader)
+{
+	reader->blockSize = 0;
+	reader->blockOffset = 0;
+
+	Uint32 header = 0;
+	if (SDL_RWread(reader->source, &header, sizeof(header), 1) != 1 || header == 0)
+	{
+		return false;
+	}
+	header = SDL_SwapLE32(header);
+	int size = (int)(header & ~LZ_STORED_BLOCK);
+
+	//Stored blocks go straight into the block buffer
+	if (header & LZ_STORED_BLOCK)
+	{
+		if (size > LZ_BLOCK_BYTES || SDL_RWread(reader->source, reader->block, size, 1) != 1)
+		{
+			SDL_SetError("Compressed stream is damaged");
+			return false;
+		}
+		reader->blockSize = size;
+		return true;
+	}
+
+	if (size > (int)sizeof(reader->compressed) || SDL_RWread(reader->source, reader->compressed, size, 1) != 1)
+	{
+		SDL_SetError("Compressed stream is damaged");
+		return false;
+	}
+	reader->blockSize = LBlockCompressor::decompressBlock(reader->compressed, size, reader->block, LZ_BLOCK_BYTES);
+	if (reader->blockSize < 0)
+	{
+		reader->blockSize = 0;
+		SDL_SetError("Compressed stream is damaged");
+		return false;
+	}
+	return true;
+}
+
+static size_t SDLCALL compressedRead(SDL_RWops* context, void* data, size_t size, size_t count)
+{
+	CompressedReader* reader = (CompressedReader*)context->hidden.unknown.data1;
+	size_t total = size * count;
+	size_t copied = 0;
+	while (copied < total)
+	{
+		//Refill once the current block is used up
+		if (reader->blockOffset == reader->blockSize)
+		{
+			if (reader->ended || !readCompressedBlock(reader))
+			{
+				reader->ended = true;
+				break;
+			}
+		}
+		size_t available = reader->blockSize - reader->blockOffset;
+		size_t bytes = total - copied < available ? total - copied : available;
+		memcpy((Uint8*)data + copied, reader->block + reader->blockOffset, bytes);
+		reader->blockOffset += (int)bytes;
+		copied += bytes;
+	}
+	reader->position += copied;
+	return size > 0 ? copied / size : 0;
+}
+
+static Sint64 SDLCALL compressedSize(SDL_RWops*)
+{
+	//Unknown until the whole stream is read
+	return -1;
+}
+
+static Sint64 SDLCALL compressedSeek(SDL_RWops* context, Sint64 offset, int whence)
+{
+	//Only telling the position is supported
+	CompressedReader* reader = (CompressedReader*)context->hidden.unknown.data1;
+	if (whence == RW_SEEK_CUR && offset == 0)
+	{
+		return reader->position;
+	}
+	return SDL_SetError("Compressed streams can't seek");
+}
+
+static size_t SDLCALL compressedWrite(SDL_RWops*, const void*, size_t, size_t)
+{
+	SDL_SetError("Compressed streams are read only");
+	return 0;
+}
+
+static int SDLCALL compressedClose(SDL_RWops* context)
+{
+	CompressedReader* reader = (CompressedReader*)context->hidden.unknown.data1;
+	int result = SDL_RWclose(reader->source);
+	delete reader;
+	SDL_FreeRW(context);
+	return result;
+}
+
+SDL_RWops* openCompressedRW(SDL_RWops* source)
+{
+	if (source == NULL)
+	{
+		return NULL;
+	}
+
+	//Check the stream header
+	Uint32 magic = 0;
+	if (SDL_RWread(source, &magic, sizeof(magic), 1) != 1 || SDL_SwapLE32(magic) != LZ_STREAM_MAGIC)
+	{
+		SDL_SetError("Not a compressed stream");
+		SDL_RWclose(source);
+		return NULL;
+	}
+
+	SDL_RWops* context = SDL_AllocRW();
+	if (context == NULL)
+	{
+		SDL_RWclose(source);
+		return NULL;
+	}
+	CompressedReader* reader = new CompressedReader();
+	reader->source = source;
+	reader->blockSize = 0;
+	reader->blockOffset = 0;
+	reader->position = 0;
+	reader->ended = false;
+
+	context->size = compressedSize;
+	context->seek = compressedSeek;
+	context->read = compressedRead;
+	context->write = compressedWrite;
+	context->close = compressedClose;
+	context->type = SDL_RWOPS_UNKNOWN;
+	context->hidden.unknown.data1 = reader;
+	return context;
+}
+
+bool init()
+{
+	//Initialization flag
+	bool success = true;
+
+	//Initialize SDL
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	{
+		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+		success = false;
+	}
+	else
+	{
+		//Set texture filtering to linear
+		if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1"))
+		{
+			printf("Warning: Linear texture filtering not enabled!");
+		}
+
+		//Create window
+		gWindow = SDL_CreateWindow("SDL Tutorial", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+		if (gWindow == NULL)
+		{
+			printf("Window could not be created! SDL Error: %s\n", SDL_GetError());
+			success = false;
+		}
+		else
+		{
+			//Create vsynced renderer for window
+			gRenderer = SDL_CreateRenderer(gWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+			if (gRenderer == NULL)
+			{
+				printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+				success = false;
+			}
+			else
+			{
+				//Initialize renderer color
+				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+
+				//Initialize PNG loading
+				int imgFlags = IMG_INIT_PNG;
+				if (!(IMG_Init(imgFlags) & imgFlags))
+				{
+					printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
+					success = false;
+				}
+
+				//Initialize SDL_ttf
+				if (TTF_Init() == -1)
+				{
+					printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+					success = false;
+				}
+			}
+		}
+	}
+
+	return success;
+}
+
+bool loadMedia()
+{//Text rendering color
+	SDL_Color textColor = { 0, 0, 0, 0xFF };
+
+	//Loading success flag
+	bool success = true;
+
+	//Open the font
+	gFont = TTF_OpenFont("33_file_reading_and_writing/lazy.ttf", 28);
+	if (gFont == NULL)
+	{
+		printf("Failed to load lazy font! SDL_ttf Error: %s\n", TTF_GetError());
+		success = false;
+	}
+	else
+	{
+		//Render the prompt
+		if (!gPromptTextTexture.loadFromRenderedText("Enter Data:", textColor))
+		{
+			printf("Failed to render prompt text!\n");
+			success = false;
+		}
+	}
+
+	//Start loading the save, the data points show up once it's done
+	gLoadTicket = gSave.loadAsync(SAVE_PATH);
+	if (gLoadTicket == 0)
+	{
+		printf("Warning: Unable to load save!\n");
+		applyData();
+	}
+	else
+	{
+		for (int i = 0; i < TOTAL_DATA; ++i)
+		{
+			gDataTextures[i].loadFromRenderedText("...", textColor);
+		}
+	}
+
+	return success;
+}
+
+void applyData()
+{
+	SDL_Color textColor = { 0, 0, 0, 0xFF };
+	SDL_Color highlightColor = { 0xFF, 0, 0, 0xFF };
+
+	//Take the data points from the save, a missing or damaged one starts from zero
+	Uint32 version = 0;
+	Uint32 size = 0;
+	const Uint8* data = gSave.getRecord(SAVE_KEY_DATA, &version, &size);
+	for (int i = 0; i < TOTAL_DATA; ++i)
+	{
+		gData[i] = 0;
+		if (data != NULL && version == SAVE_DATA_VERSION && size == TOTAL_DATA * sizeof(Sint32))
+		{
+			Sint32 value;
+			memcpy(&value, data + i * sizeof(Sint32), sizeof(Sint32));
+			gData[i] = (Sint32)SDL_SwapLE32((Uint32)value);
+		}
+	}
+
+	//Initialize data textures
+	gDataTextures[0].loadFromRenderedText(std::to_string(gData[0]), highlightColor);
+	for (int i = 1; i < TOTAL_DATA; ++i)
+	{
+		gDataTextures[i].loadFromRenderedText(std::to_string(gData[i]), textColor);
+	}
+}
+
+void storeData()
+{
+	//Data points are saved little endian
+	Sint32 data[TOTAL_DATA];
+	for (int i = 0; i < TOTAL_DATA; ++i)
+	{
+		data[i] = (Sint32)SDL_SwapLE32((Uint32)gData[i]);
+	}
+	gSave.setRecord(SAVE_KEY_DATA, SAVE_DATA_VERSION, data, sizeof(data));
+}
+
+void close()
+{
+	//Fold the journal into a fresh snapshot, unless the save never loaded
+	if (gLoadTicket == 0)
+	{
+		storeData();
+	}
+	if (gLoadTicket == 0 && !gSave.saveSnapshot())
+	{
+		printf("Error: Unable to save file!\n");
+	}
+	gSave.close();
+
+	//Free loaded images
+	gPromptTextTexture.free();
+
+	//Destroy window	
+	SDL_DestroyRenderer(gRenderer);
+	SDL_DestroyWindow(gWindow);
+	gWindow = NULL;
+	gRenderer = NULL;
+
+	//Quit SDL subsystems
+	IMG_Quit();
+	SDL_Quit();
+	TTF_Quit();
+}
+
+bool checkCollision(Circle& a, Circle& b)
+{
+	//Calculate total radius squared
+	int totalRadiusSquared = a.r + b.r;
+	totalRadiusSquared = totalRadiusSquared * totalRadiusSquared;
+
+	//If the distance between the centers of the circles is less than the sum of their radii
+	if (distanceSquared(a.x, a.y, b.x, b.y) < (totalRadiusSquared))
+	{
+		//The circles have collided
+		return true;
+	}
+
+	//If not
+	return false;
+}
+
+bool checkCollision(Circle& a, SDL_Rect& b)
+{
+	//Closest point on collision box
+	int cX, cY;
+
+	//Find closest x offset
+	if (a.x < b.x)
+	{
+		cX = b.x;
+	}
+	else if (a.x > b.x + b.w)
+	{
+		cX = b.x + b.w;
+	}
+	else
+	{
+		cX = a.x;
+	}
+
+	//Find closest y offset
+	if (a.y < b.y)
+	{
+		cY = b.y;
+	}
+	else if (a.y > b.y + b.h)
 	{
 		cY = b.y + b.h;
 	}
@@ -587,8 +1963,78 @@ double distanceSquared(int x1, int y1, int x2, int y2)
 	return deltaX * deltaX + deltaY * deltaY;
 }
 
+void runSaveBenchmark()
+{
+	std::string path = "33_file_reading_and_writing/benchmark.bin";
+	double frequency = (double)SDL_GetPerformanceFrequency();
+
+	//Fill a world of fixed size records, with a small alphabet like tile and entity data
+	LSaveFile save;
+	save.load(path);
+	std::vector<Uint8> chunk(BENCHMARK_RECORD_BYTES);
+	for (int i = 0; i < BENCHMARK_RECORDS; ++i)
+	{
+		for (int j = 0; j < BENCHMARK_RECORD_BYTES; ++j)
+		{
+			chunk[j] = (Uint8)(rand() % 16);
+		}
+		save.setRecord(i, 1, &chunk[0], BENCHMARK_RECORD_BYTES);
+	}
+
+	//Full snapshot, only the staging copy happens on this thread
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint32 ticket = save.saveSnapshotAsync();
+	double queueMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+	save.wait(ticket);
+	SaveStats stats = save.getStats();
+	printf("Snapshot: %u MB compressed to %u MB, %.2f ms on the main thread (%.2f ms staging), %.2f ms on the I/O thread\n", stats.bytes / (1024 * 1024), stats.diskBytes / (1024 * 1024), queueMs, stats.snapshotMs, stats.writeMs);
+
+	//Change a few records per frame and journal them without waiting
+	double totalMs = 0.0;
+	double peakMs = 0.0;
+	for (int i = 0; i < BENCHMARK_COMMITS; ++i)
+	{
+		for (int j = 0; j < BENCHMARK_DIRTY_RECORDS; ++j)
+		{
+			chunk[0] = (Uint8)i;
+			save.setRecord(rand() % BENCHMARK_RECORDS, 1, &chunk[0], BENCHMARK_RECORD_BYTES);
+		}
+		start = SDL_GetPerformanceCounter();
+		ticket = save.commitAsync();
+		double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+		totalMs += ms;
+		peakMs = ms > peakMs ? ms : peakMs;
+	}
+	start = SDL_GetPerformanceCounter();
+	save.wait(ticket);
+	stats = save.getStats();
+	printf("Journal: %d commits of %d KB, %.3f ms average, %.3f ms peak on the main thread, %.2f ms to drain, %u KB journaled\n", BENCHMARK_COMMITS, BENCHMARK_DIRTY_RECORDS * BENCHMARK_RECORD_BYTES / 1024, totalMs / BENCHMARK_COMMITS, peakMs, (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency, stats.journalBytes / 1024);
+
+	//Load replays the journal over the snapshot
+	save.close();
+	start = SDL_GetPerformanceCounter();
+	ticket = save.loadAsync(path);
+	double loadQueueMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+	save.wait(ticket);
+	printf("Load: %.3f ms on the main thread, %.2f ms until done\n", loadQueueMs, (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency);
+
+	//Clean up
+	save.close();
+	remove(path.c_str());
+	remove((path + ".journal").c_str());
+}
+
 int main(int argc, char* args[])
 	{
+	//Time saving without opening a window
+	if (argc > 1 && strcmp(args[1], "--benchmark") == 0)
+	{
+		SDL_Init(0);
+		runSaveBenchmark();
+		SDL_Quit();
+		return 0;
+	}
+
 	//Start up SDL and create window
 	if (!init())
 	{
@@ -616,9 +2062,23 @@ int main(int argc, char* args[])
 			//Current input point
 			int currentData = 0;
 
+			//Time the save stats were last shown
+			Uint32 statsTime = 0;
+
 			//While application is running
 			while (!quit)
 			{
+				//Show the data points once the save has loaded
+				if (gLoadTicket != 0 && gSave.isDone(gLoadTicket))
+				{
+					if (gSave.failed(gLoadTicket))
+					{
+						printf("Warning: Save didn't load cleanly, damaged records were skipped!\n");
+					}
+					gLoadTicket = 0;
+					applyData();
+				}
+
 				//Handle events on queue
 				while (SDL_PollEvent(&e) != 0)
 				{
@@ -627,10 +2087,17 @@ int main(int argc, char* args[])
 					{
 						quit = true;
 					}
-					else if (e.type == SDL_KEYDOWN)
+					//Data can't be edited until it has loaded
+					else if (e.type == SDL_KEYDOWN && gLoadTicket == 0)
 					{
 						switch (e.key.keysym.sym)
 						{
+							//Snapshot everything while the game keeps running
+						case SDLK_s:
+							storeData();
+							gSave.saveSnapshotAsync();
+							break;
+
 							//Previous data entry
 						case SDLK_UP:
 							//Rerender previous entry input point
@@ -663,12 +2130,20 @@ int main(int argc, char* args[])
 						case SDLK_LEFT:
 							--gData[currentData];
 							gDataTextures[currentData].loadFromRenderedText(std::to_string(gData[currentData]), highlightColor);
+
+							//Journal the change on the I/O thread
+							storeData();
+							gSave.commitAsync();
 							break;
 
 							//Increment input point
 						case SDLK_RIGHT:
 							++gData[currentData];
 							gDataTextures[currentData].loadFromRenderedText(std::to_string(gData[currentData]), highlightColor);
+
+							//Journal the change on the I/O thread
+							storeData();
+							gSave.commitAsync();
 							break;
 						}
 					}
@@ -687,6 +2162,16 @@ int main(int argc, char* args[])
 
 				//Update screen
 				SDL_RenderPresent(gRenderer);
+
+				//Show what the last save cost once a second
+				if (SDL_GetTicks() - statsTime >= 1000)
+				{
+					SaveStats stats = gSave.getStats();
+					std::stringstream caption;
+					caption << "SDL Tutorial - Save: " << stats.snapshotMs << " ms snapshot, " << stats.writeMs << " ms write, " << stats.pendingJobs << " pending, " << stats.journalBytes / 1024 << " KB journal";
+					SDL_SetWindowTitle(gWindow, caption.str().c_str());
+					statsTime = SDL_GetTicks();
+				}
 			}
 		}
 	}
@@ -6,9 +6,17 @@ and may not be redistributed without written permission.*/
 #include <SDL_image.h>
 #include <SDL_ttf.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <string>
 #include <sstream>
 
+// Resample four taps at a time where SSE is available
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CONVERTER_SSE
+#endif
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
@@ -23,11 +31,36 @@ const int TOTAL_DATA = 10;
 // Maximum number of supported recording devices 
 const int MAX_RECORDING_DEVICES = 10;
 
-// Maximum recording time
-const int MAX_RECORDING_SECONDS = 5;
+// Audio moves between the callbacks and the disk threads in blocks, the count must be a power of two
+const int AUDIO_BLOCK_BYTES = 32768;
+const int AUDIO_BLOCK_COUNT = 64;
+
+// How often the disk threads wake up
+const Uint32 DISK_POLL_MS = 20;
+
+// How often a recording's WAV header is brought up to date
+const Uint32 HEADER_UPDATE_MS = 1000;
+
+// Largest sample data a WAV file can describe, leaving room for the float header with its fact chunk
+const Uint32 WAV_MAX_DATA_BYTES = 0xFFFFFFFF - 50;
+
+// Where recordings are written
+const char* RECORDING_PATH = "34_audio_recording/recording.wav";
+
+// Converter input history and working chunk sizes in frames
+const int CONVERTER_INPUT_FRAMES = 4096;
+const int CONVERTER_CHUNK_FRAMES = 512;
+
+// Seconds of audio each converter benchmark case runs
+const int BENCHMARK_SECONDS = 10;
 
-// Maximum recording time plus padding
-const int RECORDING_BUFFER_SECONDS = MAX_RECORDING_SECONDS + 1;
+// Resampler quality levels, from linear interpolation to a long windowed sinc
+enum ResampleQuality {
+	RESAMPLE_FAST,
+	RESAMPLE_MEDIUM,
+	RESAMPLE_BEST,
+	RESAMPLE_QUALITY_COUNT
+};
 
 // The various recording actions we can take
 enum RecordingState {
@@ -89,6 +122,243 @@ private:
 	int mHeight;
 };
 
+// Fixed set of blocks passed from one producer thread to one consumer thread without locking
+class LBlockRing
+{
+public:
+	// Initializes variables
+	LBlockRing();
+
+	// Deallocates memory
+	~LBlockRing();
+
+	// Allocates the blocks, the count must be a power of two
+	bool init(int blockBytes, int blockCount);
+
+	// Deallocates the blocks
+	void free();
+
+	// Gets the block to fill, NULL while every block is waiting to be consumed
+	Uint8* getWriteBlock();
+
+	// Hands the filled block to the consumer
+	void commitWrite(int bytes);
+
+	// Gets the oldest filled block and its size, NULL when there is none
+	Uint8* getReadBlock(int* bytes);
+
+	// Gives the consumed block back to the producer
+	void commitRead();
+
+	// Checks if every filled block has been consumed
+	bool isEmpty();
+
+	// Gets the block size
+	int getBlockBytes();
+
+private:
+	// Block memory and the bytes filled in each block
+	Uint8* mData;
+	int* mSizes;
+	int mBlockBytes;
+	int mBlockCount;
+
+	// Blocks written and read so far
+	SDL_atomic_t mWriteIndex;
+	SDL_atomic_t mReadIndex;
+};
+
+// Appends captured audio to a WAV file from a writer thread
+class LWavRecorder
+{
+public:
+	// Initializes variables
+	LWavRecorder();
+
+	// Finishes the file
+	~LWavRecorder();
+
+	// Creates the file and starts the writer thread
+	bool start(std::string path, SDL_AudioSpec& spec);
+
+	// Writes what is left and finishes the file, the capture device must be paused first
+	void stop();
+
+	// Queues captured audio, called by the audio thread and never blocks
+	void capture(const Uint8* data, int len);
+
+	// Checks if a recording is running
+	bool isRecording();
+
+	// Gets the length of the recording so far
+	double getSeconds();
+
+	// Gets the bytes lost because the disk fell behind
+	Uint32 getDroppedBytes();
+
+private:
+	// Writes blocks as they fill up
+	static int run(void* data);
+
+	// Writes every filled block to the file
+	void writeBlocks();
+
+	// Updates the sizes in the WAV header
+	void updateHeader();
+
+	// Output file
+	SDL_RWops* mFile;
+	Uint32 mDataBytes;
+	int mBytesPerSecond;
+	int mBlockAlign;
+
+	// Header length, and where the fact chunk's frame count sits, 0 for PCM files without one
+	int mHeaderBytes;
+	int mFactOffset;
+
+	// Every nth byte has its top bit flipped, 0 when SDL and WAV agree on the signedness
+	int mSignStride;
+
+	// Blocks between the audio and writer threads
+	LBlockRing mBlocks;
+	int mFillBytes;
+
+	// Writer thread
+	SDL_Thread* mThread;
+	SDL_atomic_t mQuit;
+
+	// Stats
+	SDL_atomic_t mCapturedBytes;
+	SDL_atomic_t mDroppedBytes;
+};
+
+// Converts audio between two specs a piece at a time, resampling with a polyphase windowed sinc
+class LAudioConverter
+{
+public:
+	// Initializes variables
+	LAudioConverter();
+
+	// Deallocates memory
+	~LAudioConverter();
+
+	// Builds the filter and buffers for converting from one spec to another
+	bool init(const SDL_AudioSpec& source, const SDL_AudioSpec& destination, ResampleQuality quality);
+
+	// Deallocates the filter and buffers
+	void free();
+
+	// Takes what input fits and writes as much output as it can, returns the output bytes written
+	int process(const Uint8* input, int inputBytes, int* consumedBytes, Uint8* output, int outputBytes);
+
+	// Pads the input with silence so the frames held back for the filter come out, once the input has ended
+	void flush();
+
+	// Checks if the input was flushed and all of it has come out, safe from any thread
+	bool isDrained();
+
+	// Sample format conversion
+	static void toFloat(const Uint8* input, SDL_AudioFormat format, int count, float* output);
+	static void fromFloat(const float* input, SDL_AudioFormat format, int count, Uint8* output);
+
+private:
+	// Drops input frames no future output depends on
+	void compact();
+
+	// Converts input frames to float and maps them onto the output channels
+	void decodeInput(const Uint8* input, int frames);
+
+	// Produces up to the given number of interleaved float frames
+	int resample(float* output, int frames);
+
+	// Sums a span of input against a filter phase interpolated towards the next phase
+	static float filterTaps(const float* input, const float* phase, const float* delta, float fraction, int taps);
+
+	// Specs
+	SDL_AudioFormat mSourceFormat;
+	SDL_AudioFormat mDestinationFormat;
+	int mSourceChannels;
+	int mChannels;
+	int mSourceFrameBytes;
+	int mDestinationFrameBytes;
+
+	// Filter phases and the difference to the next phase, mPhases + 1 rows of mTaps
+	ResampleQuality mQuality;
+	float* mFilter;
+	float* mDeltas;
+	int mTaps;
+	int mPhases;
+
+	// Planar input history, one CONVERTER_INPUT_FRAMES row per output channel
+	float* mInput;
+	int mInputFrames;
+
+	// Position of the next output frame in input frames plus mFraction / mDestinationRate
+	int mPosition;
+	Uint32 mFraction;
+	int mDestinationRate;
+	int mStepFrames;
+	Uint32 mStepFraction;
+
+	// Working chunks
+	float* mDecoded;
+	float* mOutput;
+
+	// End of input
+	bool mFlushing;
+	SDL_atomic_t mDrained;
+};
+
+// Plays a WAV file read ahead by a reader thread
+class LWavPlayer
+{
+public:
+	// Initializes variables
+	LWavPlayer();
+
+	// Closes the file
+	~LWavPlayer();
+
+	// Opens the file and starts the reader thread
+	bool start(std::string path);
+
+	// Stops reading and closes the file, the playback device must be paused first
+	void stop();
+
+	// Gets the unplayed bytes of the current block, called by the audio thread and never blocks
+	int peek(const Uint8** data);
+
+	// Marks bytes returned by peek as played
+	void consume(int bytes);
+
+	// Checks if the whole file has been played
+	bool isFinished();
+
+	// Gets the format of the file
+	SDL_AudioSpec& getSpec();
+
+private:
+	// Reads blocks as they are played
+	static int run(void* data);
+
+	// Reads into every free block
+	void readBlocks();
+
+	// Input file
+	SDL_RWops* mFile;
+	Uint32 mDataRemaining;
+	SDL_AudioSpec mSpec;
+
+	// Blocks between the reader and audio threads
+	LBlockRing mBlocks;
+	int mReadOffset;
+
+	// Reader thread
+	SDL_Thread* mThread;
+	SDL_atomic_t mQuit;
+	SDL_atomic_t mEnded;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -120,37 +390,1025 @@ int gRecordingDeviceCount = 0;
 SDL_AudioSpec gReceivedRecordingSpec;
 SDL_AudioSpec gReceivedPlaybackSpec;
 
-// Recording data buffer
-Uint8* gRecordingBuffer = NULL;
-
-// Size of data buffer
-Uint32 gBufferByteSize = 0;
+// Streams the recording to and from disk
+LWavRecorder gRecorder;
+LWavPlayer gPlayer;
 
-// Position in data buffer
-Uint32 gBufferBytePosition = 0;
+// Converts the recording to what the playback device accepted
+LAudioConverter gConverter;
 
-// Maximum position in data buffer for recording
-Uint32 gBufferByteMaxPosition = 0;
+// Resampler used for playback
+ResampleQuality gResampleQuality = RESAMPLE_BEST;
 
 // Color of text 
 SDL_Color gTextColor = { 0,0,0, 0xFF };
 
 void audioRecordingCallback(void* userdata, Uint8* stream, int len) {
 	
-	// Copy audio from stream
-	memcpy(&gRecordingBuffer[gBufferBytePosition], stream, len);
-
-	// Move along buffer
-	gBufferBytePosition += len;
+	// Hand audio from stream to the writer thread
+	gRecorder.capture(stream, len);
 }
 
 void audioPlaybackCallback(void* userdata, Uint8* stream, int len) {
 	
-	// Copy audio to stream
-	memcpy(stream, &gRecordingBuffer[gBufferBytePosition], len);
+	// Convert audio read ahead by the reader thread into stream
+	while (len > 0) {
+		const Uint8* data = NULL;
+		int available = gPlayer.peek(&data);
+		int consumed = 0;
+		int produced = gConverter.process(data, available, &consumed, stream, len);
+		gPlayer.consume(consumed);
+		stream += produced;
+		len -= produced;
+
+		// At the end of the file let the converter give up the frames it held back, then play silence
+		if (produced == 0 && consumed == 0 && gPlayer.isFinished() && !gConverter.isDrained()) {
+			gConverter.flush();
+			continue;
+		}
+
+		// Play silence until the reader catches up
+		if (produced == 0 && consumed == 0) {
+			memset(stream, gReceivedPlaybackSpec.silence, len);
+			break;
+		}
+	}
+}
+
+LBlockRing::LBlockRing()
+{
+	// Initialize
+	mData = NULL;
+	mSizes = NULL;
+	mBlockBytes = 0;
+	mBlockCount = 0;
+	SDL_AtomicSet(&mWriteIndex, 0);
+	SDL_AtomicSet(&mReadIndex, 0);
+}
+
+LBlockRing::~LBlockRing()
+{
+	// Deallocate
+	free();
+}
+
+bool LBlockRing::init(int blockBytes, int blockCount)
+{
+	// Get rid of preexisting blocks
+	free();
+
+	mData = new Uint8[blockBytes * blockCount];
+	mSizes = new int[blockCount];
+	mBlockBytes = blockBytes;
+	mBlockCount = blockCount;
+	return true;
+}
+
+void LBlockRing::free()
+{
+	delete[] mData;
+	mData = NULL;
+	delete[] mSizes;
+	mSizes = NULL;
+	mBlockBytes = 0;
+	mBlockCount = 0;
+	SDL_AtomicSet(&mWriteIndex, 0);
+	SDL_AtomicSet(&mReadIndex, 0);
+}
+
+Uint8* LBlockRing::getWriteBlock()
+{
+	// Every block is still waiting for the consumer
+	Uint32 write = SDL_AtomicGet(&mWriteIndex);
+	if (mData == NULL || write - (Uint32)SDL_AtomicGet(&mReadIndex) >= (Uint32)mBlockCount)
+	{
+		return NULL;
+	}
+	return mData + (write & (mBlockCount - 1)) * mBlockBytes;
+}
+
+void LBlockRing::commitWrite(int bytes)
+{
+	// Store the size before publishing the block
+	Uint32 write = SDL_AtomicGet(&mWriteIndex);
+	mSizes[write & (mBlockCount - 1)] = bytes;
+	SDL_AtomicSet(&mWriteIndex, write + 1);
+}
+
+Uint8* LBlockRing::getReadBlock(int* bytes)
+{
+	// Nothing filled yet
+	Uint32 read = SDL_AtomicGet(&mReadIndex);
+	if (mData == NULL || read == (Uint32)SDL_AtomicGet(&mWriteIndex))
+	{
+		return NULL;
+	}
+	*bytes = mSizes[read & (mBlockCount - 1)];
+	return mData + (read & (mBlockCount - 1)) * mBlockBytes;
+}
+
+void LBlockRing::commitRead()
+{
+	SDL_AtomicAdd(&mReadIndex, 1);
+}
+
+bool LBlockRing::isEmpty()
+{
+	return SDL_AtomicGet(&mReadIndex) == SDL_AtomicGet(&mWriteIndex);
+}
+
+int LBlockRing::getBlockBytes()
+{
+	return mBlockBytes;
+}
+
+LWavRecorder::LWavRecorder()
+{
+	// Initialize
+	mFile = NULL;
+	mDataBytes = 0;
+	mBytesPerSecond = 0;
+	mBlockAlign = 0;
+	mHeaderBytes = 0;
+	mFactOffset = 0;
+	mSignStride = 0;
+	mFillBytes = 0;
+	mThread = NULL;
+	SDL_AtomicSet(&mQuit, 0);
+	SDL_AtomicSet(&mCapturedBytes, 0);
+	SDL_AtomicSet(&mDroppedBytes, 0);
+}
+
+LWavRecorder::~LWavRecorder()
+{
+	// Finish the file
+	stop();
+}
+
+bool LWavRecorder::start(std::string path, SDL_AudioSpec& spec)
+{
+	// Finish a previous recording
+	stop();
+
+	// WAV stores little endian samples
+	if (SDL_AUDIO_ISBIGENDIAN(spec.format))
+	{
+		printf("Unable to record big endian audio to %s!\n", path.c_str());
+		return false;
+	}
+
+	mFile = SDL_RWFromFile(path.c_str(), "wb");
+	if (mFile == NULL)
+	{
+		printf("Unable to create recording %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+
+	// WAV PCM is unsigned at 8 bits and signed above, the other signedness gets its top bit flipped as it's written
+	int bits = SDL_AUDIO_BITSIZE(spec.format);
+	bool isFloat = SDL_AUDIO_ISFLOAT(spec.format) != 0;
+	mSignStride = 0;
+	if (!isFloat && bits == 8 && SDL_AUDIO_ISSIGNED(spec.format))
+	{
+		mSignStride = 1;
+	}
+	else if (!isFloat && bits == 16 && !SDL_AUDIO_ISSIGNED(spec.format))
+	{
+		mSignStride = 2;
+	}
+
+	// Write the header with empty sizes, the writer thread keeps them current
+	int blockAlign = spec.channels * (bits / 8);
+	mBlockAlign = blockAlign;
+	mBytesPerSecond = spec.freq * blockAlign;
+	SDL_RWwrite(mFile, "RIFF", 4, 1);
+	SDL_WriteLE32(mFile, 0);
+	SDL_RWwrite(mFile, "WAVEfmt ", 8, 1);
+	SDL_WriteLE32(mFile, isFloat ? 18 : 16);
+	SDL_WriteLE16(mFile, isFloat ? 3 : 1);
+	SDL_WriteLE16(mFile, spec.channels);
+	SDL_WriteLE32(mFile, spec.freq);
+	SDL_WriteLE32(mFile, mBytesPerSecond);
+	SDL_WriteLE16(mFile, blockAlign);
+	SDL_WriteLE16(mFile, bits);
+
+	// Formats other than PCM carry an extension size and a fact chunk with the frame count
+	mFactOffset = 0;
+	if (isFloat)
+	{
+		SDL_WriteLE16(mFile, 0);
+		SDL_RWwrite(mFile, "fact", 4, 1);
+		SDL_WriteLE32(mFile, 4);
+		mFactOffset = (int)SDL_RWtell(mFile);
+		SDL_WriteLE32(mFile, 0);
+	}
+	SDL_RWwrite(mFile, "data", 4, 1);
+	SDL_WriteLE32(mFile, 0);
+	mHeaderBytes = (int)SDL_RWtell(mFile);
+	mDataBytes = 0;
+	updateHeader();
+
+	// Start with every block free
+	mBlocks.init(AUDIO_BLOCK_BYTES - AUDIO_BLOCK_BYTES % blockAlign, AUDIO_BLOCK_COUNT);
+	mFillBytes = 0;
+	SDL_AtomicSet(&mCapturedBytes, 0);
+	SDL_AtomicSet(&mDroppedBytes, 0);
+
+	// Start writing
+	SDL_AtomicSet(&mQuit, 0);
+	mThread = SDL_CreateThread(run, "Recording writer", this);
+	if (mThread == NULL)
+	{
+		printf("Unable to start recording writer! SDL Error: %s\n", SDL_GetError());
+		stop();
+		return false;
+	}
+	return true;
+}
+
+void LWavRecorder::stop()
+{
+	if (mFile == NULL)
+	{
+		return;
+	}
+
+	// Let the writer drain the filled blocks and quit
+	if (mThread != NULL)
+	{
+		SDL_AtomicSet(&mQuit, 1);
+		SDL_WaitThread(mThread, NULL);
+		mThread = NULL;
+	}
+
+	// The device is paused so the partly filled block can be taken as well
+	if (mFillBytes > 0 && mBlocks.getWriteBlock() != NULL)
+	{
+		mBlocks.commitWrite(mFillBytes);
+	}
+	mFillBytes = 0;
+	writeBlocks();
+
+	// Finish the file
+	updateHeader();
+	SDL_RWclose(mFile);
+	mFile = NULL;
+	mBlocks.free();
+}
+
+void LWavRecorder::capture(const Uint8* data, int len)
+{
+	while (len > 0)
+	{
+		// Drop audio rather than wait when the disk falls behind
+		Uint8* block = mBlocks.getWriteBlock();
+		if (block == NULL)
+		{
+			SDL_AtomicAdd(&mDroppedBytes, len);
+			return;
+		}
+
+		// Fill the current block
+		int count = mBlocks.getBlockBytes() - mFillBytes;
+		if (count > len)
+		{
+			count = len;
+		}
+		memcpy(block + mFillBytes, data, count);
+		mFillBytes += count;
+		data += count;
+		len -= count;
+		SDL_AtomicAdd(&mCapturedBytes, count);
+
+		// Pass it on once full
+		if (mFillBytes == mBlocks.getBlockBytes())
+		{
+			mBlocks.commitWrite(mFillBytes);
+			mFillBytes = 0;
+		}
+	}
+}
+
+bool LWavRecorder::isRecording()
+{
+	return mFile != NULL;
+}
+
+double LWavRecorder::getSeconds()
+{
+	return mBytesPerSecond > 0 ? (Uint32)SDL_AtomicGet(&mCapturedBytes) / (double)mBytesPerSecond : 0.0;
+}
+
+Uint32 LWavRecorder::getDroppedBytes()
+{
+	return SDL_AtomicGet(&mDroppedBytes);
+}
+
+int LWavRecorder::run(void* data)
+{
+	LWavRecorder* recorder = (LWavRecorder*)data;
+	Uint32 headerTime = SDL_GetTicks();
+	while (true)
+	{
+		// Check before writing so nothing filled before the quit request is missed
+		bool quit = SDL_AtomicGet(&recorder->mQuit) != 0;
+		recorder->writeBlocks();
+		if (quit)
+		{
+			break;
+		}
+
+		// Keep the file playable if the program dies mid recording
+		if (SDL_GetTicks() - headerTime >= HEADER_UPDATE_MS)
+		{
+			recorder->updateHeader();
+			headerTime = SDL_GetTicks();
+		}
+
+		SDL_Delay(DISK_POLL_MS);
+	}
+	return 0;
+}
+
+void LWavRecorder::writeBlocks()
+{
+	int bytes = 0;
+	Uint8* block = NULL;
+	while ((block = mBlocks.getReadBlock(&bytes)) != NULL)
+	{
+		// Stop growing once the header can't describe more
+		if ((Uint32)bytes > WAV_MAX_DATA_BYTES - mDataBytes)
+		{
+			SDL_AtomicAdd(&mDroppedBytes, bytes - (WAV_MAX_DATA_BYTES - mDataBytes));
+			bytes = WAV_MAX_DATA_BYTES - mDataBytes;
+		}
+		for (int i = mSignStride - 1; mSignStride > 0 && i < bytes; i += mSignStride)
+		{
+			block[i] ^= 0x80;
+		}
+		if (bytes > 0 && SDL_RWwrite(mFile, block, bytes, 1) != 1)
+		{
+			printf("Unable to write recording! SDL Error: %s\n", SDL_GetError());
+			SDL_AtomicAdd(&mDroppedBytes, bytes);
+			bytes = 0;
+		}
+		mDataBytes += bytes;
+		mBlocks.commitRead();
+	}
+}
+
+void LWavRecorder::updateHeader()
+{
+	// Patch the RIFF, fact and data sizes and go back to the end
+	Sint64 end = SDL_RWtell(mFile);
+	SDL_RWseek(mFile, 4, RW_SEEK_SET);
+	SDL_WriteLE32(mFile, mHeaderBytes - 8 + mDataBytes);
+	if (mFactOffset > 0)
+	{
+		SDL_RWseek(mFile, mFactOffset, RW_SEEK_SET);
+		SDL_WriteLE32(mFile, mBlockAlign > 0 ? mDataBytes / mBlockAlign : 0);
+	}
+	SDL_RWseek(mFile, mHeaderBytes - 4, RW_SEEK_SET);
+	SDL_WriteLE32(mFile, mDataBytes);
+	SDL_RWseek(mFile, end, RW_SEEK_SET);
+}
+
+LWavPlayer::LWavPlayer()
+{
+	// Initialize
+	mFile = NULL;
+	mDataRemaining = 0;
+	SDL_zero(mSpec);
+	mReadOffset = 0;
+	mThread = NULL;
+	SDL_AtomicSet(&mQuit, 0);
+	SDL_AtomicSet(&mEnded, 0);
+}
+
+LWavPlayer::~LWavPlayer()
+{
+	// Close the file
+	stop();
+}
+
+bool LWavPlayer::start(std::string path)
+{
+	// Close a previous file
+	stop();
+
+	mFile = SDL_RWFromFile(path.c_str(), "rb");
+	if (mFile == NULL)
+	{
+		printf("Unable to open recording %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+
+	// Walk the chunks up to the sample data
+	char id[4];
+	Uint16 formatTag = 0;
+	Uint16 bits = 0;
+	bool found = false;
+	SDL_zero(mSpec);
+	SDL_RWseek(mFile, 12, RW_SEEK_SET);
+	while (!found && SDL_RWread(mFile, id, 4, 1) == 1)
+	{
+		Uint32 size = SDL_ReadLE32(mFile);
+		Sint64 next = SDL_RWtell(mFile) + size + (size & 1);
+		if (memcmp(id, "fmt ", 4) == 0)
+		{
+			formatTag = SDL_ReadLE16(mFile);
+			mSpec.channels = (Uint8)SDL_ReadLE16(mFile);
+			mSpec.freq = SDL_ReadLE32(mFile);
+			SDL_RWseek(mFile, 6, RW_SEEK_CUR);
+			bits = SDL_ReadLE16(mFile);
+		}
+		else if (memcmp(id, "data", 4) == 0)
+		{
+			mDataRemaining = size;
+			found = true;
+		}
+		if (!found)
+		{
+			SDL_RWseek(mFile, next, RW_SEEK_SET);
+		}
+	}
+
+	// Map the header back to an SDL format
+	if (formatTag == 3 && bits == 32)
+	{
+		mSpec.format = AUDIO_F32LSB;
+	}
+	else if (formatTag == 1 && bits == 8)
+	{
+		mSpec.format = AUDIO_U8;
+	}
+	else if (formatTag == 1 && bits == 16)
+	{
+		mSpec.format = AUDIO_S16LSB;
+	}
+	else if (formatTag == 1 && bits == 32)
+	{
+		mSpec.format = AUDIO_S32LSB;
+	}
+	if (!found || mSpec.format == 0 || mSpec.channels == 0)
+	{
+		printf("Unable to play recording %s! Unsupported WAV file\n", path.c_str());
+		SDL_RWclose(mFile);
+		mFile = NULL;
+		return false;
+	}
+	mSpec.silence = mSpec.format == AUDIO_U8 ? 0x80 : 0;
+
+	// Start reading ahead in whole frames
+	int blockAlign = mSpec.channels * (bits / 8);
+	mBlocks.init(AUDIO_BLOCK_BYTES - AUDIO_BLOCK_BYTES % blockAlign, AUDIO_BLOCK_COUNT);
+	mReadOffset = 0;
+	SDL_AtomicSet(&mEnded, 0);
+	SDL_AtomicSet(&mQuit, 0);
+	mThread = SDL_CreateThread(run, "Recording reader", this);
+	if (mThread == NULL)
+	{
+		printf("Unable to start recording reader! SDL Error: %s\n", SDL_GetError());
+		stop();
+		return false;
+	}
+	return true;
+}
 
-	// Move along buffer
-	gBufferBytePosition += len;
+void LWavPlayer::stop()
+{
+	// Stop reading
+	if (mThread != NULL)
+	{
+		SDL_AtomicSet(&mQuit, 1);
+		SDL_WaitThread(mThread, NULL);
+		mThread = NULL;
+	}
+
+	// Close the file
+	if (mFile != NULL)
+	{
+		SDL_RWclose(mFile);
+		mFile = NULL;
+	}
+	mBlocks.free();
+	mDataRemaining = 0;
+}
+
+int LWavPlayer::peek(const Uint8** data)
+{
+	// Nothing when the reader is behind or done
+	int bytes = 0;
+	Uint8* block = mBlocks.getReadBlock(&bytes);
+	if (block == NULL)
+	{
+		*data = NULL;
+		return 0;
+	}
+
+	// The rest of the current block
+	*data = block + mReadOffset;
+	return bytes - mReadOffset;
+}
+
+void LWavPlayer::consume(int bytes)
+{
+	// Give the block back once used up
+	int blockBytes = 0;
+	mReadOffset += bytes;
+	if (bytes > 0 && mBlocks.getReadBlock(&blockBytes) != NULL && mReadOffset >= blockBytes)
+	{
+		mBlocks.commitRead();
+		mReadOffset = 0;
+	}
+}
+
+bool LWavPlayer::isFinished()
+{
+	return SDL_AtomicGet(&mEnded) != 0 && mBlocks.isEmpty();
+}
+
+SDL_AudioSpec& LWavPlayer::getSpec()
+{
+	return mSpec;
+}
+
+LAudioConverter::LAudioConverter()
+{
+	// Initialize
+	mSourceFormat = 0;
+	mDestinationFormat = 0;
+	mSourceChannels = 0;
+	mChannels = 0;
+	mSourceFrameBytes = 0;
+	mDestinationFrameBytes = 0;
+	mQuality = RESAMPLE_FAST;
+	mFilter = NULL;
+	mDeltas = NULL;
+	mTaps = 0;
+	mPhases = 0;
+	mInput = NULL;
+	mInputFrames = 0;
+	mPosition = 0;
+	mFraction = 0;
+	mDestinationRate = 0;
+	mStepFrames = 0;
+	mStepFraction = 0;
+	mDecoded = NULL;
+	mOutput = NULL;
+	mFlushing = false;
+	SDL_AtomicSet(&mDrained, 0);
+}
+
+LAudioConverter::~LAudioConverter()
+{
+	// Deallocate
+	free();
+}
+
+// Zeroth order modified Bessel function for the Kaiser window
+static double besselI0(double x)
+{
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; ++k)
+	{
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+bool LAudioConverter::init(const SDL_AudioSpec& source, const SDL_AudioSpec& destination, ResampleQuality quality)
+{
+	// Get rid of a previous conversion
+	free();
+
+	if (source.freq <= 0 || destination.freq <= 0 || source.channels == 0 || destination.channels == 0)
+	{
+		printf("Unable to convert between the audio specs!\n");
+		return false;
+	}
+
+	mSourceFormat = source.format;
+	mDestinationFormat = destination.format;
+	mSourceChannels = source.channels;
+	mChannels = destination.channels;
+	mSourceFrameBytes = source.channels * (SDL_AUDIO_BITSIZE(source.format) / 8);
+	mDestinationFrameBytes = destination.channels * (SDL_AUDIO_BITSIZE(destination.format) / 8);
+
+	// Step through the input by source / destination frames per output frame
+	mDestinationRate = destination.freq;
+	mStepFrames = source.freq / destination.freq;
+	mStepFraction = source.freq % destination.freq;
+
+	// Matching rates are copied exactly, the linear path does that with a zero fraction
+	mQuality = source.freq == destination.freq ? RESAMPLE_FAST : quality;
+	mTaps = 2;
+	mPhases = 1;
+	double beta = 0.0;
+	double rolloff = 1.0;
+	if (mQuality == RESAMPLE_MEDIUM)
+	{
+		mTaps = 16;
+		mPhases = 128;
+		beta = 6.0;
+		rolloff = 0.9;
+	}
+	else if (mQuality == RESAMPLE_BEST)
+	{
+		mTaps = 64;
+		mPhases = 512;
+		beta = 9.0;
+		rolloff = 0.95;
+	}
+
+	// Build the sinc phases, cutting off below the lower of the two Nyquist frequencies
+	if (mQuality != RESAMPLE_FAST)
+	{
+		mFilter = new float[(mPhases + 1) * mTaps];
+		mDeltas = new float[(mPhases + 1) * mTaps];
+		double cutoff = 0.5 * rolloff * (destination.freq < source.freq ? (double)destination.freq / source.freq : 1.0);
+		int half = mTaps / 2;
+		for (int p = 0; p <= mPhases; ++p)
+		{
+			double sum = 0.0;
+			float* row = mFilter + p * mTaps;
+			for (int t = 0; t < mTaps; ++t)
+			{
+				// Distance from the output position to this tap, in input frames
+				double x = (t - (half - 1)) - (double)p / mPhases;
+				double sinc = x == 0.0 ? 1.0 : sin(2.0 * M_PI * cutoff * x) / (2.0 * M_PI * cutoff * x);
+				double ratio = x / half;
+				double window = ratio * ratio < 1.0 ? besselI0(beta * sqrt(1.0 - ratio * ratio)) / besselI0(beta) : 0.0;
+				row[t] = (float)(sinc * window);
+				sum += row[t];
+			}
+
+			// Keep unity gain at every phase
+			for (int t = 0; t < mTaps; ++t)
+			{
+				row[t] = (float)(row[t] / sum);
+			}
+		}
+		for (int p = 0; p < mPhases; ++p)
+		{
+			for (int t = 0; t < mTaps; ++t)
+			{
+				mDeltas[p * mTaps + t] = mFilter[(p + 1) * mTaps + t] - mFilter[p * mTaps + t];
+			}
+		}
+	}
+
+	// Start with enough silent history for the first output frame
+	mInput = new float[CONVERTER_INPUT_FRAMES * mChannels];
+	memset(mInput, 0, CONVERTER_INPUT_FRAMES * mChannels * sizeof(float));
+	mInputFrames = mTaps / 2 - 1;
+	mPosition = mTaps / 2 - 1;
+	mFraction = 0;
+	mFlushing = false;
+	SDL_AtomicSet(&mDrained, 0);
+
+	mDecoded = new float[CONVERTER_CHUNK_FRAMES * mSourceChannels];
+	mOutput = new float[CONVERTER_CHUNK_FRAMES * mChannels];
+	return true;
+}
+
+void LAudioConverter::free()
+{
+	delete[] mFilter;
+	mFilter = NULL;
+	delete[] mDeltas;
+	mDeltas = NULL;
+	delete[] mInput;
+	mInput = NULL;
+	delete[] mDecoded;
+	mDecoded = NULL;
+	delete[] mOutput;
+	mOutput = NULL;
+	mInputFrames = 0;
+	mChannels = 0;
+}
+
+int LAudioConverter::process(const Uint8* input, int inputBytes, int* consumedBytes, Uint8* output, int outputBytes)
+{
+	*consumedBytes = 0;
+	if (mInput == NULL)
+	{
+		return 0;
+	}
+
+	// Take as much input as the history has room for
+	compact();
+	int frames = inputBytes / mSourceFrameBytes;
+	if (frames > CONVERTER_INPUT_FRAMES - mInputFrames)
+	{
+		frames = CONVERTER_INPUT_FRAMES - mInputFrames;
+	}
+	if (frames > 0)
+	{
+		decodeInput(input, frames);
+		*consumedBytes = frames * mSourceFrameBytes;
+	}
+
+	// Resample a chunk at a time into the output format
+	int outputFrames = outputBytes / mDestinationFrameBytes;
+	int produced = 0;
+	while (produced < outputFrames)
+	{
+		int count = resample(mOutput, outputFrames - produced < CONVERTER_CHUNK_FRAMES ? outputFrames - produced : CONVERTER_CHUNK_FRAMES);
+		if (count == 0)
+		{
+			break;
+		}
+		fromFloat(mOutput, mDestinationFormat, count * mChannels, output + produced * mDestinationFrameBytes);
+		produced += count;
+	}
+
+	// Everything up to the padding has come out
+	if (mFlushing && mPosition + mTaps / 2 >= mInputFrames)
+	{
+		SDL_AtomicSet(&mDrained, 1);
+	}
+	return produced * mDestinationFrameBytes;
+}
+
+void LAudioConverter::flush()
+{
+	if (mInput == NULL)
+	{
+		SDL_AtomicSet(&mDrained, 1);
+		return;
+	}
+	if (mFlushing)
+	{
+		return;
+	}
+
+	// Half a filter of silence lets the output reach the last real frame
+	compact();
+	int frames = mTaps / 2;
+	if (frames > CONVERTER_INPUT_FRAMES - mInputFrames)
+	{
+		frames = CONVERTER_INPUT_FRAMES - mInputFrames;
+	}
+	for (int c = 0; c < mChannels; ++c)
+	{
+		memset(mInput + c * CONVERTER_INPUT_FRAMES + mInputFrames, 0, frames * sizeof(float));
+	}
+	mInputFrames += frames;
+	mFlushing = true;
+}
+
+bool LAudioConverter::isDrained()
+{
+	return SDL_AtomicGet(&mDrained) != 0;
+}
+
+void LAudioConverter::compact()
+{
+	// The oldest frame the next output reads
+	int first = mPosition - (mTaps / 2 - 1);
+	if (first <= 0)
+	{
+		return;
+	}
+	if (first > mInputFrames)
+	{
+		first = mInputFrames;
+	}
+
+	// Slide the rest of each channel to the front
+	for (int c = 0; c < mChannels; ++c)
+	{
+		float* row = mInput + c * CONVERTER_INPUT_FRAMES;
+		memmove(row, row + first, (mInputFrames - first) * sizeof(float));
+	}
+	mInputFrames -= first;
+	mPosition -= first;
+}
+
+void LAudioConverter::decodeInput(const Uint8* input, int frames)
+{
+	while (frames > 0)
+	{
+		// Samples to float
+		int count = frames < CONVERTER_CHUNK_FRAMES ? frames : CONVERTER_CHUNK_FRAMES;
+		toFloat(input, mSourceFormat, count * mSourceChannels, mDecoded);
+
+		// Spread them over the planar output channels
+		for (int c = 0; c < mChannels; ++c)
+		{
+			float* row = mInput + c * CONVERTER_INPUT_FRAMES + mInputFrames;
+			for (int i = 0; i < count; ++i)
+			{
+				const float* frame = mDecoded + i * mSourceChannels;
+				if (mChannels == 1 && mSourceChannels > 1)
+				{
+					// Down to mono averages everything
+					float sum = 0.f;
+					for (int s = 0; s < mSourceChannels; ++s)
+					{
+						sum += frame[s];
+					}
+					row[i] = sum / mSourceChannels;
+				}
+				else if (mSourceChannels == 1)
+				{
+					// Mono goes to every channel
+					row[i] = frame[0];
+				}
+				else
+				{
+					// Otherwise channels map one to one and extra ones stay silent
+					row[i] = c < mSourceChannels ? frame[c] : 0.f;
+				}
+			}
+		}
+
+		mInputFrames += count;
+		input += count * mSourceFrameBytes;
+		frames -= count;
+	}
+}
+
+int LAudioConverter::resample(float* output, int frames)
+{
+	int half = mTaps / 2;
+	int produced = 0;
+	while (produced < frames && mPosition + half < mInputFrames)
+	{
+		if (mQuality == RESAMPLE_FAST)
+		{
+			// Straight line between the two neighbouring frames
+			float fraction = (float)mFraction / mDestinationRate;
+			for (int c = 0; c < mChannels; ++c)
+			{
+				const float* row = mInput + c * CONVERTER_INPUT_FRAMES + mPosition;
+				output[produced * mChannels + c] = row[0] + (row[1] - row[0]) * fraction;
+			}
+		}
+		else
+		{
+			// Pick the phase and how far it is towards the next one
+			Uint64 phase = (Uint64)mFraction * mPhases;
+			int index = (int)(phase / mDestinationRate);
+			float fraction = (float)(phase % mDestinationRate) / mDestinationRate;
+			const float* filter = mFilter + index * mTaps;
+			const float* delta = mDeltas + index * mTaps;
+			for (int c = 0; c < mChannels; ++c)
+			{
+				const float* row = mInput + c * CONVERTER_INPUT_FRAMES + mPosition - (half - 1);
+				output[produced * mChannels + c] = filterTaps(row, filter, delta, fraction, mTaps);
+			}
+		}
+
+		// Step exactly by the rate ratio
+		mPosition += mStepFrames;
+		mFraction += mStepFraction;
+		if (mFraction >= (Uint32)mDestinationRate)
+		{
+			mFraction -= mDestinationRate;
+			++mPosition;
+		}
+		++produced;
+	}
+	return produced;
+}
+
+float LAudioConverter::filterTaps(const float* input, const float* phase, const float* delta, float fraction, int taps)
+{
+	// sum(input * (phase + fraction * delta)) as two dot products sharing the input loads
+#if defined(CONVERTER_SSE)
+	__m128 sum = _mm_setzero_ps();
+	__m128 sumDelta = _mm_setzero_ps();
+	for (int t = 0; t < taps; t += 4)
+	{
+		__m128 in = _mm_loadu_ps(input + t);
+		sum = _mm_add_ps(sum, _mm_mul_ps(in, _mm_loadu_ps(phase + t)));
+		sumDelta = _mm_add_ps(sumDelta, _mm_mul_ps(in, _mm_loadu_ps(delta + t)));
+	}
+	sum = _mm_add_ps(sum, _mm_mul_ps(sumDelta, _mm_set1_ps(fraction)));
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+#else
+	float sum = 0.f;
+	float sumDelta = 0.f;
+	for (int t = 0; t < taps; ++t)
+	{
+		sum += input[t] * phase[t];
+		sumDelta += input[t] * delta[t];
+	}
+	return sum + fraction * sumDelta;
+#endif
+}
+
+void LAudioConverter::toFloat(const Uint8* input, SDL_AudioFormat format, int count, float* output)
+{
+	bool swap = (SDL_AUDIO_ISBIGENDIAN(format) != 0) != (SDL_BYTEORDER == SDL_BIG_ENDIAN);
+	for (int i = 0; i < count; ++i)
+	{
+		if (SDL_AUDIO_BITSIZE(format) == 8)
+		{
+			output[i] = SDL_AUDIO_ISSIGNED(format) ? (Sint8)input[i] / 128.f : (input[i] - 128) / 128.f;
+		}
+		else if (SDL_AUDIO_BITSIZE(format) == 16)
+		{
+			Uint16 sample;
+			memcpy(&sample, input + i * 2, 2);
+			sample = swap ? SDL_Swap16(sample) : sample;
+			output[i] = (Sint16)sample / 32768.f;
+		}
+		else
+		{
+			Uint32 sample;
+			memcpy(&sample, input + i * 4, 4);
+			sample = swap ? SDL_Swap32(sample) : sample;
+			if (SDL_AUDIO_ISFLOAT(format))
+			{
+				memcpy(&output[i], &sample, 4);
+			}
+			else
+			{
+				output[i] = (float)((Sint32)sample / 2147483648.0);
+			}
+		}
+	}
+}
+
+void LAudioConverter::fromFloat(const float* input, SDL_AudioFormat format, int count, Uint8* output)
+{
+	bool swap = (SDL_AUDIO_ISBIGENDIAN(format) != 0) != (SDL_BYTEORDER == SDL_BIG_ENDIAN);
+	for (int i = 0; i < count; ++i)
+	{
+		// Integer formats clip, float keeps the full range
+		float value = input[i] > 1.f ? 1.f : (input[i] < -1.f ? -1.f : input[i]);
+		if (SDL_AUDIO_BITSIZE(format) == 8)
+		{
+			int sample = (int)lrintf(value * 127.f);
+			output[i] = (Uint8)(SDL_AUDIO_ISSIGNED(format) ? sample : sample + 128);
+		}
+		else if (SDL_AUDIO_BITSIZE(format) == 16)
+		{
+			Uint16 sample = (Uint16)(Sint16)lrintf(value * 32767.f);
+			sample = swap ? SDL_Swap16(sample) : sample;
+			memcpy(output + i * 2, &sample, 2);
+		}
+		else
+		{
+			Uint32 sample;
+			if (SDL_AUDIO_ISFLOAT(format))
+			{
+				memcpy(&sample, &input[i], 4);
+			}
+			else
+			{
+				sample = (Uint32)(Sint32)(value * 2147483647.0);
+			}
+			sample = swap ? SDL_Swap32(sample) : sample;
+			memcpy(output + i * 4, &sample, 4);
+		}
+	}
+}
+
+int LWavPlayer::run(void* data)
+{
+	LWavPlayer* player = (LWavPlayer*)data;
+	while (SDL_AtomicGet(&player->mQuit) == 0 && SDL_AtomicGet(&player->mEnded) == 0)
+	{
+		player->readBlocks();
+		SDL_Delay(DISK_POLL_MS);
+	}
+	return 0;
+}
+
+void LWavPlayer::readBlocks()
+{
+	Uint8* block = NULL;
+	while (mDataRemaining > 0 && (block = mBlocks.getWriteBlock()) != NULL)
+	{
+		// Read up to a block, a short read means the file ended early
+		int bytes = mBlocks.getBlockBytes();
+		if ((Uint32)bytes > mDataRemaining)
+		{
+			bytes = mDataRemaining;
+		}
+		bytes = (int)SDL_RWread(mFile, block, 1, bytes);
+		if (bytes <= 0)
+		{
+			mDataRemaining = 0;
+			break;
+		}
+		mDataRemaining -= bytes;
+		mBlocks.commitWrite(bytes);
+	}
+
+	// Nothing left to read
+	if (mDataRemaining == 0)
+	{
+		SDL_AtomicSet(&mEnded, 1);
+	}
 }
 
 LTexture::LTexture()
@@ -422,11 +1680,9 @@ void close()
 	TTF_CloseFont(gFont);
 	gFont = NULL;
 
-	// Free playback audio
-	if (gRecordingBuffer != NULL) {
-		delete[] gRecordingBuffer;
-		gRecordingBuffer = NULL;
-	}
+	// Finish any recording and playback
+	gRecorder.stop();
+	gPlayer.stop();
 	//Destroy window	
 	SDL_DestroyRenderer(gRenderer);
 	SDL_DestroyWindow(gWindow);
@@ -439,8 +1695,98 @@ void close()
 	TTF_Quit();
 }
 
+// Measures converter throughput at each quality for a few common spec mismatches
+void runConverterBenchmark()
+{
+	struct BenchmarkCase
+	{
+		const char* name;
+		int sourceFrequency;
+		SDL_AudioFormat sourceFormat;
+		Uint8 sourceChannels;
+		int destinationFrequency;
+		SDL_AudioFormat destinationFormat;
+		Uint8 destinationChannels;
+	};
+	const BenchmarkCase cases[] =
+	{
+		{ "44100 F32 stereo -> 48000 F32 stereo", 44100, AUDIO_F32SYS, 2, 48000, AUDIO_F32SYS, 2 },
+		{ "48000 S16 stereo -> 44100 S16 stereo", 48000, AUDIO_S16SYS, 2, 44100, AUDIO_S16SYS, 2 },
+		{ "22050 S16 mono -> 48000 F32 stereo", 22050, AUDIO_S16SYS, 1, 48000, AUDIO_F32SYS, 2 }
+	};
+	const char* qualityNames[RESAMPLE_QUALITY_COUNT] = { "fast", "medium", "best" };
+
+	// Device sized buffers, the input a 440Hz tone
+	const int blockFrames = 4096;
+	Uint8* input = new Uint8[blockFrames * 2 * 4];
+	Uint8* output = new Uint8[blockFrames * 2 * 4];
+	LAudioConverter converter;
+
+	for (int i = 0; i < (int)(sizeof(cases) / sizeof(cases[0])); ++i)
+	{
+		const BenchmarkCase& c = cases[i];
+		SDL_AudioSpec source;
+		SDL_zero(source);
+		source.freq = c.sourceFrequency;
+		source.format = c.sourceFormat;
+		source.channels = c.sourceChannels;
+		SDL_AudioSpec destination;
+		SDL_zero(destination);
+		destination.freq = c.destinationFrequency;
+		destination.format = c.destinationFormat;
+		destination.channels = c.destinationChannels;
+
+		int sourceFrameBytes = c.sourceChannels * (SDL_AUDIO_BITSIZE(c.sourceFormat) / 8);
+		float* tone = new float[blockFrames * c.sourceChannels];
+		for (int f = 0; f < blockFrames * c.sourceChannels; ++f)
+		{
+			tone[f] = 0.5f * (float)sin(2.0 * M_PI * 440.0 * (f / c.sourceChannels) / c.sourceFrequency);
+		}
+		LAudioConverter::fromFloat(tone, c.sourceFormat, blockFrames * c.sourceChannels, input);
+		delete[] tone;
+
+		printf("%s\n", c.name);
+		for (int q = 0; q < RESAMPLE_QUALITY_COUNT; ++q)
+		{
+			converter.init(source, destination, (ResampleQuality)q);
+
+			// Convert BENCHMARK_SECONDS of output the way the callback does
+			Sint64 target = (Sint64)BENCHMARK_SECONDS * c.destinationFrequency;
+			Sint64 produced = 0;
+			int outputBytes = blockFrames * c.destinationChannels * (SDL_AUDIO_BITSIZE(c.destinationFormat) / 8);
+			int offset = 0;
+			Uint64 start = SDL_GetPerformanceCounter();
+			while (produced < target)
+			{
+				int consumed = 0;
+				int bytes = converter.process(input + offset, blockFrames * sourceFrameBytes - offset, &consumed, output, outputBytes);
+				offset = (offset + consumed) % (blockFrames * sourceFrameBytes);
+				produced += bytes / (outputBytes / blockFrames);
+			}
+			double seconds = (double)(SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+
+			printf("  %-6s %8.2f Mframes/s  %8.1fx realtime\n", qualityNames[q], produced / seconds / 1000000.0, BENCHMARK_SECONDS / seconds);
+		}
+	}
+
+	delete[] input;
+	delete[] output;
+}
+
 int main(int argc, char* args[])
 {
+	// Benchmark the converter without opening any devices
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(args[i], "--benchmark") == 0)
+		{
+			SDL_Init(0);
+			runConverterBenchmark();
+			SDL_Quit();
+			return 0;
+		}
+	}
+
 	//Start up SDL and create window
 	if (!init())
 	{
@@ -468,6 +1814,9 @@ int main(int argc, char* args[])
 			SDL_AudioDeviceID recordingDeviceId = 0;
 			SDL_AudioDeviceID playbackDeviceId = 0;
 
+			// Recording length last shown
+			int recordedSeconds = 0;
+
 			//While application is running
 			while (!quit)
 			{
@@ -531,7 +1880,7 @@ int main(int argc, char* args[])
 											desiredPlayabackSpec.callback = audioPlaybackCallback;
 
 											// Open Playback device
-											playbackDeviceId = SDL_OpenAudioDevice(NULL, SDL_FALSE, &desiredPlayabackSpec, &gReceivedPlaybackSpec, SDL_AUDIO_ALLOW_FORMAT_CHANGE);
+											playbackDeviceId = SDL_OpenAudioDevice(NULL, SDL_FALSE, &desiredPlayabackSpec, &gReceivedPlaybackSpec, SDL_AUDIO_ALLOW_ANY_CHANGE);
 
 											// Device failed to open
 											if (playbackDeviceId == 0) {
@@ -544,24 +1893,8 @@ int main(int argc, char* args[])
 											// Device opened successfully
 											else {
 
-												// Calculate per sample bytes
-												int bytesPerSample = gReceivedRecordingSpec.channels * (SDL_AUDIO_BITSIZE(gReceivedRecordingSpec.format) / 8);
-
-												// Calculate bytes per second
-												int bytesPerSecond = gReceivedRecordingSpec.freq * bytesPerSample;
-
-												// Calculate buffer size
-												gBufferByteSize = RECORDING_BUFFER_SECONDS * bytesPerSecond;
-
-												// Calculate max buffer use
-												gBufferByteMaxPosition = MAX_RECORDING_SECONDS * bytesPerSecond;
-
-												// allocate and initialize byte buffer
-												gRecordingBuffer = new Uint8[gBufferByteSize];
-												memset(gRecordingBuffer, 0, gBufferByteSize);
-
 												// Go on to next state
-												gPromptTexture.loadFromRenderedText("Press 1 to record 5 seconds.", gTextColor);
+												gPromptTexture.loadFromRenderedText("Press 1 to record.", gTextColor);
 												currentState = STOPPED;
 											}
 										}
@@ -576,54 +1909,90 @@ int main(int argc, char* args[])
 							// On key press
 							if (e.type == SDL_KEYDOWN) {
 
-								// Start recording
-								if (e.key.keysym.sym == SDLK_1) {
-
-									// Go back to beginning of buffer
-									gBufferBytePosition = 0;
+								// Start recording to disk
+								if (e.key.keysym.sym == SDLK_1 && gRecorder.start(RECORDING_PATH, gReceivedRecordingSpec)) {
 
 									// Start recording
 									SDL_PauseAudioDevice(recordingDeviceId, SDL_FALSE);
 
 									// Go on to next state
-									gPromptTexture.loadFromRenderedText("Recording...", gTextColor);
+									gPromptTexture.loadFromRenderedText("Recording... Press 1 to stop.", gTextColor);
 									currentState = RECORDING;
 								}
 							}
 							break;
 
-						// User has finished recording
-						case RECORDED:
+						// User is recording
+						case RECORDING:
 
 							// On key press
 							if (e.type == SDL_KEYDOWN) {
 
-								// Start playback
+								// Stop recording
 								if (e.key.keysym.sym == SDLK_1) {
 
-									// Go back to beginning of buffer
-									gBufferBytePosition = 0;
+									// Stop recording audio before finishing the file
+									SDL_PauseAudioDevice(recordingDeviceId, SDL_TRUE);
+									gRecorder.stop();
+
+									// Go on to next state
+									gPromptTexture.loadFromRenderedText("Press 1 to play back. Press 2 to record again.", gTextColor);
+									currentState = RECORDED;
+								}
+							}
+							break;
 
-									// Start playaback
-									SDL_PauseAudioDevice(playbackDeviceId, SDL_FALSE);
+						// User is listening
+						case PLAYBACK:
+
+							// On key press
+							if (e.type == SDL_KEYDOWN) {
+
+								// Stop playback
+								if (e.key.keysym.sym == SDLK_1) {
+
+									// Stop playing audio before closing the file
+									SDL_PauseAudioDevice(playbackDeviceId, SDL_TRUE);
+									gPlayer.stop();
 
 									// Go on to next state
-									gPromptTexture.loadFromRenderedText("Playing...", gTextColor);
-									currentState = PLAYBACK;
+									gPromptTexture.loadFromRenderedText("Press 1 to play back. Press 2 to record again.", gTextColor);
+									currentState = RECORDED;
 								}
+							}
+							break;
 
-								// Record again
-								if (e.key.keysym.sym == SDLK_2) {
+						// User has finished recording
+						case RECORDED:
+
+							// On key press
+							if (e.type == SDL_KEYDOWN) {
+
+								// Start playback from disk
+								if (e.key.keysym.sym == SDLK_1 && gPlayer.start(RECORDING_PATH)) {
 
-									// Reset the buffer
-									gBufferBytePosition = 0;
-									memset(gRecordingBuffer, 0, gBufferByteSize);
+									// Nothing would drain the reader without a converter
+									if (!gConverter.init(gPlayer.getSpec(), gReceivedPlaybackSpec, gResampleQuality)) {
+										gPlayer.stop();
+									}
+									else {
+										// Start playaback
+										SDL_PauseAudioDevice(playbackDeviceId, SDL_FALSE);
+
+										// Go on to next state
+										gPromptTexture.loadFromRenderedText("Playing... Press 1 to stop.", gTextColor);
+										currentState = PLAYBACK;
+									}
+								}
+
+								// Record again over the previous file
+								if (e.key.keysym.sym == SDLK_2 && gRecorder.start(RECORDING_PATH, gReceivedRecordingSpec)) {
 
 									// Start recording
 									SDL_PauseAudioDevice(recordingDeviceId, SDL_FALSE);
 
 									// Go on to next state
-									gPromptTexture.loadFromRenderedText("Recording...", gTextColor);
+									gPromptTexture.loadFromRenderedText("Recording... Press 1 to stop.", gTextColor);
 									currentState = RECORDING;
 								}
 							}
@@ -634,41 +2003,32 @@ int main(int argc, char* args[])
 				// Updating recording
 				if (currentState == RECORDING) {
 
-					//Lock callback
-					SDL_LockAudioDevice(recordingDeviceId);
-
-					// Finished recording
-					if (gBufferBytePosition > gBufferByteMaxPosition) {
-
-						// Stop recording audio
-						SDL_PauseAudioDevice(recordingDeviceId, SDL_TRUE);
-
-						// Go on to next state
-						gPromptTexture.loadFromRenderedText("Press 1 to play back. Press 2 to record again.", gTextColor);
-						currentState = RECORDED;
+					// Show the recording length once a second
+					int seconds = (int)gRecorder.getSeconds();
+					if (seconds != recordedSeconds) {
+						std::stringstream recordingText;
+						recordingText << "Recording " << seconds / 60 << ":" << (seconds % 60 < 10 ? "0" : "") << seconds % 60;
+						if (gRecorder.getDroppedBytes() > 0) {
+							recordingText << " (" << gRecorder.getDroppedBytes() << " bytes dropped)";
+						}
+						recordingText << "... Press 1 to stop.";
+						gPromptTexture.loadFromRenderedText(recordingText.str().c_str(), gTextColor);
+						recordedSeconds = seconds;
 					}
-
-					// Unlock callback
-					SDL_UnlockAudioDevice(recordingDeviceId);
 				}
 				else if (currentState == PLAYBACK) {
 
-					// Lock callback
-					SDL_LockAudioDevice(playbackDeviceId);
-
-					// Finished playback
-					if (gBufferBytePosition > gBufferByteMaxPosition) {
+					// Finished playback, including what the converter held back
+					if (gPlayer.isFinished() && gConverter.isDrained()) {
 
 						// Stop playing audio
 						SDL_PauseAudioDevice(playbackDeviceId, SDL_TRUE);
+						gPlayer.stop();
 
 						// Go on to next state
 						gPromptTexture.loadFromRenderedText("Press 1 to play back. Press 2 to record again.", gTextColor);
 						currentState = RECORDED;
 					}
-
-					// Unlock callback
-					SDL_UnlockAudioDevice(playbackDeviceId);
 				}
 
 				//Clear screen
@@ -692,6 +2052,14 @@ int main(int argc, char* args[])
 				//Update screen
 				SDL_RenderPresent(gRenderer);
 			}
+
+			// Stop the callbacks before the recorder and player go away
+			if (recordingDeviceId != 0) {
+				SDL_CloseAudioDevice(recordingDeviceId);
+			}
+			if (playbackDeviceId != 0) {
+				SDL_CloseAudioDevice(playbackDeviceId);
+			}
 		}
 	}
 
@@ -5,8 +5,10 @@ and may not be redistributed without written permission.*/
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <sstream>
+#include <vector>
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -61,6 +63,15 @@ private:
 	int mHeight;
 };
 
+// Frame timing for one window
+struct WindowStats {
+	int frames;
+	int skipped;
+	double lastMs;
+	double averageMs;
+	double worstMs;
+};
+
 // Window wrapper class
 class LWindow {
 public:
@@ -71,16 +82,28 @@ public:
 	// Creates window
 	bool init();
 
-	// Creates rendered from internal window
-	SDL_Renderer* createRenderer();
+	// Creates renderer for the window, every later call on it has to come from the same thread
+	bool initRenderer();
+
+	// Destroys renderer, from the thread that created it
+	void freeRenderer();
 
 	// Focuses on window
 	void focus();
 
 
-	// Shows window content
+	// Shows window content if it changed and can be seen
 	void render();
 
+	// Flags the content as needing to be drawn again
+	void markDirty();
+
+	// Checks if the window can be seen and has changed
+	bool needsRender();
+
+	// Gets frame timing
+	WindowStats getStats();
+
 	// Handles window events
 	void handleEvent(SDL_Event& e);
 
@@ -114,6 +137,63 @@ private:
 	bool mFullScreen;
 	bool mMinimized;
 	bool mShown;
+
+	// Content changed since it was last shown
+	bool mDirty;
+
+	// Frame timing
+	WindowStats mStats;
+};
+
+// Renders windows that need it, each on its own thread so their presents wait on vsync together
+class LWindowManager {
+public:
+	// Initializes internals
+	LWindowManager();
+
+	// Stops render threads
+	~LWindowManager();
+
+	// Takes charge of windows, starting a render thread for each when threaded, which creates and owns the window's renderer
+	bool init(LWindow* windows, int count, bool threaded);
+
+	// Stops render threads
+	void free();
+
+	// Renders the windows that need it and waits for them to finish
+	void render();
+
+	// Checks if any window needs rendering
+	bool hasWork();
+
+	// Prints each window's frame timing
+	void printStats();
+
+private:
+	// Render thread for one window
+	struct Worker {
+		LWindowManager* manager;
+		LWindow* window;
+		SDL_Thread* thread;
+		SDL_sem* start;
+
+		// The thread made its window's renderer
+		bool ready;
+	};
+
+	// Render thread loop
+	static int renderThread(void* data);
+
+	// Managed windows
+	LWindow* mWindows;
+	int mCount;
+
+	// Render threads, empty when rendering on the main thread
+	std::vector<Worker> mWorkers;
+
+	// Workers post here when their window is shown
+	SDL_sem* mDone;
+	SDL_atomic_t mQuit;
 };
 
 //Starts up SDL and creates window
@@ -134,6 +214,9 @@ LTexture gSceneTexture;
 // Our custom windows
 LWindow gWindows[TOTAL_WINDOWS];
 
+// Renders the windows
+LWindowManager gWindowManager;
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -295,10 +378,37 @@ LWindow::LWindow() {
 	mWidth = 0;
 	mHeight = 0;
 	mWindowID = 0;
+	mDirty = false;
+	memset(&mStats, 0, sizeof(mStats));
 }
 
-SDL_Renderer* LWindow::createRenderer() {
-	return SDL_CreateRenderer(mWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+bool LWindow::initRenderer() {
+	// Nothing to draw into, or already done
+	if (mWindow == NULL) {
+		return false;
+	}
+	if (mRenderer != NULL) {
+		return true;
+	}
+
+	// Create renderer for window
+	mRenderer = SDL_CreateRenderer(mWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+	if (mRenderer == NULL) {
+		printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	// Initialize renderer color
+	SDL_SetRenderDrawColor(mRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+	mDirty = true;
+	return true;
+}
+
+void LWindow::freeRenderer() {
+	if (mRenderer != NULL) {
+		SDL_DestroyRenderer(mRenderer);
+		mRenderer = NULL;
+	}
 }
 
 void LWindow::handleEvent(SDL_Event& e) {
@@ -314,6 +424,7 @@ void LWindow::handleEvent(SDL_Event& e) {
 			// Window appeared
 		case SDL_WINDOWEVENT_SHOWN:
 			mShown = true;
+			mDirty = true;
 			break;
 
 			// Window dissapeared
@@ -325,12 +436,12 @@ void LWindow::handleEvent(SDL_Event& e) {
 		case SDL_WINDOWEVENT_SIZE_CHANGED:
 			mWidth = e.window.data1;
 			mHeight = e.window.data2;
-			SDL_RenderPresent(gRenderer);
+			mDirty = true;
 			break;
 
 			// Repaint on  exposure
 		case SDL_WINDOWEVENT_EXPOSED:
-			SDL_RenderPresent(gRenderer);
+			mDirty = true;
 			break;
 
 			// Mouse entered window
@@ -365,11 +476,13 @@ void LWindow::handleEvent(SDL_Event& e) {
 			// Window maximized
 		case SDL_WINDOWEVENT_MAXIMIZED:
 			mMinimized = false;
+			mDirty = true;
 			break;
 
 			// Window restored
 		case SDL_WINDOWEVENT_RESTORED:
 			mMinimized = false;
+			mDirty = true;
 			break;
 
 			// Hide on close
@@ -415,14 +528,41 @@ void LWindow::focus() {
 }
 
 void LWindow::render() {
-	if (!mMinimized) {
-		// Clear screen
-		SDL_SetRenderDrawColor(mRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-		SDL_RenderClear(mRenderer);
-
-		// Update screen
-		SDL_RenderPresent(mRenderer);
+	// Skip windows that can't be seen or haven't changed
+	if (!needsRender()) {
+		++mStats.skipped;
+		return;
+	}
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	// Clear screen
+	SDL_SetRenderDrawColor(mRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+	SDL_RenderClear(mRenderer);
+
+	// Update screen
+	SDL_RenderPresent(mRenderer);
+	mDirty = false;
+
+	// Time the frame, present included
+	double ms = (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	mStats.lastMs = ms;
+	mStats.averageMs = mStats.frames == 0 ? ms : mStats.averageMs * 0.9 + ms * 0.1;
+	if (ms > mStats.worstMs) {
+		mStats.worstMs = ms;
 	}
+	++mStats.frames;
+}
+
+void LWindow::markDirty() {
+	mDirty = true;
+}
+
+bool LWindow::needsRender() {
+	return mRenderer != NULL && mShown && !mMinimized && mDirty;
+}
+
+WindowStats LWindow::getStats() {
+	return mStats;
 }
 
 int LWindow::getWidth() {
@@ -459,44 +599,180 @@ bool LWindow::init() {
 		mWidth = SCREEN_WIDTH;
 		mHeight = SCREEN_HEIGHT;
 
-		// Create renderer for window
-		mRenderer = SDL_CreateRenderer(mWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-		if (mRenderer == NULL) {
-			printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
-			SDL_DestroyWindow(mWindow);
-			mWindow == NULL;
-		}
-		else {
-			// Initialize renderer color
-			SDL_SetRenderDrawColor(mRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-
-			// Grab window identifier
-			mWindowID = SDL_GetWindowID(mWindow);
-
-			// Flag as opened
-			mShown = true;
+		// Grab window identifier
+		mWindowID = SDL_GetWindowID(mWindow);
 
-		}
+		// Flag as opened, the renderer comes from whichever thread draws the window
+		mShown = true;
+		mDirty = true;
 	}
 	else {
 		printf("Window could not be created! SDL Error: %s\n", SDL_GetError());
 	}
 
 
-	return mWindow != NULL && mRenderer!= NULL;
+	return mWindow != NULL;
 }
 
 void LWindow::free() {
+	freeRenderer();
 	if (mWindow != NULL)
 	{
 		SDL_DestroyWindow(mWindow);
+		mWindow = NULL;
 	}
+	mShown = false;
+	mDirty = false;
 
 	mMouseFocus = false;
 	mKeyboardFocus = false;
 	mWidth = 0;
 	mHeight = 0;
 }
+LWindowManager::LWindowManager() {
+	// Initialize
+	mWindows = NULL;
+	mCount = 0;
+	mDone = NULL;
+	SDL_AtomicSet(&mQuit, 0);
+}
+
+LWindowManager::~LWindowManager() {
+	// Deallocate
+	free();
+}
+
+bool LWindowManager::init(LWindow* windows, int count, bool threaded) {
+	// Stop preexisting threads
+	free();
+	mWindows = windows;
+	mCount = count;
+	if (!threaded) {
+		// Renderers belong to this thread
+		for (int i = 0; i < count; ++i) {
+			windows[i].initRenderer();
+		}
+		return true;
+	}
+
+	// One render thread per window
+	SDL_AtomicSet(&mQuit, 0);
+	mDone = SDL_CreateSemaphore(0);
+	if (mDone == NULL) {
+		printf("Unable to create semaphore! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	mWorkers.resize(count);
+	for (int i = 0; i < count; ++i) {
+		mWorkers[i].manager = this;
+		mWorkers[i].window = &windows[i];
+		mWorkers[i].start = SDL_CreateSemaphore(0);
+		mWorkers[i].ready = false;
+		mWorkers[i].thread = mWorkers[i].start != NULL ? SDL_CreateThread(renderThread, "Window renderer", &mWorkers[i]) : NULL;
+		if (mWorkers[i].thread == NULL) {
+			printf("Unable to start window renderer! SDL Error: %s\n", SDL_GetError());
+			mWorkers.resize(i + 1);
+			free();
+			return false;
+		}
+	}
+
+	// Wait for every thread to make its renderer
+	bool ready = true;
+	for (int i = 0; i < count; ++i) {
+		SDL_SemWait(mDone);
+	}
+	for (int i = 0; i < count; ++i) {
+		ready = ready && mWorkers[i].ready;
+	}
+	if (!ready) {
+		printf("Unable to create renderers on render threads!\n");
+		free();
+	}
+	return ready;
+}
+
+void LWindowManager::free() {
+	// Wake every render thread to quit, each destroys its own renderer
+	SDL_AtomicSet(&mQuit, 1);
+	for (size_t i = 0; i < mWorkers.size(); ++i) {
+		if (mWorkers[i].thread != NULL) {
+			SDL_SemPost(mWorkers[i].start);
+			SDL_WaitThread(mWorkers[i].thread, NULL);
+		}
+		if (mWorkers[i].start != NULL) {
+			SDL_DestroySemaphore(mWorkers[i].start);
+		}
+	}
+	mWorkers.clear();
+	if (mDone != NULL) {
+		SDL_DestroySemaphore(mDone);
+		mDone = NULL;
+	}
+}
+
+void LWindowManager::render() {
+	// Render on this thread when there are no workers
+	if (mWorkers.empty()) {
+		for (int i = 0; i < mCount; ++i) {
+			mWindows[i].render();
+		}
+		return;
+	}
+
+	// Hand each window that needs it to its thread, then wait for them all
+	int started = 0;
+	for (int i = 0; i < mCount; ++i) {
+		if (mWindows[i].needsRender()) {
+			SDL_SemPost(mWorkers[i].start);
+			++started;
+		}
+		else {
+			mWindows[i].render();
+		}
+	}
+	for (int i = 0; i < started; ++i) {
+		SDL_SemWait(mDone);
+	}
+}
+
+bool LWindowManager::hasWork() {
+	for (int i = 0; i < mCount; ++i) {
+		if (mWindows[i].needsRender()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void LWindowManager::printStats() {
+	for (int i = 0; i < mCount; ++i) {
+		WindowStats stats = mWindows[i].getStats();
+		printf("Window %d: %d frames, %d skipped, last %.2f ms, average %.2f ms, worst %.2f ms\n", i + 1, stats.frames, stats.skipped, stats.lastMs, stats.averageMs, stats.worstMs);
+	}
+}
+
+int LWindowManager::renderThread(void* data) {
+	Worker* worker = (Worker*)data;
+	LWindowManager* manager = worker->manager;
+
+	// The renderer is made, used and destroyed only here
+	worker->ready = worker->window->initRenderer();
+	SDL_SemPost(manager->mDone);
+
+	// Render the window each time it's handed over
+	while (true) {
+		SDL_SemWait(worker->start);
+		if (SDL_AtomicGet(&manager->mQuit)) {
+			break;
+		}
+		worker->window->render();
+		SDL_SemPost(manager->mDone);
+	}
+	worker->window->freeRenderer();
+	return 0;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -529,6 +805,9 @@ bool init()
 
 void close()
 {
+	// Stop render threads
+	gWindowManager.free();
+
 	//Destroy windows	
 	SDL_DestroyRenderer(gRenderer);
 	for (int i = 0; i < TOTAL_WINDOWS; i++) {
@@ -551,6 +830,16 @@ int main(int argc, char* args[])
 		for (int i = 1; i < TOTAL_WINDOWS; i++) {
 			gWindows[i].init();
 		}
+
+		// Render windows in parallel unless asked not to, macOS wants rendering on the main thread
+		bool threaded = !(argc > 1 && strcmp(args[1], "--serial") == 0);
+#if defined(__APPLE__)
+		threaded = false;
+#endif
+		// Renderers are made on the threads that draw with them
+		if (!gWindowManager.init(gWindows, TOTAL_WINDOWS, threaded)) {
+			gWindowManager.init(gWindows, TOTAL_WINDOWS, false);
+		}
 					//Main loop flag
 		bool quit = false;
 					//Event handler
@@ -558,6 +847,11 @@ int main(int argc, char* args[])
 					//While application is running
 		while (!quit)
 		{
+			// Sleep until something happens when no window needs rendering
+			if (!gWindowManager.hasWork()) {
+				SDL_WaitEvent(NULL);
+			}
+
 			//Handle events on queue
 			while (SDL_PollEvent(&e) != 0)
 			{
@@ -585,14 +879,17 @@ int main(int argc, char* args[])
 					case SDLK_3:
 						gWindows[2].focus();
 						break;
+
+					// Show frame timing
+					case SDLK_s:
+						gWindowManager.printStats();
+						break;
 					}
 				}
 			}
 
-			// Update all windows
-			for (int i = 0; i < TOTAL_WINDOWS; i++) {
-				gWindows[i].render();
-			}
+			// Update windows that changed
+			gWindowManager.render();
 
 			// Check all windows
 			bool allWindowsClosed = true;
@@ -1,6 +1,7 @@
 //Using SDL, standard IO, strings, and string streams
 #include <SDL.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <sstream>
 
@@ -8,6 +9,46 @@
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+//Frame rate used when a display doesn't report its refresh rate
+const int DEFAULT_REFRESH_RATE = 60;
+
+//How close to the deadline the pacer stops sleeping and starts spinning
+const Uint64 PACER_SPIN_MICROSECONDS = 2000;
+
+//Holds frames to a target rate on the performance counter, sleeping most of the wait and spinning the rest
+class LFramePacer
+{
+	public:
+		//Initializes variables
+		LFramePacer();
+
+		//Sets the frame rate to pace to, 0 turns pacing off
+		void setTargetRate( int framesPerSecond );
+
+		//Matches the target to the refresh rate of a display, returns false if it is unknown
+		bool setTargetFromDisplay( int display );
+
+		//Gets the frame rate being paced to
+		int getTargetRate();
+
+		//Starts timing frames from now
+		void start();
+
+		//Waits until the next frame is due
+		void wait();
+
+	private:
+		//Performance counter ticks per second and per frame
+		Uint64 mFrequency;
+		Uint64 mFrameTicks;
+
+		//When the next frame is due
+		Uint64 mDeadline;
+
+		//The frame rate being paced to
+		int mTargetRate;
+};
+
 class LWindow
 {
 	public:
@@ -26,6 +67,9 @@ class LWindow
 		//Shows windows contents
 		void render();
 
+		//Paces frames to the refresh rate of the window's display
+		void retarget();
+
 		//Deallocates internals
 		void free();
 
@@ -46,6 +90,10 @@ class LWindow
 		int mWindowID;
 		int mWindowDisplayID;
 
+		//Frame pacing for the current display
+		LFramePacer mPacer;
+		int mPacerDisplayID;
+
 		//Window dimensions
 		int mWidth;
 		int mHeight;
@@ -71,6 +119,84 @@ LWindow gWindow;
 int gTotalDisplays = 0;
 SDL_Rect* gDisplayBounds = NULL; 
 
+//Present on vsync instead of pacing frames ourselves
+bool gVSync = false;
+
+LFramePacer::LFramePacer()
+{
+	//Initialize the variables
+	mFrequency = SDL_GetPerformanceFrequency();
+	mFrameTicks = 0;
+	mDeadline = 0;
+	mTargetRate = 0;
+}
+
+void LFramePacer::setTargetRate( int framesPerSecond )
+{
+	mTargetRate = framesPerSecond > 0 ? framesPerSecond : 0;
+	mFrameTicks = mTargetRate > 0 ? mFrequency / mTargetRate : 0;
+
+	//Time the new rate from now
+	start();
+}
+
+bool LFramePacer::setTargetFromDisplay( int display )
+{
+	//Get the display's current mode
+	SDL_DisplayMode mode;
+	if( display < 0 || SDL_GetCurrentDisplayMode( display, &mode ) != 0 || mode.refresh_rate <= 0 )
+	{
+		return false;
+	}
+
+	//Only retime if the rate actually changed
+	if( mode.refresh_rate != mTargetRate )
+	{
+		setTargetRate( mode.refresh_rate );
+	}
+	return true;
+}
+
+int LFramePacer::getTargetRate()
+{
+	return mTargetRate;
+}
+
+void LFramePacer::start()
+{
+	mDeadline = SDL_GetPerformanceCounter() + mFrameTicks;
+}
+
+void LFramePacer::wait()
+{
+	//Pacing is off
+	if( mFrameTicks == 0 )
+	{
+		return;
+	}
+
+	//Sleep off whole milliseconds while the deadline is comfortably far away
+	Uint64 spinTicks = mFrequency * PACER_SPIN_MICROSECONDS / 1000000;
+	Uint64 now = SDL_GetPerformanceCounter();
+	if( now + spinTicks < mDeadline )
+	{
+		SDL_Delay( (Uint32)( ( mDeadline - now - spinTicks ) * 1000 / mFrequency ) );
+	}
+
+	//Spin out the rest, sleep can't be trusted to wake on time
+	while( now < mDeadline )
+	{
+		now = SDL_GetPerformanceCounter();
+	}
+
+	//Schedule from the deadline so rounding doesn't drift, unless we fell a whole frame behind
+	mDeadline += mFrameTicks;
+	if( now >= mDeadline )
+	{
+		mDeadline = now + mFrameTicks;
+	}
+}
+
 LWindow::LWindow()
 {
 	//Initialize non-existant window
@@ -80,9 +206,11 @@ LWindow::LWindow()
 	mMouseFocus = false;
 	mKeyboardFocus = false;
 	mFullScreen = false;
+	mMinimized = false;
 	mShown = false;
 	mWindowID = -1;
 	mWindowDisplayID = -1;
+	mPacerDisplayID = -1;
 	
 	mWidth = 0;
 	mHeight = 0;
@@ -99,8 +227,8 @@ bool LWindow::init()
 		mWidth = SCREEN_WIDTH;
 		mHeight = SCREEN_HEIGHT;
 
-		//Create renderer for window
-		mRenderer = SDL_CreateRenderer( mWindow, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC );
+		//Create renderer for window, leaving vsync off if we pace frames ourselves
+		mRenderer = SDL_CreateRenderer( mWindow, -1, gVSync ? SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC : SDL_RENDERER_ACCELERATED );
 		if( mRenderer == NULL )
 		{
 			printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
@@ -116,6 +244,9 @@ bool LWindow::init()
 			mWindowID = SDL_GetWindowID( mWindow );
 			mWindowDisplayID = SDL_GetWindowDisplayIndex( mWindow );
 
+			//Pace to the display we opened on
+			retarget();
+
 			//Flag as opened
 			mShown = true;
 		}
@@ -141,9 +272,22 @@ void LWindow::handleEvent( SDL_Event& e )
 			//Window moved
 			case SDL_WINDOWEVENT_MOVED:
 			mWindowDisplayID = SDL_GetWindowDisplayIndex( mWindow );
+			if( mWindowDisplayID != mPacerDisplayID )
+			{
+				retarget();
+			}
 			updateCaption = true;
 			break;
 
+#if SDL_VERSION_ATLEAST( 2, 0, 18 )
+			//Window moved onto another display
+			case SDL_WINDOWEVENT_DISPLAY_CHANGED:
+			mWindowDisplayID = e.window.data1;
+			retarget();
+			updateCaption = true;
+			break;
+#endif
+
 			//Window appeared
 			case SDL_WINDOWEVENT_SHOWN:
 			mShown = true;
@@ -253,7 +397,7 @@ void LWindow::handleEvent( SDL_Event& e )
 	if( updateCaption )
 	{
 		std::stringstream caption;
-		caption << "SDL Tutorial - ID: " << mWindowID << " Display: " << mWindowDisplayID << " MouseFocus:" << ( ( mMouseFocus ) ? "On" : "Off" ) << " KeyboardFocus:" << ( ( mKeyboardFocus ) ? "On" : "Off" );
+		caption << "SDL Tutorial - ID: " << mWindowID << " Display: " << mWindowDisplayID << " Rate: " << mPacer.getTargetRate() << "Hz MouseFocus:" << ( ( mMouseFocus ) ? "On" : "Off" ) << " KeyboardFocus:" << ( ( mKeyboardFocus ) ? "On" : "Off" );
 		SDL_SetWindowTitle( mWindow, caption.str().c_str() );
 	}
 }
@@ -278,9 +422,31 @@ void LWindow::render()
 		SDL_SetRenderDrawColor( mRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
 		SDL_RenderClear( mRenderer );
 
-		//Update screen
+		//Wait out the rest of the frame then update screen
+		mPacer.wait();
 		SDL_RenderPresent( mRenderer );
 	}
+	else
+	{
+		//Don't spin the loop while there is nothing to show
+		mPacer.wait();
+	}
+}
+
+void LWindow::retarget()
+{
+	//Remember which display the pacer follows
+	mPacerDisplayID = mWindowDisplayID;
+
+	//Vsync already holds presents to the display
+	if( gVSync )
+	{
+		mPacer.setTargetRate( 0 );
+	}
+	else if( !mPacer.setTargetFromDisplay( mWindowDisplayID ) )
+	{
+		mPacer.setTargetRate( DEFAULT_REFRESH_RATE );
+	}
 }
 
 void LWindow::free()
@@ -385,6 +551,12 @@ void close()
 
 int main( int argc, char* args[] )
 {
+	//Let the driver pace presents instead
+	if( argc > 1 && strcmp( args[ 1 ], "--vsync" ) == 0 )
+	{
+		gVSync = true;
+	}
+
 	//Start up SDL and create window
 	if( !init() )
 	{
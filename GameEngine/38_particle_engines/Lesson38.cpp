@@ -5,8 +5,18 @@ and may not be redistributed without written permission.*/
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -15,6 +25,30 @@ const int SCREEN_HEIGHT = 480;
 // Particle count
 const int TOTAL_PARTICLES = 100;
 
+// Particles live this many frames of a 60 frame a second animation, shimmering every other one
+const int PARTICLE_FRAMES = 11;
+const Uint32 PARTICLE_FRAME_MS = 16;
+
+// Marks an animation slot that isn't playing
+const Uint16 ANIMATION_STOPPED = 0xFFFF;
+
+// Packed assets, loose files are used when there is no archive
+const char* ARCHIVE_PATH = "38_particle_engines/assets.pak";
+
+// Archive identifier "LPAK" and format version
+const Uint32 ARCHIVE_MAGIC = 0x4B41504C;
+const Uint32 ARCHIVE_VERSION = 1;
+
+// Header is magic, version, slot count and file count, each table slot is hash, name offset, name length, data offset, data size and a spare word
+const int ARCHIVE_HEADER_BYTES = 16;
+const int ARCHIVE_SLOT_BYTES = 24;
+
+// File data starts on this boundary so loaders can read it in place
+const int ARCHIVE_ALIGNMENT = 16;
+
+// Times each loader is run by the benchmark
+const int BENCHMARK_ROUNDS = 200;
+
 //Texture wrapper class
 class LTexture
 {
@@ -116,12 +150,71 @@ private:
 	bool mShown;
 };
 
+// A run of frames in the shared frame table, each shown for the same time
+struct AnimationClip {
+	int firstFrame;
+	int frameCount;
+	Uint32 frameMs;
+	Uint32 duration;
+	bool loop;
+};
+
+// Time based sprite animation, clips are shared and every playhead is advanced in one pass
+class LAnimationSystem {
+public:
+	// Initializes variables
+	LAnimationSystem();
+
+	// Adds a clip of frames shown for frameMs each, returns the clip's id or -1 if it is empty
+	int addClip(SDL_Rect* frames, int count, Uint32 frameMs, bool loop);
+
+	// Starts playing a clip some way in, returns the animation's id
+	int play(int clip, Uint32 offsetMs);
+
+	// Stops an animation so its id can be reused
+	void stop(int animation);
+
+	// Advances every playing animation
+	void update(Uint32 elapsedMs);
+
+	// Gets the frame an animation is showing
+	SDL_Rect* getFrame(int animation);
+
+	// Gets how far into its clip an animation is in frames
+	int getFrameIndex(int animation);
+
+	// Checks if an animation that doesn't loop has played through
+	bool isFinished(int animation);
+
+	// Gets the number of playing animations
+	int getPlayingCount();
+
+	// Removes every clip and animation
+	void clear();
+
+private:
+	// Frames of every clip, back to back
+	std::vector<SDL_Rect> mFrames;
+	std::vector<AnimationClip> mClips;
+
+	// Playheads, one entry per animation in each array
+	std::vector<Uint16> mClip;
+	std::vector<Uint32> mTime;
+	std::vector<Uint32> mFrame;
+
+	// Ids of stopped animations, free for reuse
+	std::vector<int> mFreeIds;
+};
+
 // Particle wrapper class
 class Particle {
 public:
 	// Initialize position and animation
 	Particle(int x, int y);
 
+	// Stops the animation
+	~Particle();
+
 	// Shows the particle
 	void render();
 
@@ -132,8 +225,8 @@ private:
 	// Offsets
 	int mPosX, mPosY;
 
-	// Current frame of animation
-	int mFrame;
+	// Shimmer animation
+	int mAnimation;
 
 	// Type of particle
 	LTexture* mTexture;
@@ -168,6 +261,9 @@ private:
 	// The particles
 	Particle* particles[TOTAL_PARTICLES];
 
+	// Replaces dead particles
+	void updateParticles();
+
 	// Shows the particles
 	void renderParticles();
 
@@ -178,6 +274,54 @@ private:
 	int mVelX, mVelY;
 };
 
+// Read only archive of packed files, memory mapped and handed out as zero copy SDL_RWops
+class LAssetArchive {
+public:
+	// Initializes variables
+	LAssetArchive();
+
+	// Unmaps the archive
+	~LAssetArchive();
+
+	// Bundles files into an archive, each stored under the path it was given
+	static bool pack(std::string archivePath, const std::vector<std::string>& paths);
+
+	// Maps an archive into memory
+	bool open(std::string path);
+
+	// Unmaps the archive, views handed out must be closed before this
+	void close();
+
+	// Gets a read only view of a packed file, NULL if it isn't in the archive
+	SDL_RWops* openRW(std::string path);
+
+	// Checks if an archive is open
+	bool isOpen();
+
+	// Gets the number of packed files
+	int getFileCount();
+
+private:
+	// Finds a packed file through the hashed table of contents
+	const Uint8* find(std::string path, Uint32* size);
+
+	// Hashes a path with slashes made consistent
+	static Uint32 hashPath(const std::string& path);
+
+	// Archive bytes
+	const Uint8* mData;
+	size_t mSize;
+	Uint32 mSlotCount;
+	Uint32 mFileCount;
+
+	// How the bytes were obtained, so they can be released the same way
+#ifdef _WIN32
+	HANDLE mFile;
+	HANDLE mMapping;
+#endif
+	bool mMapped;
+};
+
 //Starts up SDL and creates window
 bool init();
 
@@ -187,6 +331,12 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+// Packs the lesson's assets into the archive
+bool packAssets(int count, char* paths[]);
+
+// Times decoding the lesson's images from loose files and from the archive
+void runArchiveBenchmark();
+
 // The window
 SDL_Window* gWindow = NULL;
 
@@ -205,6 +355,17 @@ LTexture gShimmerTexture;
 // Dot texture
 LTexture gDotTexture;
 
+// Particle shimmer, advanced once a tick for every particle
+LAnimationSystem gParticleAnimations;
+int gShimmerClip = 0;
+
+// Images the lesson loads
+const char* gAssetPaths[] = { "38_particle_engines/dot.bmp", "38_particle_engines/red.bmp", "38_particle_engines/green.bmp", "38_particle_engines/blue.bmp", "38_particle_engines/shimmer.bmp" };
+const int TOTAL_ASSETS = sizeof(gAssetPaths) / sizeof(gAssetPaths[0]);
+
+// Packed assets
+LAssetArchive gAssets;
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -227,8 +388,9 @@ bool LTexture::loadFromFile(std::string path)
 	//The final texture
 	SDL_Texture* newTexture = NULL;
 
-	//Load image at specified path
-	SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+	//Load image at specified path, straight from the archive when it's packed
+	SDL_RWops* asset = gAssets.openRW(path);
+	SDL_Surface* loadedSurface = asset != NULL ? IMG_Load_RW(asset, 1) : IMG_Load(path.c_str());
 	if (loadedSurface == NULL)
 	{
 		printf("Unable to load image %s! SDL_image Error: %s\n", path.c_str(), IMG_GetError());
@@ -575,7 +737,7 @@ Particle::Particle(int x, int y) {
 	mPosY = y - 5 + (rand() % 25);
 
 	// Initializes animation
-	mFrame = rand() % 5;
+	mAnimation = gParticleAnimations.play(gShimmerClip, (rand() % 5) * PARTICLE_FRAME_MS);
 
 	// Set type
 	switch (rand() % 3) {
@@ -585,21 +747,24 @@ Particle::Particle(int x, int y) {
 	}
 }
 
+Particle::~Particle() {
+	// Free the animation slot
+	gParticleAnimations.stop(mAnimation);
+}
+
 void Particle::render() {
 	// Show image
 	mTexture->render(mPosX, mPosY);
 
-	// Show shimmer
-	if (mFrame % 2 == 0) {
-		gShimmerTexture.render(mPosX, mPosY);
+	// Show shimmer on the frames that have it
+	SDL_Rect* shimmer = gParticleAnimations.getFrame(mAnimation);
+	if (shimmer->w > 0) {
+		gShimmerTexture.render(mPosX, mPosY, shimmer);
 	}
-
-	// Animate
-	mFrame++;
 }
 
 bool Particle::isDead() {
-	return mFrame > 10;
+	return gParticleAnimations.isFinished(mAnimation);
 }
 
 Dot::Dot() {
@@ -632,7 +797,7 @@ void Dot::render() {
 	renderParticles();
 }
 
-void Dot::renderParticles() {
+void Dot::updateParticles() {
 	// Go through particles
 	for (int i = 0; i < TOTAL_PARTICLES; i++) {
 		// Delete and replace dead particles
@@ -641,7 +806,9 @@ void Dot::renderParticles() {
 			particles[i] = new Particle(mPosX, mPosY);
 		}
 	}
+}
 
+void Dot::renderParticles() {
 	// Show particles
 	for (int i = 0; i < TOTAL_PARTICLES; i++) {
 		particles[i]->render();
@@ -697,6 +864,435 @@ void Dot::move()
 		//Move back
 		mPosY -= mVelY;
 	}
+
+	// Respawn the particles that finished around the new position
+	updateParticles();
+}
+
+LAnimationSystem::LAnimationSystem() {
+	// Nothing playing yet
+	clear();
+}
+
+int LAnimationSystem::addClip(SDL_Rect* frames, int count, Uint32 frameMs, bool loop) {
+	// A clip needs frames and time to show them, playheads wrap around its duration
+	if (frames == NULL || count <= 0 || frameMs == 0) {
+		printf("Unable to add animation clip of %d frames at %u ms!\n", count, frameMs);
+		return -1;
+	}
+
+	// Copy the frames into the shared table
+	AnimationClip clip;
+	clip.firstFrame = (int)mFrames.size();
+	clip.frameCount = count;
+	clip.frameMs = frameMs;
+	clip.duration = clip.frameMs * count;
+	clip.loop = loop;
+	mFrames.insert(mFrames.end(), frames, frames + count);
+	mClips.push_back(clip);
+	return (int)mClips.size() - 1;
+}
+
+int LAnimationSystem::play(int clip, Uint32 offsetMs) {
+	// Reuse a stopped animation's slot when there is one
+	int animation;
+	if (!mFreeIds.empty()) {
+		animation = mFreeIds.back();
+		mFreeIds.pop_back();
+	}
+	else {
+		animation = (int)mClip.size();
+		mClip.push_back(0);
+		mTime.push_back(0);
+		mFrame.push_back(0);
+	}
+
+	// Start at the offset, which update works out the frame for
+	mClip[animation] = (Uint16)clip;
+	mTime[animation] = 0;
+	mFrame[animation] = mClips[clip].firstFrame;
+	if (offsetMs > 0) {
+		AnimationClip& playing = mClips[clip];
+		Uint32 time = playing.loop ? offsetMs % playing.duration : SDL_min(offsetMs, playing.duration);
+		mTime[animation] = time;
+		mFrame[animation] = playing.firstFrame + SDL_min(time / playing.frameMs, (Uint32)playing.frameCount - 1);
+	}
+	return animation;
+}
+
+void LAnimationSystem::stop(int animation) {
+	if (mClip[animation] != ANIMATION_STOPPED) {
+		mClip[animation] = ANIMATION_STOPPED;
+		mFreeIds.push_back(animation);
+	}
+}
+
+void LAnimationSystem::update(Uint32 elapsedMs) {
+	// One tight pass over the playheads, no per sprite calls
+	Uint16* clips = mClip.empty() ? NULL : &mClip[0];
+	Uint32* times = mTime.empty() ? NULL : &mTime[0];
+	Uint32* frames = mFrame.empty() ? NULL : &mFrame[0];
+	int count = (int)mClip.size();
+	for (int i = 0; i < count; ++i) {
+		if (clips[i] == ANIMATION_STOPPED) {
+			continue;
+		}
+		const AnimationClip& clip = mClips[clips[i]];
+
+		// Wrap looping clips, hold the others on their last frame
+		Uint32 time = times[i] + elapsedMs;
+		if (time >= clip.duration) {
+			time = clip.loop ? time % clip.duration : clip.duration;
+		}
+		times[i] = time;
+
+		Uint32 frame = time / clip.frameMs;
+		frames[i] = clip.firstFrame + (frame < (Uint32)clip.frameCount ? frame : clip.frameCount - 1);
+	}
+}
+
+SDL_Rect* LAnimationSystem::getFrame(int animation) {
+	return &mFrames[mFrame[animation]];
+}
+
+int LAnimationSystem::getFrameIndex(int animation) {
+	// Stopped animations have no clip to count from
+	if (mClip[animation] == ANIMATION_STOPPED) {
+		return 0;
+	}
+	return (int)mFrame[animation] - mClips[mClip[animation]].firstFrame;
+}
+
+bool LAnimationSystem::isFinished(int animation) {
+	if (mClip[animation] == ANIMATION_STOPPED) {
+		return true;
+	}
+	const AnimationClip& clip = mClips[mClip[animation]];
+	return !clip.loop && mTime[animation] >= clip.duration;
+}
+
+int LAnimationSystem::getPlayingCount() {
+	return (int)(mClip.size() - mFreeIds.size());
+}
+
+void LAnimationSystem::clear() {
+	mFrames.clear();
+	mClips.clear();
+	mClip.clear();
+	mTime.clear();
+	mFrame.clear();
+	mFreeIds.clear();
+}
+
+LAssetArchive::LAssetArchive() {
+	// Initialize
+	mData = NULL;
+	mSize = 0;
+	mSlotCount = 0;
+	mFileCount = 0;
+#ifdef _WIN32
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = NULL;
+#endif
+	mMapped = false;
+}
+
+LAssetArchive::~LAssetArchive() {
+	// Deallocate
+	close();
+}
+
+bool LAssetArchive::pack(std::string archivePath, const std::vector<std::string>& paths) {
+	// Open addressed table at most half full, so lookups rarely probe more than once
+	Uint32 slotCount = 1;
+	while (slotCount < paths.size() * 2) {
+		slotCount <<= 1;
+	}
+	std::vector<Uint8> table(slotCount * ARCHIVE_SLOT_BYTES, 0);
+	std::vector<Uint8> names;
+	std::vector<Uint8> data;
+	std::vector<Uint32> dataOffsets;
+
+	for (size_t i = 0; i < paths.size(); ++i) {
+		// Read the file
+		SDL_RWops* file = SDL_RWFromFile(paths[i].c_str(), "rb");
+		if (file == NULL) {
+			printf("Unable to open %s! SDL Error: %s\n", paths[i].c_str(), SDL_GetError());
+			return false;
+		}
+		Sint64 size = SDL_RWsize(file);
+		while (data.size() % ARCHIVE_ALIGNMENT != 0) {
+			data.push_back(0);
+		}
+		size_t offset = data.size();
+		data.resize(offset + (size_t)(size > 0 ? size : 0));
+		bool read = size <= 0 || SDL_RWread(file, &data[offset], (size_t)size, 1) == 1;
+		SDL_RWclose(file);
+		if (!read) {
+			printf("Unable to read %s! SDL Error: %s\n", paths[i].c_str(), SDL_GetError());
+			return false;
+		}
+
+		// Claim the first free slot after the path's hash
+		std::string name = paths[i];
+		for (size_t c = 0; c < name.size(); ++c) {
+			name[c] = name[c] == '\\' ? '/' : name[c];
+		}
+		Uint32 hash = hashPath(name);
+		Uint32 slot = hash & (slotCount - 1);
+		Uint32 entry[6];
+		memcpy(entry, &table[slot * ARCHIVE_SLOT_BYTES], sizeof(entry));
+		while (entry[2] != 0) {
+			slot = (slot + 1) & (slotCount - 1);
+			memcpy(entry, &table[slot * ARCHIVE_SLOT_BYTES], sizeof(entry));
+		}
+
+		// Data offsets are fixed up once the table and names size is known
+		entry[0] = SDL_SwapLE32(hash);
+		entry[1] = SDL_SwapLE32((Uint32)names.size());
+		entry[2] = SDL_SwapLE32((Uint32)name.size());
+		entry[3] = (Uint32)offset;
+		entry[4] = SDL_SwapLE32((Uint32)(size > 0 ? size : 0));
+		entry[5] = 0;
+		memcpy(&table[slot * ARCHIVE_SLOT_BYTES], entry, sizeof(entry));
+		names.insert(names.end(), name.begin(), name.end());
+	}
+
+	// Names follow the table, then the aligned data
+	Uint32 namesOffset = ARCHIVE_HEADER_BYTES + slotCount * ARCHIVE_SLOT_BYTES;
+	Uint32 dataStart = namesOffset + (Uint32)names.size();
+	dataStart = (dataStart + ARCHIVE_ALIGNMENT - 1) / ARCHIVE_ALIGNMENT * ARCHIVE_ALIGNMENT;
+	for (Uint32 slot = 0; slot < slotCount; ++slot) {
+		Uint32 entry[6];
+		memcpy(entry, &table[slot * ARCHIVE_SLOT_BYTES], sizeof(entry));
+		if (entry[2] != 0) {
+			entry[1] = SDL_SwapLE32(SDL_SwapLE32(entry[1]) + namesOffset);
+			entry[3] = SDL_SwapLE32(entry[3] + dataStart);
+			memcpy(&table[slot * ARCHIVE_SLOT_BYTES], entry, sizeof(entry));
+		}
+	}
+
+	// Write it all out
+	SDL_RWops* archive = SDL_RWFromFile(archivePath.c_str(), "wb");
+	if (archive == NULL) {
+		printf("Unable to create %s! SDL Error: %s\n", archivePath.c_str(), SDL_GetError());
+		return false;
+	}
+	Uint32 header[4] = { SDL_SwapLE32(ARCHIVE_MAGIC), SDL_SwapLE32(ARCHIVE_VERSION), SDL_SwapLE32(slotCount), SDL_SwapLE32((Uint32)paths.size()) };
+	std::vector<Uint8> padding(dataStart - namesOffset - names.size(), 0);
+	bool written = SDL_RWwrite(archive, header, sizeof(header), 1) == 1;
+	written = written && SDL_RWwrite(archive, &table[0], table.size(), 1) == 1;
+	written = written && (names.empty() || SDL_RWwrite(archive, &names[0], names.size(), 1) == 1);
+	written = written && (padding.empty() || SDL_RWwrite(archive, &padding[0], padding.size(), 1) == 1);
+	written = written && (data.empty() || SDL_RWwrite(archive, &data[0], data.size(), 1) == 1);
+	if (SDL_RWclose(archive) != 0 || !written) {
+		printf("Unable to write %s! SDL Error: %s\n", archivePath.c_str(), SDL_GetError());
+		return false;
+	}
+	return true;
+}
+
+bool LAssetArchive::open(std::string path) {
+	// Get rid of a previous archive
+	close();
+
+#ifdef _WIN32
+	// Map the whole file read only
+	mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(mFile, &size);
+	mSize = (size_t)size.QuadPart;
+	mMapping = mSize > 0 ? CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	mData = mMapping != NULL ? (const Uint8*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+	mMapped = mData != NULL;
+#else
+	// Map the whole file read only, the mapping outlives the descriptor
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+	struct stat info;
+	if (fstat(file, &info) == 0 && info.st_size > 0) {
+		mSize = (size_t)info.st_size;
+		void* mapping = mmap(NULL, mSize, PROT_READ, MAP_PRIVATE, file, 0);
+		mData = mapping != MAP_FAILED ? (const Uint8*)mapping : NULL;
+		mMapped = mData != NULL;
+	}
+	::close(file);
+#endif
+
+	// Without mapping support read it into memory instead
+	if (mData == NULL) {
+		close();
+		SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+		if (file == NULL) {
+			return false;
+		}
+		Sint64 size = SDL_RWsize(file);
+		Uint8* data = size > 0 ? new Uint8[(size_t)size] : NULL;
+		if (data != NULL && SDL_RWread(file, data, (size_t)size, 1) != 1) {
+			delete[] data;
+			data = NULL;
+		}
+		SDL_RWclose(file);
+		if (data == NULL) {
+			return false;
+		}
+		mData = data;
+		mSize = (size_t)size;
+	}
+
+	// Check the header and that the table fits
+	Uint32 header[4] = { 0, 0, 0, 0 };
+	if (mSize >= (size_t)ARCHIVE_HEADER_BYTES) {
+		memcpy(header, mData, sizeof(header));
+	}
+	mSlotCount = SDL_SwapLE32(header[2]);
+	mFileCount = SDL_SwapLE32(header[3]);
+	if (SDL_SwapLE32(header[0]) != ARCHIVE_MAGIC || SDL_SwapLE32(header[1]) != ARCHIVE_VERSION || mSlotCount == 0 || (mSlotCount & (mSlotCount - 1)) != 0 || mSlotCount > (mSize - ARCHIVE_HEADER_BYTES) / ARCHIVE_SLOT_BYTES) {
+		printf("%s is not an asset archive!\n", path.c_str());
+		close();
+		return false;
+	}
+	return true;
+}
+
+void LAssetArchive::close() {
+	if (mData != NULL) {
+#ifdef _WIN32
+		if (mMapped) {
+			UnmapViewOfFile(mData);
+		}
+#else
+		if (mMapped) {
+			munmap((void*)mData, mSize);
+		}
+#endif
+		if (!mMapped) {
+			delete[] mData;
+		}
+	}
+#ifdef _WIN32
+	if (mMapping != NULL) {
+		CloseHandle(mMapping);
+		mMapping = NULL;
+	}
+	if (mFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(mFile);
+		mFile = INVALID_HANDLE_VALUE;
+	}
+#endif
+	mData = NULL;
+	mSize = 0;
+	mSlotCount = 0;
+	mFileCount = 0;
+	mMapped = false;
+}
+
+SDL_RWops* LAssetArchive::openRW(std::string path) {
+	// The view reads the mapping directly, nothing is copied
+	Uint32 size = 0;
+	const Uint8* data = find(path, &size);
+	return data != NULL ? SDL_RWFromConstMem(data, (int)size) : NULL;
+}
+
+bool LAssetArchive::isOpen() {
+	return mData != NULL;
+}
+
+int LAssetArchive::getFileCount() {
+	return (int)mFileCount;
+}
+
+const Uint8* LAssetArchive::find(std::string path, Uint32* size) {
+	if (mData == NULL) {
+		return NULL;
+	}
+	for (size_t c = 0; c < path.size(); ++c) {
+		path[c] = path[c] == '\\' ? '/' : path[c];
+	}
+
+	// Probe from the hash's slot until the path or an empty slot turns up
+	Uint32 hash = hashPath(path);
+	for (Uint32 probe = 0; probe < mSlotCount; ++probe) {
+		Uint32 slot = (hash + probe) & (mSlotCount - 1);
+		Uint32 entry[6];
+		memcpy(entry, mData + ARCHIVE_HEADER_BYTES + slot * ARCHIVE_SLOT_BYTES, sizeof(entry));
+		Uint32 nameLength = SDL_SwapLE32(entry[2]);
+		if (nameLength == 0) {
+			return NULL;
+		}
+
+		// Compare names only when the hashes agree, and never trust offsets past the end
+		Uint32 nameOffset = SDL_SwapLE32(entry[1]);
+		Uint32 dataOffset = SDL_SwapLE32(entry[3]);
+		Uint32 dataSize = SDL_SwapLE32(entry[4]);
+		if (SDL_SwapLE32(entry[0]) == hash && nameLength == path.size() && nameOffset <= mSize && nameLength <= mSize - nameOffset && memcmp(mData + nameOffset, path.c_str(), nameLength) == 0) {
+			if (dataOffset > mSize || dataSize > mSize - dataOffset) {
+				return NULL;
+			}
+			*size = dataSize;
+			return mData + dataOffset;
+		}
+	}
+	return NULL;
+}
+
+Uint32 LAssetArchive::hashPath(const std::string& path) {
+	// FNV-1a
+	Uint32 hash = 2166136261U;
+	for (size_t i = 0; i < path.size(); ++i) {
+		hash = (hash ^ (Uint8)path[i]) * 16777619U;
+	}
+	return hash;
+}
+
+bool packAssets(int count, char* paths[]) {
+	// The lesson's images plus anything named on the command line
+	std::vector<std::string> files(gAssetPaths, gAssetPaths + TOTAL_ASSETS);
+	for (int i = 0; i < count; ++i) {
+		files.push_back(paths[i]);
+	}
+	if (!LAssetArchive::pack(ARCHIVE_PATH, files)) {
+		printf("Failed to pack assets!\n");
+		return false;
+	}
+	printf("Packed %d files into %s\n", (int)files.size(), ARCHIVE_PATH);
+	return true;
+}
+
+void runArchiveBenchmark() {
+	double frequency = (double)SDL_GetPerformanceFrequency();
+
+	// Decode every image from its own file
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+		for (int i = 0; i < TOTAL_ASSETS; ++i) {
+			SDL_FreeSurface(IMG_Load(gAssetPaths[i]));
+		}
+	}
+	double looseMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+	// Open the archive once and decode every image from the mapping
+	start = SDL_GetPerformanceCounter();
+	LAssetArchive archive;
+	if (!archive.open(ARCHIVE_PATH)) {
+		printf("No archive at %s, run with --pack first\n", ARCHIVE_PATH);
+		return;
+	}
+	double openMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+	start = SDL_GetPerformanceCounter();
+	for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+		for (int i = 0; i < TOTAL_ASSETS; ++i) {
+			SDL_FreeSurface(IMG_Load_RW(archive.openRW(gAssetPaths[i]), 1));
+		}
+	}
+	double packedMs = (SDL_GetPerformanceCounter() - start) * 1000.0 / frequency;
+
+	printf("%d loads: %.3f ms each from loose files, %.3f ms each from the archive (%.3f ms to map it)\n", BENCHMARK_ROUNDS * TOTAL_ASSETS, looseMs / (BENCHMARK_ROUNDS * TOTAL_ASSETS), packedMs / (BENCHMARK_ROUNDS * TOTAL_ASSETS), openMs);
 }
 
 bool init()
@@ -762,6 +1358,9 @@ void close()
 	gDotTexture.free();
 	gShimmerTexture.free();
 
+	// Unmap the packed assets
+	gAssets.close();
+
 	//Quit SDL subsystems
 	SDL_Quit();
 }
@@ -771,6 +1370,11 @@ bool loadMedia() {
 	// Loading success flag
 	bool success = true;
 
+	// Read from the packed assets when they exist
+	if (gAssets.open(ARCHIVE_PATH)) {
+		printf("Loading from %s, %d files\n", ARCHIVE_PATH, gAssets.getFileCount());
+	}
+
 	// Load dot texture
 	if (!gDotTexture.loadFromFile("38_particle_engines/dot.bmp")) {
 		printf("Failed to load dot texture!\n");
@@ -801,6 +1405,19 @@ bool loadMedia() {
 		success = false;
 	}
 
+	// Shimmer shows on every other frame of a particle's life
+	SDL_Rect shimmerFrames[PARTICLE_FRAMES];
+	for (int i = 0; i < PARTICLE_FRAMES; ++i) {
+		shimmerFrames[i].x = 0;
+		shimmerFrames[i].y = 0;
+		shimmerFrames[i].w = i % 2 == 0 ? gShimmerTexture.getWidth() : 0;
+		shimmerFrames[i].h = i % 2 == 0 ? gShimmerTexture.getHeight() : 0;
+	}
+	gShimmerClip = gParticleAnimations.addClip(shimmerFrames, PARTICLE_FRAMES, PARTICLE_FRAME_MS, false);
+	if (gShimmerClip < 0) {
+		success = false;
+	}
+
 	// Set texture transparency
 	gRedTexture.setAlpha(192);
 	gGreenTexture.setAlpha(192);
@@ -811,6 +1428,19 @@ bool loadMedia() {
 }
 int main(int argc, char* args[])
 {
+	// Archive tools that don't need a window
+	if (argc > 1 && (strcmp(args[1], "--pack") == 0 || strcmp(args[1], "--benchmark") == 0)) {
+		SDL_Init(0);
+		if (strcmp(args[1], "--pack") == 0) {
+			packAssets(argc - 2, args + 2);
+		}
+		else {
+			runArchiveBenchmark();
+		}
+		SDL_Quit();
+		return 0;
+	}
+
 	//Start up SDL and create window
 	if (!init())
 	{
@@ -830,6 +1460,9 @@ int main(int argc, char* args[])
 			// The dot that will be moving around on the screen
 			Dot dot;
 
+			// Time of the last animation update
+			Uint32 lastTicks = SDL_GetTicks();
+
 			//While application is running
 			while (!quit)
 			{
@@ -845,6 +1478,11 @@ int main(int argc, char* args[])
 					dot.handleEvent(e);
 				}
 
+				// Advance the particle animations by the time that passed
+				Uint32 ticks = SDL_GetTicks();
+				gParticleAnimations.update(ticks - lastTicks);
+				lastTicks = ticks;
+
 				// Move the dot
 				dot.move();
 
@@ -1,12 +1,16 @@
 /*This source code copyrighted by Lazy Foo' Productions (2004-2022)
 and may not be redistributed without written permission.*/
 
-//Using SDL, SDL_image, standard IO, vectors, and strings
+//Using SDL, SDL_image, standard IO, vectors, strings, string streams, and file streams
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
 #include <string>
 #include <fstream>
+#include <vector>
+#include <sstream>
+#include <sys/stat.h>
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -36,13 +40,32 @@ const int TILE_BOTTOMLEFT = 9;
 const int TILE_LEFT = 10;
 const int TILE_TOPLEFT = 11;
 
+// Compressed streams are split into blocks of at most this many bytes
+const int LZ_BLOCK_BYTES = 64 * 1024;
+
+// Compressed stream identifier, "LZB1"
+const Uint32 LZ_STREAM_MAGIC = 0x31425A4C;
+
+// Block headers with this bit set hold the block uncompressed
+const Uint32 LZ_STORED_BLOCK = 0x80000000;
+
+// Match finder hash size, shortest match, and how close to the end matches may reach, as LZ4 requires
+const int LZ_HASH_BITS = 14;
+const int LZ_MIN_MATCH = 4;
+const int LZ_MAX_OFFSET = 65535;
+const int LZ_LAST_LITERALS = 5;
+const int LZ_MATCH_LIMIT = 12;
+
+// Compression benchmarks repeat each file for at least this long
+const Uint32 BENCHMARK_MS = 250;
+
 // The tile wrapper class
 class Tile {
 public:
 	// Initiliaze position and type
 	Tile(int x, int y, int tileType);
 
-	// Shows the tile
+	// Shows the tile (callers are expected to have culled it against the camera)
 	void render(SDL_Rect& camera);
 
 	// Get the tile type
@@ -59,6 +82,71 @@ private:
 	int mType;
 };
 
+// Culling statistics from the last spatial grid query
+struct CullStats {
+	// Objects stored in the grid
+	int total;
+
+	// Objects whose boxes were tested against the query area
+	int tested;
+
+	// Objects that intersected the query area
+	int drawn;
+
+	// Objects skipped, either by cell or by box test
+	int culled;
+};
+
+// Uniform grid that buckets object boxes by the cells they overlap
+class SpatialGrid {
+public:
+	// Initializes a grid covering the given world area
+	SpatialGrid(int worldWidth, int worldHeight, int cellWidth, int cellHeight);
+
+	// Adds an object box and returns its handle
+	int insert(SDL_Rect box);
+
+	// Moves an object, only touching the buckets if its cell span changed
+	void update(int id, SDL_Rect box);
+
+	// Fills result with the handles of every object intersecting the area
+	void query(SDL_Rect area, std::vector<int>& result);
+
+	// Gets the statistics of the last query
+	CullStats getStats();
+
+private:
+	// Cell span an object box covers
+	struct CellSpan {
+		int minX, minY, maxX, maxY;
+	};
+
+	// Computes the clamped cell span of a box
+	CellSpan getSpan(SDL_Rect box);
+
+	// Adds or removes an object from every cell in its span
+	void link(int id, CellSpan span);
+	void unlink(int id, CellSpan span);
+
+	// Grid dimensions
+	int mCellWidth, mCellHeight;
+	int mColumns, mRows;
+
+	// Object handles per cell, row major
+	std::vector<std::vector<int>> mCells;
+
+	// Per object data
+	std::vector<SDL_Rect> mBoxes;
+	std::vector<CellSpan> mSpans;
+
+	// Last query an object was visited in, so multi cell objects are reported once
+	std::vector<unsigned int> mVisitStamps;
+	unsigned int mQueryStamp;
+
+	// Statistics of the last query
+	CullStats mStats;
+};
+
 //Texture wrapper class
 class LTexture
 {
@@ -185,6 +273,9 @@ public:
 	// Centers the camera over the dot
 	void setCamera(SDL_Rect& camera);
 
+	// Gets the collision box
+	SDL_Rect getBox();
+
 private:
 
 	// Collision box of the dot
@@ -194,6 +285,32 @@ private:
 	int mVelX, mVelY;
 };
 
+// Block compressor, LZ4 block format with 64KB independent blocks
+class LBlockCompressor {
+public:
+	// Initializes variables
+	LBlockCompressor();
+
+	// Compresses one block, returns the compressed size or 0 if it doesn't fit in capacity
+	int compressBlock(const Uint8* source, int size, Uint8* destination, int capacity);
+
+	// Decompresses one block, returns the decompressed size or -1 if the data is damaged
+	static int decompressBlock(const Uint8* source, int size, Uint8* destination, int capacity);
+
+	// Appends a buffer as a stream of compressed blocks, readable through openCompressedRW
+	void compressStream(const Uint8* source, size_t size, std::vector<Uint8>& output);
+
+	// Worst case compressed size of a block
+	static int getBound(int size);
+
+private:
+	// Positions of recently seen 4 byte sequences by hash
+	Uint32 mTable[1 << LZ_HASH_BITS];
+};
+
+// Opens a compressed stream for reading, blocks are decompressed as they are read and closing it closes source
+SDL_RWops* openCompressedRW(SDL_RWops* source);
+
 //Starts up SDL and creates window
 bool init();
 
@@ -212,6 +329,18 @@ bool touchesWall(SDL_Rect box, Tile* tiles[]);
 // Sets tiles from tile map
 bool setTiles(Tile* tiles[]);
 
+// Registers the tiles in the level grid
+void indexTiles(Tile* tiles[]);
+
+// Writes a compressed copy of a file next to it
+bool compressFile(std::string path);
+
+// Checks if a file was modified after another, false if either is missing
+bool isNewerFile(std::string path, std::string otherPath);
+
+// Prints compression ratio and speed for tile maps and textures
+void runCompressionBenchmark(int count, char* paths[]);
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -223,6 +352,12 @@ LTexture gDotTexture;
 LTexture gTileTexture;
 SDL_Rect gTileClips[TOTAL_TILE_SPRITES];
 
+// Spatial index of the level tiles, handles match tile indices
+SpatialGrid gTileGrid(LEVEL_WIDTH, LEVEL_HEIGHT, TILE_WIDTH * 2, TILE_HEIGHT * 2);
+
+// Spatial index of the moving entities
+SpatialGrid gEntityGrid(LEVEL_WIDTH, LEVEL_HEIGHT, TILE_WIDTH * 2, TILE_HEIGHT * 2);
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -463,6 +598,10 @@ void Dot::setCamera(SDL_Rect& camera) {
 	}
 }
 
+SDL_Rect Dot::getBox() {
+	return mBox;
+}
+
 Tile::Tile(int x, int y, int tileType) {
 	
 	// Get the offsets
@@ -478,13 +617,9 @@ Tile::Tile(int x, int y, int tileType) {
 }
 
 void Tile::render(SDL_Rect& camera) {
-	
-	// if the tile is on screen
-	if (checkCollision(camera, mBox)) {
-		
-		// Show the tile
-		gTileTexture.render(mBox.x - camera.x, mBox.y - camera.y, &gTileClips[mType]);
-	}
+
+	// Show the tile
+	gTileTexture.render(mBox.x - camera.x, mBox.y - camera.y, &gTileClips[mType]);
 }
 
 int Tile::getType() {
@@ -495,6 +630,154 @@ SDL_Rect Tile::getBox() {
 	return mBox;
 }
 
+SpatialGrid::SpatialGrid(int worldWidth, int worldHeight, int cellWidth, int cellHeight) {
+
+	// Set the grid dimensions, rounding up so the whole world is covered
+	mCellWidth = cellWidth;
+	mCellHeight = cellHeight;
+	mColumns = (worldWidth + cellWidth - 1) / cellWidth;
+	mRows = (worldHeight + cellHeight - 1) / cellHeight;
+
+	// Allocate the cells
+	mCells.resize(mColumns * mRows);
+
+	// Initialize the query state
+	mQueryStamp = 0;
+	mStats.total = 0;
+	mStats.tested = 0;
+	mStats.drawn = 0;
+	mStats.culled = 0;
+}
+
+int SpatialGrid::insert(SDL_Rect box) {
+
+	// Store the object data
+	int id = (int)mBoxes.size();
+	CellSpan span = getSpan(box);
+	mBoxes.push_back(box);
+	mSpans.push_back(span);
+	mVisitStamps.push_back(mQueryStamp);
+
+	// Bucket the object
+	link(id, span);
+
+	return id;
+}
+
+void SpatialGrid::update(int id, SDL_Rect box) {
+
+	// Update the box
+	mBoxes[id] = box;
+
+	// Re-bucket only if the object crossed a cell border
+	CellSpan span = getSpan(box);
+	CellSpan& old = mSpans[id];
+	if (span.minX != old.minX || span.minY != old.minY || span.maxX != old.maxX || span.maxY != old.maxY) {
+		unlink(id, old);
+		link(id, span);
+		mSpans[id] = span;
+	}
+}
+
+void SpatialGrid::query(SDL_Rect area, std::vector<int>& result) {
+
+	// Start a new query
+	result.clear();
+	++mQueryStamp;
+	mStats.total = (int)mBoxes.size();
+	mStats.tested = 0;
+
+	// Go through the cells under the area
+	CellSpan span = getSpan(area);
+	for (int y = span.minY; y <= span.maxY; ++y) {
+		for (int x = span.minX; x <= span.maxX; ++x) {
+			std::vector<int>& cell = mCells[y * mColumns + x];
+			for (size_t i = 0; i < cell.size(); ++i) {
+				int id = cell[i];
+
+				// Skip objects already reported from a neighbouring cell
+				if (mVisitStamps[id] == mQueryStamp) {
+					continue;
+				}
+				mVisitStamps[id] = mQueryStamp;
+
+				// Keep the object if its box is inside the area
+				++mStats.tested;
+				if (checkCollision(area, mBoxes[id])) {
+					result.push_back(id);
+				}
+			}
+		}
+	}
+
+	// Update the statistics
+	mStats.drawn = (int)result.size();
+	mStats.culled = mStats.total - mStats.drawn;
+}
+
+CullStats SpatialGrid::getStats() {
+	return mStats;
+}
+
+SpatialGrid::CellSpan SpatialGrid::getSpan(SDL_Rect box) {
+
+	// Boxes are half open, so the last covered pixel is one before the edge
+	CellSpan span;
+	span.minX = box.x / mCellWidth;
+	span.minY = box.y / mCellHeight;
+	span.maxX = (box.x + box.w - 1) / mCellWidth;
+	span.maxY = (box.y + box.h - 1) / mCellHeight;
+
+	// Keep the span inside the grid
+	if (span.minX < 0) {
+		span.minX = 0;
+	}
+	if (span.minY < 0) {
+		span.minY = 0;
+	}
+	if (span.maxX >= mColumns) {
+		span.maxX = mColumns - 1;
+	}
+	if (span.maxY >= mRows) {
+		span.maxY = mRows - 1;
+	}
+
+	return span;
+}
+
+void SpatialGrid::link(int id, CellSpan span) {
+	for (int y = span.minY; y <= span.maxY; ++y) {
+		for (int x = span.minX; x <= span.maxX; ++x) {
+			mCells[y * mColumns + x].push_back(id);
+		}
+	}
+}
+
+void SpatialGrid::unlink(int id, CellSpan span) {
+	for (int y = span.minY; y <= span.maxY; ++y) {
+		for (int x = span.minX; x <= span.maxX; ++x) {
+			std::vector<int>& cell = mCells[y * mColumns + x];
+
+			// Swap the handle with the last one and drop it
+			for (size_t i = 0; i < cell.size(); ++i) {
+				if (cell[i] == id) {
+					cell[i] = cell.back();
+					cell.pop_back();
+					break;
+				}
+			}
+		}
+	}
+}
+
+void indexTiles(Tile* tiles[]) {
+
+	// Insert in tile order so grid handles match tile indices
+	for (int i = 0; i < TOTAL_TILES; ++i) {
+		gTileGrid.insert(tiles[i]->getBox());
+	}
+}
+
 bool setTiles(Tile* tiles[]) {
 
 	// Success flag
@@ -503,11 +786,32 @@ bool setTiles(Tile* tiles[]) {
 	// The tile offsets
 	int x = 0, y = 0;
 
-	// Open the map
-	std::ifstream map( "39_tiling/lazy.map" );
+	// Open the map, preferring a compressed copy unless the plain map was edited since
+	SDL_RWops* file = NULL;
+	if (isNewerFile("39_tiling/lazy.map", "39_tiling/lazy.map.lz")) {
+		printf("Warning: lazy.map.lz is older than lazy.map, run with --compress 39_tiling/lazy.map to update it\n");
+	}
+	else {
+		file = openCompressedRW(SDL_RWFromFile("39_tiling/lazy.map.lz", "rb"));
+	}
+	if (file == NULL) {
+		file = SDL_RWFromFile("39_tiling/lazy.map", "rb");
+	}
+
+	// Read it as it's decompressed
+	std::string text;
+	if (file != NULL) {
+		char chunk[4096];
+		size_t bytes = 0;
+		while ((bytes = SDL_RWread(file, chunk, 1, sizeof(chunk))) > 0) {
+			text.append(chunk, bytes);
+		}
+		SDL_RWclose(file);
+	}
+	std::istringstream map(text);
 
 	// If the map couldn't be loaded
-	if (map.fail()) {
+	if (file == NULL) {
 		printf("Unable to load map file!\n");
 		tilesLoaded = false;
 	}
@@ -557,6 +861,9 @@ bool setTiles(Tile* tiles[]) {
 		// Clip the sprite sheet
 		if (tilesLoaded) {
 
+			// Index the tiles for camera culling
+			indexTiles(tiles);
+
 			gTileClips[TILE_RED].x = 0;
 			gTileClips[TILE_RED].y = 0;
 			gTileClips[TILE_RED].w = TILE_WIDTH;
@@ -619,9 +926,6 @@ bool setTiles(Tile* tiles[]) {
 		}
 	}
 
-	// Close the file
-	map.close();
-
 	// If the map was loaded fine
 	return tilesLoaded;
 }
@@ -692,6 +996,357 @@ bool checkCollision(SDL_Rect a, SDL_Rect b)
 	return true;
 }
 
+LBlockCompressor::LBlockCompressor() {
+	// Initialize
+	SDL_zero(mTable);
+}
+
+int LBlockCompressor::getBound(int size) {
+	return size + size / 255 + 16;
+}
+
+// Reads 4 bytes that may not be aligned
+static Uint32 readWord(const Uint8* p) {
+	Uint32 word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+// Hashes 4 bytes into the match table
+static Uint32 hashWord(Uint32 word) {
+	return (word * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// Writes a 4 bit length's overflow as a run of 255s and a remainder
+static Uint8* writeLength(Uint8* out, int length) {
+	while (length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (Uint8)length;
+	return out;
+}
+
+int LBlockCompressor::compressBlock(const Uint8* source, int size, Uint8* destination, int capacity) {
+	const Uint8* ip = source;
+	const Uint8* anchor = source;
+	const Uint8* end = source + size;
+	const Uint8* matchEnd = end - LZ_LAST_LITERALS;
+	const Uint8* searchEnd = end - LZ_MATCH_LIMIT;
+	Uint8* op = destination;
+	Uint8* opEnd = destination + capacity;
+
+	// Too short to hold a match, everything goes out as literals
+	if (size > LZ_MATCH_LIMIT) {
+		SDL_zero(mTable);
+		++ip;
+
+		while (ip <= searchEnd) {
+			// Look for a match, stepping faster the longer nothing turns up
+			const Uint8* match = NULL;
+			int attempts = 1 << 6;
+			while (ip <= searchEnd) {
+				Uint32 word = readWord(ip);
+				Uint32 hash = hashWord(word);
+				match = source + mTable[hash];
+				mTable[hash] = (Uint32)(ip - source);
+				if (match < ip && ip - match <= LZ_MAX_OFFSET && readWord(match) == word) {
+					break;
+				}
+				match = NULL;
+				ip += attempts++ >> 6;
+			}
+			if (match == NULL) {
+				break;
+			}
+
+			// Grow the match backwards into the pending literals
+			while (ip > anchor && match > source && ip[-1] == match[-1]) {
+				--ip;
+				--match;
+			}
+
+			// And forwards as far as the format allows
+			int matchLength = LZ_MIN_MATCH;
+			while (ip + matchLength < matchEnd && ip[matchLength] == match[matchLength]) {
+				++matchLength;
+			}
+
+			// Token, literals, offset and the length overflows
+			int literalLength = (int)(ip - anchor);
+			if (op + 1 + literalLength + literalLength / 255 + 1 + 2 + matchLength / 255 + 1 > opEnd) {
+				return 0;
+			}
+			Uint8* token = op++;
+			*token = (Uint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+			if (literalLength >= 15) {
+				op = writeLength(op, literalLength - 15);
+			}
+			memcpy(op, anchor, literalLength);
+			op += literalLength;
+			int offset = (int)(ip - match);
+			*op++ = (Uint8)offset;
+			*op++ = (Uint8)(offset >> 8);
+			int extraLength = matchLength - LZ_MIN_MATCH;
+			*token |= (Uint8)(extraLength >= 15 ? 15 : extraLength);
+			if (extraLength >= 15) {
+				op = writeLength(op, extraLength - 15);
+			}
+
+			// Carry on after the match, remembering a position inside it
+			ip += matchLength;
+			anchor = ip;
+			if (ip <= searchEnd) {
+				mTable[hashWord(readWord(ip - 2))] = (Uint32)(ip - 2 - source);
+			}
+		}
+	}
+
+	// The rest goes out as literals
+	int literalLength = (int)(end - anchor);
+	if (op + 1 + literalLength + literalLength / 255 + 1 > opEnd) {
+		return 0;
+	}
+	*op++ = (Uint8)((literalLength >= 15 ? 15 : literalLength) << 4);
+	if (literalLength >= 15) {
+		op = writeLength(op, literalLength - 15);
+	}
+	memcpy(op, anchor, literalLength);
+	op += literalLength;
+	return (int)(op - destination);
+}
+
+int LBlockCompressor::decompressBlock(const Uint8* source, int size, Uint8* destination, int capacity) {
+	const Uint8* ip = source;
+	const Uint8* end = source + size;
+	Uint8* op = destination;
+	Uint8* opEnd = destination + capacity;
+
+	while (ip < end) {
+		// Literals
+		int token = *ip++;
+		int literalLength = token >> 4;
+		if (literalLength == 15) {
+			int extra = 255;
+			while (extra == 255) {
+				if (ip >= end) {
+					return -1;
+				}
+				extra = *ip++;
+				literalLength += extra;
+			}
+		}
+		if (literalLength > end - ip || literalLength > opEnd - op) {
+			return -1;
+		}
+		memcpy(op, ip, literalLength);
+		op += literalLength;
+		ip += literalLength;
+
+		// The last sequence has no match
+		if (ip == end) {
+			break;
+		}
+
+		// Match
+		if (end - ip < 2) {
+			return -1;
+		}
+		int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - destination) {
+			return -1;
+		}
+		int matchLength = token & 15;
+		if (matchLength == 15) {
+			int extra = 255;
+			while (extra == 255) {
+				if (ip >= end) {
+					return -1;
+				}
+				extra = *ip++;
+				matchLength += extra;
+			}
+		}
+		matchLength += LZ_MIN_MATCH;
+		if (matchLength > opEnd - op) {
+			return -1;
+		}
+
+		// Overlapping matches repeat the last offset bytes, so they copy a byte at a time
+		const Uint8* match = op - offset;
+		if (offset >= matchLength) {
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else {
+			for (int i = 0; i < matchLength; ++i) {
+				*op++ = *match++;
+			}
+		}
+	}
+	return (int)(op - destination);
+}
+
+void LBlockCompressor::compressStream(const Uint8* source, size_t size, std::vector<Uint8>& output) {
+	// Stream header
+	size_t start = output.size();
+	output.resize(start + sizeof(Uint32));
+	Uint32 magic = SDL_SwapLE32(LZ_STREAM_MAGIC);
+	memcpy(&output[start], &magic, sizeof(magic));
+
+	for (size_t offset = 0; offset < size; offset += LZ_BLOCK_BYTES) {
+		int blockSize = size - offset < (size_t)LZ_BLOCK_BYTES ? (int)(size - offset) : LZ_BLOCK_BYTES;
+
+		// Compress straight into the output, keeping the block as is when that doesn't make it smaller
+		size_t headerOffset = output.size();
+		output.resize(headerOffset + sizeof(Uint32) + getBound(blockSize));
+		int compressedSize = compressBlock(source + offset, blockSize, &output[headerOffset + sizeof(Uint32)], blockSize - 1);
+		Uint32 header = (Uint32)compressedSize;
+		if (compressedSize == 0) {
+			memcpy(&output[headerOffset + sizeof(Uint32)], source + offset, blockSize);
+			compressedSize = blockSize;
+			header = (Uint32)blockSize | LZ_STORED_BLOCK;
+		}
+		header = SDL_SwapLE32(header);
+		memcpy(&output[headerOffset], &header, sizeof(header));
+		output.resize(headerOffset + sizeof(Uint32) + compressedSize);
+	}
+
+	// An empty block header ends the stream
+	output.resize(output.size() + sizeof(Uint32), 0);
+}
+
+// Reading side of a compressed stream
+struct CompressedReader {
+	SDL_RWops* source;
+	Uint8 compressed[LZ_BLOCK_BYTES + LZ_BLOCK_BYTES / 255 + 16];
+	Uint8 block[LZ_BLOCK_BYTES];
+	int blockSize;
+	int blockOffset;
+	Sint64 position;
+	bool ended;
+};
+
+// Reads and decompresses the next block, false at the end of the stream or on damage
+static bool readCompressedBlock(CompressedReader* reader) {
+	reader->blockSize = 0;
+	reader->blockOffset = 0;
+
+	Uint32 header = 0;
+	if (SDL_RWread(reader->source, &header, sizeof(header), 1) != 1 || header == 0) {
+		return false;
+	}
+	header = SDL_SwapLE32(header);
+	int size = (int)(header & ~LZ_STORED_BLOCK);
+
+	// Stored blocks go straight into the block buffer
+	if (header & LZ_STORED_BLOCK) {
+		if (size > LZ_BLOCK_BYTES || SDL_RWread(reader->source, reader->block, size, 1) != 1) {
+			SDL_SetError("Compressed stream is damaged");
+			return false;
+		}
+		reader->blockSize = size;
+		return true;
+	}
+
+	if (size > (int)sizeof(reader->compressed) || SDL_RWread(reader->source, reader->compressed, size, 1) != 1) {
+		SDL_SetError("Compressed stream is damaged");
+		return false;
+	}
+	reader->blockSize = LBlockCompressor::decompressBlock(reader->compressed, size, reader->block, LZ_BLOCK_BYTES);
+	if (reader->blockSize < 0) {
+		reader->blockSize = 0;
+		SDL_SetError("Compressed stream is damaged");
+		return false;
+	}
+	return true;
+}
+
+static size_t SDLCALL compressedRead(SDL_RWops* context, void* data, size_t size, size_t count) {
+	CompressedReader* reader = (CompressedReader*)context->hidden.unknown.data1;
+	size_t total = size * count;
+	size_t copied = 0;
+	while (copied < total) {
+		// Refill once the current block is used up
+		if (reader->blockOffset == reader->blockSize) {
+			if (reader->ended || !readCompressedBlock(reader)) {
+				reader->ended = true;
+				break;
+			}
+		}
+		size_t available = reader->blockSize - reader->blockOffset;
+		size_t bytes = total - copied < available ? total - copied : available;
+		memcpy((Uint8*)data + copied, reader->block + reader->blockOffset, bytes);
+		reader->blockOffset += (int)bytes;
+		copied += bytes;
+	}
+	reader->position += copied;
+	return size > 0 ? copied / size : 0;
+}
+
+static Sint64 SDLCALL compressedSize(SDL_RWops*) {
+	// Unknown until the whole stream is read
+	return -1;
+}
+
+static Sint64 SDLCALL compressedSeek(SDL_RWops* context, Sint64 offset, int whence) {
+	// Only telling the position is supported
+	CompressedReader* reader = (CompressedReader*)context->hidden.unknown.data1;
+	if (whence == RW_SEEK_CUR && offset == 0) {
+		return reader->position;
+	}
+	return SDL_SetError("Compressed streams can't seek");
+}
+
+static size_t SDLCALL compressedWrite(SDL_RWops*, const void*, size_t, size_t) {
+	SDL_SetError("Compressed streams are read only");
+	return 0;
+}
+
+static int SDLCALL compressedClose(SDL_RWops* context) {
+	CompressedReader* reader = (CompressedReader*)context->hidden.unknown.data1;
+	int result = SDL_RWclose(reader->source);
+	delete reader;
+	SDL_FreeRW(context);
+	return result;
+}
+
+SDL_RWops* openCompressedRW(SDL_RWops* source) {
+	if (source == NULL) {
+		return NULL;
+	}
+
+	// Check the stream header
+	Uint32 magic = 0;
+	if (SDL_RWread(source, &magic, sizeof(magic), 1) != 1 || SDL_SwapLE32(magic) != LZ_STREAM_MAGIC) {
+		SDL_SetError("Not a compressed stream");
+		SDL_RWclose(source);
+		return NULL;
+	}
+
+	SDL_RWops* context = SDL_AllocRW();
+	if (context == NULL) {
+		SDL_RWclose(source);
+		return NULL;
+	}
+	CompressedReader* reader = new CompressedReader();
+	reader->source = source;
+	reader->blockSize = 0;
+	reader->blockOffset = 0;
+	reader->position = 0;
+	reader->ended = false;
+
+	context->size = compressedSize;
+	context->seek = compressedSeek;
+	context->read = compressedRead;
+	context->write = compressedWrite;
+	context->close = compressedClose;
+	context->type = SDL_RWOPS_UNKNOWN;
+	context->hidden.unknown.data1 = reader;
+	return context;
+}
+
 bool init()
 {
 	//Initialization flag
@@ -799,8 +1454,167 @@ bool loadMedia(Tile* tiles[]) {
 	return success;
 }
 
+bool compressFile(std::string path) {
+	// Read the whole file
+	SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+	if (file == NULL) {
+		printf("Unable to open %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+	std::vector<Uint8> data((size_t)SDL_RWsize(file));
+	bool success = data.empty() || SDL_RWread(file, &data[0], data.size(), 1) == 1;
+	SDL_RWclose(file);
+
+	// Compress and write it out
+	LBlockCompressor compressor;
+	std::vector<Uint8> compressed;
+	compressor.compressStream(data.empty() ? NULL : &data[0], data.size(), compressed);
+	file = success ? SDL_RWFromFile((path + ".lz").c_str(), "wb") : NULL;
+	if (file == NULL || SDL_RWwrite(file, &compressed[0], compressed.size(), 1) != 1) {
+		printf("Unable to write %s.lz! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		success = false;
+	}
+	if (file != NULL) {
+		SDL_RWclose(file);
+	}
+	if (success) {
+		printf("%s: %u -> %u bytes\n", path.c_str(), (Uint32)data.size(), (Uint32)compressed.size());
+	}
+	return success;
+}
+
+bool isNewerFile(std::string path, std::string otherPath) {
+	struct stat info;
+	struct stat otherInfo;
+	return stat(path.c_str(), &info) == 0 && stat(otherPath.c_str(), &otherInfo) == 0 && info.st_mtime > otherInfo.st_mtime;
+}
+
+void runCompressionBenchmark(int count, char* paths[]) {
+	// The lesson's own map and textures unless told otherwise
+	const char* defaultPaths[] = { "39_tiling/lazy.map", "39_tiling/tiles.png", "39_tiling/dot.bmp" };
+	if (count == 0) {
+		count = sizeof(defaultPaths) / sizeof(defaultPaths[0]);
+		paths = (char**)defaultPaths;
+	}
+
+	LBlockCompressor compressor;
+	double frequency = (double)SDL_GetPerformanceFrequency();
+	printf("%-32s %10s %10s %7s %12s %12s %12s\n", "file", "bytes", "packed", "ratio", "pack MB/s", "unpack MB/s", "stream MB/s");
+	for (int i = 0; i < count; ++i) {
+		// Textures are measured as the pixels they decode to, which is what an archive would store
+		std::string path = paths[i];
+		std::vector<Uint8> data;
+		SDL_Surface* surface = path.size() > 4 && path.compare(path.size() - 4, 4, ".png") == 0 ? IMG_Load(path.c_str()) : NULL;
+		if (surface != NULL) {
+			SDL_LockSurface(surface);
+			for (int y = 0; y < surface->h; ++y) {
+				Uint8* row = (Uint8*)surface->pixels + y * surface->pitch;
+				data.insert(data.end(), row, row + surface->w * surface->format->BytesPerPixel);
+			}
+			SDL_UnlockSurface(surface);
+			SDL_FreeSurface(surface);
+			path += " (pixels)";
+		}
+		else {
+			SDL_RWops* file = SDL_RWFromFile(paths[i], "rb");
+			if (file == NULL) {
+				printf("Unable to open %s! SDL Error: %s\n", paths[i], SDL_GetError());
+				continue;
+			}
+			data.resize((size_t)SDL_RWsize(file));
+			if (!data.empty()) {
+				SDL_RWread(file, &data[0], data.size(), 1);
+			}
+			SDL_RWclose(file);
+		}
+		if (data.empty()) {
+			continue;
+		}
+
+		// Compress repeatedly for a stable time
+		std::vector<Uint8> compressed;
+		int runs = 0;
+		Uint64 start = SDL_GetPerformanceCounter();
+		do {
+			compressed.clear();
+			compressor.compressStream(&data[0], data.size(), compressed);
+			++runs;
+		} while ((SDL_GetPerformanceCounter() - start) * 1000.0 / frequency < BENCHMARK_MS);
+		double packSeconds = (SDL_GetPerformanceCounter() - start) / frequency / runs;
+
+		// Decompress each block straight into a buffer
+		std::vector<Uint8> unpacked(data.size());
+		bool match = true;
+		runs = 0;
+		start = SDL_GetPerformanceCounter();
+		do {
+			size_t offset = sizeof(Uint32);
+			size_t written = 0;
+			while (offset + sizeof(Uint32) <= compressed.size()) {
+				Uint32 header;
+				memcpy(&header, &compressed[offset], sizeof(header));
+				header = SDL_SwapLE32(header);
+				offset += sizeof(Uint32);
+				if (header == 0) {
+					break;
+				}
+				int size = (int)(header & ~LZ_STORED_BLOCK);
+				int bytes = size;
+				if (header & LZ_STORED_BLOCK) {
+					memcpy(&unpacked[written], &compressed[offset], size);
+				}
+				else {
+					bytes = LBlockCompressor::decompressBlock(&compressed[offset], size, &unpacked[written], (int)(unpacked.size() - written));
+				}
+				if (bytes < 0) {
+					match = false;
+					break;
+				}
+				offset += size;
+				written += bytes;
+			}
+			++runs;
+		} while ((SDL_GetPerformanceCounter() - start) * 1000.0 / frequency < BENCHMARK_MS);
+		double unpackSeconds = (SDL_GetPerformanceCounter() - start) / frequency / runs;
+		match = match && unpacked == data;
+
+		// Read it back through the streaming reader, as a loader would
+		runs = 0;
+		start = SDL_GetPerformanceCounter();
+		do {
+			SDL_RWops* stream = openCompressedRW(SDL_RWFromConstMem(&compressed[0], (int)compressed.size()));
+			size_t read = stream != NULL ? SDL_RWread(stream, &unpacked[0], 1, unpacked.size()) : 0;
+			match = match && read == data.size();
+			if (stream != NULL) {
+				SDL_RWclose(stream);
+			}
+			++runs;
+		} while ((SDL_GetPerformanceCounter() - start) * 1000.0 / frequency < BENCHMARK_MS);
+		double streamSeconds = (SDL_GetPerformanceCounter() - start) / frequency / runs;
+		match = match && unpacked == data;
+
+		double megabytes = data.size() / (1024.0 * 1024.0);
+		printf("%-32s %10u %10u %6.2fx %12.1f %12.1f %12.1f%s\n", path.c_str(), (Uint32)data.size(), (Uint32)compressed.size(), (double)data.size() / compressed.size(), megabytes / packSeconds, megabytes / unpackSeconds, megabytes / streamSeconds, match ? "" : " MISMATCH");
+	}
+}
+
 int main(int argc, char* args[])
 {
+	// Compression tools that don't need a window
+	if (argc > 1 && (strcmp(args[1], "--compress") == 0 || strcmp(args[1], "--benchmark") == 0)) {
+		SDL_Init(0);
+		if (strcmp(args[1], "--compress") == 0) {
+			for (int i = 2; i < argc; ++i) {
+				compressFile(args[i]);
+			}
+		}
+		else {
+			runCompressionBenchmark(argc - 2, args + 2);
+		}
+		SDL_Quit();
+		return 0;
+	}
+
 	//Start up SDL and create window
 	if (!init())
 	{
@@ -827,6 +1641,17 @@ int main(int argc, char* args[])
 			//Level camera
 			SDL_Rect camera = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
 
+			// Index the dot alongside any other entities
+			int dotHandle = gEntityGrid.insert(dot.getBox());
+
+			// Tiles and entities visible through the camera this frame
+			std::vector<int> visibleTiles;
+			std::vector<int> visibleEntities;
+			visibleTiles.reserve(TOTAL_TILES);
+
+			// Time the culling statistics were last shown
+			Uint32 statsTime = 0;
+
 			//While application is running
 			while (!quit)
 			{
@@ -845,18 +1670,35 @@ int main(int argc, char* args[])
 				// Move the dot
 				dot.move(tileSet);
 				dot.setCamera(camera);
+				gEntityGrid.update(dotHandle, dot.getBox());
 
 				// Clear screen
 				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
 				SDL_RenderClear(gRenderer);
 
-				// Render level
-				for (int i = 0; i < TOTAL_TILES; ++i) {
-					tileSet[i]->render(camera);
+				// Render only the tiles under the camera
+				gTileGrid.query(camera, visibleTiles);
+				for (size_t i = 0; i < visibleTiles.size(); ++i) {
+					tileSet[visibleTiles[i]]->render(camera);
 				}
 
-				// Render dot
-				dot.render(camera);
+				// Render the entities under the camera
+				gEntityGrid.query(camera, visibleEntities);
+				for (size_t i = 0; i < visibleEntities.size(); ++i) {
+					if (visibleEntities[i] == dotHandle) {
+						dot.render(camera);
+					}
+				}
+
+				// Show the culling statistics once a second
+				if (SDL_GetTicks() - statsTime >= 1000) {
+					CullStats tileStats = gTileGrid.getStats();
+					CullStats entityStats = gEntityGrid.getStats();
+					std::stringstream caption;
+					caption << "SDL Tutorial - Drawn: " << tileStats.drawn + entityStats.drawn << " Culled: " << tileStats.culled + entityStats.culled << " Tested: " << tileStats.tested + entityStats.tested << " of " << tileStats.total + entityStats.total;
+					SDL_SetWindowTitle(gWindow, caption.str().c_str());
+					statsTime = SDL_GetTicks();
+				}
 
 				// Update screen
 				SDL_RenderPresent(gRenderer);
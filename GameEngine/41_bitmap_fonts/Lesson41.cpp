@@ -12,6 +12,13 @@ and may not be redistributed without written permission.*/
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Font metrics cache identifier "LFNT" and format version
+const Uint32 FONT_CACHE_MAGIC = 0x544E464C;
+const Uint32 FONT_CACHE_VERSION = 1;
+
+// Cache is magic, version, image hash, new line, space, then x, y, w, h for every character
+const int FONT_CACHE_WORDS = 5 + 256 * 4;
+
 //Texture wrapper class
 class LTexture
 {
@@ -79,7 +86,7 @@ public:
 	// Default constructor
 	LBitmapFont();
 
-	// Generates font
+	// Generates font, reusing cached metrics when the image hasn't changed
 	bool buildFont(std::string path);
 
 	// Deallocates font
@@ -90,6 +97,16 @@ public:
 
 private:
 
+	// Measures the characters in one pass over the loaded pixels
+	void scanMetrics();
+
+	// Reads and writes the metrics sidecar for an image hash
+	bool loadMetrics(std::string path, Uint32 hash);
+	void saveMetrics(std::string path, Uint32 hash);
+
+	// Hashes the image file's bytes
+	static Uint32 hashFile(std::string path);
+
 	// The font texture
 	LTexture mFontTexture;
 
@@ -348,175 +365,208 @@ LBitmapFont::LBitmapFont() {
 
 bool LBitmapFont::buildFont(std::string path) {
 
-		//Get rid of preexisting texture
-		free();
+	// Get rid of preexisting texture
+	free();
 
-		//Load bitmap image
-		bool success = true;
-		if (!mFontTexture.loadPixelsFromFile(path))
-		{
-			printf("Unable to load bitmap font surface!\n");
+	// Metrics are cached next to the image and keyed by its contents
+	std::string cachePath = path + ".metrics";
+	Uint32 hash = hashFile(path);
+
+	// With cached metrics the pixels only need uploading
+	bool success = true;
+	if (hash != 0 && loadMetrics(cachePath, hash)) {
+		if (!mFontTexture.loadFromFile(path)) {
+			printf("Unable to create font texture!\n");
 			success = false;
 		}
-		else
-		{
-			//Get the background color
-			Uint32 bgColor = mFontTexture.getPixel32(0, 0);
+	}
+
+	// Otherwise measure the characters before the pixels are released
+	else if (!mFontTexture.loadPixelsFromFile(path)) {
+		printf("Unable to load bitmap font surface!\n");
+		success = false;
+	}
+	else {
+		scanMetrics();
+		if (hash != 0) {
+			saveMetrics(cachePath, hash);
+		}
+
+		// Create final texture
+		if (!mFontTexture.loadFromPixels()) {
+			printf("Unable to create font texture!\n");
+			success = false;
+		}
+	}
 
-			//Set the cell dimensions
-			int cellW = mFontTexture.getWidth() / 16;
-			int cellH = mFontTexture.getHeight() / 16;
+	return success;
+}
 
-			//New line variables
-			int top = cellH;
-			int baseA = cellH;
+void LBitmapFont::scanMetrics() {
 
-			//The current character we're setting
-			int currentChar = 0;
+	// Get the pixels and pitch once instead of per pixel
+	Uint32* pixels = mFontTexture.getPixels32();
+	int pitch = mFontTexture.getPitch32();
 
-			//Go through the cell rows
-			for (int rows = 0; rows < 16; ++rows)
-			{
-				//Go through the cell columns
-				for (int cols = 0; cols < 16; ++cols)
-				{
-					//Set the character offset
-					mChars[currentChar].x = cellW * cols;
-					mChars[currentChar].y = cellH * rows;
+	// Get the background color
+	Uint32 bgColor = pixels[0];
 
-					//Set the dimensions of the character
-					mChars[currentChar].w = cellW;
-					mChars[currentChar].h = cellH;
+	// Set the cell dimensions
+	int cellW = mFontTexture.getWidth() / 16;
+	int cellH = mFontTexture.getHeight() / 16;
 
-					//Find Left Side
-					//Go through pixel columns
-					for (int pCol = 0; pCol < cellW; ++pCol)
-					{
-						//Go through pixel rows
-						for (int pRow = 0; pRow < cellH; ++pRow)
-						{
-							//Get the pixel offsets
-							int pX = (cellW * cols) + pCol;
-							int pY = (cellH * rows) + pRow;
-
-							//If a non colorkey pixel is found
-							if (mFontTexture.getPixel32(pX, pY) != bgColor)
-							{
-								//Set the x offset
-								mChars[currentChar].x = pX;
-
-								//Break the loops
-								pCol = cellW;
-								pRow = cellH;
-							}
-						}
-					}
+	// New line variables
+	int top = cellH;
+	int baseA = cellH;
 
-					//Find Right Side
-					//Go through pixel columns
-					for (int pColW = cellW - 1; pColW >= 0; --pColW)
-					{
-						//Go through pixel rows
-						for (int pRowW = 0; pRowW < cellH; ++pRowW)
-						{
-							//Get the pixel offsets
-							int pX = (cellW * cols) + pColW;
-							int pY = (cellH * rows) + pRowW;
-
-							//If a non colorkey pixel is found
-							if (mFontTexture.getPixel32(pX, pY) != bgColor)
-							{
-								//Set the width
-								mChars[currentChar].w = (pX - mChars[currentChar].x) + 1;
-
-								//Break the loops
-								pColW = -1;
-								pRowW = cellH;
-							}
-						}
-					}
+	// Go through the cell rows
+	for (int rows = 0; rows < 16; ++rows) {
 
-					//Find Top
-					//Go through pixel rows
-					for (int pRow = 0; pRow < cellH; ++pRow)
-					{
-						//Go through pixel columns
-						for (int pCol = 0; pCol < cellW; ++pCol)
-						{
-							//Get the pixel offsets
-							int pX = (cellW * cols) + pCol;
-							int pY = (cellH * rows) + pRow;
-
-							//If a non colorkey pixel is found
-							if (mFontTexture.getPixel32(pX, pY) != bgColor)
-							{
-								//If new top is found
-								if (pRow < top)
-								{
-									top = pRow;
-								}
-
-								//Break the loops
-								pCol = cellW;
-								pRow = cellH;
-							}
-						}
-					}
+		// Leftmost and rightmost ink found in each cell of the row
+		int left[16], right[16];
+		for (int cols = 0; cols < 16; ++cols) {
+			left[cols] = cellW;
+			right[cols] = -1;
+		}
 
-					//Find Bottom of A
-					if (currentChar == 'A')
-					{
-						//Go through pixel rows
-						for (int pRow = cellH - 1; pRow >= 0; --pRow)
-						{
-							//Go through pixel columns
-							for (int pCol = 0; pCol < cellW; ++pCol)
-							{
-								//Get the pixel offsets
-								int pX = (cellW * cols) + pCol;
-								int pY = (cellH * rows) + pRow;
-
-								//If a non colorkey pixel is found
-								if (mFontTexture.getPixel32(pX, pY) != bgColor)
-								{
-									//Bottom of a is found
-									baseA = pRow;
-
-									//Break the loops
-									pCol = cellW;
-									pRow = -1;
-								}
-							}
-						}
-					}
+		// Walk the pixel rows in memory order, measuring every cell along the way
+		for (int pRow = 0; pRow < cellH; ++pRow) {
+			Uint32* row = pixels + (cellH * rows + pRow) * pitch;
+			for (int cols = 0; cols < 16; ++cols) {
+				Uint32* cell = row + cellW * cols;
 
-					//Go to the next character
-					++currentChar;
+				// Find the first ink from the left
+				int first = 0;
+				while (first < cellW && cell[first] == bgColor) {
+					++first;
+				}
+				if (first == cellW) {
+					continue;
 				}
-			}
 
-			//Calculate space
-			mSpace = cellW / 2;
+				// Find the last ink from the right
+				int last = cellW - 1;
+				while (cell[last] == bgColor) {
+					--last;
+				}
 
-			//Calculate new line
-			mNewLine = baseA - top;
+				// Widen the cell's bounds
+				if (first < left[cols]) {
+					left[cols] = first;
+				}
+				if (last > right[cols]) {
+					right[cols] = last;
+				}
 
-			//Lop off excess top pixels
-			for (int i = 0; i < 256; ++i)
-			{
-				mChars[i].y += top;
-				mChars[i].h -= top;
+				// Rows go top to bottom, so the first ink is the highest and the last ink in A is its base
+				if (pRow < top) {
+					top = pRow;
+				}
+				if (rows * 16 + cols == 'A') {
+					baseA = pRow;
+				}
 			}
+		}
 
-			//Create final texture
-			if (!mFontTexture.loadFromPixels())
-			{
-				printf("Unable to create font texture!\n");
-				success = false;
+		// Set the character clips, empty cells keep the whole cell
+		for (int cols = 0; cols < 16; ++cols) {
+			SDL_Rect& clip = mChars[rows * 16 + cols];
+			clip.x = cellW * cols;
+			clip.y = cellH * rows;
+			clip.w = cellW;
+			clip.h = cellH;
+			if (right[cols] >= 0) {
+				clip.x += left[cols];
+				clip.w = right[cols] - left[cols] + 1;
 			}
 		}
+	}
+
+	// Calculate space
+	mSpace = cellW / 2;
+
+	// Calculate new line
+	mNewLine = baseA - top;
+
+	// Lop off excess top pixels
+	for (int i = 0; i < 256; ++i) {
+		mChars[i].y += top;
+		mChars[i].h -= top;
+	}
+}
+
+bool LBitmapFont::loadMetrics(std::string path, Uint32 hash) {
+
+	// Read the whole cache in one go
+	Uint32 words[FONT_CACHE_WORDS];
+	SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+	if (file == NULL) {
+		return false;
+	}
+	bool read = SDL_RWread(file, words, sizeof(words), 1) == 1;
+	SDL_RWclose(file);
 
-		return success;
+	// Stale or foreign caches get rebuilt
+	for (int i = 0; i < FONT_CACHE_WORDS; ++i) {
+		words[i] = SDL_SwapLE32(words[i]);
+	}
+	if (!read || words[0] != FONT_CACHE_MAGIC || words[1] != FONT_CACHE_VERSION || words[2] != hash) {
+		return false;
+	}
+
+	// Set the metrics
+	mNewLine = (Sint32)words[3];
+	mSpace = (Sint32)words[4];
+	for (int i = 0; i < 256; ++i) {
+		mChars[i].x = (Sint32)words[5 + i * 4];
+		mChars[i].y = (Sint32)words[6 + i * 4];
+		mChars[i].w = (Sint32)words[7 + i * 4];
+		mChars[i].h = (Sint32)words[8 + i * 4];
+	}
+	return true;
+}
+
+void LBitmapFont::saveMetrics(std::string path, Uint32 hash) {
+
+	// Pack the metrics
+	Uint32 words[FONT_CACHE_WORDS] = { FONT_CACHE_MAGIC, FONT_CACHE_VERSION, hash, (Uint32)mNewLine, (Uint32)mSpace };
+	for (int i = 0; i < 256; ++i) {
+		words[5 + i * 4] = (Uint32)mChars[i].x;
+		words[6 + i * 4] = (Uint32)mChars[i].y;
+		words[7 + i * 4] = (Uint32)mChars[i].w;
+		words[8 + i * 4] = (Uint32)mChars[i].h;
+	}
+	for (int i = 0; i < FONT_CACHE_WORDS; ++i) {
+		words[i] = SDL_SwapLE32(words[i]);
+	}
+
+	// A failed write just means measuring again next time
+	SDL_RWops* file = SDL_RWFromFile(path.c_str(), "wb");
+	if (file == NULL) {
+		printf("Unable to write font metrics %s! SDL Error: %s\n", path.c_str(), SDL_GetError());
+		return;
+	}
+	SDL_RWwrite(file, words, sizeof(words), 1);
+	SDL_RWclose(file);
+}
+
+Uint32 LBitmapFont::hashFile(std::string path) {
+
+	// FNV-1a over the file, zero if it can't be read
+	SDL_RWops* file = SDL_RWFromFile(path.c_str(), "rb");
+	if (file == NULL) {
+		return 0;
+	}
+	Uint32 hash = 2166136261U;
+	Uint8 buffer[4096];
+	size_t read;
+	while ((read = SDL_RWread(file, buffer, 1, sizeof(buffer))) > 0) {
+		for (size_t i = 0; i < read; ++i) {
+			hash = (hash ^ buffer[i]) * 16777619U;
+		}
+	}
+	SDL_RWclose(file);
+	return hash;
 }
 
 void LBitmapFont::free()
@@ -5,13 +5,31 @@ and may not be redistributed without written permission.*/
 #include <SDL.h>
 #include <SDL_image.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <string>
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <list>
+#include <map>
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Debug draw colors
+const SDL_Color DEBUG_RED = { 0xFF, 0x00, 0x00, 0xFF };
+const SDL_Color DEBUG_GREEN = { 0x00, 0xFF, 0x00, 0xFF };
+const SDL_Color DEBUG_BLUE = { 0x00, 0x00, 0xFF, 0xFF };
+const SDL_Color DEBUG_YELLOW = { 0xFF, 0xFF, 0x00, 0xFF };
+
+// Angle steps per turn for cached rotations, and memory for them, enough for a whole turn of the screen texture
+const int ROTATION_CACHE_STEPS = 60;
+const size_t ROTATION_CACHE_BUDGET = (size_t)ROTATION_CACHE_STEPS * 800 * 800 * 4;
+
+class LRotationCache;
+
 //Texture wrapper class
 class LTexture
 {
@@ -57,6 +75,9 @@ public:
 	// Set self as render target
 	void setAsRenderTarget();
 
+	// Draws rotations through a cache, NULL to rotate every draw
+	void setRotationCache(LRotationCache* cache);
+
 	//Gets image dimensions
 	int getWidth();
 	int getHeight();
@@ -83,6 +104,134 @@ private:
 	// Raw pixels
 	void* mRawPixels;
 	int mRawPitch;
+
+	// Where rotated variants come from, if anywhere
+	LRotationCache* mRotationCache;
+};
+
+// Immediate mode debug drawing, primitives are queued per color and drawn a batch at a time
+class LDebugDraw {
+public:
+	// Initializes variables
+	LDebugDraw();
+
+	// Queue primitives in a color
+	void point(int x, int y, SDL_Color color);
+	void line(int x1, int y1, int x2, int y2, SDL_Color color);
+	void rect(SDL_Rect box, SDL_Color color);
+	void fillRect(SDL_Rect box, SDL_Color color);
+
+	// Draws everything queued, fills first then outlines, lines and points, and empties the queue
+	void flush(SDL_Renderer* renderer);
+
+	// Gets the number of SDL draw calls the last flush made
+	int getDrawCalls();
+
+private:
+	// Everything queued in one color
+	struct Batch {
+		SDL_Color color;
+		std::vector<SDL_Point> points;
+		std::vector<SDL_Rect> rects;
+		std::vector<SDL_Rect> fillRects;
+
+		// Lines are kept as strips, a segment starting where the last ended extends the strip
+		std::vector<SDL_Point> lines;
+		std::vector<int> stripStarts;
+	};
+
+	// Finds or adds the batch for a color
+	Batch& getBatch(SDL_Color color);
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	// Queues the triangles of a quad, corners in order around it
+	void addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, SDL_Color color);
+
+	// Queues a one pixel wide line through the centres of the pixels from a to b
+	void addLine(SDL_Point a, SDL_Point b, SDL_Color color);
+
+	// Queues everything as triangles and draws them in one call, false if the renderer refuses
+	bool flushGeometry(SDL_Renderer* renderer);
+
+	// Triangles for the geometry path, kept between frames
+	std::vector<SDL_Vertex> mVertices;
+	std::vector<int> mIndices;
+#endif
+
+	// Batches in the order their colors were first used
+	std::vector<Batch> mBatches;
+	int mLastBatch;
+
+	// Draw calls made by the last flush
+	int mDrawCalls;
+};
+
+// Pre-rotated copies of textures at a fixed number of angle steps, least recently used go first once over budget
+class LRotationCache {
+public:
+	// Initializes variables
+	LRotationCache();
+
+	// Deallocates memory
+	~LRotationCache();
+
+	// Sets how many angle steps make a full turn and how many bytes of variants to keep
+	void init(int steps, size_t budget);
+
+	// Frees every variant
+	void free();
+
+	// Drops the variants of a texture whose pixels changed or that is being destroyed
+	void invalidate(SDL_Texture* texture);
+
+	// Draws like SDL_RenderCopyEx, but from a variant rotated to the nearest angle step
+	void render(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, const SDL_Rect* dst, double angle, const SDL_Point* center, SDL_RendererFlip flip);
+
+	// Gets how often draws found their variant, and the memory held
+	int getHits();
+	int getMisses();
+	size_t getBytes();
+	void resetStats();
+
+private:
+	// What a variant was made from
+	struct VariantKey {
+		SDL_Texture* texture;
+
+		// Clip x, y, w, h, drawn width and height, angle step and flip
+		int values[8];
+
+		bool operator<(const VariantKey& other) const;
+	};
+
+	// A rotated copy
+	struct Variant {
+		VariantKey key;
+		SDL_Texture* texture;
+		int width;
+		int height;
+		size_t bytes;
+	};
+
+	// Renders a new variant, returns false if it can't be cached
+	bool createVariant(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, int width, int height, double angle, SDL_RendererFlip flip, Variant& variant);
+
+	// Frees variants from the back of the list until within budget
+	void trim();
+
+	// Variants most recently used first, and an index into them
+	std::list<Variant> mVariants;
+	std::map<VariantKey, std::list<Variant>::iterator> mIndex;
+
+	// The renderer the variants belong to
+	SDL_Renderer* mRenderer;
+
+	// Settings and stats
+	int mSteps;
+	size_t mBudget;
+	size_t mBytes;
+	int mHits;
+	int mMisses;
 };
 
 //Starts up SDL and creates window
@@ -94,6 +243,9 @@ bool loadMedia();
 //Frees media and shuts down SDL
 void close();
 
+// Draws the shapes into the target texture
+void drawScene();
+
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
@@ -103,6 +255,13 @@ SDL_Renderer* gRenderer = NULL;
 // The blank texture
 LTexture gTargetTexture;
 
+// Queued debug shapes
+LDebugDraw gDebugDraw;
+
+// Rotated copies of the target texture, used with --rotation-cache
+LRotationCache gRotationCache;
+bool gUseRotationCache = false;
+
 LTexture::LTexture()
 {
 	//Initialize
@@ -113,6 +272,7 @@ LTexture::LTexture()
 	mSurfacePixels = NULL;
 	mRawPixels = NULL;
 	mRawPitch = 0;
+	mRotationCache = NULL;
 }
 
 LTexture::~LTexture()
@@ -256,6 +416,9 @@ void LTexture::free()
 	//Free texture if it exists
 	if (mTexture != NULL)
 	{
+		if (mRotationCache != NULL) {
+			mRotationCache->invalidate(mTexture);
+		}
 		SDL_DestroyTexture(mTexture);
 		mTexture = NULL;
 		mWidth = 0;
@@ -299,16 +462,34 @@ void LTexture::render(int x, int y, SDL_Rect* clip, double angle, SDL_Point* cen
 		renderQuad.h = clip->h;
 	}
 
-	//Render to screen
-	SDL_RenderCopyEx(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
+	//Render to screen, rotated copies come from the cache when there is one
+	if (mRotationCache != NULL && (angle != 0.0 || flip != SDL_FLIP_NONE)) {
+		mRotationCache->render(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
+	}
+	else {
+		SDL_RenderCopyEx(gRenderer, mTexture, clip, &renderQuad, angle, center, flip);
+	}
 }
 
 void LTexture::setAsRenderTarget() {
 
+	// Rotated copies of the old contents are stale
+	if (mRotationCache != NULL) {
+		mRotationCache->invalidate(mTexture);
+	}
+
 	// Make self render target
 	SDL_SetRenderTarget(gRenderer, mTexture);
 }
 
+void LTexture::setRotationCache(LRotationCache* cache) {
+	// Variants in the old cache won't be used again
+	if (mRotationCache != NULL && mTexture != NULL) {
+		mRotationCache->invalidate(mTexture);
+	}
+	mRotationCache = cache;
+}
+
 int LTexture::getWidth()
 {
 	return mWidth;
@@ -399,6 +580,464 @@ void LTexture::copyRawPixels32(void* pixels) {
 	}
 }
 
+bool LRotationCache::VariantKey::operator<(const VariantKey& other) const {
+	if (texture != other.texture) {
+		return texture < other.texture;
+	}
+	return memcmp(values, other.values, sizeof(values)) < 0;
+}
+
+LRotationCache::LRotationCache() {
+	// Initialize
+	mRenderer = NULL;
+	mSteps = 0;
+	mBudget = 0;
+	mBytes = 0;
+	mHits = 0;
+	mMisses = 0;
+}
+
+LRotationCache::~LRotationCache() {
+	// Deallocate
+	free();
+}
+
+void LRotationCache::init(int steps, size_t budget) {
+	// Variants made at the old steps are no use
+	free();
+	mSteps = steps;
+	mBudget = budget;
+	resetStats();
+}
+
+void LRotationCache::free() {
+	// Free every variant
+	for (std::list<Variant>::iterator it = mVariants.begin(); it != mVariants.end(); ++it) {
+		SDL_DestroyTexture(it->texture);
+	}
+	mVariants.clear();
+	mIndex.clear();
+	mBytes = 0;
+	mRenderer = NULL;
+}
+
+void LRotationCache::invalidate(SDL_Texture* texture) {
+	std::list<Variant>::iterator it = mVariants.begin();
+	while (it != mVariants.end()) {
+		if (it->key.texture == texture) {
+			SDL_DestroyTexture(it->texture);
+			mBytes -= it->bytes;
+			mIndex.erase(it->key);
+			it = mVariants.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void LRotationCache::render(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, const SDL_Rect* dst, double angle, const SDL_Point* center, SDL_RendererFlip flip) {
+	// Without steps or render targets there is nothing to cache
+	if (mSteps <= 0 || dst == NULL || !SDL_RenderTargetSupported(renderer)) {
+		SDL_RenderCopyEx(renderer, texture, clip, dst, angle, center, flip);
+		return;
+	}
+
+	// Variants only draw on the renderer that made them
+	if (renderer != mRenderer) {
+		free();
+		mRenderer = renderer;
+	}
+
+	// Nearest angle step, an unflipped step 0 is a plain copy
+	int step = (int)floor(angle * mSteps / 360.0 + 0.5) % mSteps;
+	if (step < 0) {
+		step += mSteps;
+	}
+	if (step == 0 && flip == SDL_FLIP_NONE) {
+		SDL_RenderCopy(renderer, texture, clip, dst);
+		return;
+	}
+	double radians = step * 2.0 * M_PI / mSteps;
+
+	// Find the variant, making it if it's new
+	VariantKey key;
+	key.texture = texture;
+	key.values[0] = clip != NULL ? clip->x : 0;
+	key.values[1] = clip != NULL ? clip->y : 0;
+	key.values[2] = clip != NULL ? clip->w : -1;
+	key.values[3] = clip != NULL ? clip->h : -1;
+	key.values[4] = dst->w;
+	key.values[5] = dst->h;
+	key.values[6] = step;
+	key.values[7] = flip;
+	std::map<VariantKey, std::list<Variant>::iterator>::iterator found = mIndex.find(key);
+	if (found != mIndex.end()) {
+		// Most recently used goes to the front
+		mVariants.splice(mVariants.begin(), mVariants, found->second);
+		++mHits;
+	}
+	else {
+		++mMisses;
+		Variant variant;
+		variant.key = key;
+		if (!createVariant(renderer, texture, clip, dst->w, dst->h, step * 360.0 / mSteps, flip, variant)) {
+			SDL_RenderCopyEx(renderer, texture, clip, dst, angle, center, flip);
+			return;
+		}
+		mVariants.push_front(variant);
+		mIndex[key] = mVariants.begin();
+		mBytes += variant.bytes;
+		trim();
+	}
+	Variant& variant = mVariants.front();
+
+	// Carry the texture's current modulation over to the copy
+	Uint8 r, g, b, a;
+	SDL_BlendMode blendMode;
+	SDL_GetTextureColorMod(texture, &r, &g, &b);
+	SDL_GetTextureAlphaMod(texture, &a);
+	SDL_GetTextureBlendMode(texture, &blendMode);
+	SDL_SetTextureColorMod(variant.texture, r, g, b);
+	SDL_SetTextureAlphaMod(variant.texture, a);
+	SDL_SetTextureBlendMode(variant.texture, blendMode == SDL_BLENDMODE_NONE ? SDL_BLENDMODE_BLEND : blendMode);
+
+	// The variant is rotated about its middle, shift it for any other centre
+	double middleX = dst->w / 2.0;
+	double middleY = dst->h / 2.0;
+	double offsetX = center != NULL ? center->x - middleX : 0.0;
+	double offsetY = center != NULL ? center->y - middleY : 0.0;
+	double cosine = cos(radians);
+	double sine = sin(radians);
+	double x = dst->x + middleX + offsetX - (offsetX * cosine - offsetY * sine) - variant.width / 2.0;
+	double y = dst->y + middleY + offsetY - (offsetX * sine + offsetY * cosine) - variant.height / 2.0;
+	SDL_Rect renderQuad = { (int)floor(x + 0.5), (int)floor(y + 0.5), variant.width, variant.height };
+	SDL_RenderCopy(renderer, variant.texture, NULL, &renderQuad);
+}
+
+bool LRotationCache::createVariant(SDL_Renderer* renderer, SDL_Texture* texture, const SDL_Rect* clip, int width, int height, double angle, SDL_RendererFlip flip, Variant& variant) {
+	// Bounding box of the rotated rectangle
+	double radians = angle * M_PI / 180.0;
+	double cosine = fabs(cos(radians));
+	double sine = fabs(sin(radians));
+	variant.width = (int)ceil(width * cosine + height * sine - 0.001);
+	variant.height = (int)ceil(width * sine + height * cosine - 0.001);
+	variant.bytes = (size_t)variant.width * variant.height * 4;
+
+	// Too big to ever fit
+	if (variant.bytes > mBudget) {
+		return false;
+	}
+
+	variant.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, variant.width, variant.height);
+	if (variant.texture == NULL) {
+		printf("Unable to create rotation cache texture! SDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	// Rotate once into a clear target, copying pixels as they are so modulation can be applied later
+	SDL_Texture* oldTarget = SDL_GetRenderTarget(renderer);
+	Uint8 oldR, oldG, oldB, oldA;
+	SDL_GetRenderDrawColor(renderer, &oldR, &oldG, &oldB, &oldA);
+	Uint8 r, g, b, a;
+	SDL_BlendMode blendMode;
+	SDL_GetTextureColorMod(texture, &r, &g, &b);
+	SDL_GetTextureAlphaMod(texture, &a);
+	SDL_GetTextureBlendMode(texture, &blendMode);
+
+	SDL_SetRenderTarget(renderer, variant.texture);
+	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
+	SDL_RenderClear(renderer);
+	SDL_SetTextureColorMod(texture, 0xFF, 0xFF, 0xFF);
+	SDL_SetTextureAlphaMod(texture, 0xFF);
+	SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+	SDL_Rect renderQuad = { (variant.width - width) / 2, (variant.height - height) / 2, width, height };
+	SDL_RenderCopyEx(renderer, texture, clip, &renderQuad, angle, NULL, flip);
+
+	// Put everything back
+	SDL_SetTextureColorMod(texture, r, g, b);
+	SDL_SetTextureAlphaMod(texture, a);
+	SDL_SetTextureBlendMode(texture, blendMode);
+	SDL_SetRenderTarget(renderer, oldTarget);
+	SDL_SetRenderDrawColor(renderer, oldR, oldG, oldB, oldA);
+	return true;
+}
+
+void LRotationCache::trim() {
+	// Keep at least the variant just drawn
+	while (mBytes > mBudget && mVariants.size() > 1) {
+		Variant& oldest = mVariants.back();
+		SDL_DestroyTexture(oldest.texture);
+		mBytes -= oldest.bytes;
+		mIndex.erase(oldest.key);
+		mVariants.pop_back();
+	}
+}
+
+int LRotationCache::getHits() {
+	return mHits;
+}
+
+int LRotationCache::getMisses() {
+	return mMisses;
+}
+
+size_t LRotationCache::getBytes() {
+	return mBytes;
+}
+
+void LRotationCache::resetStats() {
+	mHits = 0;
+	mMisses = 0;
+}
+
+LDebugDraw::LDebugDraw() {
+	// Initialize
+	mLastBatch = 0;
+	mDrawCalls = 0;
+}
+
+void LDebugDraw::point(int x, int y, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	SDL_Point p = { x, y };
+	getBatch(color).points.push_back(p);
+#endif
+}
+
+void LDebugDraw::line(int x1, int y1, int x2, int y2, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	Batch& batch = getBatch(color);
+
+	// Start a new strip unless this segment carries on from the last one
+	if (batch.lines.empty() || batch.lines.back().x != x1 || batch.lines.back().y != y1) {
+		SDL_Point start = { x1, y1 };
+		batch.stripStarts.push_back((int)batch.lines.size());
+		batch.lines.push_back(start);
+	}
+	SDL_Point end = { x2, y2 };
+	batch.lines.push_back(end);
+#endif
+}
+
+void LDebugDraw::rect(SDL_Rect box, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	getBatch(color).rects.push_back(box);
+#endif
+}
+
+void LDebugDraw::fillRect(SDL_Rect box, SDL_Color color) {
+#if !defined(DISABLE_DEBUG_DRAW)
+	getBatch(color).fillRects.push_back(box);
+#endif
+}
+
+void LDebugDraw::flush(SDL_Renderer* renderer) {
+	mDrawCalls = 0;
+#if !defined(DISABLE_DEBUG_DRAW)
+	// Keep the caller's draw color
+	Uint8 r, g, b, a;
+	SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+	// Every primitive as quads in a single call, per-draw calls only if that fails
+	bool drawn = flushGeometry(renderer);
+#else
+	bool drawn = false;
+#endif
+
+	// Layer by kind so the result doesn't depend on the order colors were used
+	for (int pass = 0; !drawn && pass < 4; ++pass) {
+		for (size_t i = 0; i < mBatches.size(); ++i) {
+			Batch& batch = mBatches[i];
+			bool empty = (pass == 0 && batch.fillRects.empty()) || (pass == 1 && batch.rects.empty()) || (pass == 2 && batch.lines.empty()) || (pass == 3 && batch.points.empty());
+			if (empty) {
+				continue;
+			}
+			SDL_SetRenderDrawColor(renderer, batch.color.r, batch.color.g, batch.color.b, batch.color.a);
+			if (pass == 0) {
+				SDL_RenderFillRects(renderer, &batch.fillRects[0], (int)batch.fillRects.size());
+				++mDrawCalls;
+			}
+			else if (pass == 1) {
+				SDL_RenderDrawRects(renderer, &batch.rects[0], (int)batch.rects.size());
+				++mDrawCalls;
+			}
+			else if (pass == 2) {
+				for (size_t s = 0; s < batch.stripStarts.size(); ++s) {
+					int start = batch.stripStarts[s];
+					int end = s + 1 < batch.stripStarts.size() ? batch.stripStarts[s + 1] : (int)batch.lines.size();
+					SDL_RenderDrawLines(renderer, &batch.lines[start], end - start);
+					++mDrawCalls;
+				}
+			}
+			else {
+				SDL_RenderDrawPoints(renderer, &batch.points[0], (int)batch.points.size());
+				++mDrawCalls;
+			}
+		}
+	}
+	SDL_SetRenderDrawColor(renderer, r, g, b, a);
+
+	// Empty the queue but keep the memory for the next frame, dropping colors that went unused
+	size_t kept = 0;
+	for (size_t i = 0; i < mBatches.size(); ++i) {
+		Batch& batch = mBatches[i];
+		bool used = !batch.points.empty() || !batch.rects.empty() || !batch.fillRects.empty() || !batch.lines.empty();
+		batch.points.clear();
+		batch.rects.clear();
+		batch.fillRects.clear();
+		batch.lines.clear();
+		batch.stripStarts.clear();
+		if (used) {
+			if (kept != i) {
+				std::swap(mBatches[kept], batch);
+			}
+			++kept;
+		}
+	}
+	mBatches.resize(kept);
+	mLastBatch = 0;
+#endif
+}
+
+int LDebugDraw::getDrawCalls() {
+	return mDrawCalls;
+}
+
+#if SDL_VERSION_ATLEAST(2,0,18)
+void LDebugDraw::addQuad(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, SDL_Color color) {
+	int first = (int)mVertices.size();
+	SDL_Vertex corners[4] = {
+		{ { x1, y1 }, color, { 0.0f, 0.0f } },
+		{ { x2, y2 }, color, { 0.0f, 0.0f } },
+		{ { x3, y3 }, color, { 0.0f, 0.0f } },
+		{ { x4, y4 }, color, { 0.0f, 0.0f } }
+	};
+	mVertices.insert(mVertices.end(), corners, corners + 4);
+	int indices[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+	mIndices.insert(mIndices.end(), indices, indices + 6);
+}
+
+void LDebugDraw::addLine(SDL_Point a, SDL_Point b, SDL_Color color) {
+	// A band one pixel across the minor axis, covering one pixel per step along the major axis like a drawn line
+	int dx = b.x - a.x;
+	int dy = b.y - a.y;
+	if (SDL_abs(dx) >= SDL_abs(dy)) {
+		if (dx < 0) {
+			std::swap(a, b);
+			dx = -dx;
+			dy = -dy;
+		}
+		float slope = dx != 0 ? (float)dy / dx : 0.0f;
+		float y1 = a.y - slope * 0.5f;
+		float y2 = b.y + slope * 0.5f;
+		addQuad((float)a.x, y1, (float)b.x + 1, y2, (float)b.x + 1, y2 + 1, (float)a.x, y1 + 1, color);
+	}
+	else {
+		if (dy < 0) {
+			std::swap(a, b);
+			dx = -dx;
+			dy = -dy;
+		}
+		float slope = (float)dx / dy;
+		float x1 = a.x - slope * 0.5f;
+		float x2 = b.x + slope * 0.5f;
+		addQuad(x1, (float)a.y, x1 + 1, (float)a.y, x2 + 1, (float)b.y + 1, x2, (float)b.y + 1, color);
+	}
+}
+
+bool LDebugDraw::flushGeometry(SDL_Renderer* renderer) {
+	// Same layering as the draw calls, triangles are drawn in the order they're queued
+	mVertices.clear();
+	mIndices.clear();
+	for (int pass = 0; pass < 4; ++pass) {
+		for (size_t i = 0; i < mBatches.size(); ++i) {
+			Batch& batch = mBatches[i];
+			SDL_Color color = batch.color;
+			if (pass == 0) {
+				for (size_t r = 0; r < batch.fillRects.size(); ++r) {
+					SDL_Rect& box = batch.fillRects[r];
+					if (box.w > 0 && box.h > 0) {
+						addQuad((float)box.x, (float)box.y, (float)(box.x + box.w), (float)box.y, (float)(box.x + box.w), (float)(box.y + box.h), (float)box.x, (float)(box.y + box.h), color);
+					}
+				}
+			}
+			else if (pass == 1) {
+				// Top and bottom edges, then the sides between them so corners aren't covered twice
+				for (size_t r = 0; r < batch.rects.size(); ++r) {
+					SDL_Rect& box = batch.rects[r];
+					if (box.w <= 0 || box.h <= 0) {
+						continue;
+					}
+					float left = (float)box.x;
+					float top = (float)box.y;
+					float right = (float)(box.x + box.w);
+					float bottom = (float)(box.y + box.h);
+					addQuad(left, top, right, top, right, top + 1, left, top + 1, color);
+					if (box.h > 1) {
+						addQuad(left, bottom - 1, right, bottom - 1, right, bottom, left, bottom, color);
+					}
+					if (box.h > 2) {
+						addQuad(left, top + 1, left + 1, top + 1, left + 1, bottom - 1, left, bottom - 1, color);
+						if (box.w > 1) {
+							addQuad(right - 1, top + 1, right, top + 1, right, bottom - 1, right - 1, bottom - 1, color);
+						}
+					}
+				}
+			}
+			else if (pass == 2) {
+				// Joints between segments of a strip are covered twice, which only shows with translucent colors
+				for (size_t s = 0; s < batch.stripStarts.size(); ++s) {
+					int start = batch.stripStarts[s];
+					int end = s + 1 < batch.stripStarts.size() ? batch.stripStarts[s + 1] : (int)batch.lines.size();
+					for (int p = start; p + 1 < end; ++p) {
+						addLine(batch.lines[p], batch.lines[p + 1], color);
+					}
+				}
+			}
+			else {
+				for (size_t p = 0; p < batch.points.size(); ++p) {
+					float x = (float)batch.points[p].x;
+					float y = (float)batch.points[p].y;
+					addQuad(x, y, x + 1, y, x + 1, y + 1, x, y + 1, color);
+				}
+			}
+		}
+	}
+	if (mIndices.empty()) {
+		return true;
+	}
+	if (SDL_RenderGeometry(renderer, NULL, &mVertices[0], (int)mVertices.size(), &mIndices[0], (int)mIndices.size()) < 0) {
+		return false;
+	}
+	++mDrawCalls;
+	return true;
+}
+#endif
+
+LDebugDraw::Batch& LDebugDraw::getBatch(SDL_Color color) {
+	// Primitives tend to come in runs of one color
+	if (mLastBatch < (int)mBatches.size()) {
+		SDL_Color last = mBatches[mLastBatch].color;
+		if (last.r == color.r && last.g == color.g && last.b == color.b && last.a == color.a) {
+			return mBatches[mLastBatch];
+		}
+	}
+
+	// Otherwise look through the colors in use
+	for (size_t i = 0; i < mBatches.size(); ++i) {
+		SDL_Color other = mBatches[i].color;
+		if (other.r == color.r && other.g == color.g && other.b == color.b && other.a == color.a) {
+			mLastBatch = (int)i;
+			return mBatches[i];
+		}
+	}
+	mBatches.push_back(Batch());
+	mBatches.back().color = color;
+	mLastBatch = (int)mBatches.size() - 1;
+	return mBatches.back();
+}
+
 bool init()
 {
 	//Initialization flag
@@ -466,6 +1105,10 @@ bool loadMedia()
 		printf("Failed to create streaming texture!\n");
 		success = false;
 	}
+	else if (gUseRotationCache) {
+		gRotationCache.init(ROTATION_CACHE_STEPS, ROTATION_CACHE_BUDGET);
+		gTargetTexture.setRotationCache(&gRotationCache);
+	}
 
 	return success;
 }
@@ -475,6 +1118,7 @@ void close()
 
 	//Free loaded images
 	gTargetTexture.free();
+	gRotationCache.free();
 
 	//Destroy window	
 	SDL_DestroyRenderer(gRenderer);
@@ -487,8 +1131,42 @@ void close()
 	SDL_Quit();
 }
 
+void drawScene() {
+	// Set self as render target
+	gTargetTexture.setAsRenderTarget();
+
+	//Clear screen
+	SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
+	SDL_RenderClear(gRenderer);
+
+	// Render red filled quad
+	SDL_Rect fillRect = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
+	gDebugDraw.fillRect(fillRect, DEBUG_RED);
+
+	// Render green outlined quad
+	SDL_Rect outlineRect = { SCREEN_WIDTH / 6, SCREEN_HEIGHT / 6, SCREEN_WIDTH * 2 / 3, SCREEN_HEIGHT * 2 / 3 };
+	gDebugDraw.rect(outlineRect, DEBUG_GREEN);
+
+	// Render blue horizontal line
+	gDebugDraw.line(0, SCREEN_HEIGHT / 2, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2, DEBUG_BLUE);
+
+	// Draw vertical line of yellow dots
+	for (int i = 0; i < SCREEN_HEIGHT; i += 4) {
+		gDebugDraw.point(SCREEN_WIDTH / 2, i, DEBUG_YELLOW);
+	}
+
+	// Draw the queued shapes into the target
+	gDebugDraw.flush(gRenderer);
+
+	// Reset render target
+	SDL_SetRenderTarget(gRenderer, NULL);
+}
+
 int main(int argc, char* args[])
 {
+	// Rotate the target through pre-rotated copies
+	gUseRotationCache = argc > 1 && strcmp(args[1], "--rotation-cache") == 0;
+
 	//Start up SDL and create window
 	if (!init())
 	{
@@ -513,6 +1191,9 @@ int main(int argc, char* args[])
 			double angle = 0;
 			SDL_Point screenCenter = { SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
 
+			// The shapes don't change, so they are drawn into the target once
+			drawScene();
+
 			//While application is running
 			while (!quit)
 			{
@@ -524,6 +1205,11 @@ int main(int argc, char* args[])
 					{
 						quit = true;
 					}
+					//Target textures lost their contents
+					else if (e.type == SDL_RENDER_TARGETS_RESET)
+					{
+						drawScene();
+					}
 				}
 
 				// Rotate
@@ -532,36 +1218,6 @@ int main(int argc, char* args[])
 					angle -= 360;
 				}
 
-				// Set self as render target
-				gTargetTexture.setAsRenderTarget();
-
-				//Clear screen
-				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0xFF, 0xFF);
-				SDL_RenderClear(gRenderer);
-
-				// Render red filled quad
-				SDL_Rect fillRect = { SCREEN_WIDTH / 4, SCREEN_HEIGHT / 4, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2 };
-				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0x00, 0x00, 0xFF);
-				SDL_RenderFillRect(gRenderer, &fillRect);
-
-				// Render green outlined quad
-				SDL_Rect outlineRect = { SCREEN_WIDTH / 6, SCREEN_HEIGHT / 6, SCREEN_WIDTH * 2 / 3, SCREEN_HEIGHT * 2 / 3 };
-				SDL_SetRenderDrawColor(gRenderer, 0x00, 0xFF, 0x00, 0xFF);
-				SDL_RenderDrawRect(gRenderer, &outlineRect);
-
-				// Render blue horizontal line
-				SDL_SetRenderDrawColor(gRenderer, 0x00, 0x00, 0xFF, 0xFF);
-				SDL_RenderDrawLine(gRenderer, 0, SCREEN_HEIGHT / 2, SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
-
-				// Draw vertical line of yellow dots
-				SDL_SetRenderDrawColor(gRenderer, 0xFF, 0xFF, 0x00, 0xFF);
-				for (int i = 0; i < SCREEN_HEIGHT; i += 4) {
-					SDL_RenderDrawPoint(gRenderer, SCREEN_WIDTH / 2, i);
-				}
-
-				// Reset render target
-				SDL_SetRenderTarget(gRenderer, NULL);
-
 				// Show rendererd to texture
 				gTargetTexture.render(0, 0, NULL, angle, &screenCenter);
 
@@ -1,19 +1,178 @@
-//Using SDL, SDL OpenGL, GLEW, standard IO, and strings
+//Using SDL, SDL OpenGL, GLEW, standard IO, standard library, vectors, and strings
 #include <SDL.h>
 #include <GL\glew.h>
 #include <SDL_opengl.h>
 #include <gl\glu.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
+#include <string.h>
+#include <vector>
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 
+// Sprite constants
+const int SPRITE_SIZE = 8;
+const int SPRITE_TEXTURE_SIZE = 32;
+const int DEFAULT_SPRITES = 1000;
+
+// Most sprites a batch holds before it has to draw
+const int MAX_BATCH_SPRITES = 65536;
+
+// Particle constants
+const int PARTICLE_SIZE = 4;
+const int PARTICLE_SPREAD = 25;
+const int PARTICLE_LIFETIME = 10;
+const int PARTICLE_TYPES = 3;
+const int DEFAULT_PARTICLES = 10000;
+
+// Benchmark constants
+const int BENCHMARK_SPRITES = 100000;
+const int BENCHMARK_PARTICLES = 1000000;
+const int BENCHMARK_EMITTERS = 16;
+const int BENCHMARK_FRAMES = 300;
+
+// Per instance sprite data as the shader reads it
+struct SpriteInstance {
+
+	// Screen position and size in pixels
+	GLfloat x, y, w, h;
+
+	// Texture region in normalized coordinates
+	GLfloat u, v, uw, vh;
+
+	// Color modulation
+	GLubyte r, g, b, a;
+};
+
+// Per instance particle data as the shader reads it
+struct ParticleInstance {
+
+	// Screen position in pixels
+	GLfloat x, y;
+
+	// Parity of the frame the particle was spawned on, all the shimmer needs
+	// and small enough that a float never loses it
+	GLfloat birthFrame;
+
+	// Color type
+	GLfloat type;
+};
+
+// A sprite that bounces around the screen
+struct Mover {
+
+	// Position and velocity in pixels per frame
+	GLfloat x, y;
+	GLfloat velX, velY;
+
+	// Color modulation
+	GLubyte r, g, b;
+};
+
+// Draws textured quads as instances of one unit quad
+class LSpriteBatch {
+public:
+
+	// Initializes variables
+	LSpriteBatch();
+
+	// Deallocates memory
+	~LSpriteBatch();
+
+	// Compiles the sprite shader and creates the buffers
+	bool init(int capacity);
+
+	// Deallocates the shader and buffers
+	void free();
+
+	// Starts a batch with the given texture over a screen of the given size
+	void begin(GLuint texture, int screenWidth, int screenHeight);
+
+	// Queues a sprite, drawing the batch when it is full
+	void draw(const SpriteInstance& sprite);
+
+	// Draws the queued sprites
+	void end();
+
+	// Draw calls issued since the last begin
+	int getDrawCalls();
+
+private:
+
+	// Uploads the queued sprites and draws them in one instanced call
+	void flush();
+
+	// Sprite shader
+	GLuint mProgramID;
+	GLint mScreenSizeLocation;
+	GLint mTextureLocation;
+
+	// Unit quad and instance buffers
+	GLuint mVAO;
+	GLuint mQuadVBO;
+	GLuint mQuadIBO;
+	GLuint mInstanceVBO;
+
+	// Instance buffer mapping, orphaned on every map so the driver never stalls
+	SpriteInstance* mMapped;
+	int mCapacity;
+	int mCount;
+
+	// Draw calls since the last begin
+	int mDrawCalls;
+};
+
+// Particle emitter drawn with one instanced call, animated and shimmered in the shader
+class LParticleEmitter {
+public:
+
+	// Initializes variables
+	LParticleEmitter();
+
+	// Deallocates memory
+	~LParticleEmitter();
+
+	// Creates the particle buffers and spawns every particle at the given point
+	bool init(int count, GLfloat x, GLfloat y, Uint32 frame);
+
+	// Deallocates the buffers
+	void free();
+
+	// Respawns the particles whose generation expires this frame at the given point
+	void update(GLfloat x, GLfloat y, Uint32 frame);
+
+	// Draws every particle, the particle program must be bound
+	void render();
+
+	// Particle count
+	int getCount();
+
+private:
+
+	// Spawns the particles in [begin, end) and uploads them
+	void spawn(int begin, int end, GLfloat x, GLfloat y, Uint32 frame);
+
+	// Unit quad and instance buffers
+	GLuint mVAO;
+	GLuint mQuadVBO;
+	GLuint mQuadIBO;
+	GLuint mInstanceVBO;
+
+	// CPU copy of the instances, grouped into PARTICLE_LIFETIME contiguous generations
+	std::vector<ParticleInstance> mParticles;
+	int mGenerationSize;
+
+	// Random state for spawn offsets
+	Uint32 mSeed;
+};
+
 //Starts up SDL and creates window, and initializes OpenGL
 bool init();
 
-// Initializes matrices and clear color
+// Initializes the sprite batch, texture and clear color
 bool initGL();
 
 // Input handler
@@ -22,33 +181,417 @@ void handleKeys(unsigned char key, int x, int y);
 // Per frame update
 void update();
 
-// Renders quad to the screen	
+// Renders sprites to the screen
 void render();
 
 //Frees media and shuts down SDL
 void close();
 
 // Shader loading utility programs
+GLuint loadShader(GLenum type, const char* source);
+GLuint loadProgram(const char* vertexSource, const char* fragmentSource);
 void printProgramLog(GLuint program);
 void printShaderLog(GLuint shader);
 
-// Graphics program
-GLuint gPromgramID = 0;
-GLuint gVertexPos2DLocation = -1;
-GLuint gVBO = 0;
-GLuint gIBO = 0;
+// Creates the unit quad buffers shared by the instanced renderers in the bound vertex array
+void createUnitQuad(GLuint& vbo, GLuint& ibo);
+
+// Binds the particle program for the given frame
+void beginParticles(Uint32 frame, int screenWidth, int screenHeight);
+
+// Creates the bouncing sprites
+void createSprites(int count);
+
+// Draws frames as fast as possible and reports the timings
+void runBenchmark(int count);
+void runParticleBenchmark(int count);
+
+// Sprite shader sources
+const char* SPRITE_VERTEX_SHADER =
+	"#version 330 core\n"
+	"layout(location = 0) in vec2 aCorner;\n"
+	"layout(location = 1) in vec4 aRect;\n"
+	"layout(location = 2) in vec4 aTexRect;\n"
+	"layout(location = 3) in vec4 aColor;\n"
+	"uniform vec2 uScreenSize;\n"
+	"out vec2 vTexCoord;\n"
+	"out vec4 vColor;\n"
+	"void main() {\n"
+	"	vec2 pixel = aRect.xy + aCorner * aRect.zw;\n"
+	"	vec2 ndc = pixel / uScreenSize * 2.0 - 1.0;\n"
+	"	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);\n"
+	"	vTexCoord = aTexRect.xy + aCorner * aTexRect.zw;\n"
+	"	vColor = aColor;\n"
+	"}\n";
+
+const char* SPRITE_FRAGMENT_SHADER =
+	"#version 330 core\n"
+	"in vec2 vTexCoord;\n"
+	"in vec4 vColor;\n"
+	"uniform sampler2D uTexture;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"	fragColor = texture(uTexture, vTexCoord) * vColor;\n"
+	"}\n";
+
+// Particle shader sources
+const char* PARTICLE_VERTEX_SHADER =
+	"#version 330 core\n"
+	"layout(location = 0) in vec2 aCorner;\n"
+	"layout(location = 1) in vec4 aParticle;\n"
+	"uniform vec2 uScreenSize;\n"
+	"uniform float uSize;\n"
+	"uniform float uFrame;\n"
+	"uniform vec4 uColors[3];\n"
+	"out vec2 vTexCoord;\n"
+	"out vec4 vColor;\n"
+	"flat out float vShimmer;\n"
+	"void main() {\n"
+	"	vec2 pixel = aParticle.xy + aCorner * uSize;\n"
+	"	vec2 ndc = pixel / uScreenSize * 2.0 - 1.0;\n"
+	"	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);\n"
+	"	vTexCoord = aCorner;\n"
+	"	vColor = uColors[int(aParticle.w)];\n"
+	"	vShimmer = mod(uFrame - aParticle.z, 2.0) < 0.5 ? 1.0 : 0.0;\n"
+	"}\n";
+
+const char* PARTICLE_FRAGMENT_SHADER =
+	"#version 330 core\n"
+	"in vec2 vTexCoord;\n"
+	"in vec4 vColor;\n"
+	"flat in float vShimmer;\n"
+	"uniform sampler2D uTexture;\n"
+	"out vec4 fragColor;\n"
+	"void main() {\n"
+	"	vec4 color = texture(uTexture, vTexCoord) * vColor;\n"
+	"	color.rgb = mix(color.rgb, vec3(1.0), vShimmer * 0.75);\n"
+	"	fragColor = color;\n"
+	"}\n";
 
 //The window we'll be rendering to
 SDL_Window* gWindow = NULL;
 
-//The window renderer
-SDL_Renderer* gRenderer = NULL;
-
 // OpenGL context
 SDL_GLContext gContext;
 
-// Render flag
+// Sprite renderer and texture
+LSpriteBatch gSpriteBatch;
+GLuint gSpriteTexture = 0;
+
+// The bouncing sprites
+std::vector<Mover> gSprites;
+
+// Particle program, every emitter shares it
+GLuint gParticleProgramID = 0;
+GLint gParticleScreenSizeLocation = -1;
+GLint gParticleSizeLocation = -1;
+GLint gParticleFrameLocation = -1;
+GLint gParticleColorsLocation = -1;
+GLint gParticleTextureLocation = -1;
+
+// Particle emitter that follows the mouse
+LParticleEmitter gEmitter;
+
+// Frames rendered so far, drives particle animation
+Uint32 gFrame = 0;
+
+// Render flags
 bool gRenderQuad = true;
+bool gRenderParticles = false;
+
+LSpriteBatch::LSpriteBatch() {
+
+	// Initialize
+	mProgramID = 0;
+	mScreenSizeLocation = -1;
+	mTextureLocation = -1;
+	mVAO = 0;
+	mQuadVBO = 0;
+	mQuadIBO = 0;
+	mInstanceVBO = 0;
+	mMapped = NULL;
+	mCapacity = 0;
+	mCount = 0;
+	mDrawCalls = 0;
+}
+
+LSpriteBatch::~LSpriteBatch() {
+
+	// Deallocate
+	free();
+}
+
+bool LSpriteBatch::init(int capacity) {
+
+	// Get rid of preexisting batch
+	free();
+
+	// Build the sprite shader
+	mProgramID = loadProgram(SPRITE_VERTEX_SHADER, SPRITE_FRAGMENT_SHADER);
+	if (mProgramID == 0) {
+		return false;
+	}
+
+	// Get the uniforms
+	mScreenSizeLocation = glGetUniformLocation(mProgramID, "uScreenSize");
+	mTextureLocation = glGetUniformLocation(mProgramID, "uTexture");
+
+	// Create the vertex array and the static quad
+	glGenVertexArrays(1, &mVAO);
+	glBindVertexArray(mVAO);
+	createUnitQuad(mQuadVBO, mQuadIBO);
+
+	// Create the instance buffer, each attribute advances once per sprite
+	mCapacity = capacity;
+	glGenBuffers(1, &mInstanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, mCapacity * sizeof(SpriteInstance), NULL, GL_STREAM_DRAW);
+
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (const void*)offsetof(SpriteInstance, x));
+	glVertexAttribDivisor(1, 1);
+
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (const void*)offsetof(SpriteInstance, u));
+	glVertexAttribDivisor(2, 1);
+
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteInstance), (const void*)offsetof(SpriteInstance, r));
+	glVertexAttribDivisor(3, 1);
+
+	glBindVertexArray(0);
+
+	// Check for error
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		printf("Error creating sprite buffers! %s\n", gluErrorString(error));
+		free();
+		return false;
+	}
+
+	return true;
+}
+
+void LSpriteBatch::free() {
+
+	// Release the mapping before the buffer
+	if (mMapped != NULL) {
+		glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mMapped = NULL;
+	}
+
+	// Free buffers and program if they exist
+	if (mProgramID != 0) {
+		glDeleteProgram(mProgramID);
+		mProgramID = 0;
+	}
+	if (mVAO != 0) {
+		glDeleteVertexArrays(1, &mVAO);
+		glDeleteBuffers(1, &mQuadVBO);
+		glDeleteBuffers(1, &mQuadIBO);
+		glDeleteBuffers(1, &mInstanceVBO);
+		mVAO = 0;
+		mQuadVBO = 0;
+		mQuadIBO = 0;
+		mInstanceVBO = 0;
+	}
+
+	mCapacity = 0;
+	mCount = 0;
+}
+
+void LSpriteBatch::begin(GLuint texture, int screenWidth, int screenHeight) {
+
+	// Bind the sprite state once for the whole batch
+	glUseProgram(mProgramID);
+	glUniform2f(mScreenSizeLocation, (GLfloat)screenWidth, (GLfloat)screenHeight);
+	glUniform1i(mTextureLocation, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindVertexArray(mVAO);
+
+	mCount = 0;
+	mDrawCalls = 0;
+}
+
+void LSpriteBatch::draw(const SpriteInstance& sprite) {
+
+	// Map a fresh copy of the instance buffer, the old one stays with any pending draws
+	if (mMapped == NULL) {
+		glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+		mMapped = (SpriteInstance*)glMapBufferRange(GL_ARRAY_BUFFER, 0, mCapacity * sizeof(SpriteInstance), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (mMapped == NULL) {
+			return;
+		}
+	}
+
+	// Queue the sprite
+	mMapped[mCount++] = sprite;
+
+	// Draw if the batch is full
+	if (mCount == mCapacity) {
+		flush();
+	}
+}
+
+void LSpriteBatch::end() {
+
+	// Draw whatever is left
+	flush();
+
+	// Unbind the sprite state
+	glBindVertexArray(0);
+	glUseProgram(0);
+}
+
+int LSpriteBatch::getDrawCalls() {
+	return mDrawCalls;
+}
+
+void LSpriteBatch::flush() {
+
+	// Hand the written sprites back to the driver
+	if (mMapped != NULL) {
+		glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mMapped = NULL;
+	}
+
+	// Draw every queued sprite as an instance of the unit quad
+	if (mCount > 0) {
+		glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL, mCount);
+		++mDrawCalls;
+		mCount = 0;
+	}
+}
+
+LParticleEmitter::LParticleEmitter() {
+
+	// Initialize
+	mVAO = 0;
+	mQuadVBO = 0;
+	mQuadIBO = 0;
+	mInstanceVBO = 0;
+	mGenerationSize = 0;
+	mSeed = 0x9E3779B9;
+}
+
+LParticleEmitter::~LParticleEmitter() {
+
+	// Deallocate
+	free();
+}
+
+bool LParticleEmitter::init(int count, GLfloat x, GLfloat y, Uint32 frame) {
+
+	// Get rid of preexisting particles
+	free();
+
+	// Split the particles into one contiguous generation per lifetime frame
+	mParticles.resize(count);
+	mGenerationSize = (count + PARTICLE_LIFETIME - 1) / PARTICLE_LIFETIME;
+
+	// Create the vertex array and the static quad
+	glGenVertexArrays(1, &mVAO);
+	glBindVertexArray(mVAO);
+	createUnitQuad(mQuadVBO, mQuadIBO);
+
+	// Create the instance buffer, position, birth frame and type advance once per particle
+	glGenBuffers(1, &mInstanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(ParticleInstance), NULL, GL_DYNAMIC_DRAW);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(ParticleInstance), NULL);
+	glVertexAttribDivisor(1, 1);
+
+	// Spawn every generation with staggered ages so they expire on different frames
+	for (int generation = 0; generation < PARTICLE_LIFETIME; ++generation) {
+		int begin = generation * mGenerationSize;
+		int end = begin + mGenerationSize < count ? begin + mGenerationSize : count;
+		Uint32 age = (frame + PARTICLE_LIFETIME - generation) % PARTICLE_LIFETIME;
+		if (begin < end) {
+			// Offset by an even number of frames so young emitters don't go below frame 0
+			spawn(begin, end, x, y, frame + 2 * PARTICLE_LIFETIME - age);
+		}
+	}
+
+	glBindVertexArray(0);
+
+	// Check for error
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR) {
+		printf("Error creating particle buffers! %s\n", gluErrorString(error));
+		free();
+		return false;
+	}
+
+	return true;
+}
+
+void LParticleEmitter::free() {
+
+	// Free buffers if they exist
+	if (mVAO != 0) {
+		glDeleteVertexArrays(1, &mVAO);
+		glDeleteBuffers(1, &mQuadVBO);
+		glDeleteBuffers(1, &mQuadIBO);
+		glDeleteBuffers(1, &mInstanceVBO);
+		mVAO = 0;
+		mQuadVBO = 0;
+		mQuadIBO = 0;
+		mInstanceVBO = 0;
+	}
+
+	mParticles.clear();
+	mGenerationSize = 0;
+}
+
+void LParticleEmitter::update(GLfloat x, GLfloat y, Uint32 frame) {
+
+	// Only the generation born PARTICLE_LIFETIME frames ago is dead
+	int begin = (frame % PARTICLE_LIFETIME) * mGenerationSize;
+	int end = begin + mGenerationSize < (int)mParticles.size() ? begin + mGenerationSize : (int)mParticles.size();
+	if (begin < end) {
+		glBindBuffer(GL_ARRAY_BUFFER, mInstanceVBO);
+		spawn(begin, end, x, y, frame);
+	}
+}
+
+void LParticleEmitter::render() {
+
+	// Draw every particle in a single call
+	if (!mParticles.empty()) {
+		glBindVertexArray(mVAO);
+		glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL, (GLsizei)mParticles.size());
+		glBindVertexArray(0);
+	}
+}
+
+int LParticleEmitter::getCount() {
+	return (int)mParticles.size();
+}
+
+void LParticleEmitter::spawn(int begin, int end, GLfloat x, GLfloat y, Uint32 frame) {
+
+	// Scatter the particles around the emitter like the software particle engine
+	for (int i = begin; i < end; ++i) {
+
+		// Xorshift is plenty for spawn jitter and much cheaper than rand
+		mSeed ^= mSeed << 13;
+		mSeed ^= mSeed >> 17;
+		mSeed ^= mSeed << 5;
+
+		ParticleInstance& particle = mParticles[i];
+		particle.x = x - 5 + (GLfloat)(mSeed % PARTICLE_SPREAD);
+		particle.y = y - 5 + (GLfloat)((mSeed >> 8) % PARTICLE_SPREAD);
+		particle.birthFrame = (GLfloat)(frame % 2);
+		particle.type = (GLfloat)((mSeed >> 16) % PARTICLE_TYPES);
+	}
+
+	// Upload only the respawned range, the instance buffer must be bound
+	glBufferSubData(GL_ARRAY_BUFFER, begin * sizeof(ParticleInstance), (end - begin) * sizeof(ParticleInstance), &mParticles[begin]);
+}
 
 bool init()
 {
@@ -64,9 +607,9 @@ bool init()
 	else
 	{
 
-		// Use OpenGL 3.1 core
+		// Use OpenGL 3.3 core for instanced attributes
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 
 		//Create window
@@ -96,6 +639,9 @@ bool init()
 					printf("Error initializing GLEW! %s\n", glewGetErrorString(glewError));
 				}
 
+				// GLEW can leave a harmless enum error behind on core contexts
+				glGetError();
+
 				// Use vsync
 				if (SDL_GL_SetSwapInterval(1) < 0) {
 
@@ -119,37 +665,66 @@ bool initGL() {
 
 	// Set up success flag
 	bool success = true;
-	GLenum error = GL_NO_ERROR;
 
-	// Initialize Projection matrix
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
+	// Create the sprite renderer
+	if (!gSpriteBatch.init(MAX_BATCH_SPRITES)) {
 
-	// Check for error
-	error = glGetError();
-	if (error != GL_NO_ERROR) {
-
-		printf("Error initializing OpenGL! %s\n", gluErrorString(error));
+		printf("Unable to create sprite batch!\n");
 		success = false;
 	}
 
-	// Initialize Modelview Matrix
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-
-	// Check for error
-	error = glGetError();
-	if (error != GL_NO_ERROR) {
+	// Build the particle shader
+	gParticleProgramID = loadProgram(PARTICLE_VERTEX_SHADER, PARTICLE_FRAGMENT_SHADER);
+	if (gParticleProgramID == 0) {
 
-		printf("Error intializing OpenGL! %s\n", gluErrorString(error));
+		printf("Unable to create particle program!\n");
 		success = false;
 	}
+	else {
+
+		// Get the uniforms
+		gParticleScreenSizeLocation = glGetUniformLocation(gParticleProgramID, "uScreenSize");
+		gParticleSizeLocation = glGetUniformLocation(gParticleProgramID, "uSize");
+		gParticleFrameLocation = glGetUniformLocation(gParticleProgramID, "uFrame");
+		gParticleColorsLocation = glGetUniformLocation(gParticleProgramID, "uColors");
+		gParticleTextureLocation = glGetUniformLocation(gParticleProgramID, "uTexture");
+	}
+
+	// Generate a soft round sprite
+	std::vector<GLubyte> pixels(SPRITE_TEXTURE_SIZE * SPRITE_TEXTURE_SIZE * 4);
+	GLfloat radius = SPRITE_TEXTURE_SIZE / 2.f;
+	for (int y = 0; y < SPRITE_TEXTURE_SIZE; ++y) {
+		for (int x = 0; x < SPRITE_TEXTURE_SIZE; ++x) {
+			GLfloat dx = (x + 0.5f - radius) / radius;
+			GLfloat dy = (y + 0.5f - radius) / radius;
+			GLfloat falloff = 1.f - (dx * dx + dy * dy);
+			GLubyte* pixel = &pixels[(y * SPRITE_TEXTURE_SIZE + x) * 4];
+			pixel[0] = 0xFF;
+			pixel[1] = 0xFF;
+			pixel[2] = 0xFF;
+			pixel[3] = falloff > 0.f ? (GLubyte)(falloff * 0xFF) : 0;
+		}
+	}
+
+	// Upload the sprite texture
+	glGenTextures(1, &gSpriteTexture);
+	glBindTexture(GL_TEXTURE_2D, gSpriteTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SPRITE_TEXTURE_SIZE, SPRITE_TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Blend sprites over each other
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	// Initialize clear color
 	glClearColor(0.f, 0.f, 0.f, 1.f);
 
 	// Check for error
-	error = glGetError();
+	GLenum error = glGetError();
 	if (error != GL_NO_ERROR) {
 
 		printf("Error initializing OpenGL! %s\n", gluErrorString(error));
@@ -159,18 +734,194 @@ bool initGL() {
 	return success;
 }
 
+GLuint loadProgram(const char* vertexSource, const char* fragmentSource) {
+
+	// Compile the shaders
+	GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
+	GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentSource);
+	if (vertexShader == 0 || fragmentShader == 0) {
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return 0;
+	}
+
+	// Link the program
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glLinkProgram(program);
+
+	// The program keeps the compiled shaders
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	// Check for errors
+	GLint programSuccess = GL_TRUE;
+	glGetProgramiv(program, GL_LINK_STATUS, &programSuccess);
+	if (programSuccess != GL_TRUE) {
+		printf("Error linking program %d!\n", program);
+		printProgramLog(program);
+		glDeleteProgram(program);
+		program = 0;
+	}
+
+	return program;
+}
+
+void createUnitQuad(GLuint& vbo, GLuint& ibo) {
+
+	// Unit quad corners and indices
+	GLfloat corners[] = { 0.f, 0.f, 1.f, 0.f, 1.f, 1.f, 0.f, 1.f };
+	GLuint indices[] = { 0, 1, 2, 0, 2, 3 };
+
+	// Upload the corners as attribute 0
+	glGenBuffers(1, &vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), NULL);
+
+	// Upload the indices
+	glGenBuffers(1, &ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+}
+
+void beginParticles(Uint32 frame, int screenWidth, int screenHeight) {
+
+	// Red, green and blue particles as in the software particle engine
+	GLfloat colors[PARTICLE_TYPES * 4] = {
+		1.f, 0.f, 0.f, 1.f,
+		0.f, 1.f, 0.f, 1.f,
+		0.f, 0.f, 1.f, 1.f
+	};
+
+	// Bind the particle state once for every emitter
+	glUseProgram(gParticleProgramID);
+	glUniform2f(gParticleScreenSizeLocation, (GLfloat)screenWidth, (GLfloat)screenHeight);
+	glUniform1f(gParticleSizeLocation, (GLfloat)PARTICLE_SIZE);
+	glUniform1f(gParticleFrameLocation, (GLfloat)(frame % 2));
+	glUniform4fv(gParticleColorsLocation, PARTICLE_TYPES, colors);
+	glUniform1i(gParticleTextureLocation, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, gSpriteTexture);
+}
+
+GLuint loadShader(GLenum type, const char* source) {
+
+	// Compile the shader source
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	// Check for errors
+	GLint shaderCompiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+	if (shaderCompiled != GL_TRUE) {
+
+		printf("Unable to compile shader %d!\n", shader);
+		printShaderLog(shader);
+		glDeleteShader(shader);
+		shader = 0;
+	}
+
+	return shader;
+}
+
+void printProgramLog(GLuint program) {
+
+	// Make sure name is program
+	if (glIsProgram(program)) {
+
+		// Get the log length
+		int infoLogLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+		// Get the info log
+		std::vector<char> infoLog(infoLogLength + 1, '\0');
+		glGetProgramInfoLog(program, infoLogLength, NULL, &infoLog[0]);
+		printf("%s\n", &infoLog[0]);
+	}
+	else {
+
+		printf("Name %d is not a program\n", program);
+	}
+}
+
+void printShaderLog(GLuint shader) {
+
+	// Make sure name is shader
+	if (glIsShader(shader)) {
+
+		// Get the log length
+		int infoLogLength = 0;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+		// Get the info log
+		std::vector<char> infoLog(infoLogLength + 1, '\0');
+		glGetShaderInfoLog(shader, infoLogLength, NULL, &infoLog[0]);
+		printf("%s\n", &infoLog[0]);
+	}
+	else {
+
+		printf("Name %d is not a shader\n", shader);
+	}
+}
+
 void handleKeys(unsigned char key, int x, int y) {
 
-	// Toggle quad
+	// Toggle sprites
 	if (key == 'q') {
 
 		gRenderQuad = !gRenderQuad;
 	}
+	// Toggle particles
+	else if (key == 'p') {
+
+		gRenderParticles = !gRenderParticles;
+	}
+}
+
+void createSprites(int count) {
+
+	// Scatter the sprites with random velocities and colors
+	gSprites.resize(count);
+	for (int i = 0; i < count; ++i) {
+		Mover& sprite = gSprites[i];
+		sprite.x = (GLfloat)(rand() % (SCREEN_WIDTH - SPRITE_SIZE));
+		sprite.y = (GLfloat)(rand() % (SCREEN_HEIGHT - SPRITE_SIZE));
+		sprite.velX = (rand() % 401 - 200) / 100.f;
+		sprite.velY = (rand() % 401 - 200) / 100.f;
+		sprite.r = 0x40 + rand() % 0xC0;
+		sprite.g = 0x40 + rand() % 0xC0;
+		sprite.b = 0x40 + rand() % 0xC0;
+	}
 }
 
 void update() {
 
-	// No per frame update needed
+	// Respawn the expiring particle generation under the mouse
+	if (gRenderParticles) {
+		int x = 0, y = 0;
+		SDL_GetMouseState(&x, &y);
+		gEmitter.update((GLfloat)x, (GLfloat)y, gFrame);
+	}
+
+	// Move the sprites and bounce them off the screen edges
+	for (size_t i = 0; i < gSprites.size(); ++i) {
+		Mover& sprite = gSprites[i];
+		sprite.x += sprite.velX;
+		sprite.y += sprite.velY;
+
+		if (sprite.x < 0 || sprite.x > SCREEN_WIDTH - SPRITE_SIZE) {
+			sprite.velX = -sprite.velX;
+			sprite.x += sprite.velX;
+		}
+		if (sprite.y < 0 || sprite.y > SCREEN_HEIGHT - SPRITE_SIZE) {
+			sprite.velY = -sprite.velY;
+			sprite.y += sprite.velY;
+		}
+	}
 }
 
 void render()
@@ -178,21 +929,104 @@ void render()
 	//Clear color buffer
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	//Render quad
+	//Render sprites
 	if (gRenderQuad)
 	{
-		glBegin(GL_QUADS);
-		glVertex2f(-0.5f, -0.5f);
-		glVertex2f(0.5f, -0.5f);
-		glVertex2f(0.5f, 0.5f);
-		glVertex2f(-0.5f, 0.5f);
-		glEnd();
+		gSpriteBatch.begin(gSpriteTexture, SCREEN_WIDTH, SCREEN_HEIGHT);
+		for (size_t i = 0; i < gSprites.size(); ++i) {
+			const Mover& mover = gSprites[i];
+			SpriteInstance sprite = { mover.x, mover.y, SPRITE_SIZE, SPRITE_SIZE, 0.f, 0.f, 1.f, 1.f, mover.r, mover.g, mover.b, 0xFF };
+			gSpriteBatch.draw(sprite);
+		}
+		gSpriteBatch.end();
+	}
+
+	//Render particles
+	if (gRenderParticles)
+	{
+		beginParticles(gFrame, SCREEN_WIDTH, SCREEN_HEIGHT);
+		gEmitter.render();
+		glUseProgram(0);
+	}
+}
+
+void runBenchmark(int count) {
+
+	// Draw as fast as the driver allows
+	SDL_GL_SetSwapInterval(0);
+	createSprites(count);
+
+	// Time the frames, waiting on the GPU so software GL is measured honestly
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (int frame = 0; frame < BENCHMARK_FRAMES; ++frame) {
+		SDL_PumpEvents();
+		update();
+		render();
+		glFinish();
+		SDL_GL_SwapWindow(gWindow);
 	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	// Report the timings
+	double totalMs = (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	printf("Sprites: %d Frames: %d Draw calls per frame: %d\n", count, BENCHMARK_FRAMES, gSpriteBatch.getDrawCalls());
+	printf("Average frame: %.3f ms (%.1f fps) Renderer: %s\n", totalMs / BENCHMARK_FRAMES, BENCHMARK_FRAMES * 1000.0 / totalMs, glGetString(GL_RENDERER));
+}
+
+void runParticleBenchmark(int count) {
+
+	// Draw as fast as the driver allows
+	SDL_GL_SetSwapInterval(0);
+	gRenderQuad = false;
+	gRenderParticles = false;
+
+	// Spread the particles over a grid of emitters
+	LParticleEmitter emitters[BENCHMARK_EMITTERS];
+	int columns = 4;
+	for (int i = 0; i < BENCHMARK_EMITTERS; ++i) {
+		GLfloat x = (i % columns + 0.5f) * SCREEN_WIDTH / columns;
+		GLfloat y = (i / columns + 0.5f) * SCREEN_HEIGHT / (BENCHMARK_EMITTERS / columns);
+		emitters[i].init(count / BENCHMARK_EMITTERS, x, y, 0);
+	}
+
+	// Time the frames, waiting on the GPU so software GL is measured honestly
+	Uint64 start = SDL_GetPerformanceCounter();
+	for (Uint32 frame = 1; frame <= BENCHMARK_FRAMES; ++frame) {
+		SDL_PumpEvents();
+		glClear(GL_COLOR_BUFFER_BIT);
+		beginParticles(frame, SCREEN_WIDTH, SCREEN_HEIGHT);
+		for (int i = 0; i < BENCHMARK_EMITTERS; ++i) {
+			emitters[i].update((GLfloat)(i % columns + 0.5f) * SCREEN_WIDTH / columns, (GLfloat)(i / columns + 0.5f) * SCREEN_HEIGHT / (BENCHMARK_EMITTERS / columns), frame);
+			emitters[i].render();
+		}
+		glUseProgram(0);
+		glFinish();
+		SDL_GL_SwapWindow(gWindow);
+	}
+	Uint64 end = SDL_GetPerformanceCounter();
+
+	// Report the timings
+	double totalMs = (double)(end - start) * 1000.0 / SDL_GetPerformanceFrequency();
+	printf("Particles: %d Emitters: %d Frames: %d Draw calls per frame: %d\n", emitters[0].getCount() * BENCHMARK_EMITTERS, BENCHMARK_EMITTERS, BENCHMARK_FRAMES, BENCHMARK_EMITTERS);
+	printf("Average frame: %.3f ms (%.1f fps) Renderer: %s\n", totalMs / BENCHMARK_FRAMES, BENCHMARK_FRAMES * 1000.0 / totalMs, glGetString(GL_RENDERER));
 }
 
 void close()
 {
-	//Destroy window	
+	// Free GL resources while the context is alive
+	gSpriteBatch.free();
+	gEmitter.free();
+	if (gParticleProgramID != 0) {
+		glDeleteProgram(gParticleProgramID);
+		gParticleProgramID = 0;
+	}
+	if (gSpriteTexture != 0) {
+		glDeleteTextures(1, &gSpriteTexture);
+		gSpriteTexture = 0;
+	}
+	SDL_GL_DeleteContext(gContext);
+
+	//Destroy window
 	SDL_DestroyWindow(gWindow);
 	gWindow = NULL;
 
@@ -207,6 +1041,16 @@ int main(int argc, char* args[])
 	{
 		printf("Failed to initialize!\n");
 	}
+	// Run the sprite benchmark, optionally with a sprite count
+	else if (argc > 1 && strcmp(args[1], "--benchmark") == 0)
+	{
+		runBenchmark(argc > 2 ? atoi(args[2]) : BENCHMARK_SPRITES);
+	}
+	// Run the particle benchmark, optionally with a particle count
+	else if (argc > 1 && strcmp(args[1], "--particles") == 0)
+	{
+		runParticleBenchmark(argc > 2 ? atoi(args[2]) : BENCHMARK_PARTICLES);
+	}
 	else
 	{
 		//Main loop flag
@@ -215,6 +1059,10 @@ int main(int argc, char* args[])
 		//Event handler
 		SDL_Event e;
 
+		// Create the bouncing sprites and the mouse particle emitter
+		createSprites(DEFAULT_SPRITES);
+		gEmitter.init(DEFAULT_PARTICLES, SCREEN_WIDTH / 2.f, SCREEN_HEIGHT / 2.f, gFrame);
+
 		//Enable text input
 		SDL_StartTextInput();
 
@@ -238,11 +1086,15 @@ int main(int argc, char* args[])
 				}
 			}
 
-			//Render quad
+			// Move sprites
+			update();
+
+			//Render sprites
 			render();
 
 			//Update screen
 			SDL_GL_SwapWindow(gWindow);
+			++gFrame;
 		}
 
 		//Disable text input